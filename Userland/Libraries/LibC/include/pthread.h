@@ -0,0 +1,51 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _PTHREAD_H
+#define _PTHREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Each thread's FS base points at its descriptor, so self is always at %fs:0.
+struct __pthread {
+    struct __pthread* self;
+    long tid;
+    void* (*start_routine)(void*);
+    void* arg;
+};
+
+typedef struct __pthread* pthread_t;
+
+// There are no supported attributes yet, attr must be NULL.
+typedef struct {
+    int __unused;
+} pthread_attr_t;
+
+int pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start_routine)(void*), void* arg);
+void pthread_exit(void* value) __attribute__((noreturn));
+int pthread_join(pthread_t thread, void** value);
+pthread_t pthread_self(void);
+int pthread_equal(pthread_t t1, pthread_t t2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PTHREAD_H */
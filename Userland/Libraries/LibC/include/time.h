@@ -32,6 +32,15 @@ extern "C" {
 typedef unsigned long int clock_t;
 typedef unsigned long int size_t;
 typedef unsigned int time_t;
+typedef int clockid_t;
+
+#define CLOCK_REALTIME 0
+#define CLOCK_MONOTONIC 1
+
+struct timespec {
+    time_t tv_sec;
+    long tv_nsec;
+};
 
 struct tm {
     int tm_sec;   /* seconds after the minute [0-60] */
@@ -50,6 +59,8 @@ double difftime(time_t time1, time_t time0);
 time_t mktime(struct tm* timeptr);
 time_t time(time_t* timer);
 
+int clock_gettime(clockid_t clock_id, struct timespec* tp);
+
 char* asctime(const struct tm* timeptr);
 char* ctime(const time_t* timer);
 struct tm* gmtime(const time_t* timer);
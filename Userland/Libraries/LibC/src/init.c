@@ -21,6 +21,7 @@ char** environ;
 
 void __init_libc(int argc, char** argv, int envc, char** envv) {
     environ = envv;
+    __pthread_init();
     (void)argc;
     (void)argv;
     (void)envc;
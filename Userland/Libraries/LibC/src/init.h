@@ -26,6 +26,8 @@ void __init_libc(int argc, char** argv, int envc, char** env);
 
 void __stdio_init();
 
+void __pthread_init();
+
 #ifdef __cplusplus
 }
 #endif
@@ -225,14 +225,34 @@ void HeapAllocator::CheckForDeletion() {
 
 HeapAllocator g_heapAllocator;
 
+// Processes can have multiple threads, so the allocator is guarded by a simple spinlock.
+static volatile bool g_heapLock = false;
+
+static inline void heap_lock() {
+    while (__atomic_test_and_set(&g_heapLock, __ATOMIC_ACQUIRE))
+        __builtin_ia32_pause();
+}
+
+static inline void heap_unlock() {
+    __atomic_clear(&g_heapLock, __ATOMIC_RELEASE);
+}
+
 void* malloc(size_t size) {
-    return g_heapAllocator.allocate(size);
+    heap_lock();
+    void* ptr = g_heapAllocator.allocate(size);
+    heap_unlock();
+    return ptr;
 }
 
 void free(void* ptr) {
+    heap_lock();
     g_heapAllocator.free(ptr);
+    heap_unlock();
 }
 
 uint64_t get_heap_size() {
-    return g_heapAllocator.getTotalMem();
+    heap_lock();
+    uint64_t size = g_heapAllocator.getTotalMem();
+    heap_unlock();
+    return size;
 }
\ No newline at end of file
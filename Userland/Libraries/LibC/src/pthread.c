@@ -0,0 +1,84 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <kernel/threads.h>
+
+#include "init.h"
+
+static struct __pthread __main_thread;
+
+void __pthread_init() {
+    __main_thread.self = &__main_thread;
+    __main_thread.tid = 0;
+    set_tls(&__main_thread);
+}
+
+static void __pthread_start(void* data) {
+    struct __pthread* thread = (struct __pthread*)data;
+    pthread_exit(thread->start_routine(thread->arg));
+}
+
+int pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start_routine)(void*), void* arg) {
+    if (thread == NULL || start_routine == NULL || attr != NULL)
+        return EINVAL;
+    struct __pthread* t = malloc(sizeof(struct __pthread));
+    if (t == NULL)
+        return EAGAIN;
+    t->self = t;
+    t->start_routine = start_routine;
+    t->arg = arg;
+    long tid = thread_create(__pthread_start, t, t);
+    if (tid < 0) {
+        free(t);
+        return (int)-tid;
+    }
+    t->tid = tid;
+    *thread = t;
+    return 0;
+}
+
+void pthread_exit(void* value) {
+    thread_exit((unsigned long)value);
+}
+
+int pthread_join(pthread_t thread, void** value) {
+    if (thread == NULL || thread == &__main_thread)
+        return EINVAL;
+    unsigned long result = 0;
+    int status = thread_join(thread->tid, &result);
+    if (status < 0)
+        return -status;
+    if (value != NULL)
+        *value = (void*)result;
+    free(thread);
+    return 0;
+}
+
+pthread_t pthread_self(void) {
+    pthread_t self;
+    __asm__ volatile("mov %%fs:0, %0" : "=r"(self));
+    return self;
+}
+
+int pthread_equal(pthread_t t1, pthread_t t2) {
+    return t1 == t2;
+}
@@ -0,0 +1,58 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include <errno.h>
+
+#include <kernel/sysinfo.h>
+
+// FIXME: this is the time since boot, not the processor time used by the process
+clock_t clock() {
+    unsigned long ticks;
+    sysinfo_read_clock(&ticks, NULL);
+    return (clock_t)(ticks * CLOCKS_PER_SEC / 1000);
+}
+
+time_t time(time_t* timer) {
+    unsigned long ticks;
+    sysinfo_read_clock(&ticks, NULL);
+    time_t now = (time_t)(sysinfo_global()->boot_time + ticks / 1000);
+    if (timer != NULL)
+        *timer = now;
+    return now;
+}
+
+int clock_gettime(clockid_t clock_id, struct timespec* tp) {
+    if (tp == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    unsigned long ns = sysinfo_monotonic_ns();
+    switch (clock_id) {
+    case CLOCK_MONOTONIC:
+        tp->tv_sec = (time_t)(ns / 1000000000);
+        break;
+    case CLOCK_REALTIME:
+        tp->tv_sec = (time_t)(sysinfo_global()->boot_time + ns / 1000000000);
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+    tp->tv_nsec = (long)(ns % 1000000000);
+    return 0;
+}
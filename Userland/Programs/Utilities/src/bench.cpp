@@ -0,0 +1,407 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include <kernel/file.h>
+#include <kernel/memory.h>
+#include <kernel/process.h>
+#include <kernel/synchronisation.h>
+#include <kernel/syscall.h>
+#include <kernel/sysinfo.h>
+#include <kernel/threads.h>
+
+/*
+Every result is written to the debug output as a single line starting with "bench: ", so it can be picked out of the kernel log.
+Times are measured with the TSC when the kernel says it is usable, and converted to nanoseconds with the scale from the sysinfo page.
+The ping-pong, mutex, exec and wakeup tests run other copies of this program, started with "--child".
+*/
+
+#define BENCH_PAGE_SIZE 4096
+#define BENCH_FILE_PATH "/bench.tmp"
+#define BENCH_FILE_SIZE (1024 * 1024)
+#define BENCH_BLOCK_SIZE 4096
+
+#define BENCH_SYSCALL_COUNT 10000
+#define BENCH_PINGPONG_COUNT 2000
+#define BENCH_MUTEX_COUNT 2000
+#define BENCH_MMAP_COUNT 1000
+#define BENCH_FILE_COUNT (BENCH_FILE_SIZE / BENCH_BLOCK_SIZE)
+#define BENCH_EXEC_COUNT 50
+#define BENCH_SLEEP_COUNT 50
+#define BENCH_WAKEUP_COUNT 50
+#define BENCH_WAKEUP_SLEEP_MS 5
+#define BENCH_WAKEUP_LIMIT_NS 20'000'000 // the kernel's default target latency
+
+bool g_UseTSC = false;
+const char* g_Path = "/data/bin/bench";
+
+static inline uint64_t ReadTSC() {
+    uint32_t low, high;
+    __asm__ volatile("lfence\n\trdtsc" : "=a"(low), "=d"(high) :: "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline uint64_t Now() {
+    return g_UseTSC ? ReadTSC() : sysinfo_monotonic_ns();
+}
+
+static uint64_t ToNanoseconds(uint64_t delta) {
+    if (!g_UseTSC)
+        return delta;
+    const sysinfo_global_page* page = sysinfo_global();
+    return (uint64_t)(((unsigned __int128)delta * page->tsc_mult) >> page->tsc_shift);
+}
+
+static void Report(const char* format, ...) {
+    char line[256];
+    strcpy(line, "bench: ");
+    size_t prefix = strlen(line);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(&line[prefix], sizeof(line) - prefix - 1, format, args);
+    va_end(args);
+    strcat(line, "\n");
+    dbgputs(line); // a single write, so the line isn't split up by the kernel log
+}
+
+// Shell sort, so large sample sets don't need recursion or a heap allocation.
+static void SortSamples(uint64_t* samples, uint64_t count) {
+    for (uint64_t gap = count / 2; gap > 0; gap /= 2) {
+        for (uint64_t i = gap; i < count; i++) {
+            uint64_t value = samples[i];
+            uint64_t j = i;
+            for (; j >= gap && samples[j - gap] > value; j -= gap)
+                samples[j] = samples[j - gap];
+            samples[j] = value;
+        }
+    }
+}
+
+// samples are raw clock deltas, and are sorted in place. offset is taken off every reported value, stopping at 0.
+static void ReportSamples(const char* name, uint64_t* samples, uint64_t count, uint64_t offset = 0) {
+    if (count == 0) {
+        Report("%s failed", name);
+        return;
+    }
+    SortSamples(samples, count);
+    uint64_t indices[] = {0, count / 2, (count * 9) / 10, (count * 99) / 100, count - 1};
+    uint64_t values[5];
+    for (int i = 0; i < 5; i++) {
+        uint64_t ns = ToNanoseconds(samples[indices[i]]);
+        values[i] = ns > offset ? ns - offset : 0;
+    }
+    Report("%s n=%lu min=%lu p50=%lu p90=%lu p99=%lu max=%lu ns", name, count, values[0], values[1], values[2], values[3], values[4]);
+}
+
+static uint64_t* AllocateSamples(uint64_t count) {
+    return (uint64_t*)malloc(count * sizeof(uint64_t));
+}
+
+static bool IsMapError(void* address) {
+    return (uint64_t)address >= (uint64_t)-100;
+}
+
+// Start a copy of this program in child mode. Returns the PID, or a negative error.
+static pid_t StartChild(const char* mode, long arg0, long arg1, long count) {
+    char args[3][24];
+    snprintf(args[0], sizeof(args[0]), "%ld", arg0);
+    snprintf(args[1], sizeof(args[1]), "%ld", arg1);
+    snprintf(args[2], sizeof(args[2]), "%ld", count);
+    char* const argv[] = {(char*)g_Path, (char*)"--child", (char*)mode, args[0], args[1], args[2], nullptr};
+    char* const envv[] = {nullptr};
+    return exec(g_Path, argv, envv);
+}
+
+static void Bench_Syscall() {
+    uint64_t* samples = AllocateSamples(BENCH_SYSCALL_COUNT);
+    for (uint64_t i = 0; i < BENCH_SYSCALL_COUNT; i++) {
+        uint64_t start = Now();
+        (void)system_call(SC_GETPID, 0, 0, 0);
+        samples[i] = Now() - start;
+    }
+    ReportSamples("getpid syscall", samples, BENCH_SYSCALL_COUNT);
+    free(samples);
+}
+
+// Round trip of waking another process and being woken by it in turn.
+static void Bench_PingPong() {
+    int ping = create_semaphore(0);
+    int pong = create_semaphore(0);
+    uint64_t* samples = AllocateSamples(BENCH_PINGPONG_COUNT);
+    uint64_t count = 0;
+    if (ping >= 0 && pong >= 0 && StartChild("pingpong", ping, pong, BENCH_PINGPONG_COUNT) >= 0) {
+        for (; count < BENCH_PINGPONG_COUNT; count++) {
+            uint64_t start = Now();
+            release_semaphore(ping);
+            acquire_semaphore(pong);
+            samples[count] = Now() - start;
+        }
+    }
+    ReportSamples("semaphore ping-pong", samples, count);
+    free(samples);
+    destroy_semaphore(ping);
+    destroy_semaphore(pong);
+}
+
+// Time to take a mutex that another process is taking and dropping in a loop.
+static void Bench_Mutex() {
+    int mutex = create_mutex();
+    int done = create_semaphore(0);
+    uint64_t* samples = AllocateSamples(BENCH_MUTEX_COUNT);
+    uint64_t count = 0;
+    if (mutex >= 0 && done >= 0 && StartChild("mutex", mutex, done, BENCH_MUTEX_COUNT) >= 0) {
+        acquire_semaphore(done); // the child has started
+        for (; count < BENCH_MUTEX_COUNT; count++) {
+            uint64_t start = Now();
+            acquire_mutex(mutex);
+            samples[count] = Now() - start;
+            release_mutex(mutex);
+        }
+        acquire_semaphore(done); // the child has finished
+    }
+    ReportSamples("contended mutex acquire", samples, count);
+    free(samples);
+    destroy_mutex(mutex);
+    destroy_semaphore(done);
+}
+
+static void Bench_Memory(uint64_t pages) {
+    uint64_t size = pages * BENCH_PAGE_SIZE;
+    uint64_t* map_samples = AllocateSamples(BENCH_MMAP_COUNT);
+    uint64_t* protect_samples = AllocateSamples(BENCH_MMAP_COUNT);
+    uint64_t* unmap_samples = AllocateSamples(BENCH_MMAP_COUNT);
+    uint64_t count = 0;
+    for (; count < BENCH_MMAP_COUNT; count++) {
+        uint64_t start = Now();
+        void* address = mmap(size, PROT_READ_WRITE, nullptr);
+        uint64_t mapped = Now();
+        if (IsMapError(address))
+            break;
+        int rc = mprotect(address, size, PROT_READ);
+        uint64_t protected_at = Now();
+        rc |= munmap(address, size);
+        uint64_t end = Now();
+        if (rc != 0)
+            break;
+        map_samples[count] = mapped - start;
+        protect_samples[count] = protected_at - mapped;
+        unmap_samples[count] = end - protected_at;
+    }
+    char name[48];
+    snprintf(name, sizeof(name), "mmap %lu pages", pages);
+    ReportSamples(name, map_samples, count);
+    snprintf(name, sizeof(name), "mprotect %lu pages", pages);
+    ReportSamples(name, protect_samples, count);
+    snprintf(name, sizeof(name), "munmap %lu pages", pages);
+    ReportSamples(name, unmap_samples, count);
+    free(map_samples);
+    free(protect_samples);
+    free(unmap_samples);
+}
+
+// Each sample is one block, either in order through the file or at a random block.
+// The sequential write runs first, straight after the file is opened, as seeking an empty file fails.
+static void Bench_FileIO(fd_t file, bool write_blocks, bool random, uint8_t* block) {
+    uint64_t* samples = AllocateSamples(BENCH_FILE_COUNT);
+    uint64_t count = 0;
+    if ((write_blocks && !random) || seek(file, 0, SEEK_SET) >= 0) {
+        for (; count < BENCH_FILE_COUNT; count++) {
+            uint64_t start = Now();
+            if (random && seek(file, (rand() % BENCH_FILE_COUNT) * BENCH_BLOCK_SIZE, SEEK_SET) < 0)
+                break;
+            long rc = write_blocks ? write(file, block, BENCH_BLOCK_SIZE) : read(file, block, BENCH_BLOCK_SIZE);
+            samples[count] = Now() - start;
+            if (rc != BENCH_BLOCK_SIZE)
+                break;
+        }
+    }
+    char name[48];
+    snprintf(name, sizeof(name), "tmpfs %s %s %d bytes", random ? "random" : "sequential", write_blocks ? "write" : "read", BENCH_BLOCK_SIZE);
+    ReportSamples(name, samples, count);
+    free(samples);
+}
+
+static void Bench_File() {
+    fd_t file = open(BENCH_FILE_PATH, O_CREATE | O_READ | O_WRITE, 00644);
+    if (file < 0) {
+        Report("tmpfs failed to open %s: %ld", BENCH_FILE_PATH, file);
+        return;
+    }
+    uint8_t* block = (uint8_t*)malloc(BENCH_BLOCK_SIZE);
+    memset(block, 0xA5, BENCH_BLOCK_SIZE);
+    srand(1); // the same offsets every run
+    Bench_FileIO(file, true, false, block); // also sizes the file for the rest
+    Bench_FileIO(file, false, false, block);
+    Bench_FileIO(file, true, true, block);
+    Bench_FileIO(file, false, true, block);
+    free(block);
+    close(file);
+}
+
+// From the call to exec until the new process is running its own code.
+static void Bench_Exec() {
+    int started = create_semaphore(0);
+    uint64_t* samples = AllocateSamples(BENCH_EXEC_COUNT);
+    uint64_t count = 0;
+    for (; started >= 0 && count < BENCH_EXEC_COUNT; count++) {
+        uint64_t start = Now();
+        if (StartChild("exec", started, 0, 0) < 0)
+            break;
+        acquire_semaphore(started);
+        samples[count] = Now() - start;
+    }
+    ReportSamples("exec to first instruction", samples, count);
+    free(samples);
+    destroy_semaphore(started);
+}
+
+// How far past the requested time msleep returns.
+static void Bench_Sleep(unsigned long ms) {
+    uint64_t* samples = AllocateSamples(BENCH_SLEEP_COUNT);
+    for (uint64_t i = 0; i < BENCH_SLEEP_COUNT; i++) {
+        uint64_t start = Now();
+        msleep(ms);
+        samples[i] = Now() - start;
+    }
+    char name[48];
+    snprintf(name, sizeof(name), "msleep(%lu) overshoot", ms);
+    ReportSamples(name, samples, BENCH_SLEEP_COUNT, ms * 1'000'000);
+    free(samples);
+}
+
+/*
+How late a thread that sleeps runs again while every CPU is kept busy by a process that never sleeps.
+A woken thread should be placed ahead of the hogs and preempt one of them, rather than waiting behind them for a whole period.
+*/
+static void Bench_Wakeup() {
+    uint64_t cpus = sysinfo_global()->cpu_count;
+    int started = create_semaphore(0);
+    uint64_t hogs = 0;
+    // Each hog spins for long enough to cover every sample, even if all of them are late
+    for (; started >= 0 && hogs < cpus; hogs++) {
+        if (StartChild("hog", started, BENCH_WAKEUP_COUNT * (BENCH_WAKEUP_SLEEP_MS + BENCH_WAKEUP_LIMIT_NS / 1'000'000), 0) < 0)
+            break;
+    }
+    for (uint64_t i = 0; i < hogs; i++)
+        acquire_semaphore(started);
+    uint64_t* samples = AllocateSamples(BENCH_WAKEUP_COUNT);
+    uint64_t count = 0;
+    if (hogs == cpus) {
+        for (; count < BENCH_WAKEUP_COUNT; count++) {
+            uint64_t start = Now();
+            msleep(BENCH_WAKEUP_SLEEP_MS);
+            samples[count] = Now() - start;
+        }
+    }
+    char name[48];
+    snprintf(name, sizeof(name), "msleep(%d) overshoot behind %lu hogs", BENCH_WAKEUP_SLEEP_MS, hogs);
+    ReportSamples(name, samples, count, BENCH_WAKEUP_SLEEP_MS * 1'000'000);
+    if (count > 0) {
+        uint64_t worst = ToNanoseconds(samples[count - 1]); // sorted by ReportSamples
+        worst = worst > BENCH_WAKEUP_SLEEP_MS * 1'000'000 ? worst - BENCH_WAKEUP_SLEEP_MS * 1'000'000 : 0;
+        Report("wakeup %s, worst overshoot %lu ns, limit %lu ns", worst < BENCH_WAKEUP_LIMIT_NS ? "PASS" : "FAIL", worst, (uint64_t)BENCH_WAKEUP_LIMIT_NS);
+    }
+    free(samples);
+    for (uint64_t i = 0; i < hogs; i++)
+        acquire_semaphore(started); // wait for the hogs to finish, so they don't skew anything run after this
+    destroy_semaphore(started);
+}
+
+static int RunChild(int argc, char** argv) {
+    if (argc < 6)
+        return 1;
+    const char* mode = argv[2];
+    int arg0 = atoi(argv[3]);
+    int arg1 = atoi(argv[4]);
+    long count = atoi(argv[5]);
+    if (strcmp(mode, "pingpong") == 0) {
+        for (long i = 0; i < count; i++) {
+            acquire_semaphore(arg0);
+            release_semaphore(arg1);
+        }
+    }
+    else if (strcmp(mode, "mutex") == 0) {
+        release_semaphore(arg1);
+        for (long i = 0; i < count; i++) {
+            acquire_mutex(arg0);
+            release_mutex(arg0);
+        }
+        release_semaphore(arg1);
+    }
+    else if (strcmp(mode, "exec") == 0)
+        release_semaphore(arg0);
+    else if (strcmp(mode, "hog") == 0) {
+        release_semaphore(arg0);
+        uint64_t end = sysinfo_monotonic_ns() + (uint64_t)arg1 * 1'000'000;
+        while (sysinfo_monotonic_ns() < end)
+            __asm__ volatile("" ::: "memory");
+        release_semaphore(arg0);
+    }
+    else
+        return 1;
+    return 0;
+}
+
+static bool Selected(int argc, char** argv, const char* name) {
+    if (argc <= 1)
+        return true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Usage: bench [syscall] [pingpong] [mutex] [memory] [file] [exec] [sleep] [wakeup]. With no arguments, everything is run.
+int main(int argc, char** argv) {
+    if (argc > 0 && argv[0] != nullptr && argv[0][0] == '/')
+        g_Path = argv[0];
+    if (argc > 1 && strcmp(argv[1], "--child") == 0)
+        return RunChild(argc, argv);
+
+    g_UseTSC = sysinfo_global()->tsc_available != 0;
+    Report("start cpus=%lu clock=%s", sysinfo_global()->cpu_count, g_UseTSC ? "tsc" : "tick");
+
+    if (Selected(argc, argv, "syscall"))
+        Bench_Syscall();
+    if (Selected(argc, argv, "pingpong"))
+        Bench_PingPong();
+    if (Selected(argc, argv, "mutex"))
+        Bench_Mutex();
+    if (Selected(argc, argv, "memory")) {
+        Bench_Memory(1);
+        Bench_Memory(16);
+    }
+    if (Selected(argc, argv, "file"))
+        Bench_File();
+    if (Selected(argc, argv, "exec"))
+        Bench_Exec();
+    if (Selected(argc, argv, "sleep")) {
+        Bench_Sleep(1);
+        Bench_Sleep(10);
+    }
+    if (Selected(argc, argv, "wakeup"))
+        Bench_Wakeup();
+
+    Report("done");
+    return 0;
+}
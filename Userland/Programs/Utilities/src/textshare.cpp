@@ -0,0 +1,93 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#include <kernel/memory.h>
+#include <kernel/process.h>
+
+/*
+Checks that the pages the kernel shares between processes running the same program stay private to each of them.
+The parent tries to make a page of its text writable and writes to it if that works, writes to a page of its initialised data,
+then starts a second copy of this program with "--child", which checks it still sees the original contents of both.
+Results are written to the debug output as single lines starting with "textshare: ".
+*/
+
+#define TEXTSHARE_PAGE_SIZE 4096
+#define TEXTSHARE_TEXT_VALUE 0xCC
+#define TEXTSHARE_DATA_VALUE 0x5A
+
+// A whole page of int3 in .text, so nothing that runs shares a page with it
+__asm__(".pushsection .text\n"
+        ".balign 4096\n"
+        ".globl g_TextPage\n"
+        "g_TextPage:\n"
+        ".fill 4096, 1, 0xCC\n"
+        ".popsection");
+
+extern "C" volatile uint8_t g_TextPage[TEXTSHARE_PAGE_SIZE];
+
+// Has to be in the file rather than .bss, so it comes from the shared copy
+__attribute__((aligned(TEXTSHARE_PAGE_SIZE))) volatile uint8_t g_DataPage[TEXTSHARE_PAGE_SIZE] = {TEXTSHARE_DATA_VALUE};
+
+static void Report(const char* format, ...) {
+    char line[256];
+    strcpy(line, "textshare: ");
+    size_t prefix = strlen(line);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(&line[prefix], sizeof(line) - prefix - 1, format, args);
+    va_end(args);
+    strcat(line, "\n");
+    dbgputs(line);
+}
+
+static int RunChild() {
+    bool text_ok = g_TextPage[0] == TEXTSHARE_TEXT_VALUE;
+    bool data_ok = g_DataPage[0] == TEXTSHARE_DATA_VALUE;
+    Report("%s text=%s data=%s", (text_ok && data_ok) ? "PASS" : "FAIL", text_ok ? "unchanged" : "modified", data_ok ? "unchanged" : "modified");
+    return (text_ok && data_ok) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--child") == 0)
+        return RunChild();
+    const char* path = (argc > 0 && argv[0] != nullptr && argv[0][0] == '/') ? argv[0] : "/data/bin/textshare";
+
+    int result = mprotect((void*)g_TextPage, TEXTSHARE_PAGE_SIZE, PROT_READ_WRITE);
+    if (result == 0)
+        g_TextPage[0] = (uint8_t)~TEXTSHARE_TEXT_VALUE; // only this process's copy may change
+    Report("mprotect of a text page returned %d", result);
+
+    g_DataPage[0] = (uint8_t)~TEXTSHARE_DATA_VALUE; // copy on write
+    if (g_DataPage[0] != (uint8_t)~TEXTSHARE_DATA_VALUE) {
+        Report("FAIL write to a data page was lost");
+        return 1;
+    }
+
+    char* const child_argv[] = {(char*)path, (char*)"--child", nullptr};
+    char* const envv[] = {nullptr};
+    pid_t pid = exec(path, child_argv, envv);
+    if (pid < 0) {
+        Report("FAIL could not start %s (%d)", path, pid);
+        return 1;
+    }
+    return 0;
+}
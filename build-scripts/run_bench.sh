@@ -0,0 +1,61 @@
+#!/bin/sh
+
+# Copyright (©) 2024  Frosty515
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Exit on error
+set -e
+
+# Boot iso/hdimage.bin headless under QEMU TCG and collect the benchmark results from the debug output.
+# The kernel must have been configured with -DFROSTYOS_AUTORUN=/data/bin/bench.
+# The QEMU arguments describing the machine are passed in by the run-bench target, so they stay the same as for run-qemu.
+# Usage: run_bench.sh <results file> <timeout in seconds> <QEMU machine arguments...>
+
+if [ $# -lt 3 ]; then
+    echo "Usage: $0 <results file> <timeout in seconds> <QEMU machine arguments...>"
+    exit 1
+fi
+
+RESULTS=$1
+TIMEOUT=$2
+LOG=$RESULTS.log
+shift 2
+
+rm -f "$LOG" "$RESULTS"
+
+qemu-system-x86_64 "$@" -chardev file,id=debug,path="$LOG",mux=on -debugcon chardev:debug -serial chardev:debug -display none -machine accel=tcg &
+QEMU_PID=$!
+
+ELAPSED=0
+while ! grep -q "bench: done" "$LOG" 2>/dev/null; do
+    if ! kill -0 $QEMU_PID 2>/dev/null; then
+        echo "QEMU exited before the benchmarks finished, see $LOG"
+        exit 1
+    fi
+    if [ $ELAPSED -ge "$TIMEOUT" ]; then
+        kill $QEMU_PID
+        echo "Benchmarks did not finish within $TIMEOUT seconds, see $LOG"
+        exit 1
+    fi
+    sleep 1
+    ELAPSED=$((ELAPSED + 1))
+done
+
+kill $QEMU_PID
+wait $QEMU_PID || true
+
+# Kernel log output can land in front of a result on the same line
+grep -o "bench: .*" "$LOG" | sed "s/^bench: //" > "$RESULTS"
+cat "$RESULTS"
@@ -31,6 +31,15 @@ typedef long fd_t;
 #define SEEK_CUR 1
 #define SEEK_END 2
 
+// Read-only view of the kernel log. Not backed by the VFS, so it cannot be listed.
+#define KERNEL_LOG_PATH "/dev/kmsg"
+
+// Read-only stream of struct trace_event records, see trace.h. Tracing is enabled while it is open.
+#define KERNEL_TRACE_PATH "/dev/trace"
+
+// Write-only stream to the serial port the kernel log goes to. Fails to open with ENOENT if there is none.
+#define SERIAL_PATH "/dev/serial"
+
 #define DT_FILE 0
 #define DT_DIR 1
 #define DT_SYMLNK 2
@@ -60,6 +69,7 @@ extern "C" {
 #ifndef _IN_KERNEL
 
 #include "syscall.h"
+#include "sysinfo.h"
 
 static inline fd_t open(const char* path, unsigned long flags, unsigned short mode) {
     unsigned long ret;
@@ -92,27 +102,19 @@ static inline long seek(fd_t file, long offset, long whence) {
 }
 
 static inline unsigned int getuid() {
-    unsigned long ret;
-    __asm__ volatile("syscall" : "=a"(ret) : "a"(SC_GETUID) : "rcx", "r11", "memory");
-    return (unsigned int)ret;
+    return sysinfo_process()->uid;
 }
 
 static inline unsigned int getgid() {
-    unsigned long ret;
-    __asm__ volatile("syscall" : "=a"(ret) : "a"(SC_GETGID) : "rcx", "r11", "memory");
-    return (unsigned int)ret;
+    return sysinfo_process()->gid;
 }
 
 static inline unsigned int geteuid() {
-    unsigned long ret;
-    __asm__ volatile("syscall" : "=a"(ret) : "a"(SC_GETEUID) : "rcx", "r11", "memory");
-    return (unsigned int)ret;
+    return sysinfo_process()->euid;
 }
 
 static inline unsigned int getegid() {
-    unsigned long ret;
-    __asm__ volatile("syscall" : "=a"(ret) : "a"(SC_GETEGID) : "rcx", "r11", "memory");
-    return (unsigned int)ret;
+    return sysinfo_process()->egid;
 }
 
 static inline int stat(const char* path, struct stat_buf* buf) {
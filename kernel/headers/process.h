@@ -54,13 +54,13 @@ struct signal_action {
 #ifndef _IN_KERNEL
 
 #include "syscall.h"
+#include "sysinfo.h"
 
 static inline pid_t getpid() {
-    pid_t ret;
-    __asm__ volatile("syscall" : "=a"(ret) : "a"(SC_GETPID) : "rcx", "r11", "memory");
-    return ret;
+    return sysinfo_process()->pid;
 }
 
+// The sysinfo pages are per process, so there is nowhere to read the TID from and this is still a system call.
 static inline tid_t gettid() {
     tid_t ret;
     __asm__ volatile("syscall" : "=a"(ret) : "a"(SC_GETTID) : "rcx", "r11", "memory");
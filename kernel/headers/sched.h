@@ -0,0 +1,78 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include "process.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPU_SETSIZE 1024
+
+// One bit per CPU, numbered from 0 in the order the kernel brought them up.
+typedef struct {
+    unsigned long bits[CPU_SETSIZE / 64];
+} cpu_set_t;
+
+static inline void cpuset_zero(cpu_set_t* set) {
+    for (unsigned long i = 0; i < CPU_SETSIZE / 64; i++)
+        set->bits[i] = 0;
+}
+
+static inline void cpuset_fill(cpu_set_t* set) {
+    for (unsigned long i = 0; i < CPU_SETSIZE / 64; i++)
+        set->bits[i] = ~0UL;
+}
+
+static inline void cpuset_add(cpu_set_t* set, unsigned long cpu) {
+    if (cpu < CPU_SETSIZE)
+        set->bits[cpu / 64] |= 1UL << (cpu % 64);
+}
+
+static inline void cpuset_remove(cpu_set_t* set, unsigned long cpu) {
+    if (cpu < CPU_SETSIZE)
+        set->bits[cpu / 64] &= ~(1UL << (cpu % 64));
+}
+
+static inline int cpuset_has(const cpu_set_t* set, unsigned long cpu) {
+    return cpu < CPU_SETSIZE && (set->bits[cpu / 64] & (1UL << (cpu % 64))) != 0;
+}
+
+#ifndef _IN_KERNEL
+
+#include "syscall.h"
+
+// A TID of -1 means the calling thread. The thread only moves off a CPU it is no longer allowed on when it is next preempted or blocks.
+static inline int sched_setaffinity(tid_t tid, const cpu_set_t* set) {
+    return (int)system_call(SC_SET_AFFINITY, (unsigned long)tid, (unsigned long)set, sizeof(cpu_set_t));
+}
+
+static inline int sched_getaffinity(tid_t tid, cpu_set_t* set) {
+    return (int)system_call(SC_GET_AFFINITY, (unsigned long)tid, (unsigned long)set, sizeof(cpu_set_t));
+}
+
+#endif /* _IN_KERNEL */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SCHED_H */
@@ -62,12 +62,18 @@ enum SystemCalls {
     SC_CREATE_MUTEX = 36,
     SC_DESTROY_MUTEX = 37,
     SC_ACQUIRE_MUTEX = 38,
-    SC_RELEASE_MUTEX = 39
+    SC_RELEASE_MUTEX = 39,
+    SC_THREAD_CREATE = 40,
+    SC_THREAD_EXIT = 41,
+    SC_THREAD_JOIN = 42,
+    SC_SET_TLS = 43,
+    SC_SET_AFFINITY = 44,
+    SC_GET_AFFINITY = 45
 };
 
 #ifndef _IN_KERNEL
 
-inline unsigned long system_call(unsigned long num, unsigned long arg1, unsigned long arg2, unsigned arg3) {
+inline unsigned long system_call(unsigned long num, unsigned long arg1, unsigned long arg2, unsigned long arg3) {
     // Number is in RAX, arg1 is in RDI, arg2 is in RSI, arg3 is in RDX
     unsigned long ret;
     __asm__ volatile("syscall" : "=a"(ret) : "a"(num), "D"(arg1), "S"(arg2), "d"(arg3) : "rcx", "r11", "memory");
@@ -0,0 +1,101 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SYSINFO_H
+#define _SYSINFO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Both pages are mapped read-only into every user process by the ELF loader.
+#define SYSINFO_GLOBAL_PAGE_ADDRESS 0x7FFFFFFFE000
+#define SYSINFO_PROCESS_PAGE_ADDRESS 0x7FFFFFFFF000
+
+#define SYSINFO_VERSION 1
+
+// Shared by every process. The clock fields are protected by sequence, which is odd while the kernel is updating them.
+struct sysinfo_global_page {
+    unsigned long version;
+    volatile unsigned long sequence;
+    volatile unsigned long ticks; // milliseconds since the system timer was started
+    volatile unsigned long monotonic_ns; // time of the last tick in nanoseconds
+    volatile unsigned long boot_time; // seconds since the epoch when the system timer was started
+    volatile unsigned long cpu_count;
+    // If tsc_available is set, ns = tsc_base_ns + (((rdtsc - tsc_base) * tsc_mult) >> tsc_shift)
+    volatile unsigned long tsc_available;
+    unsigned long tsc_base;
+    unsigned long tsc_base_ns;
+    unsigned long tsc_mult;
+    unsigned long tsc_shift;
+};
+
+// One per process.
+struct sysinfo_process_page {
+    volatile long pid;
+    volatile unsigned int uid;
+    volatile unsigned int gid;
+    volatile unsigned int euid;
+    volatile unsigned int egid;
+};
+
+#ifndef _IN_KERNEL
+
+static inline const struct sysinfo_global_page* sysinfo_global() {
+    return (const struct sysinfo_global_page*)SYSINFO_GLOBAL_PAGE_ADDRESS;
+}
+
+static inline const struct sysinfo_process_page* sysinfo_process() {
+    return (const struct sysinfo_process_page*)SYSINFO_PROCESS_PAGE_ADDRESS;
+}
+
+// Read the tick count and nanosecond time of the last tick as a consistent pair.
+static inline void sysinfo_read_clock(unsigned long* ticks, unsigned long* monotonic_ns) {
+    const struct sysinfo_global_page* page = sysinfo_global();
+    unsigned long seq;
+    do {
+        seq = page->sequence;
+        __asm__ volatile("" ::: "memory");
+        if (ticks != 0)
+            *ticks = page->ticks;
+        if (monotonic_ns != 0)
+            *monotonic_ns = page->monotonic_ns;
+        __asm__ volatile("" ::: "memory");
+    } while ((seq & 1) || seq != page->sequence);
+}
+
+// Nanoseconds since the system timer was started. Only has tick resolution if the TSC is unusable.
+static inline unsigned long sysinfo_monotonic_ns() {
+    const struct sysinfo_global_page* page = sysinfo_global();
+    if (page->tsc_available) {
+        unsigned int low, high;
+        __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+        unsigned long delta = (((unsigned long)high << 32) | low) - page->tsc_base;
+        return page->tsc_base_ns + (unsigned long)(__extension__ (((unsigned __int128)delta * page->tsc_mult) >> page->tsc_shift));
+    }
+    unsigned long ns;
+    sysinfo_read_clock(0, &ns);
+    return ns;
+}
+
+#endif /* _IN_KERNEL */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SYSINFO_H */
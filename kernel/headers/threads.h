@@ -26,14 +26,33 @@ extern "C" {
 
 #include "syscall.h"
 
-void sleep(unsigned long s) {
+static inline void sleep(unsigned long s) {
     __asm__ volatile("syscall" : : "a"(SC_SLEEP), "D"(s) : "rcx", "r11", "memory");
 }
 
-void msleep(unsigned long ms) {
+static inline void msleep(unsigned long ms) {
     __asm__ volatile("syscall" : : "a"(SC_MSLEEP), "D"(ms) : "rcx", "r11", "memory");
 }
 
+// The new thread starts at entry with its own stack, and tls as its FS base. entry must not return, it has to call thread_exit. Returns the TID of the new thread.
+static inline long thread_create(void (*entry)(void*), void* arg, void* tls) {
+    return (long)system_call(SC_THREAD_CREATE, (unsigned long)entry, (unsigned long)arg, (unsigned long)tls);
+}
+
+// Exiting the main thread ends the process, with value as the exit status.
+static inline void __attribute__((noreturn)) thread_exit(unsigned long value) {
+    __asm__ volatile("syscall" : : "a"(SC_THREAD_EXIT), "D"(value) : "rcx", "r11", "memory");
+    __builtin_unreachable();
+}
+
+static inline int thread_join(long tid, unsigned long* value) {
+    return (int)system_call(SC_THREAD_JOIN, (unsigned long)tid, (unsigned long)value, 0);
+}
+
+static inline int set_tls(void* base) {
+    return (int)system_call(SC_SET_TLS, (unsigned long)base, 0, 0);
+}
+
 #else
 
 void sleep(unsigned long s);
@@ -0,0 +1,48 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reading KERNEL_TRACE_PATH returns whole struct trace_event records. The meaning of args depends on type.
+#define TRACE_CONTEXT_SWITCH 1 // args: previous TID, next TID (-1 for none)
+#define TRACE_WAKEUP 2 // args: TID of the thread made runnable
+#define TRACE_SYSCALL_ENTER 3 // args: system call number, first argument
+#define TRACE_SYSCALL_EXIT 4 // args: system call number, nanoseconds since entry
+#define TRACE_PAGE_FAULT 5 // args: faulting address, error code
+#define TRACE_IPI_SEND 6 // args: vector, destination APIC ID
+#define TRACE_IPI_RECEIVE 7 // args: vector, IPI type for NMI IPIs
+#define TRACE_KMALLOC 8 // args: size, address returned
+#define TRACE_KFREE 9 // args: address
+
+struct trace_event {
+    unsigned long timestamp; // nanoseconds of monotonic time
+    unsigned long args[2];
+    int tid; // thread running when the event was recorded, -1 for none
+    unsigned short type;
+    unsigned short cpu;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TRACE_H */
@@ -0,0 +1,50 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _RWLOCK_H
+#define _RWLOCK_H
+
+#include <spinlock.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Reader-writer spinlock for read-mostly data. Any number of readers can hold it at once.
+Writers queue on a ticket lock, and a waiting writer holds off new readers so it can't be starved.
+*/
+typedef struct {
+    spinlock_t writer;
+    unsigned long readers;
+    unsigned long writing;
+} rwlock_t;
+
+#define rwlock_init(lock) ((lock)->writer = 0, (lock)->readers = 0, (lock)->writing = 0)
+#define rwlock_new(name) rwlock_t name = {0, 0, 0}
+
+void rwlock_read_acquire(rwlock_t* lock);
+void rwlock_read_release(rwlock_t* lock);
+
+void rwlock_write_acquire(rwlock_t* lock);
+void rwlock_write_release(rwlock_t* lock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RWLOCK_H */
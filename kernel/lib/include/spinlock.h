@@ -13,6 +13,20 @@ typedef unsigned long spinlock_t;
 void spinlock_acquire(spinlock_t* lock);
 void spinlock_release(spinlock_t* lock);
 
+#ifdef LOCK_STATS
+// Builds with FROSTYOS_LOCK_STATS route every lock through these, which record contention and hold times before calling the real lock.
+void spinlock_acquire_tracked(spinlock_t* lock);
+void spinlock_release_tracked(spinlock_t* lock);
+void spinlock_destroy_tracked(spinlock_t* lock);
+
+#define spinlock_acquire(lock) spinlock_acquire_tracked(lock)
+#define spinlock_release(lock) spinlock_release_tracked(lock)
+#define spinlock_destroy(lock) spinlock_destroy_tracked(lock)
+#else
+// Call before the memory of a lock that isn't held is freed, so its statistics aren't kept or inherited by whatever is put there next.
+#define spinlock_destroy(lock) ((void)(lock))
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,18 +1,24 @@
 [bits 64]
 
+; Ticket lock. The low dword hands out tickets and the high dword is the ticket being served, so
+; waiters get the lock in the order they arrived and only read the lock's cache line while spinning.
+; A zeroed lock is unlocked.
+
 global spinlock_acquire
 spinlock_acquire:
-    lock bts QWORD [rdi], 0
-    jc .spin_with_pause
+    mov eax, 1
+    lock xadd DWORD [rdi], eax ; take a ticket
+    cmp DWORD [rdi+4], eax
+    jne .spin_with_pause
     ret
 
 .spin_with_pause:
     pause
-    test QWORD [rdi], 1
-    jnz .spin_with_pause
-    jmp spinlock_acquire
+    cmp DWORD [rdi+4], eax
+    jne .spin_with_pause
+    ret
 
 global spinlock_release
 spinlock_release:
-    mov QWORD [rdi], 0
-    ret
\ No newline at end of file
+    lock inc DWORD [rdi+4] ; serve the next ticket
+    ret
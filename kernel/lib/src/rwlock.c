@@ -0,0 +1,52 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "rwlock.h"
+
+static inline void rwlock_pause() {
+#ifdef __x86_64__
+    __builtin_ia32_pause();
+#endif
+}
+
+void rwlock_read_acquire(rwlock_t* lock) {
+    while (1) {
+        while (__atomic_load_n(&(lock->writing), __ATOMIC_RELAXED))
+            rwlock_pause();
+        __atomic_add_fetch(&(lock->readers), 1, __ATOMIC_SEQ_CST);
+        // a writer may have arrived between the check and the increment. It saw us or we see it, never neither.
+        if (!__atomic_load_n(&(lock->writing), __ATOMIC_SEQ_CST))
+            return;
+        __atomic_sub_fetch(&(lock->readers), 1, __ATOMIC_RELEASE);
+    }
+}
+
+void rwlock_read_release(rwlock_t* lock) {
+    __atomic_sub_fetch(&(lock->readers), 1, __ATOMIC_RELEASE);
+}
+
+void rwlock_write_acquire(rwlock_t* lock) {
+    spinlock_acquire(&(lock->writer));
+    __atomic_store_n(&(lock->writing), 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&(lock->readers), __ATOMIC_SEQ_CST))
+        rwlock_pause();
+}
+
+void rwlock_write_release(rwlock_t* lock) {
+    __atomic_store_n(&(lock->writing), 0, __ATOMIC_RELEASE);
+    spinlock_release(&(lock->writer));
+}
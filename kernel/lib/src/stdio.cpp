@@ -28,6 +28,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <HAL/hal.hpp>
 
+#include <Log/KernelLog.hpp>
+
 #include <file.h>
 
 #define max(a, b) ((a) > (b) ? (a) : (b))
@@ -164,6 +166,8 @@ int internal_close(fd_t file) {
         if (stream != nullptr)
             delete stream;
     }
+    else if (descriptor->GetType() == FileDescriptorType::KERNEL_LOG)
+        delete (KernelLogReader*)descriptor->GetData();
     (void)g_KFDManager->FreeFileDescriptor(file); // return value is irrelevant
     delete descriptor;
     return ESUCCESS;
@@ -234,11 +238,11 @@ void internal_fputs(const fd_t file, const char* str, bool swap, bool lock) {
 }
 
 extern "C" void dbgputc(const char c) {
-    internal_write(stddebug, &c, 1);
+    KernelLog_PutChar(LogLevel::DEBUG, c);
 }
 
 extern "C" void dbgputs(const char* str) {
-    internal_write(stddebug, str, strlen(str));
+    KernelLog_Write(LogLevel::DEBUG, str, strlen(str));
 }
 
 extern "C" void fputc(const fd_t file, const char c) {
@@ -1487,13 +1491,13 @@ extern "C" int snprintf(char* s, size_t n, const char* format, ...) {
 extern "C" int dbgprintf(const char* format, ...) {
     va_list args;
     va_start(args, format);
-    int rc = vfprintf(stddebug, format, args);
+    int rc = vklog(LogLevel::DEBUG, format, args);
     va_end(args);
     return rc;
 }
 
 extern "C" int dbgvprintf(const char* format, va_list args) {
-    return vfprintf(stddebug, format, args);
+    return vklog(LogLevel::DEBUG, format, args);
 }
 
 extern "C" size_t fwrite(const void* ptr, const size_t size, const size_t count, const fd_t file) {
@@ -17,6 +17,24 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "Bitmap.hpp"
 
+#include <util.h>
+
+/*
+Bit n is bit (n % 8) of byte (n / 8), so on a little endian machine a 64-bit load of bytes 8k to 8k + 7 holds bits 64k to
+64k + 63 in order. The buffer is only byte aligned, so whole words are read through an unaligned type.
+*/
+typedef uint64_t __attribute__((may_alias, aligned(1))) Bitmap_UnalignedWord;
+
+#define BITMAP_WORD_BITS 64
+
+// The kernel doesn't link libgcc, so __builtin_popcountll isn't available without -mpopcnt.
+static inline uint64_t PopCount(uint64_t value) {
+    value = value - ((value >> 1) & 0x5555555555555555);
+    value = (value & 0x3333333333333333) + ((value >> 2) & 0x3333333333333333);
+    value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0F;
+    return (value * 0x0101010101010101) >> 56;
+}
+
 Bitmap::Bitmap() : m_Size(0), m_Buffer(nullptr) {
 
 }
@@ -35,7 +53,7 @@ bool Bitmap::operator[](uint64_t index) const {
     if (byteIndex >= m_Size)
         return false; // default is 0
     uint8_t bitIndex = index & 7;
-    uint8_t bitIndexer = 0b10000000 >> bitIndex;
+    uint8_t bitIndexer = 1 << bitIndex;
     if ((m_Buffer[byteIndex] & bitIndexer) > 0)
         return true;
     return false; // default is 0
@@ -46,13 +64,64 @@ void Bitmap::Set(uint64_t index, bool value) {
     if (byteIndex >= m_Size)
         return; // prevent memory errors
     uint8_t bitIndex = index & 7;
-    uint8_t bitIndexer = 0b10000000 >> bitIndex;
+    uint8_t bitIndexer = 1 << bitIndex;
     if (value)
         m_Buffer[byteIndex] |= bitIndexer;
     else
         m_Buffer[byteIndex] &= ~bitIndexer;
 }
 
+void Bitmap::SetRange(uint64_t start, uint64_t count) {
+    FillRange(start, count, true);
+}
+
+void Bitmap::ClearRange(uint64_t start, uint64_t count) {
+    FillRange(start, count, false);
+}
+
+uint64_t Bitmap::FindFirstClear(uint64_t start) const {
+    return FindFirst(start, m_Size << 3, false);
+}
+
+uint64_t Bitmap::FindFirstSet(uint64_t start) const {
+    return FindFirst(start, m_Size << 3, true);
+}
+
+uint64_t Bitmap::FindNextClearRun(uint64_t start, uint64_t count) const {
+    if (count == 0)
+        return UINT64_MAX;
+    uint64_t size = m_Size << 3;
+    uint64_t index = FindFirst(start, size, false);
+    while (index != UINT64_MAX) {
+        if (count > size - index)
+            return UINT64_MAX;
+        uint64_t set = FindFirst(index, index + count, true);
+        if (set == UINT64_MAX)
+            return index;
+        index = FindFirst(set, size, false);
+    }
+    return UINT64_MAX;
+}
+
+uint64_t Bitmap::CountSet(uint64_t start, uint64_t count) const {
+    uint64_t size = m_Size << 3;
+    if (start >= size || count == 0)
+        return 0;
+    uint64_t end = count > size - start ? size : start + count;
+    uint64_t first = start / BITMAP_WORD_BITS;
+    uint64_t last = (end - 1) / BITMAP_WORD_BITS;
+    uint64_t total = 0;
+    for (uint64_t word = first; word <= last; word++) {
+        uint64_t value = LoadWord(word, 0);
+        if (word == first)
+            value &= UINT64_MAX << (start % BITMAP_WORD_BITS);
+        if (word == last)
+            value &= UINT64_MAX >> (BITMAP_WORD_BITS - 1 - ((end - 1) % BITMAP_WORD_BITS));
+        total += PopCount(value);
+    }
+    return total;
+}
+
 void Bitmap::SetSize(size_t size) {
     m_Size = size;
 }
@@ -68,3 +137,61 @@ size_t Bitmap::GetSize() const {
 uint8_t* Bitmap::GetBuffer() const {
     return m_Buffer;
 }
+
+// Bytes past the end of the buffer read as fill.
+uint64_t Bitmap::LoadWord(uint64_t word, uint64_t fill) const {
+    uint64_t offset = word * 8;
+    if (offset + 8 <= m_Size)
+        return *(const Bitmap_UnalignedWord*)&m_Buffer[offset];
+    uint64_t value = fill;
+    for (uint64_t i = 0; offset + i < m_Size; i++) {
+        value &= ~(0xFFUL << (i * 8));
+        value |= (uint64_t)m_Buffer[offset + i] << (i * 8);
+    }
+    return value;
+}
+
+void Bitmap::FillRange(uint64_t start, uint64_t count, bool value) {
+    uint64_t size = m_Size << 3;
+    if (start >= size || count == 0)
+        return;
+    uint64_t end = count > size - start ? size : start + count;
+    uint64_t first = start >> 3;
+    uint64_t last = (end - 1) >> 3;
+    uint8_t head = 0xFF << (start & 7);
+    uint8_t tail = 0xFF >> (7 - ((end - 1) & 7));
+    if (first == last) {
+        head &= tail;
+        tail = 0;
+    }
+    if (value) {
+        m_Buffer[first] |= head;
+        m_Buffer[last] |= tail;
+    }
+    else {
+        m_Buffer[first] &= ~head;
+        m_Buffer[last] &= ~tail;
+    }
+    if (last > first + 1)
+        memset(&m_Buffer[first + 1], value ? 0xFF : 0, last - first - 1);
+}
+
+// Search [start, end) a word at a time.
+uint64_t Bitmap::FindFirst(uint64_t start, uint64_t end, bool value) const {
+    uint64_t size = m_Size << 3;
+    if (end > size)
+        end = size;
+    if (start >= end)
+        return UINT64_MAX;
+    uint64_t flip = value ? 0 : UINT64_MAX; // after flipping, the bits we are looking for are 1
+    uint64_t word = start / BITMAP_WORD_BITS;
+    uint64_t last = (end - 1) / BITMAP_WORD_BITS;
+    uint64_t bits = (LoadWord(word, flip) ^ flip) & (UINT64_MAX << (start % BITMAP_WORD_BITS));
+    while (bits == 0) {
+        if (++word > last)
+            return UINT64_MAX;
+        bits = LoadWord(word, flip) ^ flip;
+    }
+    uint64_t index = word * BITMAP_WORD_BITS + __builtin_ctzll(bits);
+    return index < end ? index : UINT64_MAX;
+}
@@ -30,6 +30,20 @@ public:
     bool operator[](uint64_t index) const;
     void Set(uint64_t index, bool value);
 
+    // Range operations are clipped to the end of the bitmap.
+    void SetRange(uint64_t start, uint64_t count);
+    void ClearRange(uint64_t start, uint64_t count);
+
+    // Return UINT64_MAX if there is no such bit.
+    uint64_t FindFirstClear(uint64_t start = 0) const;
+    uint64_t FindFirstSet(uint64_t start = 0) const;
+
+    // Find the first run of count clear bits starting at or after start. Returns UINT64_MAX if there is none.
+    uint64_t FindNextClearRun(uint64_t start, uint64_t count) const;
+
+    // Number of set bits in [start, start + count)
+    uint64_t CountSet(uint64_t start, uint64_t count) const;
+
     // Set size in bytes
     void SetSize(size_t size);
 
@@ -40,6 +54,11 @@ public:
 
     uint8_t* GetBuffer() const;
 
+private:
+    uint64_t LoadWord(uint64_t word, uint64_t fill) const;
+    void FillRange(uint64_t start, uint64_t count, bool value);
+    uint64_t FindFirst(uint64_t start, uint64_t end, bool value) const;
+
 private:
     size_t m_Size;
     uint8_t* m_Buffer;
@@ -0,0 +1,90 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "IntervalTree.hpp"
+
+namespace IntervalTree {
+
+    static inline Node* GetNode(RBTree::Node* node) {
+        return node != nullptr ? (Node*)node->data : nullptr;
+    }
+
+    static void UpdateMaxEnd(RBTree::Node* rb_node) {
+        Node* node = GetNode(rb_node);
+        uint64_t max_end = node->end;
+        Node* left = GetNode(rb_node->left);
+        Node* right = GetNode(rb_node->right);
+        if (left != nullptr && left->max_end > max_end)
+            max_end = left->max_end;
+        if (right != nullptr && right->max_end > max_end)
+            max_end = right->max_end;
+        node->max_end = max_end;
+    }
+
+    Tree::Tree() : m_tree(UpdateMaxEnd) {
+
+    }
+
+    void Tree::Insert(Node* node) {
+        node->rb_node.key = node->start;
+        node->rb_node.data = node;
+        node->max_end = node->end;
+        m_tree.Insert(&node->rb_node);
+    }
+
+    void Tree::Remove(Node* node) {
+        m_tree.Remove(&node->rb_node);
+    }
+
+    Node* Tree::FindContaining(uint64_t address) const {
+        return FindFirstOverlap(address, address + 1);
+    }
+
+    Node* Tree::FindFirstOverlap(uint64_t start, uint64_t end) const {
+        Node* node = GetNode(m_tree.GetRoot());
+        while (node != nullptr) {
+            /*
+            If anything on the left ends after start, either it overlaps, or it starts at or after end, in which case
+            this node and everything on the right do too. Either way the answer can only be on the left.
+            */
+            Node* left = GetNode(node->rb_node.left);
+            if (left != nullptr && left->max_end > start) {
+                node = left;
+                continue;
+            }
+            if (node->start >= end)
+                return nullptr;
+            if (node->end > start)
+                return node;
+            node = GetNode(node->rb_node.right);
+        }
+        return nullptr;
+    }
+
+    Node* Tree::GetLeftmost() const {
+        return GetNode(m_tree.GetLeftmost());
+    }
+
+    Node* Tree::GetNext(Node* node) const {
+        return GetNode(m_tree.GetNext(&node->rb_node));
+    }
+
+    uint64_t Tree::GetCount() const {
+        return m_tree.GetCount();
+    }
+
+}
@@ -0,0 +1,61 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _INTERVAL_TREE_HPP
+#define _INTERVAL_TREE_HPP
+
+#include <stdint.h>
+
+#include "RBTree.hpp"
+
+namespace IntervalTree {
+
+    /*
+    Intrusive node covering [start, end). It is embedded in the object being stored, so inserting and removing never allocate.
+    max_end is maintained by the tree and is the largest end in this node's subtree. data points back to the containing object.
+    */
+    struct Node {
+        RBTree::Node rb_node; // keyed on start
+        uint64_t start;
+        uint64_t end;
+        uint64_t max_end;
+        void* data;
+    };
+
+    // RBTree::Tree ordered by start and augmented with max_end, so overlap queries are O(log n). Intervals may overlap.
+    class Tree {
+    public:
+        Tree();
+
+        void Insert(Node* node); // start and end must not change while the node is in the tree
+        void Remove(Node* node); // node must be in this tree
+
+        Node* FindContaining(uint64_t address) const; // returns the lowest starting node containing address, or nullptr
+        Node* FindFirstOverlap(uint64_t start, uint64_t end) const; // returns the lowest starting node overlapping [start, end), or nullptr
+
+        Node* GetLeftmost() const;
+        Node* GetNext(Node* node) const;
+
+        uint64_t GetCount() const;
+
+    private:
+        RBTree::Tree m_tree;
+    };
+
+}
+
+#endif /* _INTERVAL_TREE_HPP */
@@ -0,0 +1,198 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _INTRUSIVE_LIST_HPP
+#define _INTRUSIVE_LIST_HPP
+
+#include <stdint.h>
+#include <rwlock.h>
+#include <spinlock.h>
+
+namespace IntrusiveList {
+
+    /*
+    Intrusive node, embedded in the object being stored like RBTree::Node. data points back to the containing object and
+    owner to the list the node is in, so membership checks and removal are O(1) and nothing is allocated.
+    */
+    struct Node {
+        Node* previous;
+        Node* next;
+        void* owner;
+        uint64_t key; // only used by HashTable
+        void* data;
+    };
+
+    // Doubly linked list. Like LinkedList::LockableLinkedList, the user must lock the list around every use.
+    template <typename T> class List {
+    public:
+        // The next node is read before the current one is handed out, so the current element can be removed while iterating.
+        class Iterator {
+        public:
+            explicit Iterator(Node* node) : m_node(node), m_next(node != nullptr ? node->next : nullptr) {}
+
+            T* operator*() const { return (T*)m_node->data; }
+            Iterator& operator++() {
+                m_node = m_next;
+                m_next = m_node != nullptr ? m_node->next : nullptr;
+                return *this;
+            }
+            bool operator==(const Iterator& other) const { return m_node == other.m_node; }
+            bool operator!=(const Iterator& other) const { return m_node != other.m_node; }
+
+        private:
+            Node* m_node;
+            Node* m_next;
+        };
+
+        List() : m_head(nullptr), m_tail(nullptr), m_count(0), m_lock(0) {}
+
+        void PushBack(Node* node) {
+            node->previous = m_tail;
+            node->next = nullptr;
+            node->owner = this;
+            if (m_tail != nullptr)
+                m_tail->next = node;
+            else
+                m_head = node;
+            m_tail = node;
+            m_count++;
+        }
+
+        void PushFront(Node* node) {
+            node->previous = nullptr;
+            node->next = m_head;
+            node->owner = this;
+            if (m_head != nullptr)
+                m_head->previous = node;
+            else
+                m_tail = node;
+            m_head = node;
+            m_count++;
+        }
+
+        // Returns false if node isn't in this list
+        bool Remove(Node* node) {
+            if (node->owner != this)
+                return false;
+            if (node->previous != nullptr)
+                node->previous->next = node->next;
+            else
+                m_head = node->next;
+            if (node->next != nullptr)
+                node->next->previous = node->previous;
+            else
+                m_tail = node->previous;
+            node->previous = nullptr;
+            node->next = nullptr;
+            node->owner = nullptr;
+            m_count--;
+            return true;
+        }
+
+        T* PopFront() {
+            Node* node = m_head;
+            if (node == nullptr)
+                return nullptr;
+            Remove(node);
+            return (T*)node->data;
+        }
+
+        bool Contains(const Node* node) const { return node->owner == this; }
+
+        T* GetHead() const { return m_head != nullptr ? (T*)m_head->data : nullptr; }
+        Node* GetHeadNode() const { return m_head; }
+        T* GetTail() const { return m_tail != nullptr ? (T*)m_tail->data : nullptr; }
+
+        uint64_t GetCount() const { return m_count; }
+
+        Iterator begin() const { return Iterator(m_head); }
+        Iterator end() const { return Iterator(nullptr); }
+
+        void Lock() const { spinlock_acquire(&m_lock); }
+        void Unlock() const { spinlock_release(&m_lock); }
+
+    private:
+        Node* m_head;
+        Node* m_tail;
+        uint64_t m_count;
+
+        mutable spinlock_t m_lock;
+    };
+
+    // Chained hash table keyed by an integer. BucketCount must be a power of 2. The user must lock the table around every use, although lookups only need the read lock.
+    template <typename T, uint64_t BucketCount> class HashTable {
+        static_assert(BucketCount > 0 && (BucketCount & (BucketCount - 1)) == 0, "BucketCount must be a power of 2");
+
+    public:
+        HashTable() : m_count(0), m_lock({0, 0, 0}) {}
+
+        void Insert(Node* node, uint64_t key) {
+            node->key = key;
+            m_buckets[GetBucket(key)].PushBack(node);
+            m_count++;
+        }
+
+        // Returns false if node isn't in this table
+        bool Remove(Node* node) {
+            if (!Contains(node))
+                return false;
+            m_buckets[GetBucket(node->key)].Remove(node);
+            m_count--;
+            return true;
+        }
+
+        T* Find(uint64_t key) const {
+            for (Node* node = m_buckets[GetBucket(key)].GetHeadNode(); node != nullptr; node = node->next) {
+                if (node->key == key)
+                    return (T*)node->data;
+            }
+            return nullptr;
+        }
+
+        bool Contains(const Node* node) const { return m_buckets[GetBucket(node->key)].Contains(node); }
+
+        uint64_t GetCount() const { return m_count; }
+
+        void Enumerate(void (*callback)(T* obj, void* data), void* data) const {
+            for (uint64_t i = 0; i < BucketCount; i++) {
+                for (T* obj : m_buckets[i])
+                    callback(obj, data);
+            }
+        }
+
+        void Lock() const { rwlock_write_acquire(&m_lock); }
+        void Unlock() const { rwlock_write_release(&m_lock); }
+        void ReadLock() const { rwlock_read_acquire(&m_lock); }
+        void ReadUnlock() const { rwlock_read_release(&m_lock); }
+        void ForceUnlock() const { rwlock_init(&m_lock); } // only for the panic path
+
+    private:
+        // Fibonacci hashing, so sequential keys such as PIDs spread across the buckets
+        static uint64_t GetBucket(uint64_t key) {
+            return ((key * 0x9E3779B97F4A7C15) >> 32) & (BucketCount - 1);
+        }
+
+    private:
+        List<T> m_buckets[BucketCount];
+        uint64_t m_count;
+
+        mutable rwlock_t m_lock;
+    };
+
+}
+
+#endif /* _INTRUSIVE_LIST_HPP */
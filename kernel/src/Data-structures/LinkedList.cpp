@@ -41,7 +41,7 @@ namespace LinkedList {
 	void NodePool_Init() {
 		nodePool_UsedCount = 0;
 		memset(nodePool_BitmapData, 0, POOL_SIZE / 8);
-		nodePool_Bitmap.SetSize(POOL_SIZE);
+		nodePool_Bitmap.SetSize(POOL_SIZE / 8);
 		nodePool_Bitmap.SetBuffer(&(nodePool_BitmapData[0]));
 		nodePoolHasBeenInitialised = true;
 	}
@@ -53,26 +53,21 @@ namespace LinkedList {
 
 	Node* NodePool_AllocateNode() {
 		if (nodePool_UsedCount == POOL_SIZE - 1) return nullptr;
-		for (uint64_t i = 0; i < POOL_SIZE; i++) {
-			if (nodePool_Bitmap[i] == 0) {
-				nodePool_Bitmap.Set(i, true);
-				nodePool_UsedCount++;
-				return &(nodePool[i]);
-			}
-		}
-		return nullptr;
+		uint64_t i = nodePool_Bitmap.FindFirstClear();
+		if (i == UINT64_MAX)
+			return nullptr;
+		nodePool_Bitmap.Set(i, true);
+		nodePool_UsedCount++;
+		return &(nodePool[i]);
 	}
 
 	bool NodePool_FreeNode(Node*& node) {
-		for (uint64_t i = 0; i < POOL_SIZE; i++) {
-			if ((uint64_t)node == (uint64_t)(&(nodePool[i]))) {
-				nodePool_Bitmap.Set(i, false);
-				nodePool_UsedCount--;
-				node = nullptr;
-				return true;
-			}
-		}
-		return false;
+		if (node < &nodePool[0] || node >= &nodePool[POOL_SIZE])
+			return false;
+		nodePool_Bitmap.Set(node - &nodePool[0], false);
+		nodePool_UsedCount--;
+		node = nullptr;
+		return true;
 	}
 
 	bool NodePool_HasBeenInitialised() {
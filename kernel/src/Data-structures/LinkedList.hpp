@@ -65,6 +65,27 @@ namespace LinkedList {
 
 	void panic(const char* str); // a tiny function which just expands the PANIC macro. This is so PANIC can be called from the template class below.
 
+	// Walks the nodes directly, so a full loop is O(n) where a get(i) loop is O(n^2). The next node is cached, so the current element may be removed while iterating, but nothing else may be.
+	template <typename T> class Iterator {
+	public:
+		explicit Iterator(Node* node) : m_node(node), m_next(node == nullptr ? nullptr : node->next) {}
+
+		T* operator*() const { return (T*)(m_node->data); }
+		Iterator& operator++() {
+			m_node = m_next;
+			m_next = m_node == nullptr ? nullptr : m_node->next;
+			return *this;
+		}
+		bool operator==(const Iterator& other) const { return m_node == other.m_node; }
+		bool operator!=(const Iterator& other) const { return m_node != other.m_node; }
+
+		Node* GetNode() const { return m_node; }
+
+	private:
+		Node* m_node;
+		Node* m_next;
+	};
+
 	template <typename T> class SimpleLinkedList {
 	public:
 		SimpleLinkedList(bool eternal = false) : m_count(0), m_start(nullptr), m_eternal(eternal) {}
@@ -122,6 +143,14 @@ namespace LinkedList {
 			deleteNode(m_start, (uint64_t)obj);
 			m_count--;
 		}
+		// O(1), unlike removing by object. it stays valid for moving on to the next element.
+		void remove(const Iterator<T>& it) {
+			if (m_eternal) {
+				panic("Eternal SimpleLinkedList node was deleted!");
+			}
+			deleteNode(m_start, it.GetNode());
+			m_count--;
+		}
 		void rotateLeft() {
 			if (m_count < 2) {
 				//dbgprintf("[%s] WARN: not enough nodes to rotate.\n", __extension__ __PRETTY_FUNCTION__);
@@ -172,6 +201,13 @@ namespace LinkedList {
 			return m_count;
 		}
 
+		Iterator<T> begin() const {
+			return Iterator<T>(m_start);
+		}
+		Iterator<T> end() const {
+			return Iterator<T>(nullptr);
+		}
+
 	private:
 		uint64_t m_count;
 		Node* m_start;
@@ -185,6 +221,7 @@ namespace LinkedList {
 			spinlock_acquire(&m_lock);
 			m_list.~SimpleLinkedList();
 			spinlock_release(&m_lock);
+			spinlock_destroy(&m_lock);
 		}
 
 		void insert(const T* obj) {
@@ -202,6 +239,9 @@ namespace LinkedList {
 		void remove(const T* obj) {
 			m_list.remove(obj);
 		}
+		void remove(const Iterator<T>& it) {
+			m_list.remove(it);
+		}
 		void rotateLeft() {
 			m_list.rotateLeft();
 		}
@@ -217,6 +257,12 @@ namespace LinkedList {
 		uint64_t getCount() const {
 			return m_list.getCount();
 		}
+		Iterator<T> begin() const {
+			return m_list.begin();
+		}
+		Iterator<T> end() const {
+			return m_list.end();
+		}
 
 		void lock() const {
 			spinlock_acquire(&m_lock);
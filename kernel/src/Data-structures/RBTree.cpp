@@ -0,0 +1,310 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "RBTree.hpp"
+
+namespace RBTree {
+
+    static inline bool IsRed(Node* node) {
+        return node != nullptr && node->red;
+    }
+
+    static Node* Minimum(Node* node) {
+        while (node->left != nullptr)
+            node = node->left;
+        return node;
+    }
+
+    static Node* Maximum(Node* node) {
+        while (node->right != nullptr)
+            node = node->right;
+        return node;
+    }
+
+    Tree::Tree(AugmentCallback augment) : m_root(nullptr), m_leftmost(nullptr), m_count(0), m_augment(augment) {
+
+    }
+
+    void Tree::Insert(Node* node) {
+        Node* parent = nullptr;
+        Node* current = m_root;
+        bool leftmost = true;
+        while (current != nullptr) {
+            parent = current;
+            if (node->key < current->key)
+                current = current->left;
+            else {
+                current = current->right;
+                leftmost = false;
+            }
+        }
+        node->parent = parent;
+        node->left = nullptr;
+        node->right = nullptr;
+        node->red = true;
+        if (parent == nullptr)
+            m_root = node;
+        else if (node->key < parent->key)
+            parent->left = node;
+        else
+            parent->right = node;
+        if (leftmost)
+            m_leftmost = node;
+        m_count++;
+        Propagate(node);
+        InsertFixup(node);
+    }
+
+    void Tree::Remove(Node* node) {
+        if (node == m_leftmost)
+            m_leftmost = GetNext(node);
+
+        Node* child;
+        Node* child_parent;
+        bool removed_red = node->red;
+        if (node->left == nullptr) {
+            child = node->right;
+            child_parent = node->parent;
+            Transplant(node, node->right);
+        }
+        else if (node->right == nullptr) {
+            child = node->left;
+            child_parent = node->parent;
+            Transplant(node, node->left);
+        }
+        else {
+            // Replace node with its successor, which has no left child
+            Node* successor = Minimum(node->right);
+            removed_red = successor->red;
+            child = successor->right;
+            if (successor->parent == node)
+                child_parent = successor;
+            else {
+                child_parent = successor->parent;
+                Transplant(successor, successor->right);
+                successor->right = node->right;
+                successor->right->parent = successor;
+            }
+            Transplant(node, successor);
+            successor->left = node->left;
+            successor->left->parent = successor;
+            successor->red = node->red;
+        }
+
+        // Every subtree that lost node, or had the successor moved out of it, is on the path from child_parent to the root
+        Propagate(child_parent);
+
+        if (!removed_red)
+            RemoveFixup(child, child_parent);
+
+        node->parent = nullptr;
+        node->left = nullptr;
+        node->right = nullptr;
+        m_count--;
+    }
+
+    Node* Tree::GetLeftmost() const {
+        return m_leftmost;
+    }
+
+    Node* Tree::GetRightmost() const {
+        if (m_root == nullptr)
+            return nullptr;
+        return Maximum(m_root);
+    }
+
+    Node* Tree::GetNext(Node* node) const {
+        if (node->right != nullptr)
+            return Minimum(node->right);
+        Node* parent = node->parent;
+        while (parent != nullptr && node == parent->right) {
+            node = parent;
+            parent = parent->parent;
+        }
+        return parent;
+    }
+
+    Node* Tree::GetPrevious(Node* node) const {
+        if (node->left != nullptr)
+            return Maximum(node->left);
+        Node* parent = node->parent;
+        while (parent != nullptr && node == parent->left) {
+            node = parent;
+            parent = parent->parent;
+        }
+        return parent;
+    }
+
+    Node* Tree::GetRoot() const {
+        return m_root;
+    }
+
+    uint64_t Tree::GetCount() const {
+        return m_count;
+    }
+
+    void Tree::RotateLeft(Node* node) {
+        Node* right = node->right;
+        node->right = right->left;
+        if (right->left != nullptr)
+            right->left->parent = node;
+        Transplant(node, right);
+        right->left = node;
+        node->parent = right;
+        if (m_augment != nullptr) {
+            m_augment(node);
+            m_augment(right);
+        }
+    }
+
+    void Tree::RotateRight(Node* node) {
+        Node* left = node->left;
+        node->left = left->right;
+        if (left->right != nullptr)
+            left->right->parent = node;
+        Transplant(node, left);
+        left->right = node;
+        node->parent = left;
+        if (m_augment != nullptr) {
+            m_augment(node);
+            m_augment(left);
+        }
+    }
+
+    void Tree::InsertFixup(Node* node) {
+        while (IsRed(node->parent)) {
+            Node* parent = node->parent;
+            Node* grandparent = parent->parent; // the root is black, so a red parent always has a parent
+            if (parent == grandparent->left) {
+                Node* uncle = grandparent->right;
+                if (IsRed(uncle)) {
+                    parent->red = false;
+                    uncle->red = false;
+                    grandparent->red = true;
+                    node = grandparent;
+                    continue;
+                }
+                if (node == parent->right) {
+                    RotateLeft(parent);
+                    node = parent;
+                    parent = node->parent;
+                }
+                parent->red = false;
+                grandparent->red = true;
+                RotateRight(grandparent);
+            }
+            else {
+                Node* uncle = grandparent->left;
+                if (IsRed(uncle)) {
+                    parent->red = false;
+                    uncle->red = false;
+                    grandparent->red = true;
+                    node = grandparent;
+                    continue;
+                }
+                if (node == parent->left) {
+                    RotateRight(parent);
+                    node = parent;
+                    parent = node->parent;
+                }
+                parent->red = false;
+                grandparent->red = true;
+                RotateLeft(grandparent);
+            }
+        }
+        m_root->red = false;
+    }
+
+    // node may be nullptr, so its parent is passed separately
+    void Tree::RemoveFixup(Node* node, Node* parent) {
+        while (node != m_root && !IsRed(node)) {
+            if (node == parent->left) {
+                Node* sibling = parent->right;
+                if (IsRed(sibling)) {
+                    sibling->red = false;
+                    parent->red = true;
+                    RotateLeft(parent);
+                    sibling = parent->right;
+                }
+                if (!IsRed(sibling->left) && !IsRed(sibling->right)) {
+                    sibling->red = true;
+                    node = parent;
+                    parent = node->parent;
+                    continue;
+                }
+                if (!IsRed(sibling->right)) {
+                    sibling->left->red = false;
+                    sibling->red = true;
+                    RotateRight(sibling);
+                    sibling = parent->right;
+                }
+                sibling->red = parent->red;
+                parent->red = false;
+                sibling->right->red = false;
+                RotateLeft(parent);
+            }
+            else {
+                Node* sibling = parent->left;
+                if (IsRed(sibling)) {
+                    sibling->red = false;
+                    parent->red = true;
+                    RotateRight(parent);
+                    sibling = parent->left;
+                }
+                if (!IsRed(sibling->left) && !IsRed(sibling->right)) {
+                    sibling->red = true;
+                    node = parent;
+                    parent = node->parent;
+                    continue;
+                }
+                if (!IsRed(sibling->left)) {
+                    sibling->right->red = false;
+                    sibling->red = true;
+                    RotateLeft(sibling);
+                    sibling = parent->left;
+                }
+                sibling->red = parent->red;
+                parent->red = false;
+                sibling->left->red = false;
+                RotateRight(parent);
+            }
+            node = m_root;
+        }
+        if (node != nullptr)
+            node->red = false;
+    }
+
+    void Tree::Transplant(Node* old_node, Node* new_node) {
+        if (old_node->parent == nullptr)
+            m_root = new_node;
+        else if (old_node == old_node->parent->left)
+            old_node->parent->left = new_node;
+        else
+            old_node->parent->right = new_node;
+        if (new_node != nullptr)
+            new_node->parent = old_node->parent;
+    }
+
+    void Tree::Propagate(Node* node) {
+        if (m_augment == nullptr)
+            return;
+        for (; node != nullptr; node = node->parent)
+            m_augment(node);
+    }
+
+}
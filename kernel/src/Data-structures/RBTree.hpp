@@ -0,0 +1,78 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _RB_TREE_HPP
+#define _RB_TREE_HPP
+
+#include <stdint.h>
+
+namespace RBTree {
+
+    /*
+    Intrusive node. It is embedded in the object being stored, so inserting and removing never allocate,
+    which makes the tree usable with interrupts disabled. data points back to the containing object.
+    */
+    struct Node {
+        Node* parent;
+        Node* left;
+        Node* right;
+        bool red;
+        uint64_t key;
+        void* data;
+    };
+
+    /*
+    Called on a node whose children have changed, children first, so a tree can keep data about each subtree in the containing object.
+    It only has to recompute the node's own data from its children's, as the tree calls it again for every ancestor that needs it.
+    */
+    typedef void (*AugmentCallback)(Node* node);
+
+    // Red-black tree ordered by key. Nodes with equal keys are kept in insertion order.
+    class Tree {
+    public:
+        Tree(AugmentCallback augment = nullptr);
+
+        void Insert(Node* node);
+        void Remove(Node* node); // node must be in this tree
+
+        Node* GetLeftmost() const; // O(1), cached
+        Node* GetRightmost() const;
+        Node* GetNext(Node* node) const;
+        Node* GetPrevious(Node* node) const;
+        Node* GetRoot() const;
+
+        uint64_t GetCount() const;
+
+    private:
+        void RotateLeft(Node* node);
+        void RotateRight(Node* node);
+        void InsertFixup(Node* node);
+        void RemoveFixup(Node* node, Node* parent);
+        void Transplant(Node* old_node, Node* new_node);
+        void Propagate(Node* node); // node may be nullptr
+
+    private:
+        Node* m_root;
+        Node* m_leftmost;
+        uint64_t m_count;
+        AugmentCallback m_augment;
+    };
+
+}
+
+#endif /* _RB_TREE_HPP */
@@ -0,0 +1,83 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _RING_BUFFER_HPP
+#define _RING_BUFFER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Lock-free ring buffer for exactly one producer and one consumer, e.g. an IRQ handler and a reader that serialises itself.
+Size must be a power of 2. One slot is never used so full and empty can be told apart without a shared count.
+*/
+template <typename T, size_t Size>
+class RingBuffer {
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "RingBuffer size must be a power of 2");
+
+public:
+    RingBuffer() : m_head(0), m_tail(0) {
+
+    }
+
+    // Producer only. Returns false if the buffer is full.
+    bool Push(const T& data) {
+        size_t head = __atomic_load_n(&m_head, __ATOMIC_RELAXED);
+        size_t next = (head + 1) & (Size - 1);
+        if (next == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE))
+            return false;
+        m_data[head] = data;
+        __atomic_store_n(&m_head, next, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Consumer only. Returns false if the buffer is empty.
+    bool Pop(T& data) {
+        size_t tail = __atomic_load_n(&m_tail, __ATOMIC_RELAXED);
+        if (tail == __atomic_load_n(&m_head, __ATOMIC_ACQUIRE))
+            return false;
+        data = m_data[tail];
+        __atomic_store_n(&m_tail, (tail + 1) & (Size - 1), __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Consumer only. Returns the oldest entry without removing it, or nullptr if the buffer is empty.
+    const T* Peek() const {
+        size_t tail = __atomic_load_n(&m_tail, __ATOMIC_RELAXED);
+        if (tail == __atomic_load_n(&m_head, __ATOMIC_ACQUIRE))
+            return nullptr;
+        return &m_data[tail];
+    }
+
+    // Consumer only. Removes the entry returned by Peek.
+    void Discard() {
+        size_t tail = __atomic_load_n(&m_tail, __ATOMIC_RELAXED);
+        __atomic_store_n(&m_tail, (tail + 1) & (Size - 1), __ATOMIC_RELEASE);
+    }
+
+    bool isEmpty() const {
+        return __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) == __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+    }
+
+private:
+    size_t m_head; // next slot the producer writes
+    size_t m_tail; // next slot the consumer reads
+    T m_data[Size];
+};
+
+#endif /* _RING_BUFFER_HPP */
@@ -19,16 +19,59 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "VGAFont.hpp"
 
 #include <util.h>
+#include <string.h>
 
 #ifdef __x86_64__
 #include <arch/x86_64/io.h>
 #endif
 
-BasicVGA::BasicVGA() : m_CursorPosition({0, 0}), m_bgcolour(), m_fgcolour(), m_FrameBuffer({nullptr, 0, 0, 0, 0, 0, 0, 0, 0, 0}), m_HasBeenInitialised(false), m_pm(nullptr), m_DoubleBuffer(false), m_buffer(nullptr) {
+/*
+Pixel helpers specialised on the number of bytes per pixel, so the inner loops have no format checks.
+*/
+
+template <uint8_t BytesPerPixel>
+static inline void WritePixel(uint8_t* dst, uint64_t colour) {
+    if constexpr (BytesPerPixel == 1)
+        *dst = colour & 0xFF;
+    else if constexpr (BytesPerPixel == 2)
+        *(uint16_t*)dst = colour & 0xFFFF;
+    else if constexpr (BytesPerPixel == 4)
+        *(uint32_t*)dst = colour & 0xFFFFFFFF;
+    else if constexpr (BytesPerPixel == 8)
+        *(uint64_t*)dst = colour;
+    else {
+        for (uint8_t i = 0; i < BytesPerPixel; i++)
+            dst[i] = (colour >> (i * 8)) & 0xFF;
+    }
+}
 
+// Expand one row of glyph bits, followed by the spacing columns, into VGA_CHAR_WIDTH pixels
+template <uint8_t BytesPerPixel>
+static inline void ExpandGlyphRow(uint8_t* dst, uint8_t bits, uint64_t fg, uint64_t bg) {
+    for (uint8_t cx = 0; cx < 8; cx++)
+        WritePixel<BytesPerPixel>(dst + cx * BytesPerPixel, ((bits >> (7 - cx)) & 1) ? fg : bg);
+    for (uint8_t cx = 8; cx < VGA_CHAR_WIDTH; cx++)
+        WritePixel<BytesPerPixel>(dst + cx * BytesPerPixel, bg);
 }
 
-BasicVGA::BasicVGA(const FrameBuffer& buffer, Position CursorPosition, const Colour& fg_colour, const Colour& bg_colour, bool double_buffer, PageManager* pm) : m_CursorPosition(CursorPosition), m_bgcolour(bg_colour), m_fgcolour(fg_colour), m_FrameBuffer(buffer), m_HasBeenInitialised(true), m_pm(pm), m_DoubleBuffer(double_buffer), m_buffer(nullptr) {
+template <uint8_t BytesPerPixel>
+static inline void CopyGlyphRow(uint8_t* dst, const uint8_t* src) {
+    constexpr uint64_t size = VGA_CHAR_WIDTH * BytesPerPixel;
+    if constexpr (size % 8 == 0) {
+        for (uint64_t i = 0; i < size / 8; i++)
+            ((uint64_t*)dst)[i] = ((const uint64_t*)src)[i];
+    }
+    else {
+        for (uint64_t i = 0; i < size; i++)
+            dst[i] = src[i];
+    }
+}
+
+BasicVGA::BasicVGA() : m_CursorPosition({0, 0}), m_bgcolour(), m_fgcolour(), m_FrameBuffer({nullptr, 0, 0, 0, 0, 0, 0, 0, 0, 0}), m_HasBeenInitialised(false), m_pm(nullptr), m_DoubleBuffer(false), m_buffer(nullptr), m_BytesPerPixel(0), m_dirtyLeft(0), m_dirtyTop(0), m_dirtyRight(0), m_dirtyBottom(0), m_glyphCacheFG(0), m_glyphCacheBG(0), m_glyphCacheBytesPerPixel(0), m_glyphCacheValid(), m_textBuffer(nullptr), m_dirtyRows(nullptr), m_textRows(0), m_textColumns(0), m_textFirstRow(0) {
+
+}
+
+BasicVGA::BasicVGA(const FrameBuffer& buffer, Position CursorPosition, const Colour& fg_colour, const Colour& bg_colour, bool double_buffer, PageManager* pm) : m_CursorPosition(CursorPosition), m_bgcolour(bg_colour), m_fgcolour(fg_colour), m_FrameBuffer(buffer), m_HasBeenInitialised(true), m_pm(pm), m_DoubleBuffer(double_buffer), m_buffer(nullptr), m_BytesPerPixel(buffer.bpp / 8), m_dirtyLeft(0), m_dirtyTop(0), m_dirtyRight(0), m_dirtyBottom(0), m_glyphCacheFG(0), m_glyphCacheBG(0), m_glyphCacheBytesPerPixel(0), m_glyphCacheValid(), m_textBuffer(nullptr), m_dirtyRows(nullptr), m_textRows(0), m_textColumns(0), m_textFirstRow(0) {
     if (double_buffer)
         EnableDoubleBuffering(pm);
 }
@@ -46,6 +89,8 @@ void BasicVGA::Init(const FrameBuffer& buffer, Position CursorPosition, const Co
     m_pm = pm;
     m_DoubleBuffer = double_buffer;
     m_buffer = nullptr;
+    m_BytesPerPixel = buffer.bpp / 8;
+    m_glyphCacheBytesPerPixel = 0;
     if (double_buffer)
         EnableDoubleBuffering(pm);
 }
@@ -56,6 +101,7 @@ bool BasicVGA::HasBeenInitialised() {
 
 void BasicVGA::SetFrameBuffer(const FrameBuffer& buffer) {
     m_FrameBuffer = buffer;
+    m_BytesPerPixel = buffer.bpp / 8;
 }
 
 void BasicVGA::SetCursorPosition(Position CursorPosition) {
@@ -71,10 +117,14 @@ void BasicVGA::SetBackgroundColour(const Colour& colour) {
 }
 
 void BasicVGA::ClearScreen(const Colour& colour) {
-    for (uint64_t y = 0; y < m_FrameBuffer.FrameBufferHeight; y++) {
-        for (uint64_t x = 0; x < m_FrameBuffer.FrameBufferWidth; x++) {
-            PlotPixel(x, y, colour);
-        }
+    uint64_t bg = colour.render();
+    FillRect(0, 0, m_FrameBuffer.FrameBufferWidth, m_FrameBuffer.FrameBufferHeight, bg);
+    if (m_textBuffer != nullptr) {
+        uint64_t fg = m_fgcolour.render();
+        for (uint64_t i = 0; i < m_textRows * m_textColumns; i++)
+            m_textBuffer[i] = {fg, bg, ' '};
+        for (uint64_t i = 0; i < m_textRows; i++)
+            m_dirtyRows[i] = false;
     }
 }
 
@@ -86,6 +136,7 @@ void BasicVGA::PlotPixel(uint64_t x, uint64_t y, const Colour& colour) {
         buffer = (uint8_t*)m_FrameBuffer.FrameBufferAddress;
     uint64_t data = colour.render();
     uint16_t bpp = m_FrameBuffer.bpp;
+    MarkDirty(x, y, 1, 1);
     if (bpp <= 8)
         buffer[m_FrameBuffer.FrameBufferWidth * y + x] = data & 0xFF;
     else if (bpp <= 16)
@@ -114,25 +165,30 @@ void BasicVGA::PlotPixel(uint64_t x, uint64_t y, const Colour& colour) {
 }
 
 void BasicVGA::NewLine() {
-    m_CursorPosition.y += 16;
-    if (m_CursorPosition.y >= ALIGN_DOWN(m_FrameBuffer.FrameBufferHeight, 16))
+    m_CursorPosition.y += VGA_CHAR_HEIGHT;
+    if (m_CursorPosition.y >= ALIGN_DOWN(m_FrameBuffer.FrameBufferHeight, VGA_CHAR_HEIGHT))
         ScrollText();
     m_CursorPosition.x = 0;
 }
 
 void BasicVGA::Backspace() {
-    if (m_CursorPosition.x < 10 && m_CursorPosition.y < 16)
+    if (m_CursorPosition.x < VGA_CHAR_WIDTH && m_CursorPosition.y < VGA_CHAR_HEIGHT)
         return; // Cannot backspace
     // Rewind
-    if (m_CursorPosition.x < 10)
-        m_CursorPosition = {ALIGN_DOWN(m_FrameBuffer.FrameBufferWidth, 10) - 10, m_CursorPosition.y - 16};
+    if (m_CursorPosition.x < VGA_CHAR_WIDTH)
+        m_CursorPosition = {ALIGN_DOWN(m_FrameBuffer.FrameBufferWidth, VGA_CHAR_WIDTH) - VGA_CHAR_WIDTH, m_CursorPosition.y - VGA_CHAR_HEIGHT};
     else
-        m_CursorPosition = {m_CursorPosition.x - 10, m_CursorPosition.y};
+        m_CursorPosition = {m_CursorPosition.x - VGA_CHAR_WIDTH, m_CursorPosition.y};
     // Zero it
-    for (uint8_t cy = 0; cy < 16; cy++) {
-        for (uint8_t cx = 0; cx < 10; cx++)
-            PlotPixel((m_CursorPosition.x)+cx, (m_CursorPosition.y)+cy, m_bgcolour);
+    uint64_t bg = m_bgcolour.render();
+    uint64_t row = m_CursorPosition.y / VGA_CHAR_HEIGHT;
+    uint64_t column = m_CursorPosition.x / VGA_CHAR_WIDTH;
+    if (m_textBuffer != nullptr && row < m_textRows && column < m_textColumns) {
+        GetTextRow(row)[column] = {m_fgcolour.render(), bg, ' '};
+        if (m_dirtyRows[row])
+            return; // it will be repainted anyway
     }
+    FillRect(m_CursorPosition.x, m_CursorPosition.y, VGA_CHAR_WIDTH, VGA_CHAR_HEIGHT, bg);
 }
 
 void BasicVGA::putc(const char c) {
@@ -144,59 +200,51 @@ void BasicVGA::putc(const char c) {
 
     if (!IsCharValid(c))
         return; // don't print anything if the character is invalid
-    
-    /* Prepare */
-    uint8_t mask[16];
-    GetCharReturn charReturn = getChar(c);
-
-    /* Following looks weird, but is necessary */
-    mask[0] = charReturn.b0;
-    mask[1] = charReturn.b1;
-    mask[2] = charReturn.b2;
-    mask[3] = charReturn.b3;
-    mask[4] = charReturn.b4;
-    mask[5] = charReturn.b5;
-    mask[6] = charReturn.b6;
-    mask[7] = charReturn.b7;
-    mask[8] = charReturn.b8;
-    mask[9] = charReturn.b9;
-    mask[10] = charReturn.b10;
-    mask[11] = charReturn.b11;
-    mask[12] = charReturn.b12;
-    mask[13] = charReturn.b13;
-    mask[14] = charReturn.b14;
-    mask[15] = charReturn.b15;
-
-    /* Go through each pixel in the character and draw the foreground colour if bit is 1, else draw background colour */
-    for (uint8_t cy = 0; cy < 16; cy++) {
-        int8_t inverseCX = 7;
-        uint8_t temp = 0;
-        bool bit = false;
-        for (uint8_t cx = 0; cx < 8; cx++) {
-            if (inverseCX < 0) break;
-            temp = mask[cy] >> inverseCX;
-            temp &= 1;
-            bit = temp;
-            PlotPixel((m_CursorPosition.x)+cx, (m_CursorPosition.y)+cy, (bit ? m_fgcolour : m_bgcolour));
-            inverseCX--;
-        }
+
+    uint64_t fg = m_fgcolour.render();
+    uint64_t bg = m_bgcolour.render();
+    bool deferred = false;
+    uint64_t row = m_CursorPosition.y / VGA_CHAR_HEIGHT;
+    uint64_t column = m_CursorPosition.x / VGA_CHAR_WIDTH;
+    if (m_textBuffer != nullptr && row < m_textRows && column < m_textColumns) {
+        GetTextRow(row)[column] = {fg, bg, c};
+        deferred = m_dirtyRows[row];
     }
+    if (!deferred)
+        DrawChar(m_CursorPosition.x, m_CursorPosition.y, c, fg, bg);
+
     /* Adjust Cursor position to say a character has been printed */
-    m_CursorPosition = {m_CursorPosition.x + 10, m_CursorPosition.y};
-    if (m_CursorPosition.x >= ALIGN_DOWN(m_FrameBuffer.FrameBufferWidth, 10))
+    m_CursorPosition = {m_CursorPosition.x + VGA_CHAR_WIDTH, m_CursorPosition.y};
+    if (m_CursorPosition.x >= ALIGN_DOWN(m_FrameBuffer.FrameBufferWidth, VGA_CHAR_WIDTH))
         NewLine();
 }
 
 void BasicVGA::ScrollText() {
-    /* Copy everything up one row */
-    for (uint64_t y = 16; y < (GetAmountOfTextRows() * 16); y += 16) {
-        fast_memcpy((void*)((uint64_t)(m_FrameBuffer.FrameBufferAddress) + ((y - 16) * 4 * m_FrameBuffer.FrameBufferWidth)), (void*)((uint64_t)m_FrameBuffer.FrameBufferAddress + (y * 4 * m_FrameBuffer.FrameBufferWidth)), 4 * m_FrameBuffer.FrameBufferWidth * 16);
+    uint64_t rows = GetAmountOfTextRows();
+    if (m_textBuffer == nullptr) {
+        // No shadow text yet, so the pixels have to be moved.
+        uint8_t* buffer = GetDrawBuffer();
+        uint64_t row_size = m_BytesPerPixel * m_FrameBuffer.FrameBufferWidth * VGA_CHAR_HEIGHT;
+        MarkDirty(0, 0, m_FrameBuffer.FrameBufferWidth, (rows - 1) * VGA_CHAR_HEIGHT);
+        for (uint64_t row = 1; row < rows; row++)
+            fast_memcpy(buffer + (row - 1) * row_size, buffer + row * row_size, row_size);
+        FillRect(0, (rows - 1) * VGA_CHAR_HEIGHT, m_FrameBuffer.FrameBufferWidth, VGA_CHAR_HEIGHT, m_bgcolour.render());
+    }
+    else {
+        // Rotate the ring and repaint later, so a burst of new lines only repaints the screen once.
+        m_textFirstRow = (m_textFirstRow + 1) % m_textRows;
+        TextCell* last = GetTextRow(m_textRows - 1);
+        uint64_t fg = m_fgcolour.render();
+        uint64_t bg = m_bgcolour.render();
+        for (uint64_t i = 0; i < m_textColumns; i++)
+            last[i] = {fg, bg, ' '};
+        for (uint64_t i = 0; i < m_textRows; i++)
+            m_dirtyRows[i] = true;
+        if (!m_DoubleBuffer)
+            FlushText(); // nothing else is going to repaint it
     }
 
-    /* Set everything in the last row to zero */
-    fast_memset((void*)((uint64_t)(m_FrameBuffer.FrameBufferAddress) + 4 * m_FrameBuffer.FrameBufferWidth * 16 * (GetAmountOfTextRows() - 1)), 0, (4 * m_FrameBuffer.FrameBufferWidth * 16) / 8);
-
-    m_CursorPosition.y -= 16;
+    m_CursorPosition.y -= VGA_CHAR_HEIGHT;
 }
 
 Position BasicVGA::GetCursorPosition() {
@@ -204,7 +252,7 @@ Position BasicVGA::GetCursorPosition() {
 }
 
 uint64_t BasicVGA::GetScreenSizeBytes() {
-    return m_FrameBuffer.FrameBufferWidth * m_FrameBuffer.FrameBufferHeight * 4;
+    return m_FrameBuffer.FrameBufferWidth * m_FrameBuffer.FrameBufferHeight * m_BytesPerPixel;
 }
 
 FrameBuffer BasicVGA::GetFrameBuffer() {
@@ -220,11 +268,11 @@ const Colour& BasicVGA::GetForegroundColour() {
 }
 
 uint64_t BasicVGA::GetAmountOfTextRows() {
-    return m_FrameBuffer.FrameBufferHeight / 16;
+    return m_FrameBuffer.FrameBufferHeight / VGA_CHAR_HEIGHT;
 }
 
 uint64_t BasicVGA::GetAmountOfTextColumns() {
-    return m_FrameBuffer.FrameBufferWidth / 10;
+    return m_FrameBuffer.FrameBufferWidth / VGA_CHAR_WIDTH;
 }
 
 void BasicVGA::EnableDoubleBuffering(PageManager* pm) {
@@ -236,6 +284,28 @@ void BasicVGA::EnableDoubleBuffering(PageManager* pm) {
         return;
     fast_memset(m_buffer, 0, ALIGN_UP(GetScreenSizeBytes(), 0x1000) / 8);
     m_DoubleBuffer = true;
+    MarkDirty(0, 0, m_FrameBuffer.FrameBufferWidth, m_FrameBuffer.FrameBufferHeight);
+    if (m_textBuffer == nullptr) {
+        uint64_t rows = GetAmountOfTextRows();
+        uint64_t columns = GetAmountOfTextColumns();
+        if (rows == 0 || columns == 0)
+            return;
+        uint64_t size = rows * columns * sizeof(TextCell) + rows * sizeof(bool);
+        TextCell* text = (TextCell*)m_pm->AllocatePages(DIV_ROUNDUP(size, 0x1000));
+        if (text == nullptr)
+            return; // we can still scroll by moving pixels
+        m_textRows = rows;
+        m_textColumns = columns;
+        m_textFirstRow = 0;
+        m_dirtyRows = (bool*)(text + rows * columns);
+        uint64_t fg = m_fgcolour.render();
+        uint64_t bg = m_bgcolour.render();
+        for (uint64_t i = 0; i < rows * columns; i++)
+            text[i] = {fg, bg, ' '};
+        for (uint64_t i = 0; i < rows; i++)
+            m_dirtyRows[i] = false;
+        m_textBuffer = text;
+    }
 }
 
 void BasicVGA::DisableDoubleBuffering() {
@@ -243,17 +313,43 @@ void BasicVGA::DisableDoubleBuffering() {
         return;
     m_DoubleBuffer = false;
     m_pm->FreePages(m_buffer);
+    m_dirtyLeft = 0;
+    m_dirtyTop = 0;
+    m_dirtyRight = 0;
+    m_dirtyBottom = 0;
+    if (m_textBuffer != nullptr) {
+        // The real frame buffer hasn't seen anything since the last swap
+        for (uint64_t i = 0; i < m_textRows; i++)
+            m_dirtyRows[i] = true;
+        FlushText();
+    }
 }
 
 void BasicVGA::SwapBuffers(bool disable_interrupts) {
+    FlushText();
     if (!m_DoubleBuffer)
         return;
+    if (m_dirtyLeft >= m_dirtyRight || m_dirtyTop >= m_dirtyBottom)
+        return; // nothing has changed
+    uint64_t pitch = m_FrameBuffer.FrameBufferWidth * m_BytesPerPixel;
+    uint64_t offset = m_dirtyTop * pitch + m_dirtyLeft * m_BytesPerPixel;
+    uint64_t row_size = (m_dirtyRight - m_dirtyLeft) * m_BytesPerPixel;
+    uint64_t rows = m_dirtyBottom - m_dirtyTop;
+    m_dirtyLeft = 0;
+    m_dirtyTop = 0;
+    m_dirtyRight = 0;
+    m_dirtyBottom = 0;
     if (disable_interrupts) {
 #ifdef __x86_64__
         x86_64_DisableInterrupts();
 #endif
     }
-    fast_memcpy(m_FrameBuffer.FrameBufferAddress, m_buffer, GetScreenSizeBytes());
+    if (row_size == pitch)
+        memcpy((uint8_t*)m_FrameBuffer.FrameBufferAddress + offset, m_buffer + offset, rows * pitch);
+    else {
+        for (uint64_t i = 0; i < rows; i++, offset += pitch)
+            memcpy((uint8_t*)m_FrameBuffer.FrameBufferAddress + offset, m_buffer + offset, row_size);
+    }
     if (disable_interrupts) {
 #ifdef __x86_64__
         x86_64_EnableInterrupts();
@@ -264,3 +360,160 @@ void BasicVGA::SwapBuffers(bool disable_interrupts) {
 bool BasicVGA::isDoubleBufferEnabled() {
     return m_DoubleBuffer;
 }
+
+void BasicVGA::FlushText() {
+    if (m_textBuffer == nullptr)
+        return;
+    for (uint64_t row = 0; row < m_textRows; row++) {
+        if (m_dirtyRows[row]) {
+            RepaintTextRow(row);
+            m_dirtyRows[row] = false;
+        }
+    }
+}
+
+uint8_t* BasicVGA::GetDrawBuffer() {
+    if (m_DoubleBuffer)
+        return m_buffer;
+    return (uint8_t*)m_FrameBuffer.FrameBufferAddress;
+}
+
+BasicVGA::TextCell* BasicVGA::GetTextRow(uint64_t row) {
+    return &m_textBuffer[((m_textFirstRow + row) % m_textRows) * m_textColumns];
+}
+
+void BasicVGA::RepaintTextRow(uint64_t row) {
+    TextCell* cells = GetTextRow(row);
+    for (uint64_t column = 0; column < m_textColumns; column++)
+        DrawChar(column * VGA_CHAR_WIDTH, row * VGA_CHAR_HEIGHT, cells[column].c, cells[column].fg, cells[column].bg);
+}
+
+void BasicVGA::MarkDirty(uint64_t x, uint64_t y, uint64_t width, uint64_t height) {
+    if (!m_DoubleBuffer)
+        return;
+    if (m_dirtyLeft >= m_dirtyRight || m_dirtyTop >= m_dirtyBottom) {
+        m_dirtyLeft = x;
+        m_dirtyTop = y;
+        m_dirtyRight = x + width;
+        m_dirtyBottom = y + height;
+        return;
+    }
+    if (x < m_dirtyLeft)
+        m_dirtyLeft = x;
+    if (y < m_dirtyTop)
+        m_dirtyTop = y;
+    if (x + width > m_dirtyRight)
+        m_dirtyRight = x + width;
+    if (y + height > m_dirtyBottom)
+        m_dirtyBottom = y + height;
+}
+
+void BasicVGA::DrawChar(uint64_t x, uint64_t y, char c, uint64_t fg, uint64_t bg) {
+    MarkDirty(x, y, VGA_CHAR_WIDTH, VGA_CHAR_HEIGHT);
+    switch (m_BytesPerPixel) {
+    case 1:
+        DrawCharImpl<1>(x, y, c, fg, bg);
+        break;
+    case 2:
+        DrawCharImpl<2>(x, y, c, fg, bg);
+        break;
+    case 3:
+        DrawCharImpl<3>(x, y, c, fg, bg);
+        break;
+    case 4:
+        DrawCharImpl<4>(x, y, c, fg, bg);
+        break;
+    case 5:
+        DrawCharImpl<5>(x, y, c, fg, bg);
+        break;
+    case 6:
+        DrawCharImpl<6>(x, y, c, fg, bg);
+        break;
+    case 7:
+        DrawCharImpl<7>(x, y, c, fg, bg);
+        break;
+    case 8:
+        DrawCharImpl<8>(x, y, c, fg, bg);
+        break;
+    default:
+        break;
+    }
+}
+
+void BasicVGA::FillRect(uint64_t x, uint64_t y, uint64_t width, uint64_t height, uint64_t colour) {
+    MarkDirty(x, y, width, height);
+    switch (m_BytesPerPixel) {
+    case 1:
+        FillRectImpl<1>(x, y, width, height, colour);
+        break;
+    case 2:
+        FillRectImpl<2>(x, y, width, height, colour);
+        break;
+    case 3:
+        FillRectImpl<3>(x, y, width, height, colour);
+        break;
+    case 4:
+        FillRectImpl<4>(x, y, width, height, colour);
+        break;
+    case 5:
+        FillRectImpl<5>(x, y, width, height, colour);
+        break;
+    case 6:
+        FillRectImpl<6>(x, y, width, height, colour);
+        break;
+    case 7:
+        FillRectImpl<7>(x, y, width, height, colour);
+        break;
+    case 8:
+        FillRectImpl<8>(x, y, width, height, colour);
+        break;
+    default:
+        break;
+    }
+}
+
+template <uint8_t BytesPerPixel>
+void BasicVGA::DrawCharImpl(uint64_t x, uint64_t y, char c, uint64_t fg, uint64_t bg) {
+    uint8_t index = IsCharValid(c) ? (uint8_t)(c - 32) : 0;
+    uint64_t pitch = m_FrameBuffer.FrameBufferWidth * BytesPerPixel;
+    uint8_t* dst = GetDrawBuffer() + y * pitch + x * BytesPerPixel;
+    if constexpr (BytesPerPixel <= VGA_GLYPH_CACHE_MAX_BYTES_PER_PIXEL) {
+        const uint8_t* glyph = GetCachedGlyph<BytesPerPixel>(index, fg, bg);
+        for (uint8_t cy = 0; cy < VGA_CHAR_HEIGHT; cy++, dst += pitch)
+            CopyGlyphRow<BytesPerPixel>(dst, glyph + cy * sizeof(m_glyphCache[0][0]));
+    }
+    else {
+        // The font stores rows bottom up
+        for (uint8_t cy = 0; cy < VGA_CHAR_HEIGHT; cy++, dst += pitch)
+            ExpandGlyphRow<BytesPerPixel>(dst, letters[index][VGA_CHAR_HEIGHT - 1 - cy], fg, bg);
+    }
+}
+
+template <uint8_t BytesPerPixel>
+void BasicVGA::FillRectImpl(uint64_t x, uint64_t y, uint64_t width, uint64_t height, uint64_t colour) {
+    uint64_t pitch = m_FrameBuffer.FrameBufferWidth * BytesPerPixel;
+    uint8_t* row = GetDrawBuffer() + y * pitch + x * BytesPerPixel;
+    for (uint64_t i = 0; i < height; i++, row += pitch) {
+        uint8_t* pixel = row;
+        for (uint64_t j = 0; j < width; j++, pixel += BytesPerPixel)
+            WritePixel<BytesPerPixel>(pixel, colour);
+    }
+}
+
+template <uint8_t BytesPerPixel>
+const uint8_t* BasicVGA::GetCachedGlyph(uint8_t index, uint64_t fg, uint64_t bg) {
+    if (m_glyphCacheFG != fg || m_glyphCacheBG != bg || m_glyphCacheBytesPerPixel != BytesPerPixel) {
+        m_glyphCacheFG = fg;
+        m_glyphCacheBG = bg;
+        m_glyphCacheBytesPerPixel = BytesPerPixel;
+        for (uint8_t i = 0; i < VGA_GLYPH_COUNT; i++)
+            m_glyphCacheValid[i] = false;
+    }
+    if (!m_glyphCacheValid[index]) {
+        // The font stores rows bottom up
+        for (uint8_t cy = 0; cy < VGA_CHAR_HEIGHT; cy++)
+            ExpandGlyphRow<BytesPerPixel>(m_glyphCache[index][cy], letters[index][VGA_CHAR_HEIGHT - 1 - cy], fg, bg);
+        m_glyphCacheValid[index] = true;
+    }
+    return &m_glyphCache[index][0][0];
+}
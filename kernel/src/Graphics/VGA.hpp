@@ -25,6 +25,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <Memory/PageManager.hpp>
 
+#define VGA_CHAR_WIDTH 10 // 8 pixels of glyph and 2 of spacing
+#define VGA_CHAR_HEIGHT 16
+#define VGA_GLYPH_COUNT 95 // printable ASCII, starting at space
+
+// Glyphs are only cached for formats up to this many bytes per pixel. Wider formats are expanded straight into the buffer.
+#define VGA_GLYPH_CACHE_MAX_BYTES_PER_PIXEL 4
+
 class BasicVGA {
 public:
     BasicVGA();
@@ -60,6 +67,29 @@ public:
     void SwapBuffers(bool disable_interrupts = true);
     bool isDoubleBufferEnabled();
 
+    // Repaint any text rows that were deferred by scrolling. Done automatically by SwapBuffers.
+    void FlushText();
+
+private:
+    struct TextCell {
+        uint64_t fg;
+        uint64_t bg;
+        char c;
+    } __attribute__((packed));
+
+    uint8_t* GetDrawBuffer();
+    TextCell* GetTextRow(uint64_t row); // row is on screen, not in the ring
+
+    void MarkDirty(uint64_t x, uint64_t y, uint64_t width, uint64_t height);
+
+    void DrawChar(uint64_t x, uint64_t y, char c, uint64_t fg, uint64_t bg);
+    void FillRect(uint64_t x, uint64_t y, uint64_t width, uint64_t height, uint64_t colour);
+    void RepaintTextRow(uint64_t row);
+
+    template <uint8_t BytesPerPixel> void DrawCharImpl(uint64_t x, uint64_t y, char c, uint64_t fg, uint64_t bg);
+    template <uint8_t BytesPerPixel> void FillRectImpl(uint64_t x, uint64_t y, uint64_t width, uint64_t height, uint64_t colour);
+    template <uint8_t BytesPerPixel> const uint8_t* GetCachedGlyph(uint8_t index, uint64_t fg, uint64_t bg);
+
 private:
     Position m_CursorPosition;
     Colour m_bgcolour;
@@ -69,6 +99,27 @@ private:
     PageManager* m_pm;
     bool m_DoubleBuffer;
     uint8_t* m_buffer;
+    uint8_t m_BytesPerPixel;
+
+    // Bounding rectangle of the double buffer that has changed since the last swap. Empty when left >= right.
+    uint64_t m_dirtyLeft;
+    uint64_t m_dirtyTop;
+    uint64_t m_dirtyRight;
+    uint64_t m_dirtyBottom;
+
+    // Glyphs pre-expanded to pixel rows for m_glyphCacheFG and m_glyphCacheBG, filled in lazily
+    uint64_t m_glyphCacheFG;
+    uint64_t m_glyphCacheBG;
+    uint8_t m_glyphCacheBytesPerPixel;
+    bool m_glyphCacheValid[VGA_GLYPH_COUNT];
+    uint8_t m_glyphCache[VGA_GLYPH_COUNT][VGA_CHAR_HEIGHT][VGA_CHAR_WIDTH * VGA_GLYPH_CACHE_MAX_BYTES_PER_PIXEL];
+
+    // Shadow copy of the text on screen, created with the double buffer. Scrolling rotates m_textFirstRow and marks every row dirty instead of moving pixels.
+    TextCell* m_textBuffer;
+    bool* m_dirtyRows;
+    uint64_t m_textRows;
+    uint64_t m_textColumns;
+    uint64_t m_textFirstRow;
 };
 
 #endif /* _KERNEL_HAL_GRAPHICS_HPP */
\ No newline at end of file
@@ -28,14 +28,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <arch/x86_64/interrupts/APIC/IOAPIC.hpp>
 
 #include <arch/x86_64/interrupts/IRQ.hpp>
+
+#include <arch/x86_64/Processor.hpp>
 #endif
 
+#include <Scheduling/Scheduler.hpp>
+
 #include "../../hal.hpp"
 
 //#define MADT_DEBUG
 
 ACPISDTHeader* g_MADT;
 
+#define MADT_LAPIC_ENABLED 1
+
 bool InitAndValidateMADT(ACPISDTHeader* MADT) {
     if (MADT == nullptr)
         return false;
@@ -50,12 +56,14 @@ void EnumerateMADTEntries() {
     MADTEntriesHeader* entriesHeader = (MADTEntriesHeader*)((uint64_t)g_MADT + sizeof(ACPISDTHeader));
     void* LAPIC_address = (void*)(uint64_t)(entriesHeader->LAPICAddress);
 
-    uint8_t APIC_ID;
+    uint32_t APIC_ID = 0;
 #ifdef __x86_64__
-    __asm__ volatile ("mov $1, %%eax; cpuid; shr $24, %%ebx;" : "=b"(APIC_ID) : : "eax", "ecx", "edx");
+    APIC_ID = GetCurrentProcessorID();
+    x86_64_LAPIC_DetectX2APIC();
 #endif
 
     LinkedList::SimpleLinkedList<MADT_LocalAPIC> LAPICs;
+    LinkedList::SimpleLinkedList<MADT_Localx2APIC> x2APICs;
     LinkedList::SimpleLinkedList<MADT_IOAPIC> IOAPICs;
     LinkedList::SimpleLinkedList<MADT_InterruptSourceOverride> InterruptSourceOverrides;
 
@@ -108,12 +116,15 @@ void EnumerateMADTEntries() {
                 LAPIC_address = (void*)(localAPICAddressOverride->LocalAPICAddress);
                 break;
             }
-#ifdef MADT_DEBUG
             case 9: {
                 MADT_Localx2APIC* localx2APIC = (MADT_Localx2APIC*)entry;
+#ifdef MADT_DEBUG
                 dbgprintf("Local x2APIC: ACPI Processor ID: %u, Local APIC ID: %u, Flags: %u\n", localx2APIC->ACPIProcessorUID, localx2APIC->x2APICID, localx2APIC->Flags);
+#endif
+                x2APICs.insert(localx2APIC);
                 break;
             }
+#ifdef MADT_DEBUG
             default:
                 dbgprintf("Unknown MADT entry type: %d\n", entry->Type);
                 break;
@@ -162,18 +173,57 @@ void EnumerateMADTEntries() {
         x86_64_IRQ_ReserveIRQ(interruptSourceOverride->GlobalSystemInterrupt);
     }
 
-    for (uint64_t i = 0; i < LAPICs.getCount(); i++) {
-        MADT_LocalAPIC* localAPIC = LAPICs.get(i);
-        if (localAPIC->APICID != APIC_ID) {
-            x86_64_LocalAPIC* lapic = new x86_64_LocalAPIC(to_HHDM(LAPIC_address), false, localAPIC->APICID);
-            lapic->StartCPU();
+    // Firmware lists processors with IDs below 255 as type 0 entries and the rest as type 9, but may list a processor under both.
+    uint64_t total = LAPICs.getCount() + x2APICs.getCount();
+    uint64_t started = 1; // the BSP
+    x86_64_LocalAPIC** APs = new x86_64_LocalAPIC*[total];
+    uint64_t AP_count = 0;
+    for (uint64_t i = 0; i < total; i++) {
+        uint32_t ID;
+        uint32_t flags;
+        if (i < LAPICs.getCount()) {
+            MADT_LocalAPIC* localAPIC = LAPICs.get(i);
+            ID = localAPIC->APICID;
+            flags = localAPIC->Flags;
         }
         else {
-            x86_64_LocalAPIC* lapic = new x86_64_LocalAPIC(to_HHDM(LAPIC_address), true, localAPIC->APICID);
+            MADT_Localx2APIC* localx2APIC = x2APICs.get(i - LAPICs.getCount());
+            ID = localx2APIC->x2APICID;
+            flags = localx2APIC->Flags;
+            bool duplicate = false;
+            for (uint64_t j = 0; j < LAPICs.getCount(); j++) {
+                if (LAPICs.get(j)->APICID == ID) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (duplicate)
+                continue;
+        }
+        if (ID == APIC_ID) {
+            x86_64_LocalAPIC* lapic = new x86_64_LocalAPIC(to_HHDM(LAPIC_address), true, ID);
             g_BSP.SetLocalAPIC(lapic);
             g_BSP.InitialiseLocalAPIC();
+            continue;
         }
+        if (!(flags & MADT_LAPIC_ENABLED)) // hot-pluggable processors that are not present yet
+            continue;
+        if (ID >= 0xFF && !x86_64_LAPIC_IsX2APIC()) {
+            dbgprintf("MADT: skipping processor with APIC ID %u, x2APIC is not supported\n", ID);
+            continue;
+        }
+        if (started >= SCHEDULER_MAX_PROCESSORS) {
+            dbgprintf("MADT: skipping processor with APIC ID %u, only %u processors are supported\n", ID, SCHEDULER_MAX_PROCESSORS);
+            continue;
+        }
+        APs[AP_count++] = new x86_64_LocalAPIC(to_HHDM(LAPIC_address), false, ID);
+        started++;
     }
 
+    // the APs are all started together once the BSP's local APIC is in its final mode
+    if (g_BSP.GetLocalAPIC() != nullptr)
+        g_BSP.GetLocalAPIC()->StartCPUs(APs, AP_count);
+    delete[] APs;
+
 }
 
@@ -232,6 +232,12 @@ uint64_t HPET::GetClockPeriod() const {
     return m_CounterClockPeriod;
 }
 
+uint64_t HPET::GetNanoseconds() const {
+    uint64_t counter = GetMainCounter();
+    // the period is in femtoseconds, so split the multiplication to avoid overflowing
+    return (counter / 1'000'000) * m_CounterClockPeriod + ((counter % 1'000'000) * m_CounterClockPeriod) / 1'000'000;
+}
+
 void HPET::HandleInterrupt(uint8_t timer) {
     m_timers[timer].active = false;
     m_timers[timer].callback(m_timers[timer].data);
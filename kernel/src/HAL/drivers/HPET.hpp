@@ -92,6 +92,9 @@ public:
 
     uint64_t GetClockPeriod() const;
 
+    // Returns the value of the main counter in nanoseconds
+    uint64_t GetNanoseconds() const;
+
 
     void HandleInterrupt(uint8_t interrupt);
 
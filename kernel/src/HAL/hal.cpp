@@ -16,6 +16,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include <arch/x86_64/Processor.hpp>
+#include <arch/x86_64/UART16550.hpp>
 
 #include <arch/x86_64/io.h>
 #include <arch/x86_64/panic.hpp>
@@ -49,6 +50,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 Processor g_BSP(true);
 
+x86_64_UART16550 g_COM1;
+
 void HAL_EarlyInit(MemoryMapEntry** MemoryMap, uint64_t MMEntryCount, uint64_t kernel_virtual, uint64_t kernel_physical, uint64_t kernel_size, uint64_t HHDM_start, const FrameBuffer& fb) {
     x86_64_DisableInterrupts();
 
@@ -95,7 +98,10 @@ void HAL_Stage2(void* RSDP) {
     LAPIC->InitTimer();
 
     Scheduling::Scheduler::InitProcessorTimers();
-    
+
+    // The UART needs the I/O APIC for its TX interrupt, so until now debug output has gone to port 0xE9.
+    if (MADTFound && g_COM1.Init(X86_64_COM1_PORT, X86_64_COM1_IRQ))
+        g_DebugUART = &g_COM1;
 }
 
 void HAL_FullInit() {
@@ -18,7 +18,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "time.h"
 
 #ifdef __x86_64__
+#include <arch/x86_64/io.h>
 #include <arch/x86_64/RTC.hpp>
+#include <arch/x86_64/TSC.hpp>
+
+#include <arch/x86_64/Scheduling/taskutil.hpp>
 #endif
 
 #include <util.h>
@@ -26,6 +30,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "drivers/HPET.hpp"
 
+#include <Scheduling/Scheduler.hpp>
+#include <Scheduling/SystemInfo.hpp>
+
 const char* days_of_week[7] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
 const char* months[12] = {"January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December"};
 
@@ -39,6 +46,14 @@ extern "C" void HAL_TimeInit() {
     g_timerTicks = 0;
     g_allowTimer = 1;
     g_timerRunning = 1;
+#ifdef __x86_64__
+    if (x86_64_TSC_Init()) {
+        uint64_t base_tsc, base_ns, mult;
+        uint8_t shift;
+        x86_64_TSC_GetConversion(&base_tsc, &base_ns, &mult, &shift);
+        SystemInfo_SetTSC(base_tsc, base_ns, mult, shift);
+    }
+#endif
     g_HPET->StartTimer(1'000'000'000'000, TimerCallback, nullptr);
     
     RTC_Init();
@@ -51,12 +66,22 @@ extern "C" void HAL_TimeInit() {
             break;
         }
     }
+    SystemInfo_SetBootTime(getTime() - GetTimer() / TICKS_PER_SECOND);
 }
 
 extern "C" void sleep(uint64_t ms) {
-    uint64_t start = GetTimer();
-    while ((GetTimer() - start) < ms)
-        __asm__ volatile ("" ::: "memory");
+    // The calling thread, whether a kernel thread or a user thread in a system call, is parked on the scheduler's sleep queue.
+    // Before the scheduler starts, or with interrupts off, there is nothing to park so we spin.
+    Scheduling::Thread* thread = Scheduling::Scheduler::GetCurrent();
+#ifdef __x86_64__
+    if (thread != nullptr && !thread->IsIdle() && x86_64_AreInterruptsEnabled()) {
+        thread_sleep(thread, ms);
+        return;
+    }
+#endif
+    uint64_t end = GetMonotonicTime() + ms * 1'000'000;
+    while (GetMonotonicTime() < end)
+        __asm__ volatile ("pause" ::: "memory");
 }
 
 void TimerCallback(void*) {
@@ -64,7 +89,8 @@ void TimerCallback(void*) {
         g_timerRunning = 0;
         return;
     }
-    __atomic_add_fetch(&g_timerTicks, 1, __ATOMIC_SEQ_CST);
+    uint64_t ticks = __atomic_add_fetch(&g_timerTicks, 1, __ATOMIC_SEQ_CST);
+    SystemInfo_UpdateClock(ticks, GetMonotonicTime());
     g_HPET->StartTimer(1'000'000'000'000, TimerCallback, nullptr);
 }
 
@@ -75,6 +101,14 @@ extern "C" uint64_t GetTimer() {
     return g_timerTicks;
 }
 
+extern "C" uint64_t GetMonotonicTime() {
+#ifdef __x86_64__
+    if (x86_64_TSC_IsAvailable())
+        return x86_64_TSC_GetNanoseconds();
+#endif
+    return g_HPET->GetNanoseconds();
+}
+
 extern "C" time_t getTime() {
     for (int i = 0; i < 5; i++) { // 5 attempts
         RTCTime time = RTC_getCurrentTime();
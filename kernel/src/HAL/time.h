@@ -34,6 +34,9 @@ void sleep(uint64_t ms);
 
 uint64_t GetTimer();
 
+// Monotonic time in nanoseconds. Uses the TSC when it is invariant, otherwise the HPET.
+uint64_t GetMonotonicTime();
+
 time_t getTime();
 
 #ifdef __cplusplus
@@ -0,0 +1,372 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "KernelLog.hpp"
+
+#include <Data-structures/RingBuffer.hpp>
+
+#include <HAL/time.h>
+#include <HAL/drivers/HPET.hpp>
+
+#include <Scheduling/Process.hpp>
+#include <Scheduling/Scheduler.hpp>
+#include <Scheduling/Thread.hpp>
+
+#include <spinlock.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <arch/x86_64/io.h>
+#include <arch/x86_64/Processor.hpp>
+#endif
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+static_assert((LOG_HISTORY_SIZE & (LOG_HISTORY_SIZE - 1)) == 0, "LOG_HISTORY_SIZE must be a power of 2");
+
+struct CPULog {
+    RingBuffer<LogRecord, LOG_RING_SIZE> ring;
+    uint64_t dropped; // records lost to a full ring since the drain last looked
+    char partial[sizeof(LogRecord::text)]; // characters from KernelLog_PutChar that don't end in a newline yet
+    uint16_t partial_length;
+    LogLevel partial_level;
+};
+
+CPULog g_BSPLog; // the BSP logs before the heap exists
+CPULog* g_CPULogs[SCHEDULER_MAX_PROCESSORS] = {nullptr};
+uint64_t g_LogCPUCount = 0;
+
+uint64_t g_LogNextSequence = 0;
+bool g_LogDeferred = false; // set once the drain thread exists, cleared on panic
+
+spinlock_t g_LogConsumeLock = 0;
+bool g_LogAtLineStart = true; // only touched by whoever holds g_LogConsumeLock or is draining
+
+char g_LogHistory[LOG_HISTORY_SIZE];
+uint64_t g_LogHistoryEnd = 0; // total bytes ever appended, so positions never wrap
+spinlock_t g_LogHistoryLock = 0;
+
+static bool KernelLog_DisableInterrupts() {
+#ifdef __x86_64__
+    bool enabled = x86_64_AreInterruptsEnabled();
+    x86_64_DisableInterrupts();
+    return enabled;
+#else
+    return false;
+#endif
+}
+
+static void KernelLog_RestoreInterrupts(bool enabled) {
+#ifdef __x86_64__
+    if (enabled)
+        x86_64_EnableInterrupts();
+#else
+    (void)enabled;
+#endif
+}
+
+// Interrupts must be disabled so the caller stays on this CPU.
+static CPULog* KernelLog_GetCurrentCPULog(uint16_t* id) {
+    if (g_CPULogs[0] == nullptr)
+        return nullptr; // the BSP has not been set up yet, so there is no processor info to go by
+#ifdef __x86_64__
+    Scheduling::Scheduler::ProcessorInfo* info = GetCurrentProcessorInfo();
+    if (info == nullptr || info->id >= SCHEDULER_MAX_PROCESSORS)
+        return nullptr;
+    *id = info->id;
+    return __atomic_load_n(&g_CPULogs[info->id], __ATOMIC_ACQUIRE);
+#else
+    return nullptr;
+#endif
+}
+
+static void KernelLog_AppendHistory(const char* text, size_t length) {
+    bool interrupts = KernelLog_DisableInterrupts();
+    spinlock_acquire(&g_LogHistoryLock);
+    for (size_t i = 0; i < length;) {
+        size_t offset = (g_LogHistoryEnd + i) & (LOG_HISTORY_SIZE - 1);
+        size_t chunk = min(length - i, LOG_HISTORY_SIZE - offset);
+        memcpy(&g_LogHistory[offset], &text[i], chunk);
+        i += chunk;
+    }
+    g_LogHistoryEnd += length;
+    spinlock_release(&g_LogHistoryLock);
+    KernelLog_RestoreInterrupts(interrupts);
+}
+
+static void KernelLog_Emit(LogLevel level, const char* text, size_t length) {
+    if (length == 0)
+        return;
+    fwrite(text, length, 1, stddebug);
+    if (level >= LOG_CONSOLE_LEVEL)
+        fwrite(text, length, 1, stdout);
+    KernelLog_AppendHistory(text, length);
+}
+
+static void KernelLog_Output(const LogRecord& record) {
+    if (g_LogAtLineStart) {
+        const char* tag = "";
+        if (record.level == LogLevel::WARNING)
+            tag = "WARNING: ";
+        else if (record.level == LogLevel::ERROR)
+            tag = "ERROR: ";
+        char prefix[48];
+        snprintf(prefix, sizeof(prefix), "[%5lu.%06lu] %s", record.timestamp / 1'000'000'000, (record.timestamp / 1'000) % 1'000'000, tag);
+        KernelLog_Emit(record.level, prefix, strlen(prefix));
+    }
+    KernelLog_Emit(record.level, record.text, record.length);
+    g_LogAtLineStart = record.length > 0 && record.text[record.length - 1] == '\n';
+}
+
+// Write out the oldest pending record across all CPUs. Returns false if there was nothing to write.
+static bool KernelLog_DrainOne() {
+    LogRecord record;
+    bool found = false;
+    uint64_t dropped = 0;
+
+    bool interrupts = KernelLog_DisableInterrupts();
+    spinlock_acquire(&g_LogConsumeLock);
+    CPULog* oldest = nullptr;
+    const LogRecord* oldest_record = nullptr;
+    uint64_t cpu_count = __atomic_load_n(&g_LogCPUCount, __ATOMIC_ACQUIRE);
+    for (uint64_t i = 0; i < cpu_count; i++) {
+        CPULog* log = __atomic_load_n(&g_CPULogs[i], __ATOMIC_ACQUIRE);
+        if (log == nullptr)
+            continue;
+        dropped += __atomic_exchange_n(&log->dropped, 0, __ATOMIC_RELAXED);
+        const LogRecord* current = log->ring.Peek();
+        if (current != nullptr && (oldest_record == nullptr || current->sequence < oldest_record->sequence)) {
+            oldest = log;
+            oldest_record = current;
+        }
+    }
+    if (oldest != nullptr) {
+        memcpy(&record, oldest_record, sizeof(LogRecord));
+        oldest->ring.Discard();
+        found = true;
+    }
+    spinlock_release(&g_LogConsumeLock);
+    KernelLog_RestoreInterrupts(interrupts);
+
+    // Output happens outside the lock so the rings keep accepting records while the console is slow.
+    if (dropped > 0) {
+        char message[64];
+        snprintf(message, sizeof(message), "%s%lu log records dropped\n", g_LogAtLineStart ? "" : "\n", dropped);
+        KernelLog_Emit(LogLevel::WARNING, message, strlen(message));
+        g_LogAtLineStart = true;
+    }
+    if (found)
+        KernelLog_Output(record);
+    return found;
+}
+
+static void KernelLog_DrainThread(void*) {
+    while (true) {
+        while (KernelLog_DrainOne()) {}
+        sleep(LOG_DRAIN_INTERVAL_MS);
+    }
+}
+
+// Interrupts must be disabled, as nothing else can push to this CPU's ring then, which keeps it single producer.
+static void KernelLog_PushRecord(CPULog* log, uint16_t cpu, LogRecord& record) {
+    record.sequence = __atomic_fetch_add(&g_LogNextSequence, 1, __ATOMIC_RELAXED);
+    record.cpu = cpu;
+    if (!log->ring.Push(record))
+        __atomic_add_fetch(&log->dropped, 1, __ATOMIC_RELAXED);
+}
+
+// Interrupts must be disabled.
+static void KernelLog_PushPartial(CPULog* log, uint16_t cpu) {
+    if (log->partial_length == 0)
+        return;
+    LogRecord record;
+    record.timestamp = g_HPET != nullptr ? GetMonotonicTime() : 0;
+    record.length = log->partial_length;
+    record.level = log->partial_level;
+    memcpy(record.text, log->partial, log->partial_length);
+    log->partial_length = 0;
+    KernelLog_PushRecord(log, cpu, record);
+}
+
+// Without a ring there is nothing to order against, but output still has to be serialised with the drain.
+static void KernelLog_OutputDirect(const LogRecord& record) {
+    bool interrupts = KernelLog_DisableInterrupts();
+    spinlock_acquire(&g_LogConsumeLock);
+    KernelLog_Output(record);
+    spinlock_release(&g_LogConsumeLock);
+    KernelLog_RestoreInterrupts(interrupts);
+}
+
+static void KernelLog_DrainIfImmediate() {
+    if (!__atomic_load_n(&g_LogDeferred, __ATOMIC_ACQUIRE)) {
+        while (KernelLog_DrainOne()) {}
+    }
+}
+
+static void KernelLog_WriteRecord(LogLevel level, const char* text, size_t length) {
+    LogRecord record;
+    record.timestamp = g_HPET != nullptr ? GetMonotonicTime() : 0;
+    record.length = length;
+    record.level = level;
+    memcpy(record.text, text, length);
+
+    bool interrupts = KernelLog_DisableInterrupts();
+    uint16_t cpu = 0;
+    CPULog* log = KernelLog_GetCurrentCPULog(&cpu);
+    if (log == nullptr) {
+        KernelLog_RestoreInterrupts(interrupts);
+        record.sequence = 0;
+        record.cpu = 0;
+        KernelLog_OutputDirect(record);
+        return;
+    }
+    KernelLog_PushPartial(log, cpu); // it was written first
+    KernelLog_PushRecord(log, cpu, record);
+    KernelLog_RestoreInterrupts(interrupts);
+
+    KernelLog_DrainIfImmediate();
+}
+
+void KernelLog_AddCPU(uint64_t id) {
+    if (id >= SCHEDULER_MAX_PROCESSORS)
+        return; // the scheduler won't run it either
+    CPULog* log = id == 0 ? &g_BSPLog : new CPULog;
+    log->dropped = 0;
+    log->partial_length = 0;
+    __atomic_store_n(&g_CPULogs[id], log, __ATOMIC_RELEASE);
+    uint64_t count = __atomic_load_n(&g_LogCPUCount, __ATOMIC_RELAXED);
+    while (count < id + 1 && !__atomic_compare_exchange_n(&g_LogCPUCount, &count, id + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+}
+
+void KernelLog_StartDrainThread(Scheduling::Process* process) {
+    Scheduling::Thread* thread = new Scheduling::Thread(process, KernelLog_DrainThread, nullptr, Scheduling::THREAD_KERNEL_DEFAULT);
+    process->ScheduleThread(thread);
+    __atomic_store_n(&g_LogDeferred, true, __ATOMIC_RELEASE);
+}
+
+void KernelLog_EnterPanicMode() {
+    __atomic_store_n(&g_LogDeferred, false, __ATOMIC_RELEASE);
+    // The other CPUs have been stopped, possibly while holding these.
+    spinlock_init(&g_LogConsumeLock);
+    spinlock_init(&g_LogHistoryLock);
+    bool interrupts = KernelLog_DisableInterrupts();
+    uint64_t cpu_count = __atomic_load_n(&g_LogCPUCount, __ATOMIC_ACQUIRE);
+    for (uint64_t i = 0; i < cpu_count; i++) {
+        CPULog* log = __atomic_load_n(&g_CPULogs[i], __ATOMIC_ACQUIRE);
+        if (log != nullptr)
+            KernelLog_PushPartial(log, i); // safe from here, as no other CPU is running to push to it
+    }
+    KernelLog_RestoreInterrupts(interrupts);
+    while (KernelLog_DrainOne()) {}
+}
+
+void KernelLog_Write(LogLevel level, const char* text, size_t length) {
+    while (length > 0) {
+        size_t chunk = min(length, sizeof(LogRecord::text));
+        KernelLog_WriteRecord(level, text, chunk);
+        text += chunk;
+        length -= chunk;
+    }
+}
+
+void KernelLog_PutChar(LogLevel level, char c) {
+    bool interrupts = KernelLog_DisableInterrupts();
+    uint16_t cpu = 0;
+    CPULog* log = KernelLog_GetCurrentCPULog(&cpu);
+    if (log == nullptr) {
+        KernelLog_RestoreInterrupts(interrupts);
+        KernelLog_WriteRecord(level, &c, 1);
+        return;
+    }
+    if (log->partial_length > 0 && log->partial_level != level)
+        KernelLog_PushPartial(log, cpu);
+    log->partial[log->partial_length++] = c;
+    log->partial_level = level;
+    bool pushed = c == '\n' || log->partial_length == sizeof(log->partial);
+    if (pushed)
+        KernelLog_PushPartial(log, cpu);
+    KernelLog_RestoreInterrupts(interrupts);
+
+    if (pushed)
+        KernelLog_DrainIfImmediate();
+}
+
+int klog(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int rc = vklog(level, format, args);
+    va_end(args);
+    return rc;
+}
+
+int vklog(LogLevel level, const char* format, va_list args) {
+    char buffer[LOG_MESSAGE_MAX];
+    int rc = vsnprintf(buffer, sizeof(buffer), format, args);
+    if (rc < 0)
+        return rc;
+    if ((size_t)rc >= sizeof(buffer))
+        strcpy(&buffer[sizeof(buffer) - sizeof(LOG_TRUNCATED_MARK)], LOG_TRUNCATED_MARK);
+    size_t length = strlen(buffer);
+    KernelLog_Write(level, buffer, length);
+    return (int)length;
+}
+
+int64_t KernelLog_Read(KernelLogReader* reader, uint8_t* buffer, int64_t count) {
+    int64_t total = 0;
+    char chunk[256];
+    while (total < count) {
+        // Copy through a bounce buffer so the destination is never touched with interrupts off.
+        bool interrupts = KernelLog_DisableInterrupts();
+        spinlock_acquire(&g_LogHistoryLock);
+        uint64_t start = g_LogHistoryEnd > LOG_HISTORY_SIZE ? g_LogHistoryEnd - LOG_HISTORY_SIZE : 0;
+        if (reader->position < start)
+            reader->position = start;
+        else if (reader->position > g_LogHistoryEnd)
+            reader->position = g_LogHistoryEnd;
+        uint64_t size = min(min(g_LogHistoryEnd - reader->position, (uint64_t)(count - total)), sizeof(chunk));
+        for (uint64_t i = 0; i < size;) {
+            uint64_t offset = (reader->position + i) & (LOG_HISTORY_SIZE - 1);
+            uint64_t part = min(size - i, LOG_HISTORY_SIZE - offset);
+            memcpy(&chunk[i], &g_LogHistory[offset], part);
+            i += part;
+        }
+        reader->position += size;
+        spinlock_release(&g_LogHistoryLock);
+        KernelLog_RestoreInterrupts(interrupts);
+        if (size == 0)
+            break;
+        memcpy(&buffer[total], chunk, size);
+        total += size;
+    }
+    return total;
+}
+
+uint64_t KernelLog_Seek(KernelLogReader* reader, uint64_t position) {
+    bool interrupts = KernelLog_DisableInterrupts();
+    spinlock_acquire(&g_LogHistoryLock);
+    uint64_t start = g_LogHistoryEnd > LOG_HISTORY_SIZE ? g_LogHistoryEnd - LOG_HISTORY_SIZE : 0;
+    if (position < start)
+        position = start;
+    else if (position > g_LogHistoryEnd)
+        position = g_LogHistoryEnd;
+    reader->position = position;
+    spinlock_release(&g_LogHistoryLock);
+    KernelLog_RestoreInterrupts(interrupts);
+    return position;
+}
@@ -0,0 +1,90 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _KERNEL_LOG_HPP
+#define _KERNEL_LOG_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+#define LOG_RECORD_SIZE 256
+#define LOG_RING_SIZE 256 // records per CPU, must be a power of 2
+#define LOG_HISTORY_SIZE 65536 // bytes of formatted output kept for KERNEL_LOG_PATH readers
+#define LOG_DRAIN_INTERVAL_MS 10
+#define LOG_CONSOLE_LEVEL LogLevel::INFO // records below this only go to the debug output
+#define LOG_MESSAGE_MAX 512 // bytes klog formats a message into, including the terminating null
+#define LOG_TRUNCATED_MARK " [truncated]\n"
+
+namespace Scheduling {
+    class Process;
+}
+
+enum class LogLevel : uint8_t {
+    DEBUG,
+    INFO,
+    WARNING,
+    ERROR
+};
+
+struct LogRecord {
+    uint64_t sequence;
+    uint64_t timestamp; // nanoseconds of monotonic time
+    uint16_t length;
+    LogLevel level;
+    uint16_t cpu;
+    char text[LOG_RECORD_SIZE - 21];
+} __attribute__((packed));
+
+static_assert(sizeof(LogRecord) == LOG_RECORD_SIZE);
+
+// Per file descriptor read position in the formatted history.
+struct KernelLogReader {
+    uint64_t position;
+};
+
+/*
+Each CPU appends records to its own ring with interrupts disabled, so writers never take a lock, touch the TTY or do port I/O.
+A kernel thread merges the rings in sequence order and writes them to the debug output and, from LOG_CONSOLE_LEVEL up, the console.
+Until that thread is running, and after a panic, records are written out immediately by whoever logged them.
+*/
+
+void KernelLog_AddCPU(uint64_t id);
+
+void KernelLog_StartDrainThread(Scheduling::Process* process);
+
+// Write out everything pending and stop deferring output. Only for use in a panic.
+void KernelLog_EnterPanicMode();
+
+// Text longer than one record is split over several.
+void KernelLog_Write(LogLevel level, const char* text, size_t length);
+
+// Characters are collected per CPU and logged as one record at each newline, or when a record is full.
+void KernelLog_PutChar(LogLevel level, char c);
+
+// Messages longer than LOG_MESSAGE_MAX - 1 bytes are cut short and end with LOG_TRUNCATED_MARK. Returns the number of bytes logged.
+int klog(LogLevel level, const char* format, ...);
+int vklog(LogLevel level, const char* format, va_list args);
+
+// Copies formatted history from reader's position. Readers that fall more than LOG_HISTORY_SIZE behind skip ahead to the oldest data still kept.
+int64_t KernelLog_Read(KernelLogReader* reader, uint8_t* buffer, int64_t count);
+
+// Move reader to position, clamped to the data still kept. Returns the new position.
+uint64_t KernelLog_Seek(KernelLogReader* reader, uint64_t position);
+
+#endif /* _KERNEL_LOG_HPP */
@@ -0,0 +1,218 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "LockStats.hpp"
+
+#include <spinlock.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <arch/x86_64/ELFSymbols.hpp>
+#endif
+
+#ifdef LOCK_STATS
+
+/*
+Open addressing on the lock address. Slots are claimed with a compare-exchange, so no lock is needed and everything here is safe
+from interrupt handlers, NMIs and the panic path. A destroyed lock's slot becomes a tombstone, so the probe chains through it
+stay intact, and it can be claimed again. Only the holder of a lock looks it up, so a lock can never be given two slots.
+*/
+#define LOCK_STATS_TOMBSTONE ((const void*)1)
+
+static LockStats g_LockStats[LOCK_STATS_TABLE_SIZE];
+static uint64_t g_LockStatsDropped = 0; // acquisitions of locks that didn't fit in the table
+static uint64_t g_LockStatsReleased = 0; // slots given back by destroyed locks
+
+static inline uint64_t LockStats_Now() {
+#ifdef __x86_64__
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline uint64_t LockStats_Hash(const void* lock) {
+    return (((uint64_t)lock >> 3) * 0x9E3779B97F4A7C15) >> 32;
+}
+
+static void LockStats_Clear(LockStats* stats) {
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->wait_time = 0;
+    stats->total_hold_time = 0;
+    stats->max_hold_time = 0;
+    stats->max_hold_site = nullptr;
+    stats->last_site = nullptr;
+    stats->acquired_at = 0;
+    stats->holder_site = nullptr;
+}
+
+// Returns nullptr if lock has no slot. If create is set, one is claimed for it, unless the table is full.
+static LockStats* LockStats_Find(const void* lock, bool create) {
+    uint64_t index = LockStats_Hash(lock);
+    uint64_t i = 0;
+    LockStats* tombstone = nullptr;
+    for (; i < LOCK_STATS_TABLE_SIZE; i++) {
+        LockStats* stats = &(g_LockStats[(index + i) & (LOCK_STATS_TABLE_SIZE - 1)]);
+        const void* current = __atomic_load_n(&(stats->lock), __ATOMIC_ACQUIRE);
+        if (current == lock)
+            return stats;
+        if (current == nullptr)
+            break; // nothing past here can be for lock
+        if (current == LOCK_STATS_TOMBSTONE && tombstone == nullptr)
+            tombstone = stats;
+    }
+    if (!create)
+        return nullptr;
+    if (tombstone != nullptr) {
+        const void* expected = LOCK_STATS_TOMBSTONE;
+        if (__atomic_compare_exchange_n(&(tombstone->lock), &expected, lock, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return tombstone;
+    }
+    // Another lock may claim a slot before us, in which case keep going along the chain
+    for (; i < LOCK_STATS_TABLE_SIZE; i++) {
+        LockStats* stats = &(g_LockStats[(index + i) & (LOCK_STATS_TABLE_SIZE - 1)]);
+        const void* expected = nullptr;
+        if (__atomic_compare_exchange_n(&(stats->lock), &expected, lock, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return stats;
+    }
+    return nullptr;
+}
+
+extern "C" void spinlock_acquire_tracked(spinlock_t* lock) {
+    const void* site = __builtin_return_address(0);
+    // The low dword is the next ticket and the high dword the one being served. If they differ, someone holds the lock.
+    uint64_t value = __atomic_load_n(lock, __ATOMIC_RELAXED);
+    bool contended = (uint32_t)value != (uint32_t)(value >> 32);
+    uint64_t start = LockStats_Now();
+    (spinlock_acquire)(lock);
+    uint64_t now = LockStats_Now();
+
+    LockStats* stats = LockStats_Find(lock, true);
+    if (stats == nullptr) {
+        __atomic_add_fetch(&g_LockStatsDropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    // We hold the lock, so nobody else is updating this entry
+    stats->acquisitions++;
+    if (contended) {
+        stats->contended++;
+        stats->wait_time += now - start;
+    }
+    stats->last_site = site;
+    stats->holder_site = site;
+    stats->acquired_at = now;
+}
+
+extern "C" void spinlock_release_tracked(spinlock_t* lock) {
+    LockStats* stats = LockStats_Find(lock, false);
+    if (stats != nullptr && stats->acquired_at != 0) {
+        uint64_t hold = LockStats_Now() - stats->acquired_at;
+        stats->total_hold_time += hold;
+        if (hold > stats->max_hold_time) {
+            stats->max_hold_time = hold;
+            stats->max_hold_site = stats->holder_site;
+        }
+        stats->acquired_at = 0;
+    }
+    (spinlock_release)(lock);
+}
+
+extern "C" void spinlock_destroy_tracked(spinlock_t* lock) {
+    // Nobody can be using a lock that is being destroyed, so the entry is ours to clear
+    LockStats* stats = LockStats_Find(lock, false);
+    if (stats == nullptr)
+        return;
+    LockStats_Clear(stats);
+    __atomic_store_n(&(stats->lock), LOCK_STATS_TOMBSTONE, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&g_LockStatsReleased, 1, __ATOMIC_RELAXED);
+}
+
+static void LockStats_PrintAddress(fd_t file, const void* address) {
+    fprintf(file, "%016lx", (uint64_t)address);
+#ifdef __x86_64__
+    if (g_KernelSymbols != nullptr && address != nullptr) {
+        const char* name = g_KernelSymbols->LookupSymbol((uint64_t)address);
+        if (name != nullptr)
+            fprintf(file, " (%s)", name);
+    }
+#endif
+}
+
+void LockStats_Print(fd_t file) {
+    // Selection rather than a sort, as nothing can be allocated here
+    bool printed[LOCK_STATS_TABLE_SIZE];
+    memset(printed, 0, sizeof(printed));
+    uint64_t used = 0;
+    for (uint64_t i = 0; i < LOCK_STATS_TABLE_SIZE; i++) {
+        const void* lock = __atomic_load_n(&(g_LockStats[i].lock), __ATOMIC_RELAXED);
+        if (lock != nullptr && lock != LOCK_STATS_TOMBSTONE)
+            used++;
+    }
+    fprintf(file, "Lock statistics (cycles), %lu of %u slots in use, %lu released by destroyed locks\n", used, LOCK_STATS_TABLE_SIZE, __atomic_load_n(&g_LockStatsReleased, __ATOMIC_RELAXED));
+    fprintf(file, "%lu acquisitions not recorded as the table was full:\n", __atomic_load_n(&g_LockStatsDropped, __ATOMIC_RELAXED));
+    for (uint64_t n = 0; n < LOCK_STATS_REPORT_COUNT; n++) {
+        LockStats* top = nullptr;
+        uint64_t top_index = 0;
+        for (uint64_t i = 0; i < LOCK_STATS_TABLE_SIZE; i++) {
+            LockStats* stats = &(g_LockStats[i]);
+            if (printed[i] || stats->lock == nullptr || stats->lock == LOCK_STATS_TOMBSTONE || stats->acquisitions == 0)
+                continue;
+            if (top == nullptr || stats->total_hold_time > top->total_hold_time) {
+                top = stats;
+                top_index = i;
+            }
+        }
+        if (top == nullptr)
+            break;
+        printed[top_index] = true;
+        fputs(file, "lock ");
+        LockStats_PrintAddress(file, top->lock);
+        fprintf(file, "\n    acquired %lu, contended %lu, waited %lu, held %lu, longest %lu\n", top->acquisitions, top->contended, top->wait_time, top->total_hold_time, top->max_hold_time);
+        fputs(file, "    longest hold from ");
+        LockStats_PrintAddress(file, top->max_hold_site);
+        fputs(file, "\n    last acquired from ");
+        LockStats_PrintAddress(file, top->last_site);
+        fputc(file, '\n');
+    }
+}
+
+void LockStats_Reset() {
+    for (uint64_t i = 0; i < LOCK_STATS_TABLE_SIZE; i++) {
+        LockStats* stats = &(g_LockStats[i]);
+        stats->acquisitions = 0;
+        stats->contended = 0;
+        stats->wait_time = 0;
+        stats->total_hold_time = 0;
+        stats->max_hold_time = 0;
+        stats->max_hold_site = nullptr;
+    }
+    __atomic_store_n(&g_LockStatsDropped, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_LockStatsReleased, 0, __ATOMIC_RELAXED);
+}
+
+#else
+
+void LockStats_Print(fd_t file) {
+    fputs(file, "Lock statistics are not enabled in this build\n");
+}
+
+void LockStats_Reset() {
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _LOCK_STATS_HPP
+#define _LOCK_STATS_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LOCK_STATS_TABLE_SIZE 1024 // must be a power of 2
+#define LOCK_STATS_REPORT_COUNT 32
+
+/*
+Per lock statistics, only collected when the kernel is built with FROSTYOS_LOCK_STATS.
+Locks are told apart by address. A lock gives its entry back when it is destroyed with spinlock_destroy, otherwise a lock
+allocated in its place shares the entry.
+Times are in TSC cycles.
+*/
+struct LockStats {
+    const void* lock; // nullptr for a slot never used, and 1 for one given back by a destroyed lock
+    uint64_t acquisitions;
+    uint64_t contended; // acquisitions that had to wait for another holder
+    uint64_t wait_time;
+    uint64_t total_hold_time;
+    uint64_t max_hold_time;
+    const void* max_hold_site; // where the longest hold was acquired
+    const void* last_site;
+
+    // Only written by the current holder
+    uint64_t acquired_at;
+    const void* holder_site;
+};
+
+// Print the locks with the most total hold time, with their call sites symbolised. Safe to call from the panic path.
+void LockStats_Print(fd_t file);
+
+// Forget everything recorded so far, so a workload can be measured on its own.
+void LockStats_Reset();
+
+#endif /* _LOCK_STATS_HPP */
@@ -0,0 +1,171 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Trace.hpp"
+
+#include <HAL/time.h>
+#include <HAL/drivers/HPET.hpp>
+
+#include <Scheduling/Scheduler.hpp>
+#include <Scheduling/Thread.hpp>
+
+#include <spinlock.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <arch/x86_64/io.h>
+#include <arch/x86_64/Processor.hpp>
+#endif
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of 2");
+static_assert(sizeof(trace_event) == 32);
+
+struct CPUTrace {
+    trace_event events[TRACE_RING_SIZE];
+    uint64_t head; // total events ever written, so positions never wrap
+    bool busy; // an NMI that arrives while this CPU is recording drops its event instead of sharing the slot
+};
+
+bool g_TraceEnabled = false;
+
+CPUTrace* g_CPUTraces[SCHEDULER_MAX_PROCESSORS] = {nullptr};
+uint64_t g_TraceCPUCount = 0;
+
+uint64_t g_TraceReaderCount = 0;
+spinlock_t g_TraceSetupLock = 0;
+
+void Trace_AddCPU(uint64_t id) {
+    if (id >= SCHEDULER_MAX_PROCESSORS)
+        return; // the scheduler won't run it either
+    uint64_t count = __atomic_load_n(&g_TraceCPUCount, __ATOMIC_RELAXED);
+    while (count < id + 1 && !__atomic_compare_exchange_n(&g_TraceCPUCount, &count, id + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+}
+
+void Trace_Record(uint16_t type, uint64_t arg0, uint64_t arg1) {
+#ifdef __x86_64__
+    // With interrupts off nothing but an NMI can get onto this CPU's ring, which keeps it single producer.
+    bool interrupts = x86_64_AreInterruptsEnabled();
+    x86_64_DisableInterrupts();
+    Scheduling::Scheduler::ProcessorInfo* info = GetCurrentProcessorInfo();
+    CPUTrace* trace = nullptr;
+    if (info != nullptr && info->id < SCHEDULER_MAX_PROCESSORS)
+        trace = __atomic_load_n(&g_CPUTraces[info->id], __ATOMIC_ACQUIRE);
+    if (trace != nullptr && !__atomic_load_n(&trace->busy, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&trace->busy, true, __ATOMIC_RELAXED);
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        uint64_t head = __atomic_load_n(&trace->head, __ATOMIC_RELAXED);
+        trace_event* event = &trace->events[head & (TRACE_RING_SIZE - 1)];
+        event->timestamp = g_HPET != nullptr ? GetMonotonicTime() : 0;
+        event->args[0] = arg0;
+        event->args[1] = arg1;
+        event->tid = info->current_thread != nullptr ? (int)info->current_thread->GetTID() : -1;
+        event->type = type;
+        event->cpu = (unsigned short)info->id;
+        __atomic_store_n(&trace->head, head + 1, __ATOMIC_RELEASE);
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        __atomic_store_n(&trace->busy, false, __ATOMIC_RELAXED);
+    }
+    if (interrupts)
+        x86_64_EnableInterrupts();
+#else
+    (void)type;
+    (void)arg0;
+    (void)arg1;
+#endif
+}
+
+TraceReader* Trace_OpenReader() {
+    TraceReader* reader = new TraceReader;
+    if (reader == nullptr)
+        return nullptr;
+    spinlock_acquire(&g_TraceSetupLock);
+    uint64_t cpu_count = __atomic_load_n(&g_TraceCPUCount, __ATOMIC_ACQUIRE);
+    reader->cpu_count = cpu_count;
+    reader->position = new uint64_t[cpu_count];
+    if (reader->position == nullptr) {
+        spinlock_release(&g_TraceSetupLock);
+        delete reader;
+        return nullptr;
+    }
+    for (uint64_t i = 0; i < cpu_count; i++) {
+        CPUTrace* trace = g_CPUTraces[i];
+        if (trace == nullptr) {
+            trace = new CPUTrace;
+            if (trace == nullptr) {
+                spinlock_release(&g_TraceSetupLock);
+                delete[] reader->position;
+                delete reader;
+                return nullptr;
+            }
+            trace->head = 0;
+            trace->busy = false;
+            __atomic_store_n(&g_CPUTraces[i], trace, __ATOMIC_RELEASE);
+        }
+        // Only show what happens from now on, not what an earlier reader left behind.
+        reader->position[i] = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+    }
+    g_TraceReaderCount++;
+    __atomic_store_n(&g_TraceEnabled, true, __ATOMIC_RELEASE);
+    spinlock_release(&g_TraceSetupLock);
+    return reader;
+}
+
+void Trace_CloseReader(TraceReader* reader) {
+    spinlock_acquire(&g_TraceSetupLock);
+    if (--g_TraceReaderCount == 0)
+        __atomic_store_n(&g_TraceEnabled, false, __ATOMIC_RELEASE);
+    spinlock_release(&g_TraceSetupLock);
+    delete[] reader->position;
+    delete reader;
+}
+
+int64_t Trace_Read(TraceReader* reader, uint8_t* buffer, int64_t count) {
+    int64_t total = 0;
+    for (uint64_t i = 0; i < reader->cpu_count && (uint64_t)(count - total) >= sizeof(trace_event); i++) {
+        CPUTrace* trace = __atomic_load_n(&g_CPUTraces[i], __ATOMIC_ACQUIRE);
+        if (trace == nullptr)
+            continue;
+        uint64_t head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+        if ((reader->position[i] + TRACE_RING_SIZE) < head)
+            reader->position[i] = head - TRACE_RING_SIZE;
+        uint64_t available = min(head - reader->position[i], (uint64_t)(count - total) / sizeof(trace_event));
+        if (available == 0)
+            continue;
+        trace_event* out = (trace_event*)&buffer[total];
+        for (uint64_t j = 0; j < available; j++)
+            memcpy(&out[j], &trace->events[(reader->position[i] + j) & (TRACE_RING_SIZE - 1)], sizeof(trace_event));
+
+        // The writer may have lapped the copy. It could have started on any position up to the head it has now, overwriting the event TRACE_RING_SIZE before it.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t new_head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+        uint64_t torn = 0;
+        if ((new_head + 1) > (reader->position[i] + TRACE_RING_SIZE))
+            torn = min(new_head + 1 - TRACE_RING_SIZE - reader->position[i], available);
+        if (torn > 0)
+            memmove(out, &out[torn], (available - torn) * sizeof(trace_event));
+        reader->position[i] += available;
+        total += (available - torn) * sizeof(trace_event);
+    }
+    return total;
+}
+
+void Trace_Rewind(TraceReader* reader) {
+    for (uint64_t i = 0; i < reader->cpu_count; i++)
+        reader->position[i] = 0; // the next read skips ahead to the oldest events still kept
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _KERNEL_TRACE_HPP
+#define _KERNEL_TRACE_HPP
+
+#include <stdint.h>
+
+#include <trace.h>
+
+#define TRACE_RING_SIZE 8192 // events per CPU, must be a power of 2
+
+/*
+Static tracepoints. While nothing has KERNEL_TRACE_PATH open, a tracepoint is one load and a not-taken branch.
+Each CPU writes its own ring with interrupts disabled, so writers never take a lock. When a ring is full the oldest events are overwritten.
+The rings are allocated the first time tracing is started and are kept from then on, as a writer may still be using one after tracing stops.
+*/
+
+extern bool g_TraceEnabled;
+
+#define TRACE(type, arg0, arg1) do { \
+    if (__builtin_expect(__atomic_load_n(&g_TraceEnabled, __ATOMIC_RELAXED), false)) \
+        Trace_Record(type, (uint64_t)(arg0), (uint64_t)(arg1)); \
+} while (0)
+
+// Per file descriptor read position in each CPU's ring. Only the CPUs that had a ring when the reader was opened are read.
+struct TraceReader {
+    uint64_t cpu_count;
+    uint64_t* position;
+};
+
+void Trace_AddCPU(uint64_t id);
+
+void Trace_Record(uint16_t type, uint64_t arg0, uint64_t arg1);
+
+static inline bool Trace_IsEnabled() {
+    return __builtin_expect(__atomic_load_n(&g_TraceEnabled, __ATOMIC_RELAXED), false);
+}
+
+// Tracing is on while at least one reader exists. Returns nullptr if the rings could not be allocated.
+TraceReader* Trace_OpenReader();
+void Trace_CloseReader(TraceReader* reader);
+
+// Copies whole events only, so count is rounded down to a multiple of sizeof(trace_event). Events are in order per CPU, but not across CPUs.
+// Readers that fall more than TRACE_RING_SIZE events behind on a CPU lose the overwritten events.
+int64_t Trace_Read(TraceReader* reader, uint8_t* buffer, int64_t count);
+
+// Move reader back to the oldest events still kept.
+void Trace_Rewind(TraceReader* reader);
+
+#endif /* _KERNEL_TRACE_HPP */
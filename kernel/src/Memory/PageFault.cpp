@@ -26,6 +26,18 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <arch/x86_64/Stack.hpp>
 #endif
 
+bool PageFaultTryResolve(PageFaultErrorCode error_code, void* faulting_address) {
+    if (!error_code.readable || !error_code.writable)
+        return false; // only writes to present pages can be copy-on-write
+    Scheduling::Thread* thread = Scheduling::Scheduler::GetCurrent();
+    if (thread == nullptr || thread->GetParent() == nullptr)
+        return false;
+    PageManager* pm = thread->GetParent()->GetPageManager();
+    if (pm == nullptr)
+        return false;
+    return pm->HandleCopyOnWrite(faulting_address);
+}
+
 void __attribute__((noreturn)) PageFaultHandler(PageFaultErrorCode error_code, void* faulting_address, void* current_address, CPU_Registers* regs) {
     Scheduling::Thread* thread = Scheduling::Scheduler::GetCurrent();
     Scheduling::Process* process = nullptr;
@@ -34,7 +46,7 @@ void __attribute__((noreturn)) PageFaultHandler(PageFaultErrorCode error_code, v
         process = thread->GetParent();
     }
     if (error_code.user && Scheduling::Scheduler::isRunning() && process != nullptr)
-        process->ReceiveSignal(SIGSEGV);
+        process->ReceiveSignal(SIGSEGV, thread);
     
     Scheduling::Scheduler::Stop();
 
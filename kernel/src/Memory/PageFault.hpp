@@ -30,6 +30,9 @@ struct PageFaultErrorCode {
     bool instruction_fetch;
 };
 
+// Try to fix up a fault that isn't an error, such as a write to a copy-on-write page. Returns true if the faulting access can be retried.
+bool PageFaultTryResolve(PageFaultErrorCode error_code, void* faulting_address);
+
 void __attribute__((noreturn)) PageFaultHandler(PageFaultErrorCode error_code, void* faulting_address, void* current_address, CPU_Registers* regs);
 
 #endif /* _PAGE_FAULT_HPP */
\ No newline at end of file
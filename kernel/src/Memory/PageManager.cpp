@@ -24,11 +24,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 PageManager* g_KPM = nullptr;
 
-PageManager::PageManager() : m_allocated_objects(nullptr), m_allocated_object_count(0), m_Vregion(), m_VPM(), m_PT(false, this), m_mode(false), m_page_object_pool_used(false), m_auto_expand(false), m_lock(0) {
+PageManager::PageManager() : m_objects(), m_Vregion(), m_VPM(), m_PT(false, this), m_mode(false), m_page_object_pool_used(false), m_auto_expand(false), m_lock({0, 0, 0}) {
     
 }
 
-PageManager::PageManager(const VirtualRegion& region, VirtualPageManager* VPM, bool mode, bool auto_expand) : m_allocated_objects(nullptr), m_allocated_object_count(0), m_Vregion(region), m_VPM(VPM), m_PT(mode, this), m_mode(mode), m_page_object_pool_used(false), m_auto_expand(mode && auto_expand), m_lock(0) {
+PageManager::PageManager(const VirtualRegion& region, VirtualPageManager* VPM, bool mode, bool auto_expand) : m_objects(), m_Vregion(region), m_VPM(VPM), m_PT(mode, this), m_mode(mode), m_page_object_pool_used(false), m_auto_expand(mode && auto_expand), m_lock({0, 0, 0}) {
     if (!PageObjectPool_HasBeenInitialised())
         PageObjectPool_Init();
 }
@@ -43,121 +43,79 @@ PageManager::~PageManager() {
             PANIC("SUPERVISOR PageManager illegal destruction. PageManager cannot be destroyed if page object pool has been used.");
         }
     }
-    spinlock_acquire(&m_lock);
-    for (uint64_t i = 0; i < m_allocated_object_count; i++) {
-        PageObject* object = m_allocated_objects;
-        m_allocated_objects = object->next;
+    rwlock_write_acquire(&m_lock);
+    IntervalTree::Node* node = m_objects.GetLeftmost();
+    while (node != nullptr) {
+        PageObject* object = (PageObject*)node->data;
+        m_objects.Remove(node);
         delete object;
+        node = m_objects.GetLeftmost();
     }
-    spinlock_release(&m_lock);
+    rwlock_write_release(&m_lock);
 }
 
 void PageManager::InitPageManager(const VirtualRegion& region, VirtualPageManager* VPM, bool mode, bool auto_expand) {
-    spinlock_acquire(&m_lock);
-    m_allocated_objects = nullptr;
-    m_allocated_object_count = 0;
+    rwlock_write_acquire(&m_lock);
+    m_objects = IntervalTree::Tree();
     m_Vregion = region;
     m_VPM = VPM;
     m_PT = PageTable(mode, this);
     m_mode = mode;
     m_page_object_pool_used = false;
     m_auto_expand = mode && auto_expand;
-    spinlock_release(&m_lock);
+    rwlock_write_release(&m_lock);
     if (!PageObjectPool_HasBeenInitialised())
         PageObjectPool_Init();
 }
 
 void* PageManager::AllocatePage(PagePermissions perms, void* addr) {
-    spinlock_acquire(&m_lock);
+    rwlock_write_acquire(&m_lock);
     if (addr != nullptr) {
-        PageObject* object = m_allocated_objects;
-        for (uint64_t i = 0; i < m_allocated_object_count; i++) {
-            if (object == nullptr) { // should NEVER happen
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            VirtualRegion temp_region = VirtualRegion(object->virtual_address, object->page_count * PAGE_SIZE);
-            if (temp_region.IsInside(addr, PAGE_SIZE) && (object->flags & PO_STANDBY) && !(object->flags & PO_INUSE) && object->perms == perms) {
-                if (addr > object->virtual_address) {
-                    PageObject* po;
-                    if (NewDeleteInitialised())
-                        po = new PageObject;
-                    else {
-                        po = PageObjectPool_Allocate();
-                        m_page_object_pool_used = true;
-                    }
-                    if (po == nullptr) {
-                        spinlock_release(&m_lock);
-                        return nullptr;
-                    }
-                    po->virtual_address = object->virtual_address;
-                    po->perms = perms;
-                    po->flags = object->flags;
-                    po->page_count = ((uint64_t)addr - (uint64_t)(object->virtual_address)) >> 12; // FIXME: don't assume page size
-                    if (!InsertObject(po)) {
-                        if (PageObjectPool_IsInPool(po))
-                            PageObjectPool_Free(po);
-                        else if (NewDeleteInitialised())
-                            delete po;
-                        spinlock_release(&m_lock);
-                        return nullptr;
-                    }
-                    object->page_count -= ((uint64_t)addr - (uint64_t)(object->virtual_address)) >> 12; // FIXME: don't assume page size
-                    object->virtual_address = addr;
+        PageObject* object = FindObject(addr);
+        if (object != nullptr && VirtualRegion(object->virtual_address, object->page_count * PAGE_SIZE).IsInside(addr, PAGE_SIZE) && (object->flags & PO_STANDBY) && !(object->flags & PO_INUSE) && object->perms == perms) {
+            if (addr > object->virtual_address) {
+                PageObject* po = NewObject();
+                if (po == nullptr) {
+                    rwlock_write_release(&m_lock);
+                    return nullptr;
                 }
+                po->virtual_address = object->virtual_address;
+                po->perms = perms;
+                po->flags = object->flags;
+                po->page_count = ((uint64_t)addr - (uint64_t)(object->virtual_address)) >> 12; // FIXME: don't assume page size
+                ResizeObject(object, addr, object->page_count - po->page_count);
+                InsertObject(po);
+            }
 
-                if (1 < object->page_count) {
-                    PageObject* po;
-                    if (NewDeleteInitialised())
-                        po = new PageObject;
-                    else {
-                        po = PageObjectPool_Allocate();
-                        m_page_object_pool_used = true;
-                    }
-                    if (po == nullptr) {
-                        spinlock_release(&m_lock);
-                        return nullptr;
-                    }
-                    po->virtual_address = (void*)((uint64_t)(object->virtual_address) + PAGE_SIZE);
-                    po->perms = perms;
-                    po->flags = object->flags;
-                    po->page_count = object->page_count - 1;
-                    if (!InsertObject(po)) {
-                        if (PageObjectPool_IsInPool(po))
-                            PageObjectPool_Free(po);
-                        else if (NewDeleteInitialised())
-                            delete po;
-                        spinlock_release(&m_lock);
-                        return nullptr;
-                    }
-                    object->page_count = 1;
+            if (1 < object->page_count) {
+                PageObject* po = NewObject();
+                if (po == nullptr) {
+                    rwlock_write_release(&m_lock);
+                    return nullptr;
                 }
-
-                PageObject_UnsetFlag(object, PO_STANDBY);
-                PageObject_SetFlag(object, PO_INUSE);
-                
-                m_PT.MapPage(g_PPFA->AllocatePage(), addr, perms);
-                spinlock_release(&m_lock);
-                return addr;
+                po->virtual_address = (void*)((uint64_t)(object->virtual_address) + PAGE_SIZE);
+                po->perms = perms;
+                po->flags = object->flags;
+                po->page_count = object->page_count - 1;
+                ResizeObject(object, object->virtual_address, 1);
+                InsertObject(po);
             }
-            object = object->next;
+
+            PageObject_UnsetFlag(object, PO_STANDBY);
+            PageObject_SetFlag(object, PO_INUSE);
+            
+            m_PT.MapPage(g_PPFA->AllocatePage(), addr, perms);
+            rwlock_write_release(&m_lock);
+            return addr;
         }
     }
     void* virt_addr;
     if (addr == nullptr)
         virt_addr = m_VPM->AllocatePage();
     else {
-        PageObject* object = m_allocated_objects;
-        for (uint64_t i = 0; i < m_allocated_object_count; i++) {
-            if (object == nullptr) { // should NEVER happen
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            if (object->virtual_address == addr) {
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            object = object->next;
+        if (IsRangeUsed(addr, PAGE_SIZE)) {
+            rwlock_write_release(&m_lock);
+            return nullptr;
         }
         virt_addr = m_VPM->AllocatePage(addr);
     }
@@ -170,27 +128,19 @@ void* PageManager::AllocatePage(PagePermissions perms, void* addr) {
                     virt_addr = m_VPM->AllocatePage(addr);
             }
             if (virt_addr == nullptr) {
-                spinlock_release(&m_lock);
+                rwlock_write_release(&m_lock);
                 return nullptr;
             }
         }
         else {
-            spinlock_release(&m_lock);
+            rwlock_write_release(&m_lock);
             return nullptr;
         }
     }
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr)
-        po = po->next;
-    if (NewDeleteInitialised())
-        po = new PageObject;
-    else {
-        po = PageObjectPool_Allocate();
-        m_page_object_pool_used = true;
-    }
+    PageObject* po = NewObject();
     if (po == nullptr) {
         m_VPM->UnallocatePage(virt_addr);
-        spinlock_release(&m_lock);
+        rwlock_write_release(&m_lock);
         return nullptr;
     }
     PageObject_SetFlag(po, PO_ALLOCATED);
@@ -199,130 +149,66 @@ void* PageManager::AllocatePage(PagePermissions perms, void* addr) {
     PageObject_SetFlag(po, PO_INUSE);
     po->virtual_address = virt_addr;
     po->page_count = 1;
-    if (m_allocated_object_count > 0) {
-        PageObject* previous = PageObject_GetPrevious(m_allocated_objects, po);
-        if (previous == nullptr) {
-            if (PageObjectPool_IsInPool(po))
-                PageObjectPool_Free(po);
-            else if (NewDeleteInitialised())
-                delete po;
-            m_VPM->UnallocatePage(virt_addr);
-            spinlock_release(&m_lock);
-            return nullptr;
-        }
-        else
-            previous->next = po;
-    }
-    else
-        m_allocated_objects = po;
-    m_allocated_object_count++;
     po->perms = perms;
+    InsertObject(po);
     m_PT.MapPage(g_PPFA->AllocatePage(), virt_addr, perms);
-    spinlock_release(&m_lock);
+    rwlock_write_release(&m_lock);
     return virt_addr;
 }
 
 void* PageManager::AllocatePages(uint64_t count, PagePermissions perms, void* addr) {
     if (count == 1)
         return AllocatePage(perms, addr);
-    spinlock_acquire(&m_lock);
+    rwlock_write_acquire(&m_lock);
     if (addr != nullptr) {
-        PageObject* object = m_allocated_objects;
-        for (uint64_t i = 0; i < m_allocated_object_count; i++) {
-            if (object == nullptr) { // should NEVER happen
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            VirtualRegion temp_region = VirtualRegion(object->virtual_address, object->page_count * PAGE_SIZE);
-            if (temp_region.IsInside(addr, count * PAGE_SIZE) && (object->flags & PO_STANDBY) && !(object->flags & PO_INUSE) && object->perms == perms) {
-                if (addr > object->virtual_address) {
-                    PageObject* po;
-                    if (NewDeleteInitialised())
-                        po = new PageObject;
-                    else {
-                        po = PageObjectPool_Allocate();
-                        m_page_object_pool_used = true;
-                    }
-                    if (po == nullptr) {
-                        spinlock_release(&m_lock);
-                        return nullptr;
-                    }
-                    po->virtual_address = object->virtual_address;
-                    po->perms = perms;
-                    po->flags = object->flags;
-                    po->page_count = ((uint64_t)addr - (uint64_t)(object->virtual_address)) >> 12; // FIXME: don't assume page size
-                    if (!InsertObject(po)) {
-                        if (PageObjectPool_IsInPool(po))
-                            PageObjectPool_Free(po);
-                        else if (NewDeleteInitialised())
-                            delete po;
-                        spinlock_release(&m_lock);
-                        return nullptr;
-                    }
-                    object->page_count -= ((uint64_t)addr - (uint64_t)(object->virtual_address)) >> 12; // FIXME: don't assume page size
-                    object->virtual_address = addr;
+        PageObject* object = FindObject(addr);
+        if (object != nullptr && VirtualRegion(object->virtual_address, object->page_count * PAGE_SIZE).IsInside(addr, count * PAGE_SIZE) && (object->flags & PO_STANDBY) && !(object->flags & PO_INUSE) && object->perms == perms) {
+            if (addr > object->virtual_address) {
+                PageObject* po = NewObject();
+                if (po == nullptr) {
+                    rwlock_write_release(&m_lock);
+                    return nullptr;
                 }
+                po->virtual_address = object->virtual_address;
+                po->perms = perms;
+                po->flags = object->flags;
+                po->page_count = ((uint64_t)addr - (uint64_t)(object->virtual_address)) >> 12; // FIXME: don't assume page size
+                ResizeObject(object, addr, object->page_count - po->page_count);
+                InsertObject(po);
+            }
 
-                if (count < object->page_count) {
-                    PageObject* po;
-                    if (NewDeleteInitialised())
-                        po = new PageObject;
-                    else {
-                        po = PageObjectPool_Allocate();
-                        m_page_object_pool_used = true;
-                    }
-                    if (po == nullptr) {
-                        spinlock_release(&m_lock);
-                        return nullptr;
-                    }
-                    po->virtual_address = (void*)((uint64_t)(object->virtual_address) + count * PAGE_SIZE);
-                    po->perms = perms;
-                    po->flags = object->flags;
-                    po->page_count = object->page_count - count;
-                    if (!InsertObject(po)) {
-                        if (PageObjectPool_IsInPool(po))
-                            PageObjectPool_Free(po);
-                        else if (NewDeleteInitialised())
-                            delete po;
-                        spinlock_release(&m_lock);
-                        return nullptr;
-                    }
-                    object->page_count = count;
+            if (count < object->page_count) {
+                PageObject* po = NewObject();
+                if (po == nullptr) {
+                    rwlock_write_release(&m_lock);
+                    return nullptr;
                 }
-
-                PageObject_UnsetFlag(object, PO_STANDBY);
-                PageObject_SetFlag(object, PO_INUSE);
-                
-                for (uint64_t j = 0; j < count; j++)
-                    m_PT.MapPage(g_PPFA->AllocatePage(), (void*)((uint64_t)addr + j * 0x1000), perms, false);
-                m_PT.Flush(addr, count * PAGE_SIZE, true);
-                spinlock_release(&m_lock);
-                return addr;
+                po->virtual_address = (void*)((uint64_t)(object->virtual_address) + count * PAGE_SIZE);
+                po->perms = perms;
+                po->flags = object->flags;
+                po->page_count = object->page_count - count;
+                ResizeObject(object, object->virtual_address, count);
+                InsertObject(po);
             }
-            object = object->next;
+
+            PageObject_UnsetFlag(object, PO_STANDBY);
+            PageObject_SetFlag(object, PO_INUSE);
+            
+            for (uint64_t j = 0; j < count; j++)
+                m_PT.MapPage(g_PPFA->AllocatePage(), (void*)((uint64_t)addr + j * 0x1000), perms, false);
+            m_PT.Flush(addr, count * PAGE_SIZE, true);
+            rwlock_write_release(&m_lock);
+            return addr;
         }
     }
     void* virt_addr;
     if (addr == nullptr)
         virt_addr = m_VPM->AllocatePages(count);
     else {
-        if (!m_Vregion.IsInside(addr, count * PAGE_SIZE)) {
-            spinlock_release(&m_lock);
+        if (!m_Vregion.IsInside(addr, count * PAGE_SIZE) || IsRangeUsed(addr, count * PAGE_SIZE)) {
+            rwlock_write_release(&m_lock);
             return nullptr;
         }
-        PageObject* object = m_allocated_objects;
-        for (uint64_t i = 0; i < m_allocated_object_count; i++) {
-            if (object == nullptr) { // should NEVER happen
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            VirtualRegion temp_region = VirtualRegion(object->virtual_address, object->page_count * PAGE_SIZE);
-            if (temp_region.IsInside(addr, count * PAGE_SIZE)) {
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            object = object->next;
-        }
         virt_addr = m_VPM->AllocatePages(addr, count);
     }
     if (virt_addr == nullptr) {
@@ -334,27 +220,19 @@ void* PageManager::AllocatePages(uint64_t count, PagePermissions perms, void* ad
                     virt_addr = m_VPM->AllocatePages(addr, count);
             }
             if (virt_addr == nullptr) {
-                spinlock_release(&m_lock);
+                rwlock_write_release(&m_lock);
                 return nullptr;
             }
         }
         else {
-            spinlock_release(&m_lock);
+            rwlock_write_release(&m_lock);
             return nullptr;
         }
     }
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr)
-        po = po->next;
-    if (NewDeleteInitialised())
-        po = new PageObject;
-    else {
-        po = PageObjectPool_Allocate();
-        m_page_object_pool_used = true;
-    }
+    PageObject* po = NewObject();
     if (po == nullptr) {
         m_VPM->UnallocatePages(virt_addr, count);
-        spinlock_release(&m_lock);
+        rwlock_write_release(&m_lock);
         return nullptr;
     }
     PageObject_SetFlag(po, PO_ALLOCATED);
@@ -363,48 +241,24 @@ void* PageManager::AllocatePages(uint64_t count, PagePermissions perms, void* ad
     PageObject_SetFlag(po, PO_INUSE);
     po->virtual_address = virt_addr;
     po->page_count = count;
-    if (m_allocated_object_count > 0) {
-        PageObject* previous = PageObject_GetPrevious(m_allocated_objects, po);
-        if (previous == nullptr) {
-            if (PageObjectPool_IsInPool(po))
-                PageObjectPool_Free(po);
-            else if (NewDeleteInitialised())
-                delete po;
-            m_VPM->UnallocatePages(virt_addr, count);
-            spinlock_release(&m_lock);
-            return nullptr;
-        }
-        else
-            previous->next = po;
-    }
-    else
-        m_allocated_objects = po;
-    m_allocated_object_count++;
     po->perms = perms;
+    InsertObject(po);
     for (uint64_t i = 0; i < count; i++)
         m_PT.MapPage(g_PPFA->AllocatePage(), (void*)((uint64_t)virt_addr + i * 0x1000), perms, false);
     m_PT.Flush(virt_addr, count * PAGE_SIZE, true);
-    spinlock_release(&m_lock);
+    rwlock_write_release(&m_lock);
     return virt_addr;
 }
 
 void* PageManager::ReservePage(PagePermissions perms, void* addr) {
     void* virt_addr;
-    spinlock_acquire(&m_lock);
+    rwlock_write_acquire(&m_lock);
     if (addr == nullptr)
         virt_addr = m_VPM->AllocatePage();
     else {
-        PageObject* object = m_allocated_objects;
-        for (uint64_t i = 0; i < m_allocated_object_count; i++) {
-            if (object == nullptr) { // should NEVER happen
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            if (object->virtual_address == addr) {
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            object = object->next;
+        if (IsRangeUsed(addr, PAGE_SIZE)) {
+            rwlock_write_release(&m_lock);
+            return nullptr;
         }
         virt_addr = m_VPM->AllocatePage(addr);
     }
@@ -417,27 +271,19 @@ void* PageManager::ReservePage(PagePermissions perms, void* addr) {
                     virt_addr = m_VPM->AllocatePage(addr);
             }
             if (virt_addr == nullptr) {
-                spinlock_release(&m_lock);
+                rwlock_write_release(&m_lock);
                 return nullptr;
             }
         }
         else {
-            spinlock_release(&m_lock);
+            rwlock_write_release(&m_lock);
             return nullptr;
         }
     }
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr)
-        po = po->next;
-    if (NewDeleteInitialised())
-        po = new PageObject;
-    else {
-        po = PageObjectPool_Allocate();
-        m_page_object_pool_used = true;
-    }
+    PageObject* po = NewObject();
     if (po == nullptr) {
         m_VPM->UnallocatePage(virt_addr);
-        spinlock_release(&m_lock);
+        rwlock_write_release(&m_lock);
         return nullptr;
     }
     PageObject_SetFlag(po, PO_ALLOCATED);
@@ -446,24 +292,9 @@ void* PageManager::ReservePage(PagePermissions perms, void* addr) {
     PageObject_SetFlag(po, PO_STANDBY);
     po->virtual_address = virt_addr;
     po->page_count = 1;
-    if (m_allocated_object_count > 0) {
-        PageObject* previous = PageObject_GetPrevious(m_allocated_objects, po);
-        if (previous == nullptr) {
-            if (PageObjectPool_IsInPool(po))
-                PageObjectPool_Free(po);
-            else if (NewDeleteInitialised())
-                delete po;
-            m_VPM->UnallocatePage(virt_addr);
-            spinlock_release(&m_lock);
-            return nullptr;
-        }
-        else
-            previous->next = po;
-    }
-    else
-        m_allocated_objects = po;
-    m_allocated_object_count++;
     po->perms = perms;
+    InsertObject(po);
+    rwlock_write_release(&m_lock);
     return virt_addr;
 }
 
@@ -471,26 +302,14 @@ void* PageManager::ReservePages(uint64_t count, PagePermissions perms, void* add
     if (count == 1)
         return ReservePage(perms, addr);
     void* virt_addr;
+    rwlock_write_acquire(&m_lock);
     if (addr == nullptr)
         virt_addr = m_VPM->AllocatePages(count);
     else {
-        if (!m_Vregion.IsInside(addr, count * PAGE_SIZE)) {
-            spinlock_release(&m_lock);
+        if (!m_Vregion.IsInside(addr, count * PAGE_SIZE) || IsRangeUsed(addr, count * PAGE_SIZE)) {
+            rwlock_write_release(&m_lock);
             return nullptr;
         }
-        PageObject* object = m_allocated_objects;
-        for (uint64_t i = 0; i < m_allocated_object_count; i++) {
-            if (object == nullptr) { // should NEVER happen
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            VirtualRegion temp_region = VirtualRegion(object->virtual_address, object->page_count * PAGE_SIZE);
-            if (temp_region.IsInside(addr, count * PAGE_SIZE)) {
-                spinlock_release(&m_lock);
-                return nullptr;
-            }
-            object = object->next;
-        }
         virt_addr = m_VPM->AllocatePages(addr, count);
     }
     if (virt_addr == nullptr) {
@@ -502,27 +321,19 @@ void* PageManager::ReservePages(uint64_t count, PagePermissions perms, void* add
                     virt_addr = m_VPM->AllocatePages(addr, count);
             }
             if (virt_addr == nullptr) {
-                spinlock_release(&m_lock);
+                rwlock_write_release(&m_lock);
                 return nullptr;
             }
         }
         else {
-            spinlock_release(&m_lock);
+            rwlock_write_release(&m_lock);
             return nullptr;
         }
     }
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr)
-        po = po->next;
-    if (NewDeleteInitialised())
-        po = new PageObject;
-    else {
-        po = PageObjectPool_Allocate();
-        m_page_object_pool_used = true;
-    }
+    PageObject* po = NewObject();
     if (po == nullptr) {
         m_VPM->UnallocatePages(virt_addr, count);
-        spinlock_release(&m_lock);
+        rwlock_write_release(&m_lock);
         return nullptr;
     }
     PageObject_SetFlag(po, PO_ALLOCATED);
@@ -531,165 +342,192 @@ void* PageManager::ReservePages(uint64_t count, PagePermissions perms, void* add
     PageObject_SetFlag(po, PO_STANDBY);
     po->virtual_address = virt_addr;
     po->page_count = count;
-    if (m_allocated_object_count > 0) {
-        PageObject* previous = PageObject_GetPrevious(m_allocated_objects, po);
-        if (previous == nullptr) {
-            if (PageObjectPool_IsInPool(po))
-                PageObjectPool_Free(po);
-            else if (NewDeleteInitialised())
-                delete po;
-            m_VPM->UnallocatePages(virt_addr, count);
-            spinlock_release(&m_lock);
+    po->perms = perms;
+    InsertObject(po);
+    rwlock_write_release(&m_lock);
+    return virt_addr;
+}
+
+void* PageManager::MapPage(void* physical_addr, PagePermissions perms, void* addr, bool copy_on_write) {
+    rwlock_write_acquire(&m_lock);
+    void* virt_addr;
+    if (addr == nullptr)
+        virt_addr = m_VPM->AllocatePage();
+    else {
+        if (IsRangeUsed(addr, PAGE_SIZE)) {
+            rwlock_write_release(&m_lock);
             return nullptr;
         }
-        else
-            previous->next = po;
+        virt_addr = m_VPM->AllocatePage(addr);
     }
-    else
-        m_allocated_objects = po;
-    m_allocated_object_count++;
+    if (virt_addr == nullptr) {
+        rwlock_write_release(&m_lock);
+        return nullptr;
+    }
+    PageObject* po = NewObject();
+    if (po == nullptr) {
+        m_VPM->UnallocatePage(virt_addr);
+        rwlock_write_release(&m_lock);
+        return nullptr;
+    }
+    PageObject_SetFlag(po, PO_ALLOCATED);
+    if (m_mode)
+        PageObject_SetFlag(po, PO_USER);
+    PageObject_SetFlag(po, PO_INUSE);
+    PageObject_SetFlag(po, PO_SHARED);
+    if (copy_on_write)
+        PageObject_SetFlag(po, PO_COPY_ON_WRITE);
+    po->virtual_address = virt_addr;
+    po->page_count = 1;
     po->perms = perms;
-    spinlock_release(&m_lock);
+    InsertObject(po);
+    m_PT.MapPage(physical_addr, virt_addr, copy_on_write ? PagePermissions::READ : perms);
+    rwlock_write_release(&m_lock);
     return virt_addr;
 }
 
+bool PageManager::HandleCopyOnWrite(void* addr) {
+    addr = ALIGN_ADDRESS_DOWN(addr, PAGE_SIZE);
+    // Most write faults are not copy-on-write ones, so look before allocating anything for the copy
+    rwlock_read_acquire(&m_lock);
+    PageObject* found = FindObject(addr);
+    bool writable = found != nullptr && found->virtual_address == addr && (found->perms == PagePermissions::WRITE || found->perms == PagePermissions::READ_WRITE);
+    bool copy_on_write = writable && (found->flags & PO_COPY_ON_WRITE);
+    bool shared = writable && (found->flags & PO_SHARED);
+    rwlock_read_release(&m_lock);
+    if (!copy_on_write)
+        return writable && !shared; // a private writable page was already copied by another thread's fault, so the write just needs retrying
+    // The shared page is only reachable through addr, so bounce the contents through a kernel buffer while the mapping is swapped.
+    // Both are allocated before taking the lock, as the allocators may need the kernel page manager's. The flag is checked again under it.
+    uint8_t* buffer = new uint8_t[PAGE_SIZE];
+    void* physical_addr = g_PPFA->AllocatePage();
+    if (buffer == nullptr || physical_addr == nullptr) {
+        delete[] buffer;
+        if (physical_addr != nullptr)
+            g_PPFA->FreePage(physical_addr);
+        return false;
+    }
+    rwlock_write_acquire(&m_lock);
+    PageObject* po = FindObject(addr);
+    bool result = po != nullptr && po->virtual_address == addr && (po->perms == PagePermissions::WRITE || po->perms == PagePermissions::READ_WRITE);
+    if (result && (po->flags & PO_COPY_ON_WRITE)) {
+        fast_memcpy(buffer, addr, PAGE_SIZE);
+        m_PT.MapPage(physical_addr, addr, po->perms);
+        fast_memcpy(addr, buffer, PAGE_SIZE);
+        PageObject_UnsetFlag(po, PO_COPY_ON_WRITE);
+        PageObject_UnsetFlag(po, PO_SHARED);
+        physical_addr = nullptr;
+    }
+    // Otherwise, if the page is private and writable, another thread's fault on it got here first and the write just needs retrying
+    else if (result && (po->flags & PO_SHARED))
+        result = false;
+    rwlock_write_release(&m_lock);
+    delete[] buffer;
+    if (physical_addr != nullptr)
+        g_PPFA->FreePage(physical_addr);
+    return result;
+}
+
 void PageManager::FreePage(void* addr) {
-    spinlock_acquire(&m_lock);
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr) {
-        if (po->virtual_address == addr && po->page_count == 1) {
-            g_PPFA->FreePage(m_PT.GetPhysicalAddress(addr));
-            m_VPM->UnallocatePage(addr);
-            m_PT.UnmapPage(addr);
-            PageObject* previous = PageObject_GetPrevious(m_allocated_objects, po);
-            if (previous != nullptr)
-                previous->next = po->next;
-            else
-                m_allocated_objects = po->next;
-            if (PageObjectPool_IsInPool(po))
-                PageObjectPool_Free(po);
-            else if (NewDeleteInitialised())
-                delete po;
-            m_allocated_object_count--;
-            spinlock_release(&m_lock);
-            return;
-        }
-        po = po->next;
-    }
-    spinlock_release(&m_lock);
+    rwlock_write_acquire(&m_lock);
+    PageObject* po = FindObject(addr);
+    if (po == nullptr || po->virtual_address != addr || po->page_count != 1) {
+        rwlock_write_release(&m_lock);
+        return;
+    }
+    if (!(po->flags & PO_SHARED))
+        g_PPFA->FreePage(m_PT.GetPhysicalAddress(addr));
+    m_VPM->UnallocatePage(addr);
+    m_PT.UnmapPage(addr);
+    RemoveObject(po);
+    DeleteObject(po);
+    rwlock_write_release(&m_lock);
 }
 
 void PageManager::FreePages(void* addr) {
-    spinlock_acquire(&m_lock);
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr) {
-        if (po->virtual_address == addr && po->page_count > 1) {
-            m_VPM->UnallocatePages(addr, po->page_count);
-            for (uint64_t i = 0; i < po->page_count; i++) {
-                g_PPFA->FreePage(m_PT.GetPhysicalAddress((void*)((uint64_t)addr + i * 0x1000)));
-                m_PT.UnmapPage((void*)((uint64_t)addr + i * 0x1000), false);
-            }
-            m_PT.Flush(addr, po->page_count * PAGE_SIZE, true);
-            PageObject* previous = PageObject_GetPrevious(m_allocated_objects, po);
-            if (previous != nullptr)
-                previous->next = po->next;
-            else
-                m_allocated_objects = po->next;
-            if (PageObjectPool_IsInPool(po))
-                PageObjectPool_Free(po);
-            else if (NewDeleteInitialised())
-                delete po;
-            m_allocated_object_count--;
-            spinlock_release(&m_lock);
-            return;
-        }
-        po = po->next;
-    }
-    spinlock_release(&m_lock);
+    rwlock_write_acquire(&m_lock);
+    PageObject* po = FindObject(addr);
+    if (po == nullptr || po->virtual_address != addr || po->page_count <= 1) {
+        rwlock_write_release(&m_lock);
+        return;
+    }
+    m_VPM->UnallocatePages(addr, po->page_count);
+    for (uint64_t i = 0; i < po->page_count; i++) {
+        if (!(po->flags & PO_SHARED))
+            g_PPFA->FreePage(m_PT.GetPhysicalAddress((void*)((uint64_t)addr + i * 0x1000)));
+        m_PT.UnmapPage((void*)((uint64_t)addr + i * 0x1000), false);
+    }
+    m_PT.Flush(addr, po->page_count * PAGE_SIZE, true);
+    RemoveObject(po);
+    DeleteObject(po);
+    rwlock_write_release(&m_lock);
 }
 
-void PageManager::Remap(void* addr, PagePermissions perms) {
-    spinlock_acquire(&m_lock);
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr) {
-        if (po->virtual_address == addr) {
-            po->perms = perms;
-            for (uint64_t i = 0; i < po->page_count; i++)
-                m_PT.RemapPage((void*)((uint64_t)addr + i * 0x1000), perms, false);
-            m_PT.Flush(addr, po->page_count * PAGE_SIZE, true);
-            spinlock_release(&m_lock);
-            return;
-        }
-        po = po->next;
+bool PageManager::Remap(void* addr, PagePermissions perms) {
+    rwlock_write_acquire(&m_lock);
+    PageObject* po = FindObject(addr);
+    if (po == nullptr || po->virtual_address != addr || ((po->flags & PO_SHARED) && !(po->flags & PO_COPY_ON_WRITE))) {
+        rwlock_write_release(&m_lock);
+        return false;
     }
-    spinlock_release(&m_lock);
+    po->perms = perms;
+    // A copy-on-write page stays read-only until the fault path has made the private copy, which then gets perms
+    PagePermissions table_perms = perms;
+    if (po->flags & PO_COPY_ON_WRITE)
+        table_perms = (perms == PagePermissions::EXECUTE || perms == PagePermissions::READ_EXECUTE) ? PagePermissions::READ_EXECUTE : PagePermissions::READ;
+    for (uint64_t i = 0; i < po->page_count; i++)
+        m_PT.RemapPage((void*)((uint64_t)addr + i * 0x1000), table_perms, false);
+    m_PT.Flush(addr, po->page_count * PAGE_SIZE, true);
+    rwlock_write_release(&m_lock);
+    return true;
 }
 
 bool PageManager::ExpandVRegionToRight(size_t new_size) {
-    spinlock_acquire(&m_lock);
+    rwlock_write_acquire(&m_lock);
     if (new_size <= m_Vregion.GetSize()) {
-        spinlock_release(&m_lock);
+        rwlock_write_release(&m_lock);
         return false; // invalid size
     }
     if (!(m_VPM->AttemptToExpandRight(new_size))) {
-        spinlock_release(&m_lock);
+        rwlock_write_release(&m_lock);
         return false; // virtual page manager failed to expand
     }
     m_Vregion.ExpandRight(new_size);
-    spinlock_release(&m_lock);
+    rwlock_write_release(&m_lock);
     return true;
 }
 
 bool PageManager::isWritable(void* addr, size_t size) const {
-    spinlock_acquire(&m_lock);
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr) {
-        if (addr >= po->virtual_address && (uint64_t)addr <= ((uint64_t)(po->virtual_address) + po->page_count * PAGE_SIZE)) {
-            if (!(po->perms == PagePermissions::WRITE || po->perms == PagePermissions::READ_WRITE)) {
-                spinlock_release(&m_lock);
-                return false;
-            }
-            if ((po->page_count * PAGE_SIZE) < size) {
-                size -= po->page_count * PAGE_SIZE;
-                addr = (void*)((uint64_t)addr + po->page_count * PAGE_SIZE);
-                spinlock_release(&m_lock);
-                return isWritable(addr, size);
-            }
-            spinlock_release(&m_lock);
-            return true;
+    rwlock_read_acquire(&m_lock);
+    uint64_t start = (uint64_t)addr;
+    uint64_t end = start + size;
+    // Walk the objects covering the range. Any gap, or any object without write permission, fails the check.
+    do {
+        PageObject* po = FindObject((void*)start);
+        if (po == nullptr || !(po->perms == PagePermissions::WRITE || po->perms == PagePermissions::READ_WRITE)) {
+            rwlock_read_release(&m_lock);
+            return false;
         }
-        po = po->next;
-    }
-    spinlock_release(&m_lock);
-    return false;
+        start = po->node.end;
+    } while (start < end);
+    rwlock_read_release(&m_lock);
+    return true;
 }
 
 bool PageManager::isValidAllocation(void* addr, size_t size) const {
-    spinlock_acquire(&m_lock);
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr) {
-        if (addr >= po->virtual_address && size == (po->page_count * PAGE_SIZE)) {
-            spinlock_release(&m_lock);
-            return true;
-        }
-        po = po->next;
-    }
-    spinlock_release(&m_lock);
-    return false;
+    rwlock_read_acquire(&m_lock);
+    PageObject* po = FindObject(addr);
+    bool valid = po != nullptr && po->virtual_address == addr && size == (po->page_count * PAGE_SIZE);
+    rwlock_read_release(&m_lock);
+    return valid;
 }
 
 PagePermissions PageManager::GetPermissions(void* addr) const {
-    spinlock_acquire(&m_lock);
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr) {
-        if (addr >= po->virtual_address && (uint64_t)addr <= ((uint64_t)(po->virtual_address) + po->page_count * PAGE_SIZE)) {
-            spinlock_release(&m_lock);
-            return po->perms;
-        }
-        po = po->next;
-    }
-    spinlock_release(&m_lock);
-    return PagePermissions::READ;
+    rwlock_read_acquire(&m_lock);
+    PageObject* po = FindObject(addr);
+    PagePermissions perms = po != nullptr ? po->perms : PagePermissions::READ;
+    rwlock_read_release(&m_lock);
+    return perms;
 }
 
 const VirtualRegion& PageManager::GetRegion() const {
@@ -700,24 +538,60 @@ const PageTable& PageManager::GetPageTable() const {
     return m_PT;
 }
 
-bool PageManager::InsertObject(PageObject* obj) { // it is assumed that the lock is already acquired, as this is a private function
-    if (m_allocated_object_count > 0) {
-        PageObject* previous = PageObject_GetPrevious(m_allocated_objects, obj);
-        if (previous == nullptr)
-            return false;
-        else
-            previous->next = obj;
+PageObject* PageManager::NewObject() {
+    PageObject* obj;
+    if (NewDeleteInitialised())
+        obj = new PageObject;
+    else {
+        obj = PageObjectPool_Allocate();
+        m_page_object_pool_used = true;
     }
-    else
-        m_allocated_objects = obj;
-    m_allocated_object_count++;
-    return true;
+    if (obj != nullptr)
+        obj->flags = 0;
+    return obj;
+}
+
+void PageManager::DeleteObject(PageObject* obj) {
+    if (PageObjectPool_IsInPool(obj))
+        PageObjectPool_Free(obj);
+    else if (NewDeleteInitialised())
+        delete obj;
+}
+
+void PageManager::InsertObject(PageObject* obj) {
+    obj->node.start = (uint64_t)obj->virtual_address;
+    obj->node.end = (uint64_t)obj->virtual_address + obj->page_count * PAGE_SIZE;
+    obj->node.data = obj;
+    m_objects.Insert(&obj->node);
+}
+
+void PageManager::RemoveObject(PageObject* obj) {
+    m_objects.Remove(&obj->node);
+}
+
+void PageManager::ResizeObject(PageObject* obj, void* virtual_address, uint64_t page_count) {
+    // The tree is ordered on the node bounds, so they can only change while the node is out of it
+    RemoveObject(obj);
+    obj->virtual_address = virtual_address;
+    obj->page_count = page_count;
+    InsertObject(obj);
+}
+
+PageObject* PageManager::FindObject(const void* addr) const {
+    IntervalTree::Node* node = m_objects.FindContaining((uint64_t)addr);
+    if (node == nullptr)
+        return nullptr;
+    return (PageObject*)node->data;
+}
+
+bool PageManager::IsRangeUsed(const void* addr, size_t size) const {
+    return m_objects.FindFirstOverlap((uint64_t)addr, (uint64_t)addr + size) != nullptr;
 }
 
 void PageManager::PrintRegions(fd_t fd) const {
-    spinlock_acquire(&m_lock);
-    PageObject* po = m_allocated_objects;
-    while (po != nullptr) {
+    rwlock_read_acquire(&m_lock);
+    for (IntervalTree::Node* node = m_objects.GetLeftmost(); node != nullptr; node = m_objects.GetNext(node)) {
+        PageObject* po = (PageObject*)node->data;
         if (po->flags & PO_ALLOCATED) {
             if (po->flags & PO_USER)
                 fputs(fd, "User ");
@@ -739,7 +613,6 @@ void PageManager::PrintRegions(fd_t fd) const {
                 fputs(fd, "Read/Execute ");
             fprintf(fd, "0x%016llX - 0x%016llX\n", (uint64_t)po->virtual_address, (uint64_t)po->virtual_address + po->page_count * PAGE_SIZE);
         }
-        po = po->next;
     }
-    spinlock_release(&m_lock);
+    rwlock_read_release(&m_lock);
 }
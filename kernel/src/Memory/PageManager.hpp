@@ -20,7 +20,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <stdint.h>
 #include <stddef.h>
-#include <spinlock.h>
+#include <rwlock.h>
 
 #include "PageObject.hpp"
 #include "Memory.hpp"
@@ -52,10 +52,17 @@ public:
     void* ReservePage(PagePermissions perms = PagePermissions::READ_WRITE, void* addr = nullptr);
     void* ReservePages(uint64_t count, PagePermissions perms = PagePermissions::READ_WRITE, void* addr = nullptr);
 
+    /* Map an existing physical page. The physical page is not freed when the mapping is. If copy_on_write is set, the page is mapped read-only until the first write, which gives this manager its own copy with perms. */
+    void* MapPage(void* physical_addr, PagePermissions perms = PagePermissions::READ, void* addr = nullptr, bool copy_on_write = false);
+
+    /* Resolve a write fault on a copy-on-write page. Must be called with this page manager's address space active. Returns true if the write can be retried, which includes when another thread's fault already copied the page, and false if addr is not a writable copy-on-write page. */
+    bool HandleCopyOnWrite(void* addr);
+
     void FreePage(void* addr);
     void FreePages(void* addr);
 
-    void Remap(void* addr, PagePermissions perms);
+    /* Change the permissions of the allocation at addr. Returns false if there is none, or if it maps physical pages this manager does not own, as whoever does may rely on them staying read-only. Copy-on-write pages are the exception, as they stay read-only until they are copied. */
+    bool Remap(void* addr, PagePermissions perms);
 
     bool ExpandVRegionToRight(size_t new_size);
 
@@ -73,11 +80,17 @@ public:
     void PrintRegions(fd_t fd) const;
 
 private:
-    bool InsertObject(PageObject* obj);
+    // All of these assume the lock is already acquired.
+    PageObject* NewObject(); // flags are cleared
+    void DeleteObject(PageObject* obj);
+    void InsertObject(PageObject* obj);
+    void RemoveObject(PageObject* obj);
+    void ResizeObject(PageObject* obj, void* virtual_address, uint64_t page_count);
+    PageObject* FindObject(const void* addr) const; // the object containing addr
+    bool IsRangeUsed(const void* addr, size_t size) const;
 
 private:
-    PageObject* m_allocated_objects;
-    uint64_t m_allocated_object_count;
+    IntervalTree::Tree m_objects; // keyed on virtual address
     
     VirtualRegion m_Vregion;
     VirtualPageManager* m_VPM; // uses a pointer to avoid wasted RAM
@@ -87,7 +100,7 @@ private:
     bool m_page_object_pool_used;
     bool m_auto_expand;
 
-    mutable spinlock_t m_lock;
+    mutable rwlock_t m_lock; // the permission checks done for every system call only need to read
 };
 
 extern PageManager* g_KPM;
@@ -29,16 +29,6 @@ void PageObject_UnsetFlag(PageObject*& obj, uint64_t flag) {
     obj->flags &= ~flag;
 }
 
-PageObject* PageObject_GetPrevious(PageObject* root, PageObject* current) {
-    if (root == nullptr || root == current)
-        return nullptr;
-    if (root->next == nullptr)
-        return root;
-    if (root->next == current)
-        return root;
-    return PageObject_GetPrevious(root->next, current);
-}
-
 
 PageObject g_PageObjectPool[PAGE_OBJECT_POOL_SIZE];
 
@@ -53,18 +43,14 @@ bool g_PageObjectPool_HasBeenInitialised = false;
 void PageObjectPool_Init() {
     g_PageObjectPool_Bitmap.SetBuffer(g_PageObjectPool_Bitmap_Buffer);
     g_PageObjectPool_Bitmap.SetSize(PAGE_OBJECT_POOL_SIZE / 8);
-    memset(g_PageObjectPool, 0, PAGE_OBJECT_POOL_SIZE / 8);
+    g_PageObjectPool_Bitmap.ClearRange(0, PAGE_OBJECT_POOL_SIZE);
     g_PageObjectPool_UsedCount = 0;
     g_PageObjectPool_HasBeenInitialised = true;
 }
 
 void PageObjectPool_Destroy() {
-    for (uint64_t i = 0; i <= PAGE_OBJECT_POOL_SIZE; i++) {
-        if (g_PageObjectPool_Bitmap[i] == true) {
-            g_PageObjectPool_Bitmap.Set(i, false);
-            g_PageObjectPool_UsedCount--;
-        }
-    }
+    g_PageObjectPool_UsedCount -= g_PageObjectPool_Bitmap.CountSet(0, PAGE_OBJECT_POOL_SIZE);
+    g_PageObjectPool_Bitmap.ClearRange(0, PAGE_OBJECT_POOL_SIZE);
     g_PageObjectPool_Bitmap.~Bitmap();
     g_PageObjectPool_HasBeenInitialised = false;
 }
@@ -81,25 +67,20 @@ PageObject* PageObjectPool_Allocate() {
     if (!g_PageObjectPool_HasBeenInitialised)
         return nullptr;
     if (g_PageObjectPool_UsedCount == PAGE_OBJECT_POOL_SIZE) return nullptr;
-    for (uint64_t i = 0; i <= PAGE_OBJECT_POOL_SIZE; i++) {
-        if (g_PageObjectPool_Bitmap[i] == 0) {
-            g_PageObjectPool_Bitmap.Set(i, true);
-            g_PageObjectPool_UsedCount++;
-            return &(g_PageObjectPool[i]);
-        }
-    }
-    return nullptr;
+    uint64_t i = g_PageObjectPool_Bitmap.FindFirstClear();
+    if (i == UINT64_MAX)
+        return nullptr;
+    g_PageObjectPool_Bitmap.Set(i, true);
+    g_PageObjectPool_UsedCount++;
+    return &(g_PageObjectPool[i]);
 }
 
 void PageObjectPool_Free(PageObject* obj) {
     if (!g_PageObjectPool_HasBeenInitialised)
         return;
     if (g_PageObjectPool_UsedCount == 0) return;
-    for (uint64_t i = 0; i <= PAGE_OBJECT_POOL_SIZE; i++) {
-        if ((uint64_t)obj == (uint64_t)(&(g_PageObjectPool[i]))) {
-            g_PageObjectPool_Bitmap.Set(i, false);
-            g_PageObjectPool_UsedCount--;
-            return;
-        }
-    }
+    if (!PageObjectPool_IsInPool(obj))
+        return;
+    g_PageObjectPool_Bitmap.Set(obj - &g_PageObjectPool[0], false);
+    g_PageObjectPool_UsedCount--;
 }
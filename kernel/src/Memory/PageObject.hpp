@@ -20,6 +20,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <stdint.h>
 
+#include <Data-structures/IntervalTree.hpp>
+
 enum class PagePermissions;
 
 struct PageObject {
@@ -28,7 +30,7 @@ struct PageObject {
     uint64_t flags;
     PagePermissions perms;
 
-    PageObject* next;
+    IntervalTree::Node node; // covers [virtual_address, virtual_address + page_count * PAGE_SIZE) while in a page manager
 };
 
 enum PageObjectFlags {
@@ -36,12 +38,13 @@ enum PageObjectFlags {
     PO_RESERVED   = 0b00010, // invert bit for not reserved
     PO_ALLOCATED  = 0b00100, // invert bit for free
     PO_INUSE      = 0b01000, // invert bit for unused
-    PO_STANDBY    = 0b10000  // invert bit for not standby
+    PO_STANDBY    = 0b10000, // invert bit for not standby
+    PO_SHARED     = 0b100000, // physical pages are not owned by this page manager, so they are never freed by it
+    PO_COPY_ON_WRITE = 0b1000000 // mapped read-only over a shared page. The first write replaces it with a private copy with the real permissions
 };
 
 void PageObject_SetFlag(PageObject*& obj, uint64_t flag);
 void PageObject_UnsetFlag(PageObject*& obj, uint64_t flag);
-PageObject* PageObject_GetPrevious(PageObject* root, PageObject* current);
 
 
 /* Page Object Pool stuff */
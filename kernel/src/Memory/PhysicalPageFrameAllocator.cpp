@@ -64,24 +64,14 @@ void PhysicalPageFrameAllocator::EarlyInit(const MemoryMapEntry* FirstMemoryMapE
     for (uint64_t i = 0; i < MemoryMapEntryCount; i++) {
         MemoryMapEntry* entry = (MemoryMapEntry*)((uint64_t)FirstMemoryMapEntry + (i * MEMORY_MAP_ENTRY_SIZE));
         // We don't need to check if the address is in bitmap range because the bitmap has protections
+        uint64_t pages = DIV_ROUNDUP(entry->length, PAGE_SIZE);
         if (entry->type == FROSTYOS_MEMORY_FREE) {
             m_FreeMem += entry->length;
-            if (entry->length > PAGE_SIZE) {
-                for (uint64_t j = 0; j < entry->length; j += PAGE_SIZE)
-                    m_Bitmap.Set((entry->Address + j) / PAGE_SIZE, false);
-            }
-            else
-                m_Bitmap.Set(entry->Address / PAGE_SIZE, false);
+            m_Bitmap.ClearRange(entry->Address / PAGE_SIZE, pages);
         }
         else {
             m_ReservedMem += entry->length;
-            uint64_t length = ALIGN_UP(entry->length, PAGE_SIZE);
-            if (length > PAGE_SIZE) {
-                for (uint64_t j = 0; j < length; j += PAGE_SIZE)
-                    m_Bitmap.Set((j + entry->Address) / PAGE_SIZE, true);
-            }
-            else
-                m_Bitmap.Set(entry->Address / PAGE_SIZE, true);
+            m_Bitmap.SetRange(entry->Address / PAGE_SIZE, pages);
         }
     }
 
@@ -115,36 +105,18 @@ void PhysicalPageFrameAllocator::FullInit(const MemoryMapEntry* FirstMemoryMapEn
         MemoryMapEntry* entry = (MemoryMapEntry*)((uint64_t)FirstMemoryMapEntry + (i * MEMORY_MAP_ENTRY_SIZE));
         if ((entry->Address + entry->length) <= GiB(4))
             continue; // ignore entries below 4GiB
+        // Address and length must be made page aligned because they might not be, and the part below 4GiB was done in EarlyInit
+        uint64_t start = ALIGN_DOWN(entry->Address, PAGE_SIZE);
+        uint64_t end = ALIGN_UP((entry->Address + entry->length), PAGE_SIZE);
+        if (start < GiB(4))
+            start = GiB(4);
         if (entry->type == FROSTYOS_MEMORY_FREE) {
             m_FreeMem += entry->length;
-            if (entry->length > PAGE_SIZE) {
-                for (uint64_t j = 0; j < entry->length; j += PAGE_SIZE) {
-                    if ((entry->Address + j) < GiB(4))
-                        continue; // skip entries below 4GiB
-                    m_Bitmap.Set((j + entry->Address) / PAGE_SIZE, false);
-                }
-            }
-            else {
-                if (!(entry->Address < GiB(4)))
-                    m_Bitmap.Set(entry->Address / PAGE_SIZE, false);
-            }
+            m_Bitmap.ClearRange(start / PAGE_SIZE, (end - start) / PAGE_SIZE);
         }
         else {
-            // Address and length must be made page aligned because they might not be
             m_ReservedMem += entry->length;
-            uint64_t length = ALIGN_UP(entry->length, PAGE_SIZE);
-            uint64_t addr = ALIGN_DOWN(entry->Address, PAGE_SIZE);
-            if (length > 4096) {
-                for (uint64_t j = 0; j < length; j += 4096) {
-                    if ((addr + j) < GiB(4))
-                        continue; // skip entries below 4GiB
-                    m_Bitmap.Set((j + addr) / PAGE_SIZE, true);
-                }
-            }
-            else {
-                if (!(addr < GiB(4)))
-                    m_Bitmap.Set(addr / PAGE_SIZE, true);
-            }
+            m_Bitmap.SetRange(start / PAGE_SIZE, (end - start) / PAGE_SIZE);
         }
     }
 
@@ -187,22 +159,27 @@ void PhysicalPageFrameAllocator::ReservePage(void* page) {
         return;
     }
     m_Bitmap.Set(((uint64_t)page >> 12), true);
+    if (m_nextFree == ((uint64_t)page >> 12))
+        m_nextFree = UINT64_MAX;
     if (m_fullyInitialised) {
         spinlock_release(&m_BitmapLock);
         spinlock_acquire(&m_globalLock);
     }
     m_FreeMem -= 4096;
     m_ReservedMem += 4096;
-    if (m_nextFree == ((uint64_t)page >> 12))
-        m_nextFree = UINT64_MAX;
     if (m_fullyInitialised)
         spinlock_release(&m_globalLock);
 }
 
 void PhysicalPageFrameAllocator::ReservePages(void* start, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        ReservePage((void*)(i * 4096 + (uint64_t)start));
-    }
+    uint64_t index = (uint64_t)start >> 12;
+    uint64_t changed = UpdatePages(index, count, true);
+    if (m_fullyInitialised)
+        spinlock_acquire(&m_globalLock);
+    m_FreeMem -= changed * 4096;
+    m_ReservedMem += changed * 4096;
+    if (m_fullyInitialised)
+        spinlock_release(&m_globalLock);
 }
 
 void PhysicalPageFrameAllocator::UnreservePage(void* page) {
@@ -214,21 +191,26 @@ void PhysicalPageFrameAllocator::UnreservePage(void* page) {
         return;
     }
     m_Bitmap.Set(((uint64_t)page >> 12), false);
+    m_nextFree = ((uint64_t)page >> 12);
     if (m_fullyInitialised) {
         spinlock_release(&m_BitmapLock);
         spinlock_acquire(&m_globalLock);
     }
     m_FreeMem += 4096;
     m_ReservedMem -= 4096;
-    m_nextFree = ((uint64_t)page >> 12);
     if (m_fullyInitialised)
         spinlock_release(&m_globalLock);
 }
 
 void PhysicalPageFrameAllocator::UnreservePages(void* start, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        UnreservePage((void*)(i * 4096 + (uint64_t)start));
-    }
+    uint64_t index = (uint64_t)start >> 12;
+    uint64_t changed = UpdatePages(index, count, false);
+    if (m_fullyInitialised)
+        spinlock_acquire(&m_globalLock);
+    m_FreeMem += changed * 4096;
+    m_ReservedMem -= changed * 4096;
+    if (m_fullyInitialised)
+        spinlock_release(&m_globalLock);
 }
 
 void PhysicalPageFrameAllocator::FreePage(void* page) {
@@ -240,21 +222,26 @@ void PhysicalPageFrameAllocator::FreePage(void* page) {
         return;
     }
     m_Bitmap.Set(((uint64_t)page >> 12), false);
+    m_nextFree = ((uint64_t)page >> 12);
     if (m_fullyInitialised) {
         spinlock_release(&m_BitmapLock);
         spinlock_acquire(&m_globalLock);
     }
     m_FreeMem += 4096;
     m_UsedMem -= 4096;
-    m_nextFree = ((uint64_t)page >> 12);
     if (m_fullyInitialised)
         spinlock_release(&m_globalLock);
 }
 
 void PhysicalPageFrameAllocator::FreePages(void* start, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        FreePage((void*)(i * 4096 + (uint64_t)start));
-    }
+    uint64_t index = (uint64_t)start >> 12;
+    uint64_t changed = UpdatePages(index, count, false);
+    if (m_fullyInitialised)
+        spinlock_acquire(&m_globalLock);
+    m_FreeMem += changed * 4096;
+    m_UsedMem -= changed * 4096;
+    if (m_fullyInitialised)
+        spinlock_release(&m_globalLock);
 }
 
 /* Private Methods */
@@ -279,9 +266,13 @@ void PhysicalPageFrameAllocator::LockPage(void* page) {
 }
 
 void PhysicalPageFrameAllocator::LockPages(void* start, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        LockPage((void*)(i * 4096 + (uint64_t)start));
-    }
+    uint64_t changed = UpdatePages((uint64_t)start >> 12, count, true);
+    if (m_fullyInitialised)
+        spinlock_acquire(&m_globalLock);
+    m_FreeMem -= changed * 4096;
+    m_UsedMem += changed * 4096;
+    if (m_fullyInitialised)
+        spinlock_release(&m_globalLock);
 }
 
 
@@ -305,9 +296,39 @@ void PhysicalPageFrameAllocator::UnlockPage(void* page) {
 }
 
 void PhysicalPageFrameAllocator::UnlockPages(void* start, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        UnlockPage((void*)(i * 4096 + (uint64_t)start));
+    uint64_t changed = UpdatePages((uint64_t)start >> 12, count, false);
+    if (m_fullyInitialised)
+        spinlock_acquire(&m_globalLock);
+    m_FreeMem += changed * 4096;
+    m_UsedMem -= changed * 4096;
+    if (m_fullyInitialised)
+        spinlock_release(&m_globalLock);
+}
+
+// Mark count pages from index as used or free, returning how many of them changed state.
+// The free page hint is updated under the bitmap lock, so it can never point at a page that has since been allocated.
+uint64_t PhysicalPageFrameAllocator::UpdatePages(uint64_t index, uint64_t count, bool used) {
+    if (m_fullyInitialised)
+        spinlock_acquire(&m_BitmapLock);
+    uint64_t size = m_Bitmap.GetSize() << 3;
+    if (index >= size)
+        count = 0;
+    else if (count > size - index)
+        count = size - index;
+    uint64_t set = m_Bitmap.CountSet(index, count);
+    if (used) {
+        m_Bitmap.SetRange(index, count);
+        if (m_nextFree >= index && (m_nextFree - index) < count)
+            m_nextFree = UINT64_MAX;
+    }
+    else {
+        m_Bitmap.ClearRange(index, count);
+        if (set > 0)
+            m_nextFree = index;
     }
+    if (m_fullyInitialised)
+        spinlock_release(&m_BitmapLock);
+    return used ? count - set : set;
 }
 
 uint64_t PhysicalPageFrameAllocator::FindFreePage() {
@@ -315,79 +336,32 @@ uint64_t PhysicalPageFrameAllocator::FindFreePage() {
         spinlock_acquire(&m_BitmapLock);
         spinlock_acquire(&m_globalLock);
     }
-    if (m_nextFree != UINT64_MAX) {
-        uint64_t i = m_nextFree;
-        if ((i + 1) < (m_Bitmap.GetSize() << 3) && m_Bitmap[i + 1] == 0)
-            m_nextFree = i + 1;
-        else
-            m_nextFree = UINT64_MAX;
-        if (m_fullyInitialised) {
-            spinlock_release(&m_globalLock);
-            spinlock_release(&m_BitmapLock);
-        }
-        return i;
-    }
-    for (uint64_t i = 0; i < (m_Bitmap.GetSize() << 3); i++) {
-        if (m_Bitmap[i] == 0) {
-            if ((i + 1) < (m_Bitmap.GetSize() << 3) && m_Bitmap[i + 1] == 0)
-                m_nextFree = i + 1;
-            if (m_fullyInitialised) {
-                spinlock_release(&m_globalLock);
-                spinlock_release(&m_BitmapLock);
-            }
-            return i;
-        }
-    }
+    uint64_t i = m_nextFree;
+    if (i == UINT64_MAX)
+        i = m_Bitmap.FindFirstClear(0);
+    if (i != UINT64_MAX && (i + 1) < (m_Bitmap.GetSize() << 3) && m_Bitmap[i + 1] == 0)
+        m_nextFree = i + 1;
+    else
+        m_nextFree = UINT64_MAX;
     if (m_fullyInitialised) {
         spinlock_release(&m_globalLock);
         spinlock_release(&m_BitmapLock);
     }
-    return UINT64_MAX; // impossible offset into bitmap, so good for errors
+    return i; // UINT64_MAX is an impossible offset into bitmap, so good for errors
 }
 
 uint64_t PhysicalPageFrameAllocator::FindFreePages(uint64_t count) {
+    if (count == 0) return UINT64_MAX; // impossible offset into bitmap, so good for errors
     if (m_fullyInitialised) {
         spinlock_acquire(&m_BitmapLock);
         spinlock_acquire(&m_globalLock);
     }
-    uint64_t next = 0;
-    if (count == 0) return UINT64_MAX; // impossible offset into bitmap, so good for errors
-    for (uint64_t i = 0; i < (m_Bitmap.GetSize() << 3); i+=next) {
-        next = 1;
-        if (m_Bitmap[i] == 0) {
-            if (count == 1) {
-                if (m_nextFree == i)
-                    m_nextFree = UINT64_MAX;
-                if (m_fullyInitialised) {
-                    spinlock_release(&m_globalLock);
-                    spinlock_release(&m_BitmapLock);
-                }
-                return i * 8;
-            }
-            bool found = true;
-            next = 1;
-            while (next <= count) {
-                if (m_Bitmap[i + next] == 1) {
-                    found = false;
-                    break;
-                }
-                if (count <= next) break; // check if next > count on next iteration
-                next++;
-            }
-            if (found) {
-                if (m_nextFree >= i && (i + count) > m_nextFree)
-                    m_nextFree = UINT64_MAX; // reset it
-                if (m_fullyInitialised) {
-                    spinlock_release(&m_globalLock);
-                    spinlock_release(&m_BitmapLock);
-                }
-                return i; // return start page index of the block
-            }
-        }
-    }
+    uint64_t i = m_Bitmap.FindNextClearRun(0, count);
+    if (i != UINT64_MAX && m_nextFree >= i && (m_nextFree - i) < count)
+        m_nextFree = UINT64_MAX; // reset it
     if (m_fullyInitialised) {
         spinlock_release(&m_globalLock);
         spinlock_release(&m_BitmapLock);
     }
-    return UINT64_MAX; // impossible offset into bitmap, so good for errors
+    return i; // start page index of the block
 }
@@ -57,6 +57,7 @@ private:
     void LockPages(void* start, uint64_t count);
     void UnlockPage(void* page);
     void UnlockPages(void* start, uint64_t count);
+    uint64_t UpdatePages(uint64_t index, uint64_t count, bool used);
     uint64_t FindFreePage();
     uint64_t FindFreePages(uint64_t count);
 
@@ -66,7 +67,7 @@ private:
     size_t m_ReservedMem;
     size_t m_UsedMem;
     size_t m_MemSize;
-    uint64_t m_nextFree;
+    uint64_t m_nextFree; // hint for FindFreePage, protected by m_BitmapLock
 
     bool m_fullyInitialised;
 
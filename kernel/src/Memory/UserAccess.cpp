@@ -0,0 +1,85 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "UserAccess.hpp"
+
+#include <errno.h>
+
+#include <Scheduling/Scheduler.hpp>
+
+#include <arch/x86_64/UserCopy.hpp>
+
+// Returns how many bytes from addr, up to size, are inside the current process's region.
+static size_t GetUserSize(const void* addr, size_t size) {
+    Scheduling::Thread* thread = Scheduling::Scheduler::GetCurrent();
+    if (thread == nullptr || thread->GetParent() == nullptr)
+        return 0;
+    const VirtualRegion& region = thread->GetParent()->GetRegion();
+    if (!region.IsInside(addr))
+        return 0;
+    size_t available = (size_t)region.GetEnd() - (size_t)addr;
+    return size < available ? size : available;
+}
+
+int copy_from_user(void* dst, const void* user_src, size_t size) {
+    if (size == 0)
+        return ESUCCESS;
+    if (GetUserSize(user_src, size) != size)
+        return -EFAULT;
+    return x86_64_CopyUser(dst, user_src, size) == 0 ? ESUCCESS : -EFAULT;
+}
+
+int copy_to_user(void* user_dst, const void* src, size_t size) {
+    if (size == 0)
+        return ESUCCESS;
+    if (GetUserSize(user_dst, size) != size)
+        return -EFAULT;
+    return x86_64_CopyUser(user_dst, src, size) == 0 ? ESUCCESS : -EFAULT;
+}
+
+long strncpy_from_user(char* dst, const char* user_src, size_t size) {
+    if (size == 0)
+        return -ENAMETOOLONG;
+    size_t available = GetUserSize(user_src, size);
+    if (available == 0)
+        return -EFAULT;
+    int64_t length = x86_64_StrncpyUser(dst, user_src, available);
+    if (length < 0)
+        return -EFAULT;
+    if ((size_t)length == available)
+        return available == size ? -ENAMETOOLONG : -EFAULT; // ran off the end of the buffer or the region
+    return length;
+}
+
+char* strndup_from_user(const char* user_src, size_t max, int* status) {
+    char* buffer = new char[max];
+    if (buffer == nullptr) {
+        if (status != nullptr)
+            *status = -ENOMEM;
+        return nullptr;
+    }
+    long length = strncpy_from_user(buffer, user_src, max);
+    if (length < 0) {
+        delete[] buffer;
+        if (status != nullptr)
+            *status = (int)length;
+        return nullptr;
+    }
+    if (status != nullptr)
+        *status = ESUCCESS;
+    return buffer;
+}
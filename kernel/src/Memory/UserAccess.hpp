@@ -0,0 +1,53 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _USER_ACCESS_HPP
+#define _USER_ACCESS_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define USER_PATH_MAX 4096
+#define USER_IO_BUFFER_SIZE 65536 // largest kernel bounce buffer used by read and write
+
+/*
+Copy to and from the current process's memory. The user side is bounds checked against the process's region, and
+any fault while copying is caught and reported, so there is no need to validate user pointers beforehand.
+*/
+
+int copy_from_user(void* dst, const void* user_src, size_t size); // ESUCCESS or -EFAULT
+int copy_to_user(void* user_dst, const void* src, size_t size); // ESUCCESS or -EFAULT
+
+// Returns the length of the string excluding the NUL, -EFAULT, or -ENAMETOOLONG if there is no NUL within size bytes.
+long strncpy_from_user(char* dst, const char* user_src, size_t size);
+
+// Copy a string of at most max - 1 characters into a new buffer, which must be freed with delete[]. status will be set if not nullptr.
+char* strndup_from_user(const char* user_src, size_t max = USER_PATH_MAX, int* status = nullptr);
+
+// Call function with a kernel copy of the path at user_path, which is freed afterwards. Returns what function returns, or the error from copying the path.
+template <typename Function>
+long WithUserPath(const char* user_path, Function function) {
+    int status = 0;
+    char* path = strndup_from_user(user_path, USER_PATH_MAX, &status);
+    if (path == nullptr)
+        return status;
+    long rc = (long)function((const char*)path);
+    delete[] path;
+    return rc;
+}
+
+#endif /* _USER_ACCESS_HPP */
@@ -24,6 +24,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <util.h>
 #include <spinlock.h>
 
+#include <Log/Trace.hpp>
+
 #include <Memory/PageManager.hpp>
 
 #include <HAL/hal.hpp>
@@ -256,10 +258,12 @@ extern "C" void* kcalloc(size_t num, size_t size) {
     if (mem == nullptr)
         return nullptr;
     fast_memset(mem, 0, size / 8);
+    TRACE(TRACE_KMALLOC, size, mem);
     return mem;
 }
 
 extern "C" void kfree(void* addr) {
+    TRACE(TRACE_KFREE, addr, 0);
     g_heapAllocator.lock();
     g_heapAllocator.free(addr);
     g_heapAllocator.unlock();
@@ -271,6 +275,7 @@ extern "C" void* kmalloc(size_t size) {
     g_heapAllocator.lock();
     void* mem = g_heapAllocator.allocate(ALIGN_UP(size, MIN_SIZE));
     g_heapAllocator.unlock();
+    TRACE(TRACE_KMALLOC, size, mem);
     return mem;
 }
 
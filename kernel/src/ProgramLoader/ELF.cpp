@@ -28,9 +28,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifdef __x86_64__
 #include <arch/x86_64/io.h>
 #include <arch/x86_64/Memory/PagingUtil.hpp>
+#include <arch/x86_64/Scheduling/taskutil.hpp>
 #endif
 
-ELF_Executable::ELF_Executable(void* addr, size_t size) : m_addr(addr), m_header(nullptr), m_fileSize(size), m_VPM(nullptr), m_process(nullptr), m_entry(nullptr), m_entry_data({0, nullptr, 0, nullptr}), m_new_entry_data(nullptr), m_entry_data_size(0), m_error(ELFError::SUCCESS) {
+ELF_Executable::ELF_Executable(void* addr, size_t size) : m_addr(addr), m_inode(nullptr), m_headers(nullptr), m_text_cache(nullptr), m_header(nullptr), m_fileSize(size), m_VPM(nullptr), m_process(nullptr), m_entry(nullptr), m_entry_data({0, nullptr, 0, nullptr}), m_new_entry_data(nullptr), m_entry_data_size(0), m_sysinfo_page(nullptr), m_error(ELFError::SUCCESS) {
+
+}
+
+ELF_Executable::ELF_Executable(Inode* inode, size_t size) : m_addr(nullptr), m_inode(inode), m_headers(nullptr), m_text_cache(nullptr), m_header(nullptr), m_fileSize(size), m_VPM(nullptr), m_process(nullptr), m_entry(nullptr), m_entry_data({0, nullptr, 0, nullptr}), m_new_entry_data(nullptr), m_entry_data_size(0), m_sysinfo_page(nullptr), m_error(ELFError::SUCCESS) {
 
 }
 
@@ -45,11 +50,18 @@ ELF_Executable::~ELF_Executable() {
         delete m_VPM;
         delete m_PM;
     }
+    SystemInfo_DestroyProcessPage(m_sysinfo_page);
+    delete[] m_headers;
+    TextCache_Release(m_text_cache);
     if (m_process != nullptr)
         delete m_process;
 }
 
 bool ELF_Executable::Load(ELF_entry_data* entry_data) {
+    if (m_addr == nullptr && (m_inode == nullptr || !ReadHeaders())) {
+        SetLastError(ELFError::INVALID_ELF);
+        return false;
+    }
     {
         ELF_Header64* header = (ELF_Header64*)m_addr;
         char magic[4] = { 0x7F, 'E', 'L', 'F' };
@@ -96,6 +108,24 @@ bool ELF_Executable::Load(ELF_entry_data* entry_data) {
         return false;
     m_VPM->InitVPageMgr(m_region);
     m_PM = new PageManager(m_region, m_VPM, true, true);
+    m_sysinfo_page = SystemInfo_CreateProcessPage();
+    if (m_sysinfo_page == nullptr || !SystemInfo_MapPages(m_PM, m_sysinfo_page)) {
+        SetLastError(ELFError::ALLOCATION_FAILED);
+        return false;
+    }
+#ifdef __x86_64__
+    if (!x86_64_MapSignalTrampoline(m_PM)) {
+        SetLastError(ELFError::ALLOCATION_FAILED);
+        return false;
+    }
+#endif
+    if (m_inode != nullptr) {
+        m_text_cache = TextCache_Acquire(m_inode, m_fileSize);
+        if (m_text_cache == nullptr) {
+            SetLastError(ELFError::ALLOCATION_FAILED);
+            return false;
+        }
+    }
 #ifdef __x86_64__
     uint64_t old_CR3 = x86_64_SwapCR3((uint64_t)(m_PM->GetPageTable().GetRootTablePhysical()) & 0x000FFFFFFFFFF000);
 #endif
@@ -121,6 +151,20 @@ bool ELF_Executable::Load(ELF_entry_data* entry_data) {
                 }
                 else
                     perms = PagePermissions::READ;
+                if (m_inode != nullptr) {
+#ifdef __x86_64__
+                    x86_64_DisableInterrupts();
+#endif
+                    bool mapped = MapSegment(prog_header, perms);
+#ifdef __x86_64__
+                    x86_64_EnableInterrupts();
+#endif
+                    if (!mapped) {
+                        SetLastError(ELFError::ALLOCATION_FAILED);
+                        return false;
+                    }
+                    break;
+                }
                 uint8_t Alignment = log2(prog_header->RequiredAlignment);
                 uint64_t RequiredAlignment = ALIGN_UP(prog_header->RequiredAlignment, 8);
                 void* start = ALIGN_ADDRESS_DOWN(prog_header->VirtualAddress, 8);
@@ -234,6 +278,7 @@ pid_t ELF_Executable::Execute(Scheduling::Priority priority, VFS_WorkingDirector
     m_process->SetFlags(Scheduling::USER_DEFAULT);
     m_process->SetEntry(m_entry, m_new_entry_data);
     m_process->SetPriority(priority);
+    m_process->SetSystemInfoPage(m_sysinfo_page);
     m_process->SetUID(0);
     m_process->SetGID(0);
     m_process->SetDefaultWorkingDirectory(wd);
@@ -260,9 +305,86 @@ void ELF_Executable::End_Handler() {
         delete m_PM;
         delete m_VPM;
     }
+    SystemInfo_DestroyProcessPage(m_sysinfo_page);
+    delete[] m_headers;
+    TextCache_Release(m_text_cache);
     kfree(this);
 }
 
 void ELF_Executable::SetLastError(ELFError error) {
     m_error = error;
 }
+
+bool ELF_Executable::ReadHeaders() {
+    ELF_Header64 header;
+    if (!ReadFile(0, &header, sizeof(ELF_Header64)))
+        return false;
+    uint64_t headers_size = header.ProgramHeaderTablePosition + header.ProgramHeaderEntryCount * header.ProgramHeaderEntrySize;
+    if (headers_size < sizeof(ELF_Header64))
+        headers_size = sizeof(ELF_Header64);
+    m_headers = new uint8_t[headers_size];
+    if (m_headers == nullptr || !ReadFile(0, m_headers, headers_size))
+        return false;
+    m_addr = m_headers;
+    return true;
+}
+
+bool ELF_Executable::ReadFile(uint64_t offset, void* buffer, size_t size) const {
+    if ((offset + size) > m_fileSize)
+        return false;
+    while (size > 0) {
+        uint64_t page_offset = offset % PAGE_SIZE;
+        const uint8_t* page = (const uint8_t*)m_inode->GetBackingPage(offset - page_offset);
+        if (page == nullptr)
+            return false;
+        size_t count = PAGE_SIZE - page_offset;
+        if (count > size)
+            count = size;
+        memcpy(buffer, &(page[page_offset]), count);
+        buffer = (void*)((uint64_t)buffer + count);
+        offset += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Expects the new process's address space to be active.
+bool ELF_Executable::MapSegment(const ELF_ProgramHeader64* prog_header, PagePermissions perms) {
+    uint64_t start = prog_header->VirtualAddress;
+    uint64_t file_end = start + prog_header->SizeInFile;
+    uint64_t mem_end = start + prog_header->SizeInMemory;
+    bool copy_on_write = prog_header->Flags & 2;
+    bool can_share = (start % PAGE_SIZE) == (prog_header->OffsetWithinFile % PAGE_SIZE); // file pages have to line up with the virtual pages
+    uint64_t page = ALIGN_DOWN(start, PAGE_SIZE);
+    for (; page < file_end; page += PAGE_SIZE) {
+        uint64_t page_end = page + PAGE_SIZE;
+        // Share the cached copy of the file's page unless .bss starts part way through it
+        if (can_share && (page_end <= file_end || mem_end <= file_end)) {
+            void* physical_addr = TextCache_GetPage(m_text_cache, prog_header->OffsetWithinFile - (start - page));
+            if (physical_addr == nullptr)
+                return false;
+            if (m_PM->MapPage(physical_addr, perms, (void*)page, copy_on_write) == nullptr)
+                return false;
+            continue;
+        }
+        if (m_PM->AllocatePage(PagePermissions::READ_WRITE, (void*)page) == nullptr)
+            return false;
+        fast_memset((void*)page, 0, PAGE_SIZE >> 3);
+        uint64_t copy_start = page < start ? start : page;
+        uint64_t copy_end = page_end < file_end ? page_end : file_end;
+        if (!ReadFile(prog_header->OffsetWithinFile + (copy_start - start), (void*)copy_start, copy_end - copy_start))
+            return false;
+        if (perms != PagePermissions::READ_WRITE)
+            m_PM->Remap((void*)page, perms);
+    }
+    // Whatever is left is pure .bss
+    if (page < mem_end) {
+        uint64_t page_count = DIV_ROUNDUP(mem_end - page, PAGE_SIZE);
+        if (m_PM->AllocatePages(page_count, PagePermissions::READ_WRITE, (void*)page) == nullptr)
+            return false;
+        fast_memset((void*)page, 0, (page_count * PAGE_SIZE) >> 3);
+        if (perms != PagePermissions::READ_WRITE)
+            m_PM->Remap((void*)page, perms);
+    }
+    return true;
+}
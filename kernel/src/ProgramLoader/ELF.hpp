@@ -26,6 +26,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <Memory/VirtualRegion.hpp>
 
 #include <Scheduling/Process.hpp>
+#include <Scheduling/SystemInfo.hpp>
+
+#include <fs/Inode.hpp>
+#include <fs/TextCache.hpp>
 
 struct ELF_Header64 {
     char magic[4]; // should be 0x7F, then 'ELF' in ASCII
@@ -77,6 +81,7 @@ enum class ELFError {
 class ELF_Executable {
 public:
     ELF_Executable(void* addr, size_t size);
+    ELF_Executable(Inode* inode, size_t size); // inode must be memory backed (see Inode::GetBackingPage). Its pages are shared through the text cache.
     ~ELF_Executable();
 
     bool Load(ELF_entry_data* entry_data);
@@ -89,8 +94,15 @@ private:
 
     void SetLastError(ELFError error);
 
+    bool ReadHeaders();
+    bool ReadFile(uint64_t offset, void* buffer, size_t size) const;
+    bool MapSegment(const ELF_ProgramHeader64* prog_header, PagePermissions perms);
+
 private:
     void* m_addr;
+    Inode* m_inode;
+    uint8_t* m_headers; // only used when loading from an inode
+    TextCacheEntry* m_text_cache; // only used when loading from an inode
     ELF_Header64* m_header;
     size_t m_fileSize;
     VirtualPageManager* m_VPM;
@@ -101,6 +113,7 @@ private:
     ELF_entry_data m_entry_data;
     ELF_entry_data* m_new_entry_data;
     size_t m_entry_data_size;
+    sysinfo_process_page* m_sysinfo_page;
     ELFError m_error;
 };
 
@@ -0,0 +1,103 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "InitTask.hpp"
+#include "Scheduler.hpp"
+#include "Thread.hpp"
+#include "WaitQueue.hpp"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <HAL/time.h>
+
+namespace Scheduling {
+
+    // Shared by every task. Completions are rare, so waking everyone on each one is cheap enough.
+    WaitQueue g_InitTaskQueue;
+
+    static bool InitTask_DependenciesDone(InitTask* task) {
+        for (uint8_t i = 0; i < task->dependency_count; i++) {
+            if (!__atomic_load_n(&(task->dependencies[i]->done), __ATOMIC_ACQUIRE))
+                return false;
+        }
+        return true;
+    }
+
+    static void InitTask_Run(void* data) {
+        InitTask* task = (InitTask*)data;
+        Thread* thread = Scheduler::GetCurrent();
+        while (true) {
+            uint64_t sequence = g_InitTaskQueue.GetSequence();
+            if (InitTask_DependenciesDone(task))
+                break;
+            g_InitTaskQueue.Wait(thread, sequence);
+        }
+        uint64_t start = GetTimer();
+        task->function(task->data);
+        dbgprintf("[Init] %s finished in %lums\n", task->name, GetTimer() - start);
+        __atomic_store_n(&(task->done), true, __ATOMIC_RELEASE);
+        g_InitTaskQueue.WakeAll();
+    }
+
+    void RunInitTasks(Process* process, InitTask** tasks, uint64_t count) {
+        for (uint64_t i = 0; i < count; i++) {
+            InitTask* task = tasks[i];
+            assert(task->dependency_count <= INIT_TASK_MAX_DEPENDENCIES);
+            for (uint8_t j = 0; j < task->dependency_count; j++) {
+                bool earlier = false;
+                for (uint64_t k = 0; k < i; k++) {
+                    if (tasks[k] == task->dependencies[j]) {
+                        earlier = true;
+                        break;
+                    }
+                }
+                assert(earlier);
+            }
+            task->done = false;
+        }
+
+        Thread** threads = new Thread*[count];
+        for (uint64_t i = 0; i < count; i++) {
+            threads[i] = new Thread(process, InitTask_Run, tasks[i], THREAD_KERNEL_DEFAULT);
+            process->ScheduleThread(threads[i]);
+        }
+
+        Thread* thread = Scheduler::GetCurrent();
+        for (uint64_t i = 0; i < count; i++) {
+            while (true) {
+                uint64_t sequence = g_InitTaskQueue.GetSequence();
+                if (__atomic_load_n(&(tasks[i]->done), __ATOMIC_ACQUIRE))
+                    break;
+                g_InitTaskQueue.Wait(thread, sequence);
+            }
+        }
+
+        // A task is done just before its thread returns, so wait for Scheduler::End to let go of each one before freeing it
+        for (uint64_t i = 0; i < count; i++) {
+            while (!threads[i]->IsExitAcknowledged()) {
+#ifdef __x86_64__
+                __asm__ volatile("pause" ::: "memory");
+#endif
+            }
+            process->RemoveThread(threads[i]);
+            delete threads[i];
+        }
+        delete[] threads;
+    }
+
+}
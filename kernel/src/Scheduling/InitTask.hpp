@@ -0,0 +1,48 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _INIT_TASK_HPP
+#define _INIT_TASK_HPP
+
+#include <stdint.h>
+
+#include "Process.hpp"
+#include "Thread.hpp"
+
+#define INIT_TASK_MAX_DEPENDENCIES 4
+
+namespace Scheduling {
+
+    /*
+    One stage of kernel initialisation. Each task runs in its own kernel thread, so independent stages are spread across the processors.
+    A task only starts once every task it depends on has finished.
+    */
+    struct InitTask {
+        const char* name;
+        ThreadEntry_t function;
+        void* data;
+        InitTask* dependencies[INIT_TASK_MAX_DEPENDENCIES];
+        uint8_t dependency_count;
+        volatile bool done;
+    };
+
+    // Run every task in process and return once they have all finished. Dependencies must come earlier in the list than the tasks that need them, which also rules out cycles.
+    void RunInitTasks(Process* process, InitTask** tasks, uint64_t count);
+
+}
+
+#endif /* _INIT_TASK_HPP */
@@ -18,14 +18,18 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "Process.hpp"
 
 #include "Scheduler.hpp"
+#include "WaitQueue.hpp"
 
 #include <errno.h>
 
 #include <SystemCalls/exit.hpp>
 
+#include <Memory/UserAccess.hpp>
 #include <Memory/VirtualPageManager.hpp>
 
 #ifdef __x86_64__
+#include <arch/x86_64/io.h>
+#include <arch/x86_64/Memory/PagingUtil.hpp>
 #include <arch/x86_64/Scheduling/taskutil.hpp>
 #endif
 
@@ -88,15 +92,16 @@ namespace Scheduling {
 
 
 
-    Process::Process() : m_Entry(nullptr), m_entry_data(nullptr), m_flags(USER_DEFAULT), m_Priority(Priority::NORMAL), m_pm(nullptr), m_main_thread_initialised(false), m_main_thread(nullptr), m_region(nullptr, nullptr), m_VPM(nullptr), m_main_thread_creation_requested(false), m_region_allocated(false), m_PID(-1), m_NextTID(0), m_UID(0), m_GID(0), m_EUID(0), m_EGID(0), m_defaultWorkingDirectory(nullptr), m_sigMetadata{{false, nullptr, 0, nullptr, nullptr, 0}} {
-
+    Process::Process() : m_Entry(nullptr), m_entry_data(nullptr), m_flags(USER_DEFAULT), m_Priority(Priority::NORMAL), m_pm(nullptr), m_main_thread_initialised(false), m_main_thread(nullptr), m_region(nullptr, nullptr), m_VPM(nullptr), m_main_thread_creation_requested(false), m_region_allocated(false), m_PID(-1), m_NextTID(0), m_UID(0), m_GID(0), m_EUID(0), m_EGID(0), m_sysinfo(nullptr), m_defaultWorkingDirectory(nullptr), m_threadsLock(0), m_threadExitQueue(new WaitQueue()), m_scheduler_node() {
+        m_scheduler_node.data = this;
     }
 
-    Process::Process(ProcessEntry_t entry, void* entry_data, uint32_t UID, uint32_t GID, Priority priority, uint8_t flags, PageManager* pm) : m_Entry(entry), m_entry_data(entry_data), m_flags(flags), m_Priority(priority), m_pm(pm), m_main_thread_initialised(false), m_main_thread(nullptr), m_main_thread_creation_requested(false), m_region_allocated(false), m_UID(UID), m_GID(GID), m_EUID(UID), m_EGID(GID), m_defaultWorkingDirectory(nullptr), m_sigMetadata{{false, nullptr, 0, nullptr, nullptr, 0}} {
-
+    Process::Process(ProcessEntry_t entry, void* entry_data, uint32_t UID, uint32_t GID, Priority priority, uint8_t flags, PageManager* pm) : m_Entry(entry), m_entry_data(entry_data), m_flags(flags), m_Priority(priority), m_pm(pm), m_main_thread_initialised(false), m_main_thread(nullptr), m_main_thread_creation_requested(false), m_region_allocated(false), m_UID(UID), m_GID(GID), m_EUID(UID), m_EGID(GID), m_sysinfo(nullptr), m_defaultWorkingDirectory(nullptr), m_threadsLock(0), m_threadExitQueue(new WaitQueue()), m_scheduler_node() {
+        m_scheduler_node.data = this;
     }
 
     Process::~Process() {
+        Scheduler::RemoveProcess(this); // otherwise its node would stay linked into the PID table
         delete m_main_thread;
         if (m_region_allocated) {
             delete m_pm;
@@ -104,12 +109,13 @@ namespace Scheduling {
         }
         if (m_defaultWorkingDirectory != nullptr)
             delete m_defaultWorkingDirectory;
-        for (uint64_t i = 0; i < (SIG_MAX - SIG_MIN + 1); i++) {
-            if (m_sigMetadata[i].in_signal_handler) {
-                delete m_sigMetadata[i].old_regs;
-                delete[] (uint8_t*)(m_sigMetadata[i].old_ins);
-            }
+        while (m_exitedThreads.getCount() > 0) {
+            ExitedThread* exited = m_exitedThreads.get(0);
+            m_exitedThreads.remove(exited);
+            delete exited;
         }
+        delete m_threadExitQueue;
+        spinlock_destroy(&m_threadsLock);
     }
 
     void Process::SetEntry(ProcessEntry_t entry, void* entry_data) {
@@ -213,36 +219,48 @@ namespace Scheduling {
         m_main_thread->Start();
     }
 
-    void Process::ScheduleThread(Thread* thread) {
+    tid_t Process::ScheduleThread(Thread* thread) {
         if (thread == nullptr)
-            return;
+            return -1;
+        spinlock_acquire(&m_threadsLock);
         m_threads.insert(thread);
         thread->SetParent(this);
-        thread->SetTID(m_NextTID);
+        tid_t TID = m_NextTID;
+        thread->SetTID(TID);
         m_NextTID++;
+        spinlock_release(&m_threadsLock);
         if (thread->GetWorkingDirectory() == nullptr && m_defaultWorkingDirectory != nullptr)
             thread->SetWorkingDirectory(new VFS_WorkingDirectory(*m_defaultWorkingDirectory));
         thread->Start();
+        return TID;
     }
 
     void Process::RemoveThread(Thread* thread) {
         if (thread == nullptr)
             return;
+        spinlock_acquire(&m_threadsLock);
         uint64_t i = m_threads.getIndex(thread); // verify the thread is actually valid
-        if (i == UINT64_MAX)
+        if (i == UINT64_MAX) {
+            spinlock_release(&m_threadsLock);
             return;
+        }
         bool is_main_thread = m_main_thread == thread;
         m_threads.remove(thread);
+        spinlock_release(&m_threadsLock);
         thread->SetParent(nullptr);
         if (is_main_thread)
             m_main_thread = nullptr;
     }
 
     void Process::RemoveThread(uint64_t index) {
+        spinlock_acquire(&m_threadsLock);
         Thread* thread = m_threads.get(index);
-        if (thread == nullptr)
+        if (thread == nullptr) {
+            spinlock_release(&m_threadsLock);
             return;
+        }
         m_threads.remove(index);
+        spinlock_release(&m_threadsLock);
         thread->SetParent(nullptr);
     }
 
@@ -252,18 +270,60 @@ namespace Scheduling {
         return thread == m_main_thread;
     }
 
+    bool Process::HasThread(tid_t TID) const {
+        return FindThread(TID) != nullptr;
+    }
+
+    Thread* Process::FindThread(tid_t TID) const {
+        spinlock_acquire(&m_threadsLock);
+        for (uint64_t i = 0; i < m_threads.getCount(); i++) {
+            Thread* thread = m_threads.get(i);
+            if (thread != nullptr && thread->GetTID() == TID) {
+                spinlock_release(&m_threadsLock);
+                return thread;
+            }
+        }
+        spinlock_release(&m_threadsLock);
+        return nullptr;
+    }
+
+    void Process::AddExitedThread(tid_t TID, uint64_t value) {
+        ExitedThread* exited = new ExitedThread{TID, value};
+        spinlock_acquire(&m_threadsLock);
+        m_exitedThreads.insert(exited);
+        spinlock_release(&m_threadsLock);
+        m_threadExitQueue->WakeAll();
+    }
+
+    bool Process::TakeExitedThread(tid_t TID, uint64_t* value) {
+        spinlock_acquire(&m_threadsLock);
+        for (uint64_t i = 0; i < m_exitedThreads.getCount(); i++) {
+            ExitedThread* exited = m_exitedThreads.get(i);
+            if (exited->TID == TID) {
+                m_exitedThreads.remove(exited);
+                spinlock_release(&m_threadsLock);
+                if (value != nullptr)
+                    *value = exited->value;
+                delete exited;
+                return true;
+            }
+        }
+        spinlock_release(&m_threadsLock);
+        return false;
+    }
+
+    WaitQueue* Process::GetThreadExitQueue() const {
+        return m_threadExitQueue;
+    }
+
+    IntrusiveList::Node* Process::GetSchedulerNode() {
+        return &m_scheduler_node;
+    }
+
     bool Process::ValidateRead(const void* buf, size_t size) const {
         return m_region.IsInside(buf, size);
     }
 
-    bool Process::ValidateStringRead(const char* str) const {
-        if (!m_region.IsInside(str, sizeof(char)))
-            return false;
-        if (str[0] == '\0')
-            return true;
-        return ValidateStringRead((const char*)((uint64_t)str + sizeof(char)));
-    }
-    
     bool Process::ValidateWrite(void* buf, size_t size) const {
         if (!m_region.IsInside(buf, size))
             return false;
@@ -278,6 +338,7 @@ namespace Scheduling {
 
     void Process::SetPID(pid_t pid) {
         m_PID = pid;
+        UpdateSystemInfoPage();
     }
 
     pid_t Process::GetPID() const {
@@ -287,19 +348,23 @@ namespace Scheduling {
     void Process::SetUID(uint32_t uid) {
         m_UID = uid;
         m_EUID = uid;
+        UpdateSystemInfoPage();
     }
 
     void Process::SetGID(uint32_t gid) {
         m_GID = gid;
         m_EGID = gid;
+        UpdateSystemInfoPage();
     }
 
     void Process::SetEUID(uint32_t euid) {
         m_EUID = euid;
+        UpdateSystemInfoPage();
     }
 
     void Process::SetEGID(uint32_t egid) {
         m_EGID = egid;
+        UpdateSystemInfoPage();
     }
 
     uint32_t Process::GetUID() const {
@@ -318,6 +383,15 @@ namespace Scheduling {
         return m_EGID;
     }
 
+    void Process::SetSystemInfoPage(sysinfo_process_page* page) {
+        m_sysinfo = page;
+        UpdateSystemInfoPage();
+    }
+
+    sysinfo_process_page* Process::GetSystemInfoPage() const {
+        return m_sysinfo;
+    }
+
     void Process::SetDefaultWorkingDirectory(VFS_WorkingDirectory* wd) {
         m_defaultWorkingDirectory = wd;
     }
@@ -326,19 +400,26 @@ namespace Scheduling {
         return m_defaultWorkingDirectory;
     }
 
+    void Process::UpdateSystemInfoPage() {
+        if (m_sysinfo == nullptr)
+            return;
+        m_sysinfo->pid = m_PID;
+        m_sysinfo->uid = m_UID;
+        m_sysinfo->gid = m_GID;
+        m_sysinfo->euid = m_EUID;
+        m_sysinfo->egid = m_EGID;
+    }
+
     int Process::sys_onsignal(int signum, const struct signal_action* new_action, struct signal_action* old_action) {
         if (!IN_BOUNDS(signum, SIG_MIN, SIG_MAX))
             return -EINVAL;
-        if (old_action != nullptr) {
-            if (!ValidateWrite(old_action, sizeof(struct signal_action)))
-                return -EFAULT;
-            memcpy(old_action, &(m_sigActions[signum - SIG_MIN]), sizeof(struct signal_action));
-        }
-        if (new_action != nullptr) {
-            if (!ValidateRead(new_action, sizeof(struct signal_action)))
-                return -EFAULT;
-            memcpy(&(m_sigActions[signum - SIG_MIN]), new_action, sizeof(struct signal_action));
-        }
+        struct signal_action action;
+        if (new_action != nullptr && copy_from_user(&action, new_action, sizeof(struct signal_action)) != ESUCCESS)
+            return -EFAULT;
+        if (old_action != nullptr && copy_to_user(old_action, &(m_sigActions[signum - SIG_MIN]), sizeof(struct signal_action)) != ESUCCESS)
+            return -EFAULT;
+        if (new_action != nullptr)
+            m_sigActions[signum - SIG_MIN] = action;
         return ESUCCESS;
     }
 
@@ -346,37 +427,33 @@ namespace Scheduling {
         return Scheduler::SendSignal(this, pid, signum);
     }
 
-    void Process::sys_sigreturn(int signum) {
-        // We must first restore the registers
-        CPU_Registers* regs = m_main_thread->GetCPURegisters();
-        memcpy(regs, m_sigMetadata[signum - SIG_MIN].old_regs, sizeof(CPU_Registers));
-        delete m_sigMetadata[signum - SIG_MIN].old_regs;
+    void Process::sys_sigreturn(Thread* thread, void* frame) {
+        CPU_Registers* regs = thread->GetCPURegisters();
 #ifdef __x86_64__
-        // We must now restore the instructions
-        // Validate we can read the pages
-        if (!ValidateRead((void*)regs->RIP, m_sigMetadata[signum - SIG_MIN].ret_ins_size)) {
-            // If we are in a SIGSEGV handler, we set the action for SIGSEGV to default, and then send it
-            if (signum == SIGSEGV)
-                m_sigActions[SIGSEGV - SIG_MIN].flags = SIG_DFL;
-            ReceiveSignal(SIGSEGV);
+        // The frame lives in user memory, so it is copied out before anything in it is trusted.
+        x86_64_SignalFrame signal_frame;
+        if (copy_from_user(&signal_frame, frame, sizeof(x86_64_SignalFrame)) != ESUCCESS) {
+            m_sigActions[SIGSEGV - SIG_MIN].flags = SIG_DFL;
+            ReceiveSignal(SIGSEGV, thread);
         }
-        uint64_t start = ALIGN_DOWN(regs->RIP, PAGE_SIZE);
-        uint64_t end = ALIGN_UP((regs->RIP + m_sigMetadata[signum - SIG_MIN].ret_ins_size), PAGE_SIZE);
-        uint64_t pages = (end - start) / PAGE_SIZE;
-        PagePermissions* perms = new PagePermissions[pages];
-        for (uint64_t i = 0; i < pages; i++) {
-            perms[i] = m_pm->GetPermissions((void*)(start + (i * PAGE_SIZE)));
-            m_pm->Remap((void*)(start + (i * PAGE_SIZE)), PagePermissions::READ_WRITE);
+        int signum = (int)signal_frame.signum;
+        // Only the frame this thread's handler was entered with can be returned through
+        if (signum < SIG_MIN || signum > SIG_MAX || thread->GetSignalFrame(signum) != (uint64_t)frame) {
+            m_sigActions[SIGSEGV - SIG_MIN].flags = SIG_DFL;
+            ReceiveSignal(SIGSEGV, thread);
         }
-        memcpy((void*)regs->RIP, m_sigMetadata[signum - SIG_MIN].old_ins, m_sigMetadata[signum - SIG_MIN].ret_ins_size);
-        delete[] (uint8_t*)(m_sigMetadata[signum - SIG_MIN].old_ins);
-        // restore the permissions
-        for (uint64_t i = 0; i < pages; i++)
-            m_pm->Remap((void*)(start + (i * PAGE_SIZE)), perms[i]);
-        delete[] perms;
-        *(uint64_t*)(regs->RSP - 8) = (uint64_t)m_sigMetadata[signum - SIG_MIN].extra_data;
+        // The handler may have modified the saved state, so the segments and address space are kept and only the user flags are restored.
+        x86_64_Registers* saved = &signal_frame.regs;
+        saved->CS = regs->CS;
+        saved->DS = regs->DS;
+        saved->CR3 = regs->CR3;
+        saved->RFLAGS = (saved->RFLAGS & 0xDD5) | (regs->RFLAGS & ~0xDD5UL);
+        memcpy(regs, saved, sizeof(CPU_Registers));
+#else
+        (void)frame;
+        int signum = SIG_MIN;
 #endif
-        m_sigMetadata[signum - SIG_MIN].in_signal_handler = false;
+        thread->LeaveSignalHandler(signum);
         // we are in a syscall, so we must force the scheduler to pick a different thread to run next
         Scheduler::PickNext();
         Scheduler::Next();
@@ -384,7 +461,25 @@ namespace Scheduling {
         PANIC("sys_sigreturn returned");
     }
 
-    void Process::ReceiveSignal(int signum) {
+    Thread* Process::PickSignalThread(int signum) {
+        // The current thread takes it without a switch, then the main thread, as it did before threads had their own signal state
+        Thread* current = Scheduler::GetCurrent();
+        if (current != nullptr && current->GetParent() == this && !current->IsInSignalHandler(signum))
+            return current;
+        spinlock_acquire(&m_threadsLock);
+        Thread* picked = nullptr;
+        if (m_main_thread != nullptr && !m_main_thread->IsInSignalHandler(signum))
+            picked = m_main_thread;
+        for (uint64_t i = 0; picked == nullptr && i < m_threads.getCount(); i++) {
+            Thread* thread = m_threads.get(i);
+            if (thread != nullptr && !thread->IsExiting() && !thread->IsInSignalHandler(signum))
+                picked = thread;
+        }
+        spinlock_release(&m_threadsLock);
+        return picked;
+    }
+
+    void Process::ReceiveSignal(int signum, Thread* thread) {
         struct signal_action action = m_sigActions[signum - SIG_MIN];
         if (action.flags == SIG_IGN)
             return;
@@ -407,69 +502,55 @@ namespace Scheduling {
         }
         else {
             /*
-            This is where things get complicated.
-            We need to save the current state of the thread in a way where if it exits, we can still cleanup the thread,
-            and then move the thread to the signal handler, get it to return to here, while exiting userland, and then restore the thread state.
-            To do this, we copy some special return instructions to the location at which the thread was interrupt, after saving the previous state.
+            The interrupted state is saved in a frame on the user stack, below the red zone. The handler returns into the trampoline,
+            which hands the frame back to sys_sigreturn. Nothing is allocated and no pages are remapped.
             */
-            if (m_sigMetadata[signum - SIG_MIN].in_signal_handler)
-                return; // we're already in a signal handler, so we can't handle this signal.
-            CPU_Registers* signal_regs = new CPU_Registers;
-            memcpy(signal_regs, m_main_thread->GetCPURegisters(), sizeof(CPU_Registers));
-            m_sigMetadata[signum - SIG_MIN].old_regs = signal_regs;
-            m_sigMetadata[signum - SIG_MIN].in_signal_handler = true;
+            if (thread == nullptr)
+                thread = PickSignalThread(signum);
+            if (thread == nullptr || thread->IsInSignalHandler(signum))
+                return; // every thread is already handling this signal, so it can't be handled now.
 #ifdef __x86_64__
-            m_sigMetadata[signum - SIG_MIN].ret_ins = x86_64_GetSignalReturnInstructions(&(m_sigMetadata[signum - SIG_MIN].ret_ins_size), signum);
-            CPU_Registers* regs = m_main_thread->GetCPURegisters();
-            // We must validate that we can decrement the stack
-            if (!ValidateWrite((void*)(regs->RSP - 8), 8)) {
-                // If we are in a SIGSEGV handler, we set the action for SIGSEGV to default, and then send it
-                if (signum == SIGSEGV)
-                    m_sigActions[SIGSEGV - SIG_MIN].flags = SIG_DFL;
-                delete signal_regs;
-                m_sigMetadata[signum - SIG_MIN].in_signal_handler = false;
-                ReceiveSignal(SIGSEGV);
+            CPU_Registers* regs = thread->GetCPURegisters();
+            // Positioned so the handler sees RSP + 8 16-byte aligned, as it would after a call.
+            x86_64_SignalFrame* frame = (x86_64_SignalFrame*)(ALIGN_DOWN(regs->RSP - X86_64_RED_ZONE_SIZE - sizeof(x86_64_SignalFrame), 16) - 8);
+            // If another process sent the signal, we are in its address space and must switch to ours to reach the stack.
+            Thread* current = Scheduler::GetCurrent();
+            bool foreign = current == nullptr || current->GetParent() != this;
+            bool interrupts_enabled = x86_64_AreInterruptsEnabled();
+            uint64_t old_CR3 = 0;
+            if (foreign) {
+                x86_64_DisableInterrupts();
+                old_CR3 = x86_64_SwapCR3(regs->CR3);
+            }
+            bool valid = ValidateWrite(frame, sizeof(x86_64_SignalFrame));
+            if (valid) {
+                frame->return_address = X86_64_SIGNAL_TRAMPOLINE_ADDRESS;
+                frame->signum = (uint64_t)signum;
+                memcpy(&(frame->regs), regs, sizeof(CPU_Registers));
             }
-            // push the current RIP onto the stack
-            regs->RSP -= 8;
-            m_sigMetadata[signum - SIG_MIN].extra_data = *(uint64_t*)(regs->RSP); // save it
-            *(uint64_t*)(regs->RSP) = regs->RIP;
-            // we must now verify that the RIP is readable. If it is not writable, we just make it writable temporarily, and then copy.
-            if (!ValidateRead((void*)regs->RIP, m_sigMetadata[signum - SIG_MIN].ret_ins_size)) {
+            if (foreign) {
+                x86_64_SwapCR3(old_CR3);
+                if (interrupts_enabled)
+                    x86_64_EnableInterrupts();
+            }
+            if (!valid) {
                 // If we are in a SIGSEGV handler, we set the action for SIGSEGV to default, and then send it
                 if (signum == SIGSEGV)
                     m_sigActions[SIGSEGV - SIG_MIN].flags = SIG_DFL;
-                delete signal_regs;
-                *(uint64_t*)(regs->RSP) = m_sigMetadata[signum - SIG_MIN].extra_data;
-                regs->RSP += 8;
-                m_sigMetadata[signum - SIG_MIN].in_signal_handler = false;
-                ReceiveSignal(SIGSEGV);
-            }
-            m_sigMetadata[signum - SIG_MIN].old_ins = new uint8_t[m_sigMetadata[signum - SIG_MIN].ret_ins_size];
-            memcpy(m_sigMetadata[signum - SIG_MIN].old_ins, (void*)regs->RIP, m_sigMetadata[signum - SIG_MIN].ret_ins_size);
-            // we must now enumerate the pages that we need to make writable
-            uint64_t start = ALIGN_DOWN(regs->RIP, PAGE_SIZE);
-            uint64_t end = ALIGN_UP((regs->RIP + m_sigMetadata[signum - SIG_MIN].ret_ins_size), PAGE_SIZE);
-            uint64_t pages = (end - start) / PAGE_SIZE;
-            PagePermissions* perms = new PagePermissions[pages];
-            for (uint64_t i = 0; i < pages; i++) {
-                perms[i] = m_pm->GetPermissions((void*)(start + (i * PAGE_SIZE)));
-                m_pm->Remap((void*)(start + (i * PAGE_SIZE)), PagePermissions::READ_WRITE);
+                ReceiveSignal(SIGSEGV, thread);
+                return;
             }
-            memcpy((void*)regs->RIP, m_sigMetadata[signum - SIG_MIN].ret_ins, m_sigMetadata[signum - SIG_MIN].ret_ins_size);
-            // restore the permissions
-            for (uint64_t i = 0; i < pages; i++)
-                m_pm->Remap((void*)(start + (i * PAGE_SIZE)), perms[i]);
-            delete[] perms;
-            delete[] (uint8_t*)(m_sigMetadata[signum - SIG_MIN].ret_ins);
+            thread->EnterSignalHandler(signum, (uint64_t)frame);
+            regs->RSP = (uint64_t)frame;
             regs->RIP = (uint64_t)action.handler;
             regs->RDI = (uint64_t)signum;
+            regs->RFLAGS &= ~(1UL << 10); // the ABI requires DF to be clear on function entry
 #endif
             /*
-            if the main thread is the current thread, a.k.a. we are in a syscall, 
+            if the thread is the current thread, a.k.a. we are in a syscall or a fault,
             we have to force the scheduler to pick a different thread to run next
             */
-            if (m_main_thread == Scheduler::GetCurrent()) {
+            if (thread == Scheduler::GetCurrent()) {
                 Scheduler::PickNext();
                 Scheduler::Next();
                 // we should never get to here
@@ -479,8 +560,8 @@ namespace Scheduling {
         }
     }
 
-    bool Process::IsInSignalHandler(int signum) const {
-        return m_sigMetadata[signum - SIG_MIN].in_signal_handler;
+    bool Process::IsInSignalHandler(int signum) {
+        return PickSignalThread(signum) == nullptr;
     }
 
 }
@@ -19,11 +19,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define _KERNEL_PROCESS_HPP
 
 #include <stdint.h>
+#include <spinlock.h>
 
 #include <process.h>
+#include <sysinfo.h>
 
 #include <HAL/hal.hpp>
 
+#include <Data-structures/IntrusiveList.hpp>
 #include <Data-structures/LinkedList.hpp>
 
 #include <Memory/PageManager.hpp>
@@ -34,6 +37,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 namespace Scheduling {
     class Thread;
+    class WaitQueue;
 
     typedef void (*ProcessEntry_t)(void*);
 
@@ -80,14 +84,20 @@ namespace Scheduling {
 
         void CreateMainThread();
         void Start();
-        void ScheduleThread(Thread* thread);
+        tid_t ScheduleThread(Thread* thread); // returns the TID given to the thread, which may already have exited by the time this returns
         void RemoveThread(Thread* thread);
         void RemoveThread(uint64_t index);
 
         bool IsMainThread(Thread* thread) const;
+        bool HasThread(tid_t TID) const;
+        Thread* FindThread(tid_t TID) const; // nullptr if there is no thread with that TID
+
+        // Exit values of threads that have finished but not been joined yet. Joiners wait on the thread exit queue.
+        void AddExitedThread(tid_t TID, uint64_t value);
+        bool TakeExitedThread(tid_t TID, uint64_t* value);
+        WaitQueue* GetThreadExitQueue() const;
 
         bool ValidateRead(const void* buf, size_t size) const;
-        bool ValidateStringRead(const char* str) const;
         bool ValidateWrite(void* buf, size_t size) const;
 
         void SyncRegion(); // ensure the region matches the page manager's region
@@ -106,26 +116,35 @@ namespace Scheduling {
         uint32_t GetEUID() const;
         uint32_t GetEGID() const;
 
+        // The page is kept up to date with the PID and IDs of the process
+        void SetSystemInfoPage(sysinfo_process_page* page);
+        sysinfo_process_page* GetSystemInfoPage() const;
+
         void SetDefaultWorkingDirectory(VFS_WorkingDirectory* wd);
         VFS_WorkingDirectory* GetDefaultWorkingDirectory() const;
 
         int sys_onsignal(int signum, const struct signal_action* new_action, struct signal_action* old_action);
         int sys_sendsig(pid_t pid, int signum);
 
-        void sys_sigreturn(int signum);
+        // frame is the signal frame built on the user stack by ReceiveSignal, as passed back by the trampoline to thread
+        void sys_sigreturn(Thread* thread, void* frame);
 
-        void ReceiveSignal(int signum);
+        // thread is the one to deliver to, for signals it caused itself. Otherwise one that isn't already handling signum is picked.
+        void ReceiveSignal(int signum, Thread* thread = nullptr);
 
-        bool IsInSignalHandler(int signum) const;
+        // True if every thread is already handling signum
+        bool IsInSignalHandler(int signum);
+
+        IntrusiveList::Node* GetSchedulerNode(); // used by the scheduler's process table
 
     private:
-        struct SignalMetadata {
-            bool in_signal_handler;
-            void* ret_ins;
-            size_t ret_ins_size;
-            void* old_ins;
-            CPU_Registers* old_regs;
-            uint64_t extra_data;
+        void UpdateSystemInfoPage();
+
+        Thread* PickSignalThread(int signum); // nullptr if none can take it
+
+        struct ExitedThread {
+            tid_t TID;
+            uint64_t value;
         };
 
         ProcessEntry_t m_Entry;
@@ -149,10 +168,17 @@ namespace Scheduling {
         uint32_t m_EUID; // effective UID
         uint32_t m_EGID; // effective GID
 
+        sysinfo_process_page* m_sysinfo;
+
         VFS_WorkingDirectory* m_defaultWorkingDirectory;
 
+        LinkedList::SimpleLinkedList<ExitedThread> m_exitedThreads;
+        mutable spinlock_t m_threadsLock; // protects m_exitedThreads and lookups in m_threads from other threads of the process
+        WaitQueue* m_threadExitQueue;
+
         signal_action m_sigActions[SIG_COUNT];
-        SignalMetadata m_sigMetadata[SIG_COUNT];
+
+        IntrusiveList::Node m_scheduler_node;
     };
 }
 
@@ -0,0 +1,251 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "RunQueue.hpp"
+#include "Thread.hpp"
+
+#ifdef __x86_64__
+#include <arch/x86_64/io.h>
+#endif
+
+#define SCHEDULER_MIGRATION_SCAN_LIMIT 8
+
+namespace Scheduling {
+
+    namespace Scheduler {
+
+        uint64_t g_target_latency = SCHEDULER_DEFAULT_TARGET_LATENCY_NS;
+        uint64_t g_min_granularity = SCHEDULER_DEFAULT_MIN_GRANULARITY_NS;
+
+        // Each step is roughly 1.25x the CPU share of the one below it, 5 steps apart.
+        uint64_t GetPriorityWeight(Priority priority) {
+            switch (priority) {
+            case Priority::KERNEL:
+                return 9548;
+            case Priority::HIGH:
+                return 3121;
+            case Priority::NORMAL:
+                return SCHEDULER_NICE_0_WEIGHT;
+            case Priority::LOW:
+                return 335;
+            default:
+                return SCHEDULER_NICE_0_WEIGHT;
+            }
+        }
+
+        bool SetLatencyParameters(uint64_t target_latency, uint64_t min_granularity) {
+            if (min_granularity < 1000000 || target_latency < min_granularity)
+                return false;
+            __atomic_store_n(&g_min_granularity, min_granularity, __ATOMIC_RELAXED);
+            __atomic_store_n(&g_target_latency, target_latency, __ATOMIC_RELAXED);
+            return true;
+        }
+
+        void GetLatencyParameters(uint64_t* target_latency, uint64_t* min_granularity) {
+            if (target_latency != nullptr)
+                *target_latency = __atomic_load_n(&g_target_latency, __ATOMIC_RELAXED);
+            if (min_granularity != nullptr)
+                *min_granularity = __atomic_load_n(&g_min_granularity, __ATOMIC_RELAXED);
+        }
+
+        static inline uint64_t GetThreadWeight(Thread* thread) {
+            return GetPriorityWeight(thread->GetParent()->GetPriority());
+        }
+
+        RunQueue::RunQueue() : m_tree(), m_current(nullptr), m_min_vruntime(0), m_load(0), m_lock(0), m_interrupts_enabled(false) {
+
+        }
+
+        void RunQueue::Enqueue(Thread* thread, uint64_t now, bool waking) {
+            int64_t lag = (int64_t)thread->GetVirtualRuntime();
+            if (waking) {
+                /*
+                The lag is relative to the minimum when the thread went to sleep, and the minimum has moved on by about as long as it slept since then.
+                Taking that off gives max(min_vruntime - target_latency / 2, vruntime). Without a limit, a thread that slept for a long time would hold the CPU until it caught up.
+                */
+                uint64_t sleep_start = thread->GetExecStart();
+                uint64_t slept = now > sleep_start ? now - sleep_start : 0;
+                int64_t max_credit = (int64_t)(__atomic_load_n(&g_target_latency, __ATOMIC_RELAXED) / 2);
+                if (lag <= -max_credit || slept >= (uint64_t)(lag + max_credit))
+                    lag = -max_credit;
+                else
+                    lag -= (int64_t)slept;
+            }
+            uint64_t vruntime;
+            if (lag < 0 && (uint64_t)(-lag) > m_min_vruntime)
+                vruntime = 0;
+            else
+                vruntime = m_min_vruntime + lag;
+            thread->SetVirtualRuntime(vruntime);
+            thread->SetRunQueue(this);
+            RBTree::Node* node = thread->GetRunNode();
+            node->key = vruntime;
+            m_tree.Insert(node);
+            m_load += GetThreadWeight(thread);
+        }
+
+        bool RunQueue::Dequeue(Thread* thread) {
+            if (thread->GetRunQueue() != this || thread == m_current)
+                return false;
+            m_tree.Remove(thread->GetRunNode());
+            m_load -= GetThreadWeight(thread);
+            thread->SetRunQueue(nullptr);
+            UpdateMinVirtualRuntime();
+            thread->SetVirtualRuntime(thread->GetVirtualRuntime() - m_min_vruntime);
+            return true;
+        }
+
+        Thread* RunQueue::PickFirst(uint64_t now) {
+            RBTree::Node* node = m_tree.GetLeftmost();
+            if (node == nullptr)
+                return nullptr;
+            m_tree.Remove(node);
+            m_current = (Thread*)node->data;
+            m_current->SetExecStart(now);
+            UpdateMinVirtualRuntime();
+            return m_current;
+        }
+
+        Thread* RunQueue::PopLast(bool (*filter)(Thread* thread, void* data), void* data) {
+            RBTree::Node* node = m_tree.GetRightmost();
+            for (uint64_t i = 0; node != nullptr && i < SCHEDULER_MIGRATION_SCAN_LIMIT; i++, node = m_tree.GetPrevious(node)) {
+                Thread* thread = (Thread*)node->data;
+                if (filter == nullptr || filter(thread, data)) {
+                    Dequeue(thread);
+                    return thread;
+                }
+            }
+            return nullptr;
+        }
+
+        void RunQueue::UpdateCurrent(uint64_t now) {
+            if (m_current == nullptr)
+                return;
+            uint64_t start = m_current->GetExecStart();
+            if (now > start) {
+                m_current->SetVirtualRuntime(m_current->GetVirtualRuntime() + (now - start) * SCHEDULER_NICE_0_WEIGHT / GetThreadWeight(m_current));
+                m_current->SetExecStart(now);
+            }
+            UpdateMinVirtualRuntime();
+        }
+
+        void RunQueue::PutCurrent(uint64_t now) {
+            if (m_current == nullptr)
+                return;
+            UpdateCurrent(now);
+            RBTree::Node* node = m_current->GetRunNode();
+            node->key = m_current->GetVirtualRuntime();
+            m_tree.Insert(node);
+            m_current = nullptr;
+        }
+
+        void RunQueue::DetachCurrent(uint64_t now) {
+            if (m_current == nullptr)
+                return;
+            UpdateCurrent(now);
+            Thread* thread = m_current;
+            m_current = nullptr;
+            m_load -= GetThreadWeight(thread);
+            thread->SetRunQueue(nullptr);
+            thread->SetVirtualRuntime(thread->GetVirtualRuntime() - m_min_vruntime);
+        }
+
+        Thread* RunQueue::GetCurrent() const {
+            return m_current;
+        }
+
+        uint64_t RunQueue::GetSlice() const {
+            if (m_current == nullptr || m_load == 0)
+                return 0;
+            uint64_t target_latency = __atomic_load_n(&g_target_latency, __ATOMIC_RELAXED);
+            uint64_t min_granularity = __atomic_load_n(&g_min_granularity, __ATOMIC_RELAXED);
+            uint64_t period = target_latency;
+            uint64_t count = m_tree.GetCount() + 1;
+            if (count * min_granularity > period)
+                period = count * min_granularity;
+            uint64_t slice = (uint64_t)(((__uint128_t)period * GetThreadWeight(m_current)) / m_load);
+            return slice < min_granularity ? min_granularity : slice;
+        }
+
+        bool RunQueue::ShouldPreempt(uint64_t ran) const {
+            if (m_current == nullptr)
+                return true;
+            RBTree::Node* first = m_tree.GetLeftmost();
+            if (first == nullptr)
+                return false;
+            if (ran >= GetSlice())
+                return true;
+            // A thread that woke up well behind the current one shouldn't wait out the whole slice
+            return ran >= __atomic_load_n(&g_min_granularity, __ATOMIC_RELAXED) && first->key + SCHEDULER_WAKEUP_GRANULARITY_NS < m_current->GetVirtualRuntime();
+        }
+
+        uint64_t RunQueue::GetQueuedCount() const {
+            return m_tree.GetCount();
+        }
+
+        uint64_t RunQueue::GetLoad() const {
+            return m_load;
+        }
+
+        void RunQueue::EnumerateThreads(void (*callback)(Thread* thread, void* data), void* data) {
+            for (RBTree::Node* node = m_tree.GetLeftmost(); node != nullptr; node = m_tree.GetNext(node))
+                callback((Thread*)node->data, data);
+        }
+
+        void RunQueue::Lock() const {
+            // Also taken from the timer IRQ, so interrupts stay off while it is held
+#ifdef __x86_64__
+            bool interrupts_enabled = x86_64_AreInterruptsEnabled();
+            x86_64_DisableInterrupts();
+#endif
+            spinlock_acquire(&m_lock);
+#ifdef __x86_64__
+            m_interrupts_enabled = interrupts_enabled;
+#endif
+        }
+
+        void RunQueue::Unlock() const {
+#ifdef __x86_64__
+            bool interrupts_enabled = m_interrupts_enabled;
+#endif
+            spinlock_release(&m_lock);
+#ifdef __x86_64__
+            if (interrupts_enabled)
+                x86_64_EnableInterrupts();
+#endif
+        }
+
+        void RunQueue::ForceUnlock() const {
+            spinlock_init(&m_lock);
+        }
+
+        // The minimum only ever moves forwards, so threads placed relative to it can't jump backwards in time.
+        void RunQueue::UpdateMinVirtualRuntime() {
+            uint64_t vruntime = m_min_vruntime;
+            RBTree::Node* first = m_tree.GetLeftmost();
+            if (m_current != nullptr)
+                vruntime = m_current->GetVirtualRuntime();
+            if (first != nullptr && (m_current == nullptr || first->key < vruntime))
+                vruntime = first->key;
+            if (vruntime > m_min_vruntime)
+                m_min_vruntime = vruntime;
+        }
+
+    }
+
+}
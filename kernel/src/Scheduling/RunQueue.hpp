@@ -0,0 +1,123 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _KERNEL_RUN_QUEUE_HPP
+#define _KERNEL_RUN_QUEUE_HPP
+
+#include <stdint.h>
+#include <spinlock.h>
+
+#include <Data-structures/RBTree.hpp>
+
+#include "Process.hpp"
+
+/*
+Every runnable thread on a CPU should get to run once per target latency. When there are too many threads
+for that, the period is stretched so each still gets the minimum granularity. The timer ticks every 1ms,
+so the granularity can't usefully be any lower than that.
+*/
+#define SCHEDULER_DEFAULT_TARGET_LATENCY_NS 20000000 // 20ms
+#define SCHEDULER_DEFAULT_MIN_GRANULARITY_NS 4000000 // 4ms
+#define SCHEDULER_WAKEUP_GRANULARITY_NS 1000000 // how far a waiting thread must fall behind the current one before it preempts it early
+
+#define SCHEDULER_NICE_0_WEIGHT 1024 // weight of a NORMAL thread
+
+namespace Scheduling {
+
+    class Thread;
+
+    namespace Scheduler {
+
+        uint64_t GetPriorityWeight(Priority priority);
+
+        // Both are in nanoseconds. Returns false if they are out of range and leaves the current values alone.
+        bool SetLatencyParameters(uint64_t target_latency, uint64_t min_granularity);
+        void GetLatencyParameters(uint64_t* target_latency, uint64_t* min_granularity);
+
+        /*
+        Per-CPU queue of runnable threads, ordered by virtual runtime, which is the time a thread has run scaled
+        by NICE_0_WEIGHT / weight. The leftmost thread has had the least CPU for its weight and runs next.
+        The thread currently running is kept out of the tree but still counts towards the load.
+        Lock must be held around every other method.
+        */
+        class RunQueue {
+        public:
+            RunQueue();
+
+            /*
+            thread's virtual runtime must be relative. A waking thread gets credit for the time since it was last charged for running, which is when it went to sleep,
+            up to half a target latency, so it is placed at max(min_vruntime - target_latency / 2, its vruntime).
+            */
+            void Enqueue(Thread* thread, uint64_t now, bool waking);
+
+            // Takes a queued thread off, leaving its virtual runtime relative. Returns false if it isn't queued here.
+            bool Dequeue(Thread* thread);
+
+            // Makes the leftmost thread the current one. Returns nullptr if nothing is queued.
+            Thread* PickFirst(uint64_t now);
+
+            /*
+            Takes the queued thread with the highest virtual runtime that filter accepts off for migration, leaving its virtual runtime relative.
+            Only the last few threads are looked at, so this stays cheap in the timer IRQ. filter may be nullptr to accept any thread.
+            */
+            Thread* PopLast(bool (*filter)(Thread* thread, void* data) = nullptr, void* data = nullptr);
+
+            // Charge the current thread for the time it has run since it was last charged.
+            void UpdateCurrent(uint64_t now);
+
+            // The current thread stays runnable and goes back in the tree.
+            void PutCurrent(uint64_t now);
+
+            // The current thread is leaving this CPU without going back in the tree. Its virtual runtime becomes relative.
+            void DetachCurrent(uint64_t now);
+
+            Thread* GetCurrent() const;
+
+            // How long the current thread should run before another thread is picked, in nanoseconds.
+            uint64_t GetSlice() const;
+
+            // ran is how long the current thread has been running since it was picked.
+            bool ShouldPreempt(uint64_t ran) const;
+
+            uint64_t GetQueuedCount() const; // excludes the current thread
+            uint64_t GetLoad() const; // total weight, including the current thread
+
+            void EnumerateThreads(void (*callback)(Thread* thread, void* data), void* data);
+
+            void Lock() const;
+            void Unlock() const;
+            void ForceUnlock() const; // only for the panic path, leaves interrupts alone
+
+        private:
+            void UpdateMinVirtualRuntime();
+
+        private:
+            RBTree::Tree m_tree;
+            Thread* m_current;
+            uint64_t m_min_vruntime;
+            uint64_t m_load;
+
+            mutable spinlock_t m_lock;
+            mutable bool m_interrupts_enabled; // only written by the lock holder
+        };
+
+    }
+
+}
+
+#endif /* _KERNEL_RUN_QUEUE_HPP */
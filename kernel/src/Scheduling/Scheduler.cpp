@@ -18,6 +18,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "Scheduler.hpp"
 #include "Data-structures/LinkedList.hpp"
 #include "Semaphore.hpp"
+#include "SystemInfo.hpp"
 #include "arch/x86_64/interrupts/APIC/IPI.hpp"
 
 #include <assert.h>
@@ -29,8 +30,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <HAL/hal.hpp>
 
+#include <Log/KernelLog.hpp>
+#include <Log/Trace.hpp>
+
 #ifdef __x86_64__
 #include <arch/x86_64/io.h>
+#include <arch/x86_64/CPUTopology.hpp>
 #include <arch/x86_64/Processor.hpp>
 #include <arch/x86_64/Stack.hpp>
 
@@ -73,6 +78,19 @@ namespace Scheduling {
             m_count++;
         }
 
+        void ThreadList::InsertBefore(Thread* position, Thread* thread) {
+            if (position == nullptr)
+                return PushBack(thread);
+            if (position == m_start)
+                return PushFront(thread);
+            Thread* previous = position->GetPreviousThread();
+            previous->SetNextThread(thread);
+            thread->SetPreviousThread(previous);
+            thread->SetNextThread(position);
+            position->SetPreviousThread(thread);
+            m_count++;
+        }
+
         Thread* ThreadList::PopBack() {
             if (m_count == 0)
                 return nullptr;
@@ -118,17 +136,18 @@ namespace Scheduling {
                         if (m_start != nullptr)
                             m_start->SetPreviousThread(nullptr);
                     }
-                    else if (current == m_end) {
+                    else
+                        current->GetPreviousThread()->SetNextThread(current->GetNextThread());
+                    if (current == m_end) {
                         m_end = current->GetPreviousThread();
                         if (m_end != nullptr)
                             m_end->SetNextThread(nullptr);
                     }
-                    else {
-                        current->GetPreviousThread()->SetNextThread(current->GetNextThread());
+                    else
                         current->GetNextThread()->SetPreviousThread(current->GetPreviousThread());
-                    }
                     current->SetNextThread(nullptr);
                     current->SetPreviousThread(nullptr);
+                    m_count--;
                     return true;
                 }
                 current = current->GetNextThread();
@@ -175,16 +194,24 @@ namespace Scheduling {
             spinlock_release(&m_lock);
         }
 
+        void ThreadList::ForceUnlock() const {
+            spinlock_init(&m_lock);
+        }
+
 
         ProcessorInfo g_BSPInfo;
 
-        LinkedList::LockableLinkedList<ProcessorInfo> g_processors;
-        LinkedList::LockableLinkedList<Process> g_processes;
-        LinkedList::LockableLinkedList<Semaphore> g_semaphores;
-        ThreadList g_kernel_threads;
-        ThreadList g_high_threads;
-        ThreadList g_normal_threads;
-        ThreadList g_low_threads;
+        // Indexed by ProcessorInfo::id. Entries are only ever appended and the count is published after the entry is written, so
+        // the table can be walked without a lock from anywhere, including interrupt handlers.
+        ProcessorInfo* g_processors[SCHEDULER_MAX_PROCESSORS];
+        uint64_t g_processor_count = 0;
+        spinlock_new(g_processors_lock); // serialises adding processors and changing another processor's current thread
+        IntrusiveList::HashTable<Process, 64> g_processes; // keyed by PID
+        IntrusiveList::HashTable<Semaphore, 64> g_semaphores; // keyed by ID
+        RunQueue g_BSPRunQueue;
+#ifdef __x86_64__
+        uint8_t __attribute__((aligned(16))) g_BSPExitStack[KERNEL_STACK_SIZE]; // the BSP is set up before the kernel page manager exists
+#endif
         ThreadList g_idle_threads;
         ThreadList g_sleeping_threads;
         uint64_t g_total_threads = 0;
@@ -193,61 +220,339 @@ namespace Scheduling {
         bool g_scheduler_running = false;
         spinlock_new(g_global_lock);
 
+        static inline uint64_t LoadProcessorCount() {
+            return __atomic_load_n(&g_processor_count, __ATOMIC_ACQUIRE);
+        }
+
+        // Cheap unlocked check used to decide whether an idle processor has anything better to do.
+        static bool HasRunnableThreads() {
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++) {
+                if (g_processors[i]->run_queue->GetQueuedCount() > 0)
+                    return true;
+            }
+            return false;
+        }
+
+        // Send a wakeup to a processor halted in its idle thread, so new work doesn't wait for its next timer tick.
+        static void KickProcessor(ProcessorInfo* info) {
+            if (!g_scheduler_running || info == GetCurrentProcessorInfo())
+                return;
+            Thread* thread = info->current_thread;
+            if (!info->running || thread == nullptr || !thread->IsIdle())
+                return;
+#ifdef __x86_64__
+            x86_64_LocalAPIC* LAPIC = info->processor->GetLocalAPIC();
+            if (LAPIC != nullptr)
+                x86_64_SendWakeupIPI(LAPIC->GetID());
+#endif
+        }
+
+        // Levels of the CPU topology, from the cheapest to move a thread across to the most expensive.
+        enum class TopologyLevel {
+            CORE, // SMT siblings, which share every cache
+            PACKAGE, // cores sharing the last level cache
+            SYSTEM
+        };
+
+        static const TopologyLevel g_topology_levels[] = {TopologyLevel::CORE, TopologyLevel::PACKAGE, TopologyLevel::SYSTEM};
+
+        static bool SharesTopology(ProcessorInfo* a, ProcessorInfo* b, TopologyLevel level) {
+            switch (level) {
+            case TopologyLevel::CORE:
+                return a->core_id == b->core_id;
+            case TopologyLevel::PACKAGE:
+                return a->package_id == b->package_id;
+            default:
+                return true;
+            }
+        }
+
+        static void SetProcessorTopology(ProcessorInfo* info) {
+#ifdef __x86_64__
+            x86_64_CPUTopology topology;
+            x86_64_GetCPUTopology(&topology);
+            info->core_id = topology.core_ID;
+            info->package_id = topology.package_ID;
+#else
+            info->core_id = info->id;
+            info->package_id = 0;
+#endif
+        }
+
+        static ProcessorInfo* FindProcessor(uint64_t id) {
+            return id < LoadProcessorCount() ? g_processors[id] : nullptr;
+        }
+
+        // Total load of info and its SMT siblings. A processor whose siblings are busy only gets part of its core.
+        static uint64_t GetCoreLoad(ProcessorInfo* info) {
+            uint64_t load = 0;
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++) {
+                ProcessorInfo* other = g_processors[i];
+                if (SharesTopology(info, other, TopologyLevel::CORE))
+                    load += other->run_queue->GetLoad();
+            }
+            return load;
+        }
+
+        /*
+        The thread stays on the processor it last ran on while that isn't much busier than the best alternative, as its caches
+        probably still hold the thread's data. Otherwise the least loaded allowed processor is used, preferring an idle core over an
+        idle SMT sibling of a busy one, and then staying in the same package.
+        */
+        static ProcessorInfo* SelectProcessor(Thread* thread) {
+            // Loads are read unlocked, they only need to be roughly right.
+            ProcessorInfo* current = GetCurrentProcessorInfo();
+            ProcessorInfo* last = thread->GetLastCPU() == UINT64_MAX ? nullptr : FindProcessor(thread->GetLastCPU());
+            if (last != nullptr && !thread->CanRunOn(last->id))
+                last = nullptr;
+            ProcessorInfo* best = nullptr;
+            uint64_t best_load = UINT64_MAX;
+            uint64_t best_core_load = UINT64_MAX;
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++) {
+                ProcessorInfo* info = g_processors[i];
+                if (!thread->CanRunOn(info->id))
+                    continue;
+                uint64_t load = info->run_queue->GetLoad();
+                if (load > best_load)
+                    continue;
+                uint64_t core_load = GetCoreLoad(info);
+                if (load == best_load) {
+                    if (core_load > best_core_load)
+                        continue;
+                    if (core_load == best_core_load) {
+                        ProcessorInfo* reference = last != nullptr ? last : current;
+                        if (info != reference && (best == reference || !SharesTopology(info, reference, TopologyLevel::PACKAGE) || SharesTopology(best, reference, TopologyLevel::PACKAGE)))
+                            continue;
+                    }
+                }
+                best = info;
+                best_load = load;
+                best_core_load = core_load;
+            }
+            if (last != nullptr && last->run_queue->GetLoad() <= best_load + SCHEDULER_NICE_0_WEIGHT / 2)
+                best = last;
+            return best != nullptr ? best : current; // only if the affinity allows no processor that is online
+        }
+
+        // thread's virtual runtime must be relative, see Thread::GetVirtualRuntime.
+        static void EnqueueThread(Thread* thread, bool waking) {
+            ProcessorInfo* info = SelectProcessor(thread);
+            info->run_queue->Lock();
+            // Checked under the run queue lock, so RemoveThread either finds it queued or it is never queued
+            if (thread->IsExiting()) {
+                info->run_queue->Unlock();
+                spinlock_acquire(&g_global_lock);
+                g_total_threads--; // it was counted as runnable by whoever made it so
+                spinlock_release(&g_global_lock);
+                thread->AcknowledgeExit();
+                return;
+            }
+            info->run_queue->Enqueue(thread, GetMonotonicTime(), waking);
+            info->run_queue->Unlock();
+            KickProcessor(info);
+        }
+
+        // Take a runnable thread off whichever run queue it is on. Returns false if it isn't queued, which includes when it is running.
+        static bool DequeueThread(Thread* thread) {
+            while (true) {
+                RunQueue* run_queue = thread->GetRunQueue();
+                if (run_queue == nullptr)
+                    return false;
+                run_queue->Lock();
+                if (thread->GetRunQueue() != run_queue) {
+                    run_queue->Unlock(); // it was migrated while we were waiting for the lock
+                    continue;
+                }
+                bool success = run_queue->Dequeue(thread);
+                run_queue->Unlock();
+                return success;
+            }
+        }
+
+        // The current thread of info is leaving that processor without going back in its run queue.
+        static void ReleaseCurrentThread(ProcessorInfo* info) {
+            Thread* thread = info->current_thread;
+            if (thread != nullptr && !thread->IsIdle()) {
+                info->run_queue->Lock();
+                info->run_queue->DetachCurrent(GetMonotonicTime());
+                info->run_queue->Unlock();
+            }
+            __atomic_store_n(&info->current_thread, nullptr, __ATOMIC_RELEASE);
+            if (thread != nullptr && thread->IsExiting())
+                thread->AcknowledgeExit();
+        }
+
+        // Returns the processor thread is the current thread of, or nullptr if there is none.
+        static ProcessorInfo* FindRunningProcessor(Thread* thread) {
+            ProcessorInfo* running = nullptr;
+            spinlock_acquire(&g_processors_lock);
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count && running == nullptr; i++) {
+                if (__atomic_load_n(&g_processors[i]->current_thread, __ATOMIC_ACQUIRE) == thread)
+                    running = g_processors[i];
+            }
+            spinlock_release(&g_processors_lock);
+            return running;
+        }
+
+        struct MigrationFilter {
+            ProcessorInfo* destination;
+            uint64_t max_weight; // moving a heavier thread would leave the imbalance worse the other way
+            uint64_t now;
+            bool allow_cache_hot;
+        };
+
+        static bool CanMigrate(Thread* thread, void* data) {
+            MigrationFilter* filter = (MigrationFilter*)data;
+            if (!thread->CanRunOn(filter->destination->id))
+                return false;
+            if (GetPriorityWeight(thread->GetParent()->GetPriority()) > filter->max_weight)
+                return false;
+            return filter->allow_cache_hot || filter->now - thread->GetExecStart() >= SCHEDULER_MIGRATION_COST_NS;
+        }
+
+        // Move one thread from source to destination. Returns false if no queued thread on source passes the filter.
+        static bool MigrateThread(ProcessorInfo* source, ProcessorInfo* destination, MigrationFilter* filter) {
+            source->run_queue->Lock();
+            Thread* thread = source->run_queue->PopLast(CanMigrate, filter);
+            source->run_queue->Unlock();
+            if (thread == nullptr)
+                return false;
+            destination->run_queue->Lock();
+            destination->run_queue->Enqueue(thread, filter->now, false);
+            destination->run_queue->Unlock();
+            return true;
+        }
+
+        // Pull a queued thread to an idle processor, looking at its SMT siblings first, then its package, then everything else.
+        static bool StealThread(ProcessorInfo* info) {
+            MigrationFilter filter = {info, UINT64_MAX, GetMonotonicTime(), true};
+            for (TopologyLevel level : g_topology_levels) {
+                ProcessorInfo* busiest = nullptr;
+                uint64_t busiest_count = 0;
+                uint64_t processor_count = LoadProcessorCount();
+                for (uint64_t i = 0; i < processor_count; i++) {
+                    ProcessorInfo* other = g_processors[i];
+                    uint64_t count = other->run_queue->GetQueuedCount();
+                    if (other != info && SharesTopology(info, other, level) && count > busiest_count) {
+                        busiest = other;
+                        busiest_count = count;
+                    }
+                }
+                if (busiest != nullptr && MigrateThread(busiest, info, &filter))
+                    return true;
+            }
+            return false;
+        }
+
+        /*
+        Periodic balancing for a busy processor. At each topology level the busiest processor is found, and if it has more than a
+        thread's worth of load over this one, a thread that isn't cache hot is pulled across. Crossing packages loses the last level
+        cache as well, so it needs twice the imbalance. At most one thread is moved per call.
+        */
+        static void BalanceLoad(ProcessorInfo* info) {
+            uint64_t load = info->run_queue->GetLoad();
+            MigrationFilter filter = {info, 0, GetMonotonicTime(), false};
+            for (TopologyLevel level : g_topology_levels) {
+                ProcessorInfo* busiest = nullptr;
+                uint64_t busiest_load = load;
+                uint64_t count = LoadProcessorCount();
+                for (uint64_t i = 0; i < count; i++) {
+                    ProcessorInfo* other = g_processors[i];
+                    uint64_t other_load = other->run_queue->GetLoad();
+                    if (other != info && SharesTopology(info, other, level) && other_load > busiest_load && other->run_queue->GetQueuedCount() > 0) {
+                        busiest = other;
+                        busiest_load = other_load;
+                    }
+                }
+                if (busiest == nullptr)
+                    continue;
+                uint64_t imbalance = busiest_load - load;
+                if (level == TopologyLevel::SYSTEM)
+                    imbalance /= 2;
+                if (imbalance <= SCHEDULER_NICE_0_WEIGHT / 2)
+                    continue;
+                filter.max_weight = imbalance;
+                if (MigrateThread(busiest, info, &filter))
+                    return;
+            }
+        }
+
+        // The sleep queue is kept sorted by wake time, so the timer only ever has to look at the front.
+        static void AddSleepingThread(Thread* thread, uint64_t ms) {
+            thread->SetSleeping(true);
+            thread->SetWakeTime(GetTimer() + DIV_ROUNDUP(ms, MS_PER_TICK) + 1); // +1 as the current tick is already partially over
+            g_sleeping_threads.Lock();
+            Thread* position = g_sleeping_threads.Get(0);
+            while (position != nullptr && position->GetWakeTime() <= thread->GetWakeTime())
+                position = position->GetNextThread();
+            g_sleeping_threads.InsertBefore(position, thread);
+            g_sleeping_threads.Unlock();
+        }
+
         void ClearGlobalData() {
-            g_processors.unlock();
-            g_processes.unlock();
+            spinlock_init(&g_processors_lock);
+            g_processor_count = 0;
+            g_processes.ForceUnlock();
             g_total_threads = 0;
             g_NextPID = 0;
             g_NextSemaphoreID = 0;
             g_scheduler_running = false;
             spinlock_init(&g_global_lock);
 
-            g_kernel_threads = ThreadList();
-            g_high_threads = ThreadList();
-            g_normal_threads = ThreadList();
-            g_low_threads = ThreadList();
+            g_BSPRunQueue = RunQueue();
             g_sleeping_threads = ThreadList();
         }
 
         void InitBSPInfo() {
             g_BSPInfo.processor = &g_BSP;
             g_BSPInfo.id = 0;
-            g_BSPInfo.kernel_run_count = 0;
-            g_BSPInfo.high_run_count = 0;
-            g_BSPInfo.normal_run_count = 0;
+            g_BSPInfo.run_queue = &g_BSPRunQueue;
+            g_BSPInfo.slice_start = 0;
+            SetProcessorTopology(&g_BSPInfo);
             g_BSPInfo.current_thread = nullptr;
             g_BSPInfo.running = false;
             g_BSPInfo.ticks = 0;
             g_BSPInfo.start_allowed = 0;
-            g_processors.insert(&g_BSPInfo); // no point in locking, as we are the only ones running
+#ifdef __x86_64__
+            g_BSPInfo.exit_stack = (uint64_t)g_BSPExitStack + KERNEL_STACK_SIZE;
+#endif
+            g_processors[0] = &g_BSPInfo; // no point in locking, as we are the only ones running
+            __atomic_store_n(&g_processor_count, 1, __ATOMIC_RELEASE);
+            KernelLog_AddCPU(0);
+            Trace_AddCPU(0);
 #ifdef __x86_64__
             x86_64_set_kernel_gs_base((uint64_t)&g_BSPInfo);
 #endif
         }
 
         void AddProcess(Process* process) {
-            g_processes.lock();
-            g_processes.insert(process);
+            g_processes.Lock();
+            if (g_processes.Contains(process->GetSchedulerNode())) {
+                g_processes.Unlock();
+                return;
+            }
             spinlock_acquire(&g_global_lock);
             process->SetPID(g_NextPID);
             g_NextPID++;
             spinlock_release(&g_global_lock);
-            g_processes.unlock();
+            g_processes.Insert(process->GetSchedulerNode(), process->GetPID());
+            g_processes.Unlock();
         }
 
         void RemoveProcess(Process* process) {
-            g_processes.lock();
-            g_processes.remove(process);
-            g_processes.unlock();
+            g_processes.Lock();
+            g_processes.Remove(process->GetSchedulerNode());
+            g_processes.Unlock();
         }
 
         void ScheduleThread(Thread* thread) {
             assert(thread != nullptr);
-            g_processes.lock();
             Priority thread_priority = thread->GetParent()->GetPriority();
-            if (g_processes.getIndex(thread->GetParent()) == UINT64_MAX)
-                AddProcess(thread->GetParent());
-            g_processes.unlock();
+            AddProcess(thread->GetParent()); // does nothing if it is already there
             CPU_Registers* regs = thread->GetCPURegisters();
             fast_memset(regs, 0, DIV_ROUNDUP(sizeof(CPU_Registers), 8));
 #ifdef __x86_64__
@@ -274,107 +579,101 @@ namespace Scheduling {
 #else
 #error Unkown Architecture
 #endif
-                g_kernel_threads.Lock();
-                g_kernel_threads.PushBack(thread);
-                g_kernel_threads.Unlock();
             }
             else {
 #ifdef __x86_64__
                 regs->CS = 0x23; // User Code Segment
                 regs->DS = 0x1b; // User Data Segment
 #endif
-                switch (thread_priority) {
-                    case Priority::HIGH:
-                        g_high_threads.Lock();
-                        g_high_threads.PushBack(thread);
-                        g_high_threads.Unlock();
-                        break;
-                    case Priority::NORMAL:
-                        g_normal_threads.Lock();
-                        g_normal_threads.PushBack(thread);
-                        g_normal_threads.Unlock();
-                        break;
-                    case Priority::LOW:
-                        g_low_threads.Lock();
-                        g_low_threads.PushBack(thread);
-                        g_low_threads.Unlock();
-                        break;
-                    default:
-                        assert(false);
-                        return; // just in case assertions are disabled
-                }
             }
+            thread->SetVirtualRuntime(0); // starts level with the queue it lands on
             spinlock_acquire(&g_global_lock);
             g_total_threads++;
             spinlock_release(&g_global_lock);
+            EnqueueThread(thread, false);
         }
 
+        /*
+        Once the exiting flag is set, whichever processor next has the thread in its hands drops it instead of running or queueing it,
+        and acknowledges that. Until the acknowledgement, the thread may be between a run queue and a processor, so it can't be freed.
+        */
         void RemoveThread(Thread* thread) {
             if (thread == nullptr)
                 return;
-            bool success = false;
-            switch (thread->GetParent()->GetPriority()) {
-                case Priority::KERNEL: {
-                    g_kernel_threads.Lock();
-                    success = g_kernel_threads.RemoveThread(thread);
-                    g_kernel_threads.Unlock();
-                    break;
-                }
-                case Priority::HIGH: {
-                    g_high_threads.Lock();
-                    success = g_high_threads.RemoveThread(thread);
-                    g_high_threads.Unlock();
-                    break;
-                }
-                case Priority::NORMAL: {
-                    g_normal_threads.Lock();
-                    success = g_normal_threads.RemoveThread(thread);
-                    g_normal_threads.Unlock();
-                    break;
-                }
-                case Priority::LOW: {
-                    g_low_threads.Lock();
-                    success = g_low_threads.RemoveThread(thread);
-                    g_low_threads.Unlock();
-                    break;
-                }
-                default:
-                    return;
+            thread->SetExiting(true); // ordered before the run queue locks below, which every path that queues or picks it takes
+            if (DequeueThread(thread)) {
+                spinlock_acquire(&g_global_lock);
+                g_total_threads--;
+                spinlock_release(&g_global_lock);
+                return;
             }
-            if (!success) {
-                g_processors.lock();
-                for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                    ProcessorInfo* proc = g_processors.get(i);
-                    if (proc->current_thread == thread) {
-                        proc->current_thread = nullptr;
-                        success = true;
-                        spinlock_acquire(&g_global_lock);
-                        g_total_threads--;
-                        spinlock_release(&g_global_lock);
-                        PickNext(proc);
-                        break;
+            ProcessorInfo* current = GetCurrentProcessorInfo();
+            if (current->current_thread == thread) {
+                spinlock_acquire(&g_global_lock);
+                g_total_threads--;
+                spinlock_release(&g_global_lock);
+                ReleaseCurrentThread(current);
+                PickNext(current);
+                return;
+            }
+            bool kicked = false;
+            while (!thread->IsExitAcknowledged()) {
+                ProcessorInfo* remote = FindRunningProcessor(thread);
+                if (remote != nullptr) {
+                    // Only it knows where the thread's registers are, so it has to switch away itself
+                    if (!kicked) {
+#ifdef __x86_64__
+                        x86_64_SendWakeupIPI(remote->processor->GetLocalAPIC()->GetID());
+#endif
+                        kicked = true;
                     }
                 }
-                g_processors.unlock();
+                else if (thread->IsSleeping()) {
+                    g_sleeping_threads.Lock();
+                    bool removed = thread->IsSleeping() && g_sleeping_threads.RemoveThread(thread);
+                    if (removed)
+                        thread->SetSleeping(false);
+                    g_sleeping_threads.Unlock();
+                    if (removed)
+                        return; // sleeping threads aren't counted
+                }
+                else if (thread->IsBlocked())
+                    return; // not counted either, and whoever wakes it up will find it exiting
+#ifdef __x86_64__
+                __asm__ volatile("pause" ::: "memory");
+#endif
             }
-            else
-                g_total_threads--;
         }
 
         void AddProcessor(Processor* processor) {
             ProcessorInfo* info = new ProcessorInfo();
             info->processor = processor;
-            info->id = g_processors.getCount();
-            info->kernel_run_count = 0;
-            info->high_run_count = 0;
-            info->normal_run_count = 0;
+            info->run_queue = new RunQueue();
+            info->slice_start = 0;
+            SetProcessorTopology(info); // we are running on the new processor
             info->current_thread = nullptr;
             info->running = false;
             info->ticks = 0;
             info->start_allowed = 0;
-            g_processors.lock();
-            g_processors.insert(info);
-            g_processors.unlock();
+#ifdef __x86_64__
+            info->exit_stack = (uint64_t)g_KPM->AllocatePages(KERNEL_STACK_SIZE >> 12) + KERNEL_STACK_SIZE;
+#endif
+            spinlock_acquire(&g_processors_lock);
+            uint64_t id = g_processor_count;
+            if (id >= SCHEDULER_MAX_PROCESSORS) {
+                spinlock_release(&g_processors_lock);
+                dbgprintf("Scheduler: too many processors, halting processor %lu\n", id);
+                delete info->run_queue;
+                delete info;
+                processor->StopThis();
+            }
+            info->id = id;
+            g_processors[id] = info;
+            __atomic_store_n(&g_processor_count, id + 1, __ATOMIC_RELEASE);
+            SystemInfo_SetCPUCount(id + 1);
+            spinlock_release(&g_processors_lock);
+            KernelLog_AddCPU(info->id);
+            Trace_AddCPU(info->id);
 #ifdef __x86_64__
             x86_64_set_kernel_gs_base((uint64_t)info);
             x86_64_LocalAPIC* LAPIC = processor->GetLocalAPIC();
@@ -401,94 +700,56 @@ namespace Scheduling {
             PANIC("Failed to start Scheduler. This should never happen and most likely means the task switch code for the relevant architecture returned.");
         }
 
-        Processor* GetProcessor(uint8_t ID) {
-            g_processors.lock();
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
-#ifdef __x86_64__
-                x86_64_LocalAPIC* LAPIC = info->processor->GetLocalAPIC();
-                if (LAPIC == nullptr)
-                    continue;
-                if (LAPIC->GetID() == ID) {
-                    g_processors.unlock();
-                    return info->processor;
-                }
-#endif
-            }
-            g_processors.unlock();
-            return nullptr;
+        Processor* GetProcessor(uint32_t ID) {
+            ProcessorInfo* info = GetProcessorInfo(ID);
+            return info != nullptr ? info->processor : nullptr;
         }
 
         ProcessorInfo* GetProcessorInfo(Processor* processor) {
-            g_processors.lock();
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
-                if (info->processor == processor) {
-                    g_processors.unlock();
-                    return info;
-                }
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++) {
+                if (g_processors[i]->processor == processor)
+                    return g_processors[i];
             }
-            g_processors.unlock();
             return nullptr;
         }
 
-        ProcessorInfo* GetProcessorInfo(uint8_t ID) {
-            g_processors.lock();
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
+        ProcessorInfo* GetProcessorInfo(uint32_t ID) {
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++) {
+                ProcessorInfo* info = g_processors[i];
 #ifdef __x86_64__
                 x86_64_LocalAPIC* LAPIC = info->processor->GetLocalAPIC();
-                if (LAPIC == nullptr)
-                    continue;
-                if (LAPIC->GetID() == ID) {
-                    g_processors.unlock();
+                if (LAPIC != nullptr && LAPIC->GetID() == ID)
                     return info;
-                }
 #endif
             }
-            g_processors.unlock();
             return nullptr;
         }
 
-        void RemoveProcessor(Processor* processor) {
-            g_processors.lock();
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
-                if (info->processor == processor) {
-                    g_processors.remove(i);
-                    g_processors.unlock();
-                    return;
-                }
-            }
-            g_processors.unlock();
-        }
-
-        uint8_t GetProcessorCount() {
-            g_processors.lock();
-            uint8_t count = g_processors.getCount();
-            g_processors.unlock();
-            return count;
+        uint32_t GetProcessorCount() {
+            return (uint32_t)LoadProcessorCount();
         }
 
         void EnumerateProcessors(void(*callback)(ProcessorInfo* info, void* data), void* data) {
-            g_processors.lock();
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
-                callback(info, data);
-            }
-            g_processors.unlock();
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++)
+                callback(g_processors[i], data);
         }
 
         void SetThreadFrame(ProcessorInfo* info, Thread::Register_Frame* frame) {
             if (info == nullptr)
                 return;
             memcpy(&info->thread_metadata, frame, sizeof(Thread::Register_Frame));
+#ifdef __x86_64__
+            x86_64_set_fs_base(frame->fs_base); // every switch goes through here, and info is always the current CPU
+#endif
         }
 
         void InitProcessorTimers() {
-            g_processors.lock();
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++) {
+                ProcessorInfo* info = g_processors[i];
 #ifdef __x86_64__
                 x86_64_LocalAPIC* LAPIC = info->processor->GetLocalAPIC();
                 if (LAPIC == nullptr)
@@ -496,37 +757,35 @@ namespace Scheduling {
                 LAPIC->AllowInitTimer();
 #endif
             }
-            g_processors.unlock();
         }
 
         void __attribute__((noreturn)) Start() {
 #ifdef __x86_64__
             x86_64_DisableInterrupts(); // task switch code re-enables them
 #endif
-            g_processors.lock();
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
+            spinlock_acquire(&g_processors_lock);
+            uint64_t count = g_processor_count;
+            for (uint64_t i = 0; i < count; i++) {
+                ProcessorInfo* info = g_processors[i];
                 info->running = true;
                 info->current_thread = nullptr;
                 info->ticks = 0;
             }
             g_scheduler_running = true; // this means that the scheduler is actually running
-            ProcessorInfo* current_processor = nullptr;
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
+            ProcessorInfo* current_processor = GetCurrentProcessorInfo();
+            for (uint64_t i = 0; i < count; i++) {
+                ProcessorInfo* info = g_processors[i];
                 PickNext(info);
 #ifdef __x86_64__
                 x86_64_LocalAPIC* LAPIC = info->processor->GetLocalAPIC();
                 if (LAPIC == nullptr) {
                     PANIC("FATAL: Processor does not have a Local APIC!");
                 }
-                if (LAPIC->GetID() == GetCurrentProcessorID())
-                    current_processor = info;
-                else
-                    info->start_allowed = 1;
 #endif
+                if (info != current_processor)
+                    info->start_allowed = 1;
             }
-            g_processors.unlock();
+            spinlock_release(&g_processors_lock);
             if (current_processor == nullptr) {
                 PANIC("Scheduler: Invalid current processor. This should not be possible.");
             }
@@ -595,10 +854,15 @@ namespace Scheduling {
 
         void End() {
             ProcessorInfo* info = GetCurrentProcessorInfo();
+            Thread* thread = info->current_thread;
             // TODO: call any destructors or other destruction function
-            if (info->current_thread->GetFlags() & CREATE_STACK)
-                info->current_thread->GetParent()->GetPageManager()->FreePages((void*)(info->current_thread->GetStack() - KiB(64)));
-            info->current_thread = nullptr;
+            if (thread->GetFlags() & CREATE_STACK)
+                thread->GetParent()->GetPageManager()->FreePages((void*)(thread->GetStack() - KiB(64)));
+            spinlock_acquire(&g_global_lock);
+            g_total_threads--;
+            spinlock_release(&g_global_lock);
+            thread->SetExiting(true); // so ReleaseCurrentThread acknowledges it, after which its owner may free it
+            ReleaseCurrentThread(info);
             PickNext(info);
             Next();
         }
@@ -619,11 +883,15 @@ namespace Scheduling {
             if (g_total_threads == 0) {
                 PANIC("Scheduler: No available threads. This means all threads have ended and there is nothing else to run.");
             }
-            if (g_total_threads == 1 && info->current_thread != nullptr) {
+            if (g_total_threads == 1 && info->current_thread != nullptr && !info->current_thread->IsExiting()) {
                 spinlock_release(&g_global_lock);
                 return;
             }
             spinlock_release(&g_global_lock);
+            uint64_t now = GetMonotonicTime();
+            Thread* previous = info->current_thread;
+            Thread* evicted = nullptr; // lost the right to run here after an affinity change
+            Thread* exited = nullptr; // removed by RemoveThread, so it must not go back in the run queue
             if (info->current_thread != nullptr) {
                 if (info->current_thread->IsIdle()) {
                     g_idle_threads.Lock();
@@ -631,108 +899,92 @@ namespace Scheduling {
                     g_idle_threads.Unlock();
                 }
                 else {
-                    switch (info->current_thread->GetParent()->GetPriority()) {
-                        case Priority::KERNEL:
-                            g_kernel_threads.Lock();
-                            g_kernel_threads.PushBack(info->current_thread);
-                            g_kernel_threads.Unlock();
-                            info->kernel_run_count++;
-                            break;
-                        case Priority::HIGH:
-                            g_high_threads.Lock();
-                            g_high_threads.PushBack(info->current_thread);
-                            g_high_threads.Unlock();
-                            info->high_run_count++;
-                            break;
-                        case Priority::NORMAL:
-                            g_normal_threads.Lock();
-                            g_normal_threads.PushBack(info->current_thread);
-                            g_normal_threads.Unlock();
-                            info->normal_run_count++;
-                            break;
-                        case Priority::LOW:
-                            g_low_threads.Lock();
-                            g_low_threads.PushBack(info->current_thread);
-                            g_low_threads.Unlock();
-                            break;
-                        default:
-                            PANIC("Scheduler: A thread has run with an unknown priority.");
-                            return; // unnecessary, but only here to remove compiler warnings
-                    }
-                }
-            }
-            g_kernel_threads.Lock();
-            g_high_threads.Lock();
-            g_normal_threads.Lock();
-            g_low_threads.Lock();
-            if ((info->kernel_run_count >= 4 || g_kernel_threads.GetCount() == 0) && (g_high_threads.GetCount() > 0 || g_normal_threads.GetCount() > 0 || g_low_threads.GetCount() > 0)) { // time to select a high thread
-                g_kernel_threads.Unlock(); // we must unlock as soon as possible
-                if ((info->high_run_count >= 4 || g_high_threads.GetCount() == 0) && (g_normal_threads.GetCount() > 0 || g_low_threads.GetCount() > 0)) { // time to select a normal thread
-                    g_high_threads.Unlock();
-                    if ((info->normal_run_count >= 4 || g_normal_threads.GetCount() == 0) && g_low_threads.GetCount() > 0) { // time to select a low thread
-                        g_normal_threads.Unlock();
-                        info->current_thread = g_low_threads.PopFront();
-                        g_low_threads.Unlock();
-                        info->normal_run_count = 0;
+                    info->run_queue->Lock();
+                    if (info->current_thread->IsExiting()) {
+                        exited = info->current_thread;
+                        info->run_queue->DetachCurrent(now);
+                        if (!exited->IsBlocked() && !exited->IsSleeping()) {
+                            spinlock_acquire(&g_global_lock);
+                            g_total_threads--; // still counted as runnable, as it was running
+                            spinlock_release(&g_global_lock);
+                        }
                     }
+                    else if (info->current_thread->CanRunOn(info->id))
+                        info->run_queue->PutCurrent(now);
                     else {
-                        g_low_threads.Unlock();
-                        info->current_thread = g_normal_threads.PopFront();
-                        g_normal_threads.Unlock();
+                        evicted = info->current_thread;
+                        info->run_queue->DetachCurrent(now);
                     }
-                    info->high_run_count = 0;
+                    info->run_queue->Unlock();
                 }
-                else {
-                    g_normal_threads.Unlock();
-                    g_low_threads.Unlock();
-                    info->current_thread = g_high_threads.PopFront();
-                    g_high_threads.Unlock();
-                }
-                info->kernel_run_count = 0;
+                if (exited == nullptr)
+                    info->current_thread = nullptr; // an exiting thread stays visible to RemoveThread until it is acknowledged
             }
-            else {
-                g_high_threads.Unlock();
-                g_normal_threads.Unlock();
-                g_low_threads.Unlock();
-                if (g_kernel_threads.GetCount() == 0) {
-                    g_kernel_threads.Unlock();
-                    g_idle_threads.Lock();
-                    if (g_idle_threads.GetCount() > 0)
-                        info->current_thread = g_idle_threads.PopFront();
-                    else
-                        info->current_thread = nullptr;
-                    g_idle_threads.Unlock();
-                }
-                else {
-                    info->current_thread = g_kernel_threads.PopFront();
-                    g_kernel_threads.Unlock();
-                }
+            if (info->run_queue->GetQueuedCount() == 0)
+                StealThread(info);
+            info->run_queue->Lock();
+            Thread* thread = info->run_queue->PickFirst(now);
+            info->run_queue->Unlock();
+            if (thread == nullptr) {
+                g_idle_threads.Lock();
+                if (g_idle_threads.GetCount() > 0)
+                    thread = g_idle_threads.PopFront();
+                g_idle_threads.Unlock();
             }
+            if (thread != nullptr && !thread->IsIdle())
+                thread->SetLastCPU(info->id);
+            tid_t previous_tid = previous != nullptr ? previous->GetTID() : -1;
+            __atomic_store_n(&info->current_thread, thread, __ATOMIC_RELEASE);
+            info->slice_start = now;
+            if (exited != nullptr)
+                exited->AcknowledgeExit(); // nothing here touches it again, so RemoveThread's caller can free it
+            if (thread != previous)
+                TRACE(TRACE_CONTEXT_SWITCH, previous_tid, thread != nullptr ? thread->GetTID() : -1);
+            if (evicted != nullptr)
+                EnqueueThread(evicted, false);
         }
 
 
         void TimerTick(void* iregs) {
             ProcessorInfo* info = GetCurrentProcessorInfo();
             info->ticks++;
+            uint64_t now = GetTimer();
+            ThreadList woken;
             g_sleeping_threads.Lock();
-            for (uint64_t i = 0; i < g_sleeping_threads.GetCount(); i++) { // can't use EnumerateThreads here, as we need to modify the list
-                Thread* thread = g_sleeping_threads.Get(i);
-                thread->SetRemainingSleepTime(thread->GetRemainingSleepTime() - MS_PER_TICK);
-                if (thread->GetRemainingSleepTime() == 0) {
-                    thread->SetSleeping(false);
-                    g_sleeping_threads.RemoveThread(thread);
-                    ReaddThread(thread);
-                    i--;
-                }
+            while (g_sleeping_threads.GetCount() > 0 && g_sleeping_threads.Get(0)->GetWakeTime() <= now) {
+                Thread* thread = g_sleeping_threads.PopFront();
+                thread->SetSleeping(false);
+                if (thread->IsExiting())
+                    thread->AcknowledgeExit(); // RemoveThread is waiting for it, and it isn't counted while asleep
+                else
+                    woken.PushBack(thread);
             }
             g_sleeping_threads.Unlock();
-            if (info->ticks == TICKS_PER_SCHEDULER_CYCLE) {
+            // Readd outside the sleeping list lock, as ReaddThread may need the processor list lock
+            while (woken.GetCount() > 0) {
+                spinlock_acquire(&g_global_lock);
+                g_total_threads++;
+                spinlock_release(&g_global_lock);
+                ReaddThread(woken.PopFront());
+            }
+            if (!info->running || info->current_thread == nullptr)
+                return; // Nothing to switch from, or another processor is in the middle of picking for us
+            bool preempt;
+            if (info->current_thread->IsExiting())
+                preempt = true; // RemoveThread on another processor is waiting for us to switch away
+            else if (info->current_thread->IsIdle())
+                preempt = HasRunnableThreads(); // an idle processor shouldn't wait when there is work to do
+            else {
+                if ((now + info->id) % SCHEDULER_BALANCE_INTERVAL_TICKS == 0) // staggered so the processors don't all balance on the same tick
+                    BalanceLoad(info);
+                uint64_t monotonic_now = GetMonotonicTime();
+                info->run_queue->Lock();
+                info->run_queue->UpdateCurrent(monotonic_now);
+                preempt = info->run_queue->ShouldPreempt(monotonic_now - info->slice_start);
+                info->run_queue->Unlock();
+            }
+            if (preempt) {
                 info->ticks = 0;
-                if (!info->running)
-                    return; // Nothing to switch to
-                if (info->current_thread == nullptr) {
-                    PANIC("Scheduler: No available threads. This means all threads have ended and there is nothing else to run.");
-                }
                 PickNext(info);
 #ifdef __x86_64__
                 if (info->current_thread->GetParent()->GetPriority() == Priority::KERNEL)
@@ -742,6 +994,21 @@ namespace Scheduling {
             }
         }
 
+        void IdleWakeup(void* iregs) {
+            if (!g_scheduler_running)
+                return;
+            ProcessorInfo* info = GetCurrentProcessorInfo();
+            if (info->current_thread != nullptr && info->current_thread->IsExiting()) {
+                PickNext(info); // drops it and tells RemoveThread on the other processor
+                Next(iregs);
+                return;
+            }
+            if (!info->running || info->current_thread == nullptr || !info->current_thread->IsIdle() || !HasRunnableThreads())
+                return; // another processor got to the work first
+            PickNext(info);
+            Next(iregs);
+        }
+
         bool GlobalIsRunning() {
             return g_scheduler_running;
         }
@@ -780,53 +1047,24 @@ namespace Scheduling {
         void SleepThread(Thread* thread, uint64_t ms) {
             assert(thread != nullptr);
             // Remove the thread
-            bool found = false;
-            switch (thread->GetParent()->GetPriority()) {
-            case Priority::KERNEL: {
-                g_kernel_threads.Lock();
-                found = g_kernel_threads.RemoveThread(thread);
-                g_kernel_threads.Unlock();
-                break;
-            }
-            case Priority::HIGH: {
-                g_high_threads.Lock();
-                found = g_high_threads.RemoveThread(thread);
-                g_high_threads.Unlock();
-                break;
-            }
-            case Priority::NORMAL: {
-                g_normal_threads.Lock();
-                found = g_normal_threads.RemoveThread(thread);
-                g_normal_threads.Unlock();
-                break;
-            }
-            case Priority::LOW: {
-                g_low_threads.Lock();
-                found = g_low_threads.RemoveThread(thread);
-                g_low_threads.Unlock();
-                break;
-            }
-            default:
-                return;
-            }
+            bool found = DequeueThread(thread);
             if (!found) {
                 ProcessorInfo* current = GetCurrentProcessorInfo();
-                g_processors.lock();
-                for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                    ProcessorInfo* info = g_processors.get(i);
+                spinlock_acquire(&g_processors_lock);
+                uint64_t count = LoadProcessorCount();
+                for (uint64_t i = 0; i < count; i++) {
+                    ProcessorInfo* info = g_processors[i];
                     if (info->current_thread == thread) {
-                        info->current_thread = nullptr;
+                        ReleaseCurrentThread(info);
                         found = true;
+                        spinlock_acquire(&g_global_lock);
                         g_total_threads--;
-                        thread->SetSleeping(true);
-                        thread->SetRemainingSleepTime(ALIGN_UP(ms, MS_PER_TICK));
+                        spinlock_release(&g_global_lock);
                         assert(thread->GetCPURegisters() != nullptr);
                         //thread->GetCPURegisters()->RIP = (uint64_t)return_address;
-                        g_sleeping_threads.Lock();
-                        g_sleeping_threads.PushBack(thread);
-                        g_sleeping_threads.Unlock();
+                        AddSleepingThread(thread, ms);
                         PickNext(info);
-                        g_processors.unlock();
+                        spinlock_release(&g_processors_lock);
 
                         if (info->id == current->id) {
                             Next();
@@ -837,62 +1075,79 @@ namespace Scheduling {
                             x86_64_IssueIPI(x86_64_IPI_DestinationShorthand::NoShorthand, LAPIC->GetID(), x86_64_IPI_Type::NextThread, 0, true);
 #endif
                         }
-                        break;
+                        return;
                     }
                 }
-                g_processors.unlock();
+                spinlock_release(&g_processors_lock);
             }
             else {
-                thread->SetSleeping(true);
-                thread->SetRemainingSleepTime(ALIGN_UP(ms, MS_PER_TICK));
+                spinlock_acquire(&g_global_lock);
+                g_total_threads--;
+                spinlock_release(&g_global_lock);
                 assert(thread->GetCPURegisters() != nullptr);
                 //thread->GetCPURegisters()->RIP = (uint64_t)return_address;
-                g_sleeping_threads.Lock();
-                g_sleeping_threads.PushBack(thread);
-                g_sleeping_threads.Unlock();
+                AddSleepingThread(thread, ms);
             }
         }
 
+        bool BlockThread(Thread* thread, bool (*park)(Thread* thread, void* data), void* data) {
+            assert(thread != nullptr && park != nullptr);
+            ProcessorInfo* info = GetCurrentProcessorInfo();
+            assert(info->current_thread == thread);
+            // The thread must look blocked before park publishes it, as it can be woken on another CPU straight away
+            thread->SetBlocked(true);
+            spinlock_acquire(&g_global_lock);
+            g_total_threads--;
+            spinlock_release(&g_global_lock);
+            if (!park(thread, data)) {
+                spinlock_acquire(&g_global_lock);
+                g_total_threads++;
+                spinlock_release(&g_global_lock);
+                thread->SetBlocked(false);
+                return false;
+            }
+            ReleaseCurrentThread(info);
+            PickNext(info);
+            Next();
+        }
+
+        void WakeThread(Thread* thread) {
+            assert(thread != nullptr);
+            thread->SetBlocked(false);
+            spinlock_acquire(&g_global_lock);
+            g_total_threads++;
+            spinlock_release(&g_global_lock);
+            ReaddThread(thread);
+        }
+
         void ReaddThread(Thread* thread) {
             assert(thread != nullptr);
-            switch (thread->GetParent()->GetPriority()) {
-            case Priority::KERNEL:
-                g_kernel_threads.Lock();
-                g_kernel_threads.PushBack(thread);
-                g_kernel_threads.Unlock();
-                break;
-            case Priority::HIGH:
-                g_high_threads.Lock();
-                g_high_threads.PushBack(thread);
-                g_high_threads.Unlock();
-                break;
-            case Priority::NORMAL:
-                g_normal_threads.Lock();
-                g_normal_threads.PushBack(thread);
-                g_normal_threads.Unlock();
-                break;
-            case Priority::LOW:
-                g_low_threads.Lock();
-                g_low_threads.PushBack(thread);
-                g_low_threads.Unlock();
-                break;
-            default:
-                return;
-            }
+            TRACE(TRACE_WAKEUP, thread->GetTID(), 0);
+            EnqueueThread(thread, true);
+        }
+
+        int SetThreadAffinity(Thread* thread, const cpu_set_t* affinity) {
+            if (thread == nullptr || affinity == nullptr)
+                return -EINVAL;
+            bool any_online = false;
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count && !any_online; i++)
+                any_online = cpuset_has(affinity, g_processors[i]->id);
+            if (!any_online)
+                return -EINVAL;
+            thread->SetAffinity(affinity);
+            // A running thread is moved by PickNext the next time it is switched out
+            if (DequeueThread(thread))
+                EnqueueThread(thread, false);
+            return ESUCCESS;
         }
 
         int SendSignal(Process* sender, pid_t PID, int signum) {
             if (sender == nullptr)
                 return -EFAULT;
-            Process* receiver = nullptr;
-            g_processes.lock();
-            for (uint64_t i = 0; i < g_processes.getCount(); i++) {
-                if (g_processes.get(i)->GetPID() == PID) {
-                    receiver = g_processes.get(i);
-                    break;
-                }
-            }
-            g_processes.unlock();
+            g_processes.ReadLock();
+            Process* receiver = g_processes.Find(PID);
+            g_processes.ReadUnlock();
             if (receiver == nullptr)
                 return -EINVAL;
             if (PriorityGreaterThan(receiver->GetPriority(), sender->GetPriority()))
@@ -904,46 +1159,6 @@ namespace Scheduling {
         }
 
         void PrintThreads(fd_t file) {
-            g_kernel_threads.Lock();
-            if (g_kernel_threads.GetCount() > 0) {
-                fprintf(file, "Kernel Threads:\n");
-                g_kernel_threads.EnumerateThreads([](Thread* thread, void* raw_file) {
-                    fd_t file = *reinterpret_cast<fd_t*>(raw_file);
-                    thread->PrintInfo(file);
-                    fputc(file, '\n');
-                }, &file);
-            }
-            g_kernel_threads.Unlock();
-            g_high_threads.Lock();
-            if (g_high_threads.GetCount() > 0) {
-                fprintf(file, "High Threads:\n");
-                g_high_threads.EnumerateThreads([](Thread* thread, void* raw_file) {
-                    fd_t file = *reinterpret_cast<fd_t*>(raw_file);
-                    thread->PrintInfo(file);
-                    fputc(file, '\n');
-                }, &file);
-            }
-            g_high_threads.Unlock();
-            g_normal_threads.Lock();
-            if (g_normal_threads.GetCount() > 0) {
-                fprintf(file, "Normal Threads:\n");
-                g_normal_threads.EnumerateThreads([](Thread* thread, void* raw_file) {
-                    fd_t file = *reinterpret_cast<fd_t*>(raw_file);
-                    thread->PrintInfo(file);
-                    fputc(file, '\n');
-                }, &file);
-            }
-            g_normal_threads.Unlock();
-            g_low_threads.Lock();
-            if (g_low_threads.GetCount() > 0) {
-                fprintf(file, "Low Threads:\n");
-                g_low_threads.EnumerateThreads([](Thread* thread, void* raw_file) {
-                    fd_t file = *reinterpret_cast<fd_t*>(raw_file);
-                    thread->PrintInfo(file);
-                    fputc(file, '\n');
-                }, &file);
-            }
-            g_low_threads.Unlock();
             g_sleeping_threads.Lock();
             if (g_sleeping_threads.GetCount() > 0) {
                 fprintf(file, "Sleeping Threads:\n");
@@ -954,27 +1169,35 @@ namespace Scheduling {
                 }, &file);
             }
             g_sleeping_threads.Unlock();
-            g_processors.lock();
-            for (uint64_t i = 0; i < g_processors.getCount(); i++) {
-                ProcessorInfo* info = g_processors.get(i);
-                fprintf(file, "Processor %d:\n", info->id);
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++) {
+                ProcessorInfo* info = g_processors[i];
+                fprintf(file, "Processor %lu:\n", info->id);
                 if (info->current_thread != nullptr) {
                     fprintf(file, "Current Thread:\n");
                     info->current_thread->PrintInfo(file);
                     fputc(file, '\n');
                 }
+                info->run_queue->Lock();
+                if (info->run_queue->GetQueuedCount() > 0) {
+                    fprintf(file, "Queued Threads:\n");
+                    info->run_queue->EnumerateThreads([](Thread* thread, void* raw_file) {
+                        fd_t file = *reinterpret_cast<fd_t*>(raw_file);
+                        thread->PrintInfo(file);
+                        fprintf(file, "vruntime=%lu\n", thread->GetVirtualRuntime());
+                    }, &file);
+                }
+                info->run_queue->Unlock();
             }
-            g_processors.unlock();
         }
 
         void ForceUnlockEverything() {
-            g_kernel_threads.Unlock();
-            g_high_threads.Unlock();
-            g_normal_threads.Unlock();
-            g_low_threads.Unlock();
-            g_sleeping_threads.Unlock();
-            g_processors.unlock();
-            g_processes.unlock();
+            uint64_t count = LoadProcessorCount();
+            for (uint64_t i = 0; i < count; i++)
+                g_processors[i]->run_queue->ForceUnlock();
+            g_sleeping_threads.ForceUnlock();
+            spinlock_init(&g_processors_lock);
+            g_processes.ForceUnlock();
         }
 
         void AddIdleThread(Thread* thread) {
@@ -986,10 +1209,7 @@ namespace Scheduling {
             - Only run if nothing else can be run on that CPU
             */
             assert(thread != nullptr);
-            g_processes.lock();
-            if (g_processes.getIndex(thread->GetParent()) == UINT64_MAX)
-                AddProcess(thread->GetParent());
-            g_processes.unlock();
+            AddProcess(thread->GetParent()); // does nothing if it is already there
             CPU_Registers* regs = thread->GetCPURegisters();
             fast_memset(regs, 0, DIV_ROUNDUP(sizeof(CPU_Registers), 8));
 #ifdef __x86_64__
@@ -1021,16 +1241,16 @@ namespace Scheduling {
             if (semaphore == nullptr)
                 return -EINVAL;
 
-            g_semaphores.lock();
-            g_semaphores.insert(semaphore);
-            g_semaphores.unlock();
-
             spinlock_acquire(&g_global_lock);
             int ID = g_NextSemaphoreID;
             semaphore->SetID(ID);
             g_NextSemaphoreID++;
             spinlock_release(&g_global_lock);
 
+            g_semaphores.Lock();
+            g_semaphores.Insert(semaphore->GetSchedulerNode(), ID);
+            g_semaphores.Unlock();
+
             return ID;
         }
 
@@ -1038,50 +1258,34 @@ namespace Scheduling {
             if (ID < 0)
                 return nullptr;
 
-            g_semaphores.lock();
-            for (uint64_t i = 0; i < g_semaphores.getCount(); i++) {
-                Semaphore* semaphore = g_semaphores.get(i);
-                if (semaphore->GetID() == ID) {
-                    g_semaphores.unlock();
-                    return semaphore;
-                }
-            }
-            g_semaphores.unlock();
+            g_semaphores.ReadLock();
+            Semaphore* semaphore = g_semaphores.Find(ID);
+            g_semaphores.ReadUnlock();
 
-            return nullptr;
+            return semaphore;
         }
 
         int UnregisterSemaphore(int ID) {
             if (ID < 0)
                 return -EINVAL;
 
-            g_semaphores.lock();
-            for (uint64_t i = 0; i < g_semaphores.getCount(); i++) {
-                Semaphore* semaphore = g_semaphores.get(i);
-                if (semaphore->GetID() == ID) {
-                    g_semaphores.remove(i);
-                    g_semaphores.unlock();
-                    return ESUCCESS;
-                }
-            }
-            g_semaphores.unlock();
-            return -EINVAL;
+            g_semaphores.Lock();
+            Semaphore* semaphore = g_semaphores.Find(ID);
+            if (semaphore != nullptr)
+                g_semaphores.Remove(semaphore->GetSchedulerNode());
+            g_semaphores.Unlock();
+            return semaphore != nullptr ? ESUCCESS : -EINVAL;
         }
 
         int UnregisterSemaphore(Semaphore* semaphore) {
             if (semaphore == nullptr)
                 return -EINVAL;
             
-            g_semaphores.lock();
-            uint64_t index = g_semaphores.getIndex(semaphore);
-            if (index == UINT64_MAX) {
-                g_semaphores.unlock();
-                return -EINVAL;
-            }
-            g_semaphores.remove(index);
-            g_semaphores.unlock();
+            g_semaphores.Lock();
+            bool success = g_semaphores.Remove(semaphore->GetSchedulerNode());
+            g_semaphores.Unlock();
 
-            return ESUCCESS;
+            return success ? ESUCCESS : -EINVAL;
         }
     }
 }
@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <HAL/time.h>
 
 #include "Process.hpp"
+#include "RunQueue.hpp"
 #include "Thread.hpp"
 
 #include <Data-structures/LinkedList.hpp>
@@ -32,11 +33,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <arch/x86_64/Processor.hpp>
 #endif
 
-// The scheduler needs to switch task every 40ms and the timer runs at 1kHz (or a tick every 1ms), so we need to switch every 40 ticks.
+// Processor numbers index cpu_set_t, so there can't be more processors than it has bits.
+#define SCHEDULER_MAX_PROCESSORS CPU_SETSIZE
 
-#define MS_PER_SCHEDULER_CYCLE 40
-#define TICKS_PER_SCHEDULER_CYCLE MS_PER_SCHEDULER_CYCLE / MS_PER_TICK
+// How often each processor checks for an imbalance with the rest of the system, in timer ticks.
+#define SCHEDULER_BALANCE_INTERVAL_TICKS 4
 
+// A thread that ran more recently than this probably still has its working set in cache, so periodic balancing leaves it alone.
+#define SCHEDULER_MIGRATION_COST_NS 500000
 
 namespace Scheduling {
 
@@ -49,6 +53,7 @@ namespace Scheduling {
 
             void PushBack(Thread* thread);
             void PushFront(Thread* thread);
+            void InsertBefore(Thread* position, Thread* thread); // position must be in the list, or nullptr to insert at the end
 
             Thread* PopBack();
             Thread* PopFront();
@@ -65,6 +70,7 @@ namespace Scheduling {
 
             void Lock() const;
             void Unlock() const;
+            void ForceUnlock() const; // only for the panic path
 
         private:
             Thread* m_start;
@@ -78,13 +84,15 @@ namespace Scheduling {
             Processor* processor;
             uint64_t id;
             Thread::Register_Frame thread_metadata;
-            uint8_t kernel_run_count; // the amount of times a kernel thread has been run in a row
-            uint8_t high_run_count;   // the amount of times a high thread has been run in a row
-            uint8_t normal_run_count; // the amount of times a normal thread has been run in a row
+            RunQueue* run_queue;
+            uint64_t slice_start; // monotonic time at which current_thread was picked
+            uint32_t core_id; // equal for SMT siblings
+            uint32_t package_id;
             Thread* current_thread;
             bool running;
             size_t ticks;
             uint32_t start_allowed; // when this is locked, the processor is not allowed to run anything
+            uint64_t exit_stack; // top of a stack only this processor uses, for kernel threads ending after their own stack is freed
         } __attribute__((packed));
 
         void ClearGlobalData();
@@ -94,14 +102,13 @@ namespace Scheduling {
         void AddProcess(Process* process);
         void RemoveProcess(Process* process);
         void ScheduleThread(Thread* thread);
-        void RemoveThread(Thread* thread);
+        void RemoveThread(Thread* thread); // if the thread is running on, or in transit to, another processor, this waits until that processor acknowledges dropping it
 
         void AddProcessor(Processor* processor);
-        Processor* GetProcessor(uint8_t ID);
+        Processor* GetProcessor(uint32_t ID); // ID is the local APIC ID
         ProcessorInfo* GetProcessorInfo(Processor* processor);
-        ProcessorInfo* GetProcessorInfo(uint8_t ID);
-        void RemoveProcessor(Processor* processor);
-        uint8_t GetProcessorCount();
+        ProcessorInfo* GetProcessorInfo(uint32_t ID); // ID is the local APIC ID
+        uint32_t GetProcessorCount();
         void EnumerateProcessors(void (*callback)(ProcessorInfo* info, void* data), void* data);
 
         void SetThreadFrame(ProcessorInfo* info, Thread::Register_Frame* frame);
@@ -123,6 +130,8 @@ namespace Scheduling {
 
         void TimerTick(void* iregs); // Only to be called in timer IRQ
 
+        void IdleWakeup(void* iregs); // Only to be called in the wakeup IPI handler, after the idle or exiting thread's registers have been saved
+
         // Is the scheduler running globally.
         bool GlobalIsRunning();
 
@@ -137,8 +146,21 @@ namespace Scheduling {
 
         void SleepThread(Thread* thread, uint64_t ms);
 
+        /*
+        Take thread, which must be running on this CPU with its registers saved, off the CPU and hand it to park.
+        park must record the thread somewhere that will later call WakeThread on it. If park returns false, the
+        thread is left running and false is returned. Otherwise this does not return.
+        */
+        bool BlockThread(Thread* thread, bool (*park)(Thread* thread, void* data), void* data);
+
+        // Make a thread that was parked by BlockThread runnable again. Safe to call from an IRQ handler.
+        void WakeThread(Thread* thread);
+
         void ReaddThread(Thread* thread);
 
+        // Returns -EINVAL if affinity contains no processor that is online.
+        int SetThreadAffinity(Thread* thread, const cpu_set_t* affinity);
+
         int SendSignal(Process* sender, pid_t PID, int signum);
 
         void PrintThreads(fd_t file);
@@ -29,8 +29,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 namespace Scheduling {
 
-    Semaphore::Semaphore(uint32_t value) : m_value(value), m_id(-1), m_lock(0), m_waitingThreads(), m_holders() {
-
+    Semaphore::Semaphore(uint32_t value) : m_value(value), m_id(-1), m_lock(0), m_waitingThreads(), m_holders(), m_scheduler_node() {
+        m_scheduler_node.data = this;
     }
 
     Semaphore::~Semaphore() {
@@ -41,6 +41,7 @@ namespace Scheduling {
             Scheduler::ReaddThread(thread);
         }
         m_waitingThreads.Unlock();
+        spinlock_destroy(&m_lock);
     }
 
     void Semaphore::acquire(Thread* thread) {
@@ -153,4 +154,8 @@ namespace Scheduling {
         m_id = id;
     }
 
+    IntrusiveList::Node* Semaphore::GetSchedulerNode() {
+        return &m_scheduler_node;
+    }
+
 }
\ No newline at end of file
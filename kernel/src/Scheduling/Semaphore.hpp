@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <spinlock.h>
 
+#include <Data-structures/IntrusiveList.hpp>
 #include <Data-structures/LinkedList.hpp>
 
 #include "Scheduler.hpp"
@@ -53,6 +54,8 @@ namespace Scheduling {
 
         void SetID(int id);
 
+        IntrusiveList::Node* GetSchedulerNode(); // used by the scheduler's semaphore table
+
     private:
         uint64_t m_value;
         int m_id;
@@ -60,6 +63,8 @@ namespace Scheduling {
 
         Scheduler::ThreadList m_waitingThreads;
         LinkedList::LockableLinkedList<Thread> m_holders;
+
+        IntrusiveList::Node m_scheduler_node;
     };
 
 }
@@ -0,0 +1,87 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "SystemInfo.hpp"
+
+#include <util.h>
+
+#include <Memory/PageTable.hpp>
+
+// Lives in the kernel image so it is usable before the memory managers are, and it never has to be freed.
+union SystemInfoGlobalPage {
+    sysinfo_global_page info;
+    uint8_t raw[PAGE_SIZE];
+};
+
+SystemInfoGlobalPage __attribute__((aligned(0x1000))) g_SystemInfoGlobalPage = {{SYSINFO_VERSION, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0}};
+
+void SystemInfo_UpdateClock(uint64_t ticks, uint64_t monotonic_ns) {
+    sysinfo_global_page* page = &g_SystemInfoGlobalPage.info;
+    page->sequence = page->sequence + 1;
+    __asm__ volatile("" ::: "memory");
+    page->ticks = ticks;
+    page->monotonic_ns = monotonic_ns;
+    __asm__ volatile("" ::: "memory");
+    page->sequence = page->sequence + 1;
+}
+
+void SystemInfo_SetBootTime(uint64_t boot_time) {
+    g_SystemInfoGlobalPage.info.boot_time = boot_time;
+}
+
+void SystemInfo_SetCPUCount(uint64_t count) {
+    g_SystemInfoGlobalPage.info.cpu_count = count;
+}
+
+void SystemInfo_SetTSC(uint64_t base_tsc, uint64_t base_ns, uint64_t mult, uint8_t shift) {
+    sysinfo_global_page* page = &g_SystemInfoGlobalPage.info;
+    page->tsc_available = 0;
+    __asm__ volatile("" ::: "memory");
+    page->tsc_base = base_tsc;
+    page->tsc_base_ns = base_ns;
+    page->tsc_mult = mult;
+    page->tsc_shift = shift;
+    __asm__ volatile("" ::: "memory");
+    page->tsc_available = 1;
+}
+
+sysinfo_process_page* SystemInfo_CreateProcessPage() {
+    sysinfo_process_page* page = (sysinfo_process_page*)g_KPM->AllocatePage();
+    if (page == nullptr)
+        return nullptr;
+    fast_memset(page, 0, PAGE_SIZE >> 3);
+    page->pid = -1;
+    return page;
+}
+
+void SystemInfo_DestroyProcessPage(sysinfo_process_page* page) {
+    if (page != nullptr)
+        g_KPM->FreePage(page);
+}
+
+bool SystemInfo_MapPages(PageManager* pm, sysinfo_process_page* process_page) {
+    if (pm == nullptr || process_page == nullptr)
+        return false;
+    void* global_page = pm->MapPage(g_KPT.GetPhysicalAddress(&g_SystemInfoGlobalPage), PagePermissions::READ, (void*)SYSINFO_GLOBAL_PAGE_ADDRESS);
+    if (global_page == nullptr)
+        return false;
+    if (pm->MapPage(g_KPM->GetPageTable().GetPhysicalAddress(process_page), PagePermissions::READ, (void*)SYSINFO_PROCESS_PAGE_ADDRESS) == nullptr) {
+        pm->FreePage(global_page);
+        return false;
+    }
+    return true;
+}
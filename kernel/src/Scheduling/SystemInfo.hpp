@@ -0,0 +1,40 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _KERNEL_SYSTEM_INFO_HPP
+#define _KERNEL_SYSTEM_INFO_HPP
+
+#include <stdint.h>
+
+#include <sysinfo.h>
+
+#include <Memory/PageManager.hpp>
+
+// Only to be called from the system timer callback
+void SystemInfo_UpdateClock(uint64_t ticks, uint64_t monotonic_ns);
+
+void SystemInfo_SetBootTime(uint64_t boot_time);
+void SystemInfo_SetCPUCount(uint64_t count);
+void SystemInfo_SetTSC(uint64_t base_tsc, uint64_t base_ns, uint64_t mult, uint8_t shift);
+
+sysinfo_process_page* SystemInfo_CreateProcessPage();
+void SystemInfo_DestroyProcessPage(sysinfo_process_page* page);
+
+// Map the global page and a process page read-only into a user page manager at their fixed addresses
+bool SystemInfo_MapPages(PageManager* pm, sysinfo_process_page* process_page);
+
+#endif /* _KERNEL_SYSTEM_INFO_HPP */
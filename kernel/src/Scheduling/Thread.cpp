@@ -31,17 +31,32 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <fs/FileStream.hpp>
 #include <fs/DirectoryStream.hpp>
 
+#include <Log/KernelLog.hpp>
+#include <Log/Trace.hpp>
+
+#include <Memory/UserAccess.hpp>
+
+#ifdef __x86_64__
+#include <arch/x86_64/UART16550.hpp>
+#endif
+
 namespace Scheduling {
 
-    Thread::Thread(Process* parent, ThreadEntry_t entry, void* entry_data, uint8_t flags, tid_t TID) : m_Parent(parent), m_entry(entry), m_entry_data(entry_data), m_flags(flags), m_stack(0), m_cleanup({nullptr, nullptr}), m_FDManager(), m_TID(TID), m_sleeping(false), m_remaining_sleep_time(0), m_idle(false), m_blocked(false), m_working_directory(nullptr) {
+    Thread::Thread(Process* parent, ThreadEntry_t entry, void* entry_data, uint8_t flags, tid_t TID) : m_Parent(parent), m_entry(entry), m_entry_data(entry_data), m_flags(flags), m_stack(0), m_cleanup({nullptr, nullptr}), m_FDManager(), m_io_buffer(nullptr), m_TID(TID), m_sleeping(false), m_wake_time(0), m_idle(false), m_blocked(false), m_exiting(false), m_exit_acknowledged(false), m_working_directory(nullptr), m_vruntime(0), m_exec_start(0), m_run_queue(nullptr), m_run_node(), m_last_cpu(UINT64_MAX), m_signal_frames{} {
         memset(&m_regs, 0, DIV_ROUNDUP(sizeof(m_regs), 8));
-        m_frame.kernel_stack = (uint64_t)g_KPM->AllocatePages(KERNEL_STACK_SIZE >> 12, PagePermissions::READ_WRITE) + KERNEL_STACK_SIZE; // FIXME: use actual page size
+        m_run_node.data = this;
+        cpuset_fill(&m_affinity);
+        m_frame.fs_base = 0;
+        m_own_kernel_stack = (uint64_t)g_KPM->AllocatePages(KERNEL_STACK_SIZE >> 12, PagePermissions::READ_WRITE) + KERNEL_STACK_SIZE; // FIXME: use actual page size
+        m_frame.kernel_stack = m_own_kernel_stack;
     }
 
     Thread::~Thread() {
-        g_KPM->FreePages((void*)(m_frame.kernel_stack - KERNEL_STACK_SIZE));
+        g_KPM->FreePages((void*)(m_own_kernel_stack - KERNEL_STACK_SIZE)); // m_frame.kernel_stack is the thread's stack for kernel threads
         if (m_working_directory != nullptr)
             delete m_working_directory;
+        if (m_io_buffer != nullptr)
+            delete[] m_io_buffer;
     }
 
     void Thread::SetEntry(ThreadEntry_t entry, void* entry_data) {
@@ -105,6 +120,14 @@ namespace Scheduling {
         return &m_frame;
     }
 
+    void Thread::SetFSBase(uint64_t base) {
+        m_frame.fs_base = base;
+    }
+
+    uint64_t Thread::GetFSBase() const {
+        return m_frame.fs_base;
+    }
+
     void Thread::Start() {
         m_FDManager.ReserveFileDescriptor(FileDescriptorType::TTY, g_CurrentTTY, FileDescriptorMode::READ, 0); // not properly supported yet, but here to reserve the file descriptor ID
         Position pos = g_CurrentTTY->GetVGADevice()->GetCursorPosition(); // save the current position
@@ -116,9 +139,50 @@ namespace Scheduling {
     }
 
     fd_t Thread::sys_open(const char* path, unsigned long flags, unsigned short mode) {
-        if (m_Parent == nullptr || !m_Parent->ValidateStringRead(path))
+        if (m_Parent == nullptr)
             return -EFAULT;
 
+        if (strcmp(path, KERNEL_LOG_PATH) == 0) {
+            if (flags != O_READ)
+                return -EACCES;
+            KernelLogReader* reader = new KernelLogReader{0};
+            fd_t fd = m_FDManager.AllocateFileDescriptor(FileDescriptorType::KERNEL_LOG, reader, FileDescriptorMode::READ);
+            if (fd < 0) {
+                delete reader;
+                return -ENOMEM;
+            }
+            return fd;
+        }
+
+        if (strcmp(path, KERNEL_TRACE_PATH) == 0) {
+            if (flags != O_READ)
+                return -EACCES;
+            TraceReader* reader = Trace_OpenReader();
+            if (reader == nullptr)
+                return -ENOMEM;
+            fd_t fd = m_FDManager.AllocateFileDescriptor(FileDescriptorType::KERNEL_TRACE, reader, FileDescriptorMode::READ);
+            if (fd < 0) {
+                Trace_CloseReader(reader);
+                return -ENOMEM;
+            }
+            return fd;
+        }
+
+        if (strcmp(path, SERIAL_PATH) == 0) {
+            if (flags != O_WRITE && flags != O_APPEND)
+                return -EACCES;
+            void* serial = nullptr;
+#ifdef __x86_64__
+            serial = g_DebugUART;
+#endif
+            if (serial == nullptr)
+                return -ENOENT;
+            fd_t fd = m_FDManager.AllocateFileDescriptor(FileDescriptorType::SERIAL, serial, flags == O_APPEND ? FileDescriptorMode::APPEND : FileDescriptorMode::WRITE);
+            if (fd < 0)
+                return -ENOMEM;
+            return fd;
+        }
+
         bool create = flags & O_CREATE;
         if (create)
             flags &= ~O_CREATE;
@@ -246,48 +310,99 @@ namespace Scheduling {
     }
 
     long Thread::sys_read(fd_t file, void* buf, unsigned long count) {
-        if (m_Parent == nullptr || !m_Parent->ValidateWrite(buf, count))
+        if (m_Parent == nullptr)
             return -EFAULT;
 
         FileDescriptor* descriptor = m_FDManager.GetFileDescriptor(file);
         if (descriptor == nullptr)
             return -EBADF;
-        
-        int status = 0;
-        long rc = descriptor->Read((uint8_t*)buf, count, &status);
-        if (rc == 0) {
-            if (status == -EINVAL)
-                return EOF;
-            else
-                return status;
-        }
-        return rc;
+
+        // Check before reading, as the data is gone from the device once it has been read. Only an unmap racing with the read can still lose it.
+        if (count > 0 && !m_Parent->GetPageManager()->isWritable(buf, count))
+            return -EFAULT;
+
+        // Read through a kernel buffer, so a bad user buffer fails the copy instead of faulting inside a driver
+        unsigned long buffer_size = count < USER_IO_BUFFER_SIZE ? count : USER_IO_BUFFER_SIZE;
+        uint8_t* buffer = GetIOBuffer();
+        if (buffer == nullptr)
+            return -ENOMEM;
+        unsigned long total = 0;
+        do {
+            unsigned long chunk = (count - total) < buffer_size ? (count - total) : buffer_size;
+            int status = 0;
+            long rc = descriptor->Read(buffer, chunk, &status);
+            if (rc <= 0) {
+                if (total > 0)
+                    break;
+                if (rc == 0) {
+                    if (status == -EINVAL)
+                        return EOF;
+                    else
+                        return status;
+                }
+                return rc;
+            }
+            if (copy_to_user((void*)((uint64_t)buf + total), buffer, rc) != ESUCCESS)
+                return total > 0 ? (long)total : -EFAULT;
+            total += rc;
+            if ((unsigned long)rc < chunk)
+                break; // don't wait for more than the device had ready
+        } while (total < count);
+        return total;
     }
 
     long Thread::sys_write(fd_t file, const void* buf, unsigned long count) {
         if (count == 0)
             return ESUCCESS; // no point as there is nothing to write
 
-        if (m_Parent == nullptr || !m_Parent->ValidateRead(buf, count))
+        if (m_Parent == nullptr)
             return -EFAULT;
 
         FileDescriptor* descriptor = m_FDManager.GetFileDescriptor(file);
         if (descriptor == nullptr)
             return -EBADF;
-        
-        int status = 0;
-        long rc = descriptor->Write((uint8_t*)buf, count, &status);
-        if (rc == 0) {
-            if (status == -EINVAL)
-                return EOF;
-            else
-                return status;
-        }
+
+        // Write through a kernel buffer, so a bad user buffer fails the copy instead of faulting inside a driver
+        unsigned long buffer_size = count < USER_IO_BUFFER_SIZE ? count : USER_IO_BUFFER_SIZE;
+        uint8_t* buffer = GetIOBuffer();
+        if (buffer == nullptr)
+            return -ENOMEM;
+        unsigned long total = 0;
+        do {
+            unsigned long chunk = (count - total) < buffer_size ? (count - total) : buffer_size;
+            if (copy_from_user(buffer, (const void*)((uint64_t)buf + total), chunk) != ESUCCESS) {
+                if (total > 0)
+                    break;
+                return -EFAULT;
+            }
+            int status = 0;
+            long rc = descriptor->Write(buffer, chunk, &status);
+            if (rc <= 0) {
+                if (total > 0)
+                    break;
+                if (rc == 0) {
+                    if (status == -EINVAL)
+                        return EOF;
+                    else
+                        return status;
+                }
+                return rc;
+            }
+            total += rc;
+            if ((unsigned long)rc < chunk)
+                break;
+        } while (total < count);
 
         if (descriptor->GetType() == FileDescriptorType::TTY)
             ((TTY*)descriptor->GetData())->GetVGADevice()->SwapBuffers(false);
 
-        return rc;
+        return total;
+    }
+
+    uint8_t* Thread::GetIOBuffer() {
+        if (m_io_buffer == nullptr)
+            m_io_buffer = new uint8_t[USER_IO_BUFFER_SIZE];
+        return m_io_buffer;
     }
 
     int Thread::sys_close(fd_t file) {
@@ -301,6 +416,10 @@ namespace Scheduling {
             if (stream != nullptr)
                 delete stream;
         }
+        else if (descriptor->GetType() == FileDescriptorType::KERNEL_LOG)
+            delete (KernelLogReader*)descriptor->GetData();
+        else if (descriptor->GetType() == FileDescriptorType::KERNEL_TRACE)
+            Trace_CloseReader((TraceReader*)descriptor->GetData());
         (void)m_FDManager.FreeFileDescriptor(file); // return value is irrelevant
         delete descriptor;
         return ESUCCESS;
@@ -352,7 +471,7 @@ namespace Scheduling {
     }
 
     int Thread::sys_stat(const char* path, struct stat_buf* buf) {
-        if (m_Parent == nullptr || !m_Parent->ValidateWrite(buf, sizeof(struct stat_buf)) || !m_Parent->ValidateStringRead(path))
+        if (m_Parent == nullptr)
             return -EFAULT;
 
         // Validate path
@@ -374,8 +493,7 @@ namespace Scheduling {
             buffer.st_type = DT_DIR;
             buffer.st_size = 0;
 
-            memcpy(buf, &buffer, sizeof(struct stat_buf));
-            return ESUCCESS;
+            return copy_to_user(buf, &buffer, sizeof(struct stat_buf));
         }
 
         FilePrivilegeLevel privilege = inode->GetPrivilegeLevel();
@@ -411,12 +529,11 @@ namespace Scheduling {
             return -ENOSYS;
         }
 
-        memcpy(buf, &buffer, sizeof(struct stat_buf));
-        return ESUCCESS;
+        return copy_to_user(buf, &buffer, sizeof(struct stat_buf));
     }
 
     int Thread::sys_fstat(fd_t file, struct stat_buf* buf) {
-        if (m_Parent == nullptr || !m_Parent->ValidateWrite(buf, sizeof(struct stat_buf)))
+        if (m_Parent == nullptr)
             return -EFAULT;
 
         FileDescriptor* descriptor = m_FDManager.GetFileDescriptor(file);
@@ -465,12 +582,11 @@ namespace Scheduling {
             return -ENOSYS;
         }
 
-        memcpy(buf, &buffer, sizeof(struct stat_buf));
-        return ESUCCESS;
+        return copy_to_user(buf, &buffer, sizeof(struct stat_buf));
     }
 
     int Thread::sys_chown(const char* path, unsigned int uid, unsigned int gid) {
-        if (m_Parent == nullptr || !m_Parent->ValidateStringRead(path))
+        if (m_Parent == nullptr)
             return -EFAULT;
         
         if (uid == (unsigned int)-1 && gid == (unsigned int)-1)
@@ -530,7 +646,7 @@ namespace Scheduling {
     }
 
     int Thread::sys_chmod(const char* path, unsigned short mode) {
-        if (m_Parent == nullptr || !m_Parent->ValidateStringRead(path))
+        if (m_Parent == nullptr)
             return -EFAULT;
 
         // Validate path
@@ -592,7 +708,7 @@ namespace Scheduling {
     }
 
     int Thread::sys_getdirents(fd_t file, struct dirent* buf, unsigned long count) {
-        if (m_Parent == nullptr || !m_Parent->ValidateWrite(buf, count * sizeof(struct dirent)))
+        if (m_Parent == nullptr)
             return -EFAULT;
 
         FileDescriptor* descriptor = m_FDManager.GetFileDescriptor(file);
@@ -673,16 +789,17 @@ namespace Scheduling {
 
             strncpy(i_dirent.d_name, inode->GetName(), 255);
 
-            memcpy(&(buf[i]), &i_dirent, sizeof(struct dirent));
-
             kfree(inode);
+
+            if (copy_to_user(&(buf[i]), &i_dirent, sizeof(struct dirent)) != ESUCCESS)
+                return -EFAULT;
         }
 
         return ESUCCESS;
     }
 
     int Thread::sys_chdir(const char* path) {
-        if (m_Parent == nullptr || !m_Parent->ValidateStringRead(path))
+        if (m_Parent == nullptr)
             return -EFAULT;
 
         if (m_working_directory == nullptr)
@@ -796,12 +913,12 @@ namespace Scheduling {
         m_sleeping = sleeping;
     }
 
-    uint64_t Thread::GetRemainingSleepTime() const {
-        return m_remaining_sleep_time;
+    uint64_t Thread::GetWakeTime() const {
+        return m_wake_time;
     }
 
-    void Thread::SetRemainingSleepTime(uint64_t remaining_sleep_time) {
-        m_remaining_sleep_time = remaining_sleep_time;
+    void Thread::SetWakeTime(uint64_t wake_time) {
+        m_wake_time = wake_time;
     }
 
     bool Thread::IsIdle() const {
@@ -820,6 +937,70 @@ namespace Scheduling {
         m_blocked = blocked;
     }
 
+    bool Thread::IsExiting() const {
+        return __atomic_load_n(&m_exiting, __ATOMIC_ACQUIRE);
+    }
+
+    void Thread::SetExiting(bool exiting) {
+        __atomic_store_n(&m_exiting, exiting, __ATOMIC_SEQ_CST);
+    }
+
+    bool Thread::IsExitAcknowledged() const {
+        return __atomic_load_n(&m_exit_acknowledged, __ATOMIC_ACQUIRE);
+    }
+
+    void Thread::AcknowledgeExit() {
+        __atomic_store_n(&m_exit_acknowledged, true, __ATOMIC_RELEASE);
+    }
+
+    uint64_t Thread::GetVirtualRuntime() const {
+        return m_vruntime;
+    }
+
+    void Thread::SetVirtualRuntime(uint64_t vruntime) {
+        m_vruntime = vruntime;
+    }
+
+    uint64_t Thread::GetExecStart() const {
+        return m_exec_start;
+    }
+
+    void Thread::SetExecStart(uint64_t exec_start) {
+        m_exec_start = exec_start;
+    }
+
+    Scheduler::RunQueue* Thread::GetRunQueue() const {
+        return m_run_queue;
+    }
+
+    void Thread::SetRunQueue(Scheduler::RunQueue* run_queue) {
+        m_run_queue = run_queue;
+    }
+
+    RBTree::Node* Thread::GetRunNode() {
+        return &m_run_node;
+    }
+
+    const cpu_set_t* Thread::GetAffinity() const {
+        return &m_affinity;
+    }
+
+    void Thread::SetAffinity(const cpu_set_t* affinity) {
+        m_affinity = *affinity;
+    }
+
+    bool Thread::CanRunOn(uint64_t CPU) const {
+        return cpuset_has(&m_affinity, CPU);
+    }
+
+    uint64_t Thread::GetLastCPU() const {
+        return m_last_cpu;
+    }
+
+    void Thread::SetLastCPU(uint64_t CPU) {
+        m_last_cpu = CPU;
+    }
+
     VFS_WorkingDirectory* Thread::GetWorkingDirectory() const {
         return m_working_directory;
     }
@@ -828,6 +1009,22 @@ namespace Scheduling {
         m_working_directory = working_directory;
     }
 
+    bool Thread::IsInSignalHandler(int signum) const {
+        return m_signal_frames[signum - SIG_MIN] != 0;
+    }
+
+    uint64_t Thread::GetSignalFrame(int signum) const {
+        return m_signal_frames[signum - SIG_MIN];
+    }
+
+    void Thread::EnterSignalHandler(int signum, uint64_t frame) {
+        m_signal_frames[signum - SIG_MIN] = frame;
+    }
+
+    void Thread::LeaveSignalHandler(int signum) {
+        m_signal_frames[signum - SIG_MIN] = 0;
+    }
+
     Thread* Thread::GetNextThread() {
         return m_next_thread;
     }
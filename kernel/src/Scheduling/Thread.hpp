@@ -22,15 +22,22 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <stdint.h>
 
+#include <Data-structures/RBTree.hpp>
+
 #include <fs/FileDescriptorManager.hpp>
 #include <fs/VFS.hpp>
 
 #include <file.h>
+#include <sched.h>
 
 namespace Scheduling {
 
     class Semaphore;
 
+    namespace Scheduler {
+        class RunQueue;
+    }
+
     typedef void (*ThreadEntry_t)(void*);
     struct ThreadCleanup_t {
         void (*function)(void*);
@@ -45,6 +52,7 @@ namespace Scheduling {
         struct Register_Frame {
             uint64_t user_stack;
             uint64_t kernel_stack;
+            uint64_t fs_base; // user TLS pointer
         } __attribute__((packed));
 
         Thread(Process* parent, ThreadEntry_t entry = nullptr, void* entry_data = nullptr, uint8_t flags = THREAD_USER_DEFAULT, tid_t TID = -1);
@@ -66,8 +74,13 @@ namespace Scheduling {
         ThreadCleanup_t GetCleanupFunction() const;
         Register_Frame* GetStackRegisterFrame() const;
 
+        // Takes effect the next time the thread is switched to.
+        void SetFSBase(uint64_t base);
+        uint64_t GetFSBase() const;
+
         void Start();
 
+        // Paths are kernel copies made by the system call dispatcher. Buffers are still user pointers.
         fd_t sys_open(const char* path, unsigned long flags, unsigned short mode);
         long sys_read(fd_t file, void* buf, unsigned long count);
         long sys_write(fd_t file, const void* buf, unsigned long count);
@@ -97,8 +110,8 @@ namespace Scheduling {
         bool IsSleeping() const;
         void SetSleeping(bool sleeping);
 
-        uint64_t GetRemainingSleepTime() const;
-        void SetRemainingSleepTime(uint64_t time);
+        uint64_t GetWakeTime() const; // tick count (see GetTimer) at which a sleeping thread should wake
+        void SetWakeTime(uint64_t wake_time);
 
         bool IsIdle() const;
         void SetIdle(bool idle);
@@ -106,14 +119,51 @@ namespace Scheduling {
         bool IsBlocked() const;
         void SetBlocked(bool blocked);
 
+        // Set by Scheduler::RemoveThread. From then on no processor puts the thread back in a run queue.
+        bool IsExiting() const;
+        void SetExiting(bool exiting);
+
+        // Set by whichever processor drops an exiting thread, once it will not touch it again. Only then may it be freed.
+        bool IsExitAcknowledged() const;
+        void AcknowledgeExit();
+
         VFS_WorkingDirectory* GetWorkingDirectory() const;
         void SetWorkingDirectory(VFS_WorkingDirectory* working_directory);
 
+        // Absolute while the thread is queued or running on a run queue, otherwise relative to the minimum of the queue it last left.
+        uint64_t GetVirtualRuntime() const;
+        void SetVirtualRuntime(uint64_t vruntime);
+
+        uint64_t GetExecStart() const; // monotonic time up to which the thread has been charged for running
+        void SetExecStart(uint64_t exec_start);
+
+        Scheduler::RunQueue* GetRunQueue() const; // the run queue the thread is queued or running on, or nullptr
+        void SetRunQueue(Scheduler::RunQueue* run_queue);
+
+        RBTree::Node* GetRunNode();
+
+        // Use Scheduler::SetThreadAffinity to change it, so the thread gets moved if needed.
+        const cpu_set_t* GetAffinity() const;
+        void SetAffinity(const cpu_set_t* affinity);
+        bool CanRunOn(uint64_t CPU) const;
+
+        uint64_t GetLastCPU() const; // UINT64_MAX if it hasn't run yet
+        void SetLastCPU(uint64_t CPU);
+
+        // frame is the user address of the signal frame the handler for signum returns through
+        bool IsInSignalHandler(int signum) const;
+        uint64_t GetSignalFrame(int signum) const; // 0 if the handler for signum isn't running
+        void EnterSignalHandler(int signum, uint64_t frame);
+        void LeaveSignalHandler(int signum);
+
         Thread* GetNextThread();
         Thread* GetPreviousThread();
         void SetNextThread(Thread* next_thread);
         void SetPreviousThread(Thread* previous_thread);
 
+    private:
+        uint8_t* GetIOBuffer(); // nullptr if it could not be allocated
+
     private:
         Process* m_Parent;
         ThreadEntry_t m_entry;
@@ -121,21 +171,34 @@ namespace Scheduling {
         uint8_t m_flags;
         uint64_t m_stack;
         mutable Register_Frame m_frame;
+        uint64_t m_own_kernel_stack; // the one allocated in the constructor, which kernel threads replace with their own stack
         mutable CPU_Registers m_regs;
         ThreadCleanup_t m_cleanup;
         FileDescriptorManager m_FDManager;
+        uint8_t* m_io_buffer; // USER_IO_BUFFER_SIZE bytes, kept from the first read or write so each call doesn't allocate. Per thread, as a read can sleep.
 
         tid_t m_TID;
 
         bool m_sleeping;
-        uint64_t m_remaining_sleep_time;
+        uint64_t m_wake_time;
 
         bool m_idle;
 
         bool m_blocked;
+        bool m_exiting;
+        bool m_exit_acknowledged;
 
         VFS_WorkingDirectory* m_working_directory;
 
+        uint64_t m_vruntime;
+        uint64_t m_exec_start;
+        Scheduler::RunQueue* m_run_queue;
+        RBTree::Node m_run_node;
+        cpu_set_t m_affinity;
+        uint64_t m_last_cpu;
+
+        uint64_t m_signal_frames[SIG_COUNT];
+
         Thread* m_next_thread;
         Thread* m_previous_thread;
     };
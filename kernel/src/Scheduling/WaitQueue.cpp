@@ -0,0 +1,79 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "WaitQueue.hpp"
+
+#ifdef __x86_64__
+#include <arch/x86_64/io.h>
+#include <arch/x86_64/Scheduling/taskutil.hpp>
+#endif
+
+namespace Scheduling {
+
+    WaitQueue::WaitQueue() : m_sequence(0), m_waitingThreads() {
+
+    }
+
+    WaitQueue::~WaitQueue() {
+        WakeAll();
+    }
+
+    uint64_t WaitQueue::GetSequence() const {
+        return __atomic_load_n(&m_sequence, __ATOMIC_ACQUIRE);
+    }
+
+    void WaitQueue::Wait(Thread* thread, uint64_t sequence) {
+        if (thread == nullptr || thread->IsIdle() || thread != Scheduler::GetCurrent())
+            return;
+#ifdef __x86_64__
+        if (!x86_64_AreInterruptsEnabled())
+            return;
+        wait_queue_wait(this, thread, sequence);
+        // We come back here with interrupts disabled if the wait was cut short
+        x86_64_EnableInterrupts();
+#endif
+    }
+
+    void WaitQueue::WakeAll() {
+        m_waitingThreads.Lock();
+        __atomic_add_fetch(&m_sequence, 1, __ATOMIC_RELEASE);
+        while (m_waitingThreads.GetCount() > 0)
+            Scheduler::WakeThread(m_waitingThreads.PopFront());
+        m_waitingThreads.Unlock();
+    }
+
+    bool WaitQueue::Block(Thread* thread, uint64_t sequence) {
+        struct BlockData {
+            WaitQueue* queue;
+            uint64_t sequence;
+        } data = {this, sequence};
+        return Scheduler::BlockThread(thread, [](Thread* thread, void* raw_data) -> bool {
+            BlockData* data = (BlockData*)raw_data;
+            WaitQueue* queue = data->queue;
+            queue->m_waitingThreads.Lock();
+            if (queue->GetSequence() != data->sequence) {
+                queue->m_waitingThreads.Unlock();
+                return false;
+            }
+            queue->m_waitingThreads.PushBack(thread);
+            queue->m_waitingThreads.Unlock();
+            return true;
+        }, &data);
+    }
+
+}
@@ -0,0 +1,57 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _WAIT_QUEUE_HPP
+#define _WAIT_QUEUE_HPP
+
+#include <stdint.h>
+
+#include "Scheduler.hpp"
+#include "Thread.hpp"
+
+namespace Scheduling {
+
+    /*
+    Threads park here until an event, usually raised from an IRQ handler, wakes them.
+    To avoid missing a wakeup, a waiter takes the sequence before checking its condition and passes it to Wait.
+    If WakeAll has run in between, Wait returns straight away.
+    */
+    class WaitQueue {
+    public:
+        WaitQueue();
+        ~WaitQueue();
+
+        uint64_t GetSequence() const;
+
+        // Park the current thread until the next WakeAll. If the thread cannot be parked (no scheduler, idle thread or interrupts disabled), this returns immediately and the caller ends up polling.
+        void Wait(Thread* thread, uint64_t sequence);
+
+        // Wake every waiting thread. Safe to call from an IRQ handler.
+        void WakeAll();
+
+        // Only to be called by the architecture specific wait code, with the thread's registers saved. Returns false if the thread must not be parked.
+        bool Block(Thread* thread, uint64_t sequence);
+
+    private:
+        uint64_t m_sequence;
+        Scheduler::ThreadList m_waitingThreads;
+    };
+
+}
+
+#endif /* _WAIT_QUEUE_HPP */
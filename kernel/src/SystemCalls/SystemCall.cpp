@@ -21,10 +21,17 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "exec.hpp"
 #include "mount.hpp"
 #include "Synchronisation.hpp"
+#include "thread.hpp"
 
 #include <stdio.h>
 #include <errno.h>
 
+#include <HAL/time.h>
+
+#include <Log/Trace.hpp>
+
+#include <Memory/UserAccess.hpp>
+
 #include <Scheduling/Scheduler.hpp>
 #include <Scheduling/Thread.hpp>
 
@@ -34,15 +41,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <arch/x86_64/io.h>
 #endif
 
-extern "C" uint64_t SystemCallHandler(uint64_t num, uint64_t arg1, uint64_t arg2, uint64_t arg3, CPU_Registers* regs) {
-#ifdef __x86_64__
-    x86_64_DisableInterrupts();
-#endif
-    Scheduling::Thread* current_thread = Scheduling::Scheduler::GetCurrent();
-    fast_memcpy(current_thread->GetCPURegisters(), regs, sizeof(CPU_Registers)); // save the registers
-#ifdef __x86_64__
-    x86_64_EnableInterrupts();
-#endif
+static uint64_t SystemCallDispatch(Scheduling::Thread* current_thread, uint64_t num, uint64_t arg1, uint64_t arg2, uint64_t arg3) {
     switch (num) {
     case SC_EXIT:
         sys_exit(current_thread, (int)arg1);
@@ -52,7 +51,7 @@ extern "C" uint64_t SystemCallHandler(uint64_t num, uint64_t arg1, uint64_t arg2
     case SC_WRITE:
         return (uint64_t)(current_thread->sys_write((fd_t)arg1, (const void*)arg2, arg3));
     case SC_OPEN:
-        return (uint64_t)(current_thread->sys_open((const char*)arg1, arg2, (unsigned short)arg3));
+        return (uint64_t)WithUserPath((const char*)arg1, [&](const char* path) { return current_thread->sys_open(path, arg2, (unsigned short)arg3); });
     case SC_CLOSE:
         return (uint64_t)(current_thread->sys_close((fd_t)arg1));
     case SC_SEEK:
@@ -88,15 +87,15 @@ extern "C" uint64_t SystemCallHandler(uint64_t num, uint64_t arg1, uint64_t arg2
         return (uint64_t)(parent->GetEGID());
     }
     case SC_STAT:
-        return (uint64_t)(current_thread->sys_stat((const char*)arg1, (struct stat_buf*)arg2));
+        return (uint64_t)WithUserPath((const char*)arg1, [&](const char* path) { return current_thread->sys_stat(path, (struct stat_buf*)arg2); });
     case SC_FSTAT:
         return (uint64_t)(current_thread->sys_fstat((fd_t)arg1, (struct stat_buf*)arg2));
     case SC_CHOWN:
-        return (uint64_t)(current_thread->sys_chown((const char*)arg1, (unsigned int)arg2, (unsigned int)arg3));
+        return (uint64_t)WithUserPath((const char*)arg1, [&](const char* path) { return current_thread->sys_chown(path, (unsigned int)arg2, (unsigned int)arg3); });
     case SC_FCHOWN:
         return (uint64_t)(current_thread->sys_fchown((fd_t)arg1, (unsigned int)arg2, (unsigned int)arg3));
     case SC_CHMOD:
-        return (uint64_t)(current_thread->sys_chmod((const char*)arg1, (unsigned short)arg2));
+        return (uint64_t)WithUserPath((const char*)arg1, [&](const char* path) { return current_thread->sys_chmod(path, (unsigned short)arg2); });
     case SC_FCHMOD:
         return (uint64_t)(current_thread->sys_fchmod((fd_t)arg1, (unsigned short)arg2));
     case SC_GETPID: {
@@ -118,7 +117,7 @@ extern "C" uint64_t SystemCallHandler(uint64_t num, uint64_t arg1, uint64_t arg2
     case SC_GETDIRENTS:
         return (uint64_t)(current_thread->sys_getdirents((fd_t)arg1, (struct dirent*)arg2, (size_t)arg3));
     case SC_CHDIR:
-        return (uint64_t)(current_thread->sys_chdir((const char*)arg1));
+        return (uint64_t)WithUserPath((const char*)arg1, [&](const char* path) { return current_thread->sys_chdir(path); });
     case SC_FCHDIR:
         return (uint64_t)(current_thread->sys_fchdir((fd_t)arg1));
     case SC_ONSIGNAL: {
@@ -139,13 +138,13 @@ extern "C" uint64_t SystemCallHandler(uint64_t num, uint64_t arg1, uint64_t arg2
             // there is nothing we can do here. We got a noreturn syscall with a parent-less thread.
             PANIC("sigreturn from thread with no parent");
         }
-        parent->sys_sigreturn((int)arg1);
+        parent->sys_sigreturn(current_thread, (void*)arg1);
         PANIC("sys_sigreturn returned.");
     }
     case SC_MOUNT:
         return (uint64_t)(sys_mount(current_thread, (const char*)arg1, (const char*)arg2, (const char*)arg3));
     case SC_UNMOUNT:
-        return (uint64_t)(sys_unmount(current_thread, (const char*)arg1));
+        return (uint64_t)WithUserPath((const char*)arg1, [&](const char* path) { return sys_unmount(current_thread, path); });
     case SC_CREATE_SEMAPHORE:
         return (uint64_t)(sys_createSemaphore((int)arg1));
     case SC_DESTROY_SEMAPHORE:
@@ -162,12 +161,43 @@ extern "C" uint64_t SystemCallHandler(uint64_t num, uint64_t arg1, uint64_t arg2
         return (uint64_t)(sys_acquireMutex((int)arg1));
     case SC_RELEASE_MUTEX:
         return (uint64_t)(sys_releaseMutex((int)arg1));
+    case SC_THREAD_CREATE:
+        return (uint64_t)(sys_thread_create(current_thread, (void (*)(void*))arg1, (void*)arg2, arg3));
+    case SC_THREAD_EXIT:
+        sys_thread_exit(current_thread, arg1);
+        return 0;
+    case SC_THREAD_JOIN:
+        return (uint64_t)(sys_thread_join(current_thread, (tid_t)arg1, (uint64_t*)arg2));
+    case SC_SET_TLS:
+        return (uint64_t)(sys_set_tls(current_thread, arg1));
+    case SC_SET_AFFINITY:
+        return (uint64_t)(sys_set_affinity(current_thread, (tid_t)arg1, (const cpu_set_t*)arg2, arg3));
+    case SC_GET_AFFINITY:
+        return (uint64_t)(sys_get_affinity(current_thread, (tid_t)arg1, (cpu_set_t*)arg2, arg3));
     default:
         dbgprintf("Unknown system call. number = %lu, arg1 = %lx, arg2 = %lx, arg3 = %lx.\n", num, arg1, arg2, arg3);
         return -1;
     }
 }
 
+extern "C" uint64_t SystemCallHandler(uint64_t num, uint64_t arg1, uint64_t arg2, uint64_t arg3, CPU_Registers* regs) {
+#ifdef __x86_64__
+    x86_64_DisableInterrupts();
+#endif
+    Scheduling::Thread* current_thread = Scheduling::Scheduler::GetCurrent();
+    fast_memcpy(current_thread->GetCPURegisters(), regs, sizeof(CPU_Registers)); // save the registers
+#ifdef __x86_64__
+    x86_64_EnableInterrupts();
+#endif
+    if (!Trace_IsEnabled())
+        return SystemCallDispatch(current_thread, num, arg1, arg2, arg3);
+    uint64_t start = GetMonotonicTime();
+    Trace_Record(TRACE_SYSCALL_ENTER, num, arg1);
+    uint64_t rc = SystemCallDispatch(current_thread, num, arg1, arg2, arg3);
+    Trace_Record(TRACE_SYSCALL_EXIT, num, GetMonotonicTime() - start);
+    return rc;
+}
+
 void SystemCallInit() {
     
 }
@@ -22,56 +22,87 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <errno.h>
 #include <string.h>
 
+#include <Memory/UserAccess.hpp>
+
 #include <ProgramLoader/ELF.hpp>
 
 #include <fs/VFS.hpp>
 #include <fs/FileStream.hpp>
 #include <fs/FilePrivilegeLevel.hpp>
 
-int sys_exec(Scheduling::Process* parent, const char *path, char *const argv[], char *const envv[]) {
-    if (parent == nullptr || !parent->ValidateStringRead(path) || !parent->ValidateRead(argv, sizeof(char*)) || !parent->ValidateRead(envv, sizeof(char*)))
-        return -EFAULT;
+static void FreeStringArray(char** array, int count) {
+    for (int i = 0; i < count; i++)
+        delete[] array[i];
+    delete[] array;
+}
 
-    int argc;
-    for (argc = 0; argv[argc] != nullptr; argc++) {
-        if (!parent->ValidateStringRead(argv[argc]))
-            return -EFAULT;
-        if (!parent->ValidateRead(&(argv[argc + 1]), sizeof(char*)))
+// Copy a NULL terminated array of user strings into the kernel. On success, *array must be freed with FreeStringArray.
+static int CopyStringArrayFromUser(char* const* user_array, char*** array, int* count) {
+    int i_count = 0;
+    while (true) {
+        char* entry = nullptr;
+        if (copy_from_user(&entry, &(user_array[i_count]), sizeof(char*)) != ESUCCESS)
             return -EFAULT;
+        if (entry == nullptr)
+            break;
+        i_count++;
     }
 
-    int envc;
-    for (envc = 0; envv[envc] != nullptr; envc++) {
-        if (!parent->ValidateStringRead(envv[envc]))
-            return -EFAULT;
-        if (!parent->ValidateRead(&(envv[envc + 1]), sizeof(char*)))
-            return -EFAULT;
+    char** i_array = new char*[i_count + 1];
+    char* scratch = new char[USER_PATH_MAX];
+    for (int i = 0; i < i_count; i++) {
+        char* entry = nullptr;
+        long length = -EFAULT;
+        if (copy_from_user(&entry, &(user_array[i]), sizeof(char*)) == ESUCCESS && entry != nullptr)
+            length = strncpy_from_user(scratch, entry, USER_PATH_MAX);
+        if (length < 0) {
+            delete[] scratch;
+            FreeStringArray(i_array, i);
+            return length == -ENAMETOOLONG ? -E2BIG : (int)length;
+        }
+        i_array[i] = new char[length + 1];
+        memcpy(i_array[i], scratch, length + 1);
     }
+    i_array[i_count] = nullptr;
+    delete[] scratch;
 
-    // Copy argv and envv to the kernel
-    char** argv_k = new char*[argc + 1];
-    char** envv_k = new char*[envc + 1];
-    for (int i = 0; i < argc; i++) {
-        argv_k[i] = new char[strlen(argv[i]) + 1];
-        strcpy(argv_k[i], argv[i]);
-    }
-    argv_k[argc] = nullptr;
-    for (int i = 0; i < envc; i++) {
-        envv_k[i] = new char[strlen(envv[i]) + 1];
-        strcpy(envv_k[i], envv[i]);
+    *array = i_array;
+    *count = i_count;
+    return ESUCCESS;
+}
+
+int sys_exec(Scheduling::Process* parent, const char *path, char *const argv[], char *const envv[]) {
+    if (parent == nullptr)
+        return -EFAULT;
+
+    // Copy path, argv and envv to the kernel
+    int status = 0;
+    char* path_k = strndup_from_user(path, USER_PATH_MAX, &status);
+    if (path_k == nullptr)
+        return status;
+
+    int argc = 0;
+    char** argv_k = nullptr;
+    status = CopyStringArrayFromUser(argv, &argv_k, &argc);
+    if (status != ESUCCESS) {
+        delete[] path_k;
+        return status;
     }
-    envv_k[envc] = nullptr;
 
-    int rc = Execute(parent, path, argc, argv_k, envc, envv_k);
-    
-    for (int i = 0; i < argc; i++)
-        delete[] argv_k[i];
+    int envc = 0;
+    char** envv_k = nullptr;
+    status = CopyStringArrayFromUser(envv, &envv_k, &envc);
+    if (status != ESUCCESS) {
+        FreeStringArray(argv_k, argc);
+        delete[] path_k;
+        return status;
+    }
 
-    for (int i = 0; i < envc; i++)
-        delete[] envv_k[i];
+    int rc = Execute(parent, path_k, argc, argv_k, envc, envv_k);
 
-    delete[] argv_k;
-    delete[] envv_k;
+    FreeStringArray(argv_k, argc);
+    FreeStringArray(envv_k, envc);
+    delete[] path_k;
 
     return rc;
 }
@@ -114,16 +145,21 @@ int Execute(Scheduling::Process* parent, const char *path, int argc, char *const
         return -ENOEXEC;
     }
 
-    uint8_t* buffer = new uint8_t[size];
+    uint8_t* buffer = nullptr;
+    ELF_Executable* exe;
 
-    assert((int64_t)size == stream->ReadStream(buffer, size)); // This should NEVER fail under these conditions.
+    if (inode->GetBackingPage(0) != nullptr) // the file is already in memory, so the loader can map it directly
+        exe = new ELF_Executable(inode, size);
+    else {
+        buffer = new uint8_t[size];
+        assert((int64_t)size == stream->ReadStream(buffer, size)); // This should NEVER fail under these conditions.
+        exe = new ELF_Executable(buffer, size);
+    }
 
     stream->Close();
 
     g_VFS->CloseStream(stream);
 
-
-    ELF_Executable* exe = new ELF_Executable(buffer, size);
     ELF_entry_data entry_data = {argc, (char**)argv, envc, (char**)envv};
     if (!exe->Load(&entry_data)) {
         ELFError error = exe->GetLastError();
@@ -43,16 +43,16 @@ void do_exit(Scheduling::Thread* thread, int status, bool was_scheduler_running)
     bool is_main_thread = parent->GetMainThread() == thread;
     parent->RemoveThread(thread);
     if (is_main_thread) {
-        for (uint64_t i = 0; i < parent->GetThreadCount(); i++) {
+        while (parent->GetThreadCount() > 0) {
             Thread* i_thread = parent->GetThread(0);
             if (i_thread == nullptr)
                 break; // should never happen
             Scheduler::RemoveThread(i_thread);
             if (i_thread->GetFlags() & CREATE_STACK)
                 parent->GetPageManager()->FreePages((void*)(i_thread->GetStack() - KiB(64)));
-            cleanup = i_thread->GetCleanupFunction();
-            if (cleanup.function != nullptr)
-                cleanup.function(cleanup.data);
+            ThreadCleanup_t i_cleanup = i_thread->GetCleanupFunction(); // cleanup still holds the main thread's handler
+            if (i_cleanup.function != nullptr)
+                i_cleanup.function(i_cleanup.data);
             parent->RemoveThread(i_thread);
             delete i_thread;
         }
@@ -90,6 +90,7 @@ int sys_mprotect(void* addr, unsigned long size, unsigned long perms) {
         i_perms = PagePermissions::READ_EXECUTE;
     else
         return -EINVAL; // read, write, execute and write, execute are unsupported
-    process->GetPageManager()->Remap(addr, i_perms);
+    if (!(process->GetPageManager()->Remap(addr, i_perms)))
+        return -EACCES; // shared with the kernel or other processes, such as the sysinfo pages
     return 0;
 }
@@ -20,6 +20,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <errno.h>
 #include <string.h>
 
+#include <Memory/UserAccess.hpp>
+
 #include <Scheduling/Process.hpp>
 
 int Mount(const char* source, const char* target, FileSystemType type, FilePrivilegeLevel current_privilege) {
@@ -37,23 +39,34 @@ int Unmount(const char* target, FilePrivilegeLevel current_privilege) {
 
 int sys_mount(Scheduling::Thread* thread, const char* target, const char* type, const char* device) {
     Scheduling::Process* process = thread->GetParent();
-    if (process == nullptr || !process->ValidateStringRead(target) || !process->ValidateStringRead(type) || !process->ValidateStringRead(device))
+    if (process == nullptr)
         return -EFAULT;
 
+    char fsTypeName[16];
+    long length = strncpy_from_user(fsTypeName, type, sizeof(fsTypeName));
+    if (length == -ENAMETOOLONG)
+        return -ENOSYS; // longer than any type we know
+    if (length < 0)
+        return (int)length;
+
     FileSystemType fsType;
 
-    if (strcmp(type, "tempfs") == 0 || strcmp(type, "tmpfs") == 0)
+    if (strcmp(fsTypeName, "tempfs") == 0 || strcmp(fsTypeName, "tmpfs") == 0)
         fsType = FileSystemType::TMPFS;
     else
         return -ENOSYS;
 
-    return Mount(device, target, fsType, {process->GetEUID(), process->GetEGID(), 0});
+    return (int)WithUserPath(target, [&](const char* k_target) {
+        return WithUserPath(device, [&](const char* k_device) {
+            return Mount(k_device, k_target, fsType, {process->GetEUID(), process->GetEGID(), 0});
+        });
+    });
 }
 
 int sys_unmount(Scheduling::Thread* thread, const char* target) {
     Scheduling::Process* process = thread->GetParent();
-    if (process == nullptr || !process->ValidateStringRead(target))
+    if (process == nullptr)
         return -EFAULT;
 
     return Unmount(target, {process->GetEUID(), process->GetEGID(), 0});
-}
\ No newline at end of file
+}
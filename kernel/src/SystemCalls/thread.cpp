@@ -0,0 +1,133 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "thread.hpp"
+#include "exit.hpp"
+
+#include <errno.h>
+
+#include <Memory/UserAccess.hpp>
+
+#include <Scheduling/Scheduler.hpp>
+#include <Scheduling/WaitQueue.hpp>
+
+#ifdef __x86_64__
+#include <arch/x86_64/io.h>
+#include <arch/x86_64/Processor.hpp>
+#endif
+
+#define USER_ADDRESS_END 0x800000000000 // the FS base must stay canonical, and user pointers stay in the lower half
+
+tid_t sys_thread_create(Scheduling::Thread* current, void (*entry)(void*), void* arg, uint64_t tls) {
+    using namespace Scheduling;
+    Process* parent = current->GetParent();
+    if (parent == nullptr)
+        return -EFAULT;
+    if (!parent->ValidateRead((const void*)entry, 1))
+        return -EFAULT;
+    if (tls >= USER_ADDRESS_END)
+        return -EINVAL;
+
+    Thread* thread = new Thread(parent, entry, arg, THREAD_USER_DEFAULT);
+    thread->SetFSBase(tls);
+    if (current->GetWorkingDirectory() != nullptr)
+        thread->SetWorkingDirectory(new VFS_WorkingDirectory(*current->GetWorkingDirectory()));
+    return parent->ScheduleThread(thread);
+}
+
+void sys_thread_exit(Scheduling::Thread* current, uint64_t value) {
+    Scheduling::Process* parent = current->GetParent();
+    if (parent == nullptr || parent->IsMainThread(current))
+        sys_exit(current, (int)value);
+    // Recorded before the thread goes away, so a joiner never sees neither the thread nor its exit value.
+    parent->AddExitedThread(current->GetTID(), value);
+    sys_exit(current, 0);
+}
+
+int sys_thread_join(Scheduling::Thread* current, tid_t TID, uint64_t* value) {
+    using namespace Scheduling;
+    Process* parent = current->GetParent();
+    if (parent == nullptr)
+        return -EFAULT;
+    if (TID == current->GetTID())
+        return -EDEADLK;
+
+    WaitQueue* queue = parent->GetThreadExitQueue();
+    uint64_t result = 0;
+    while (true) {
+        uint64_t sequence = queue->GetSequence();
+        bool running = parent->HasThread(TID); // checked first, as the exit value is recorded before the thread is removed
+        if (parent->TakeExitedThread(TID, &result))
+            break;
+        if (!running)
+            return -ESRCH;
+        queue->Wait(current, sequence);
+    }
+    if (value != nullptr)
+        return copy_to_user(value, &result, sizeof(uint64_t));
+    return ESUCCESS;
+}
+
+int sys_set_tls(Scheduling::Thread* current, uint64_t base) {
+    if (base >= USER_ADDRESS_END)
+        return -EINVAL;
+    current->SetFSBase(base);
+#ifdef __x86_64__
+    // Load it now, later switches back to this thread will load it again
+    x86_64_DisableInterrupts();
+    Scheduling::Scheduler::SetThreadFrame(GetCurrentProcessorInfo(), current->GetStackRegisterFrame());
+    x86_64_EnableInterrupts();
+#endif
+    return ESUCCESS;
+}
+
+static Scheduling::Thread* GetTargetThread(Scheduling::Thread* current, tid_t TID) {
+    if (TID == -1)
+        return current;
+    Scheduling::Process* parent = current->GetParent();
+    if (parent == nullptr)
+        return nullptr;
+    return parent->FindThread(TID);
+}
+
+int sys_set_affinity(Scheduling::Thread* current, tid_t TID, const cpu_set_t* set, size_t size) {
+    Scheduling::Process* parent = current->GetParent();
+    if (parent == nullptr)
+        return -EFAULT;
+    if (size != sizeof(cpu_set_t))
+        return -EINVAL;
+    cpu_set_t affinity;
+    if (copy_from_user(&affinity, set, size) != ESUCCESS)
+        return -EFAULT;
+    Scheduling::Thread* thread = GetTargetThread(current, TID);
+    if (thread == nullptr)
+        return -ESRCH;
+    return Scheduling::Scheduler::SetThreadAffinity(thread, &affinity);
+}
+
+int sys_get_affinity(Scheduling::Thread* current, tid_t TID, cpu_set_t* set, size_t size) {
+    Scheduling::Process* parent = current->GetParent();
+    if (parent == nullptr)
+        return -EFAULT;
+    if (size != sizeof(cpu_set_t))
+        return -EINVAL;
+    Scheduling::Thread* thread = GetTargetThread(current, TID);
+    if (thread == nullptr)
+        return -ESRCH;
+    return copy_to_user(set, thread->GetAffinity(), size);
+}
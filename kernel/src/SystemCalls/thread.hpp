@@ -0,0 +1,39 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _SYS_THREAD_HPP
+#define _SYS_THREAD_HPP
+
+#include <Scheduling/Thread.hpp>
+
+// New threads get their own 64KiB user stack and start at entry with arg in the first argument register. tls becomes their FS base.
+tid_t sys_thread_create(Scheduling::Thread* current, void (*entry)(void*), void* arg, uint64_t tls);
+
+// Exiting the main thread ends the whole process, with value as the exit status.
+void sys_thread_exit(Scheduling::Thread* current, uint64_t value);
+
+// Blocks until the thread exits. Each thread can only be joined once.
+int sys_thread_join(Scheduling::Thread* current, tid_t TID, uint64_t* value);
+
+int sys_set_tls(Scheduling::Thread* current, uint64_t base);
+
+// TID -1 is the calling thread. Only threads in the caller's process can be changed. size must be sizeof(cpu_set_t).
+int sys_set_affinity(Scheduling::Thread* current, tid_t TID, const cpu_set_t* set, size_t size);
+int sys_get_affinity(Scheduling::Thread* current, tid_t TID, cpu_set_t* set, size_t size);
+
+#endif /* _SYS_THREAD_HPP */
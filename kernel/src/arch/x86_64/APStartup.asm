@@ -29,7 +29,6 @@ align 32
     mov eax, cr0
     or eax, 1 ; PE
     mov cr0, eax
-    mov esp, 0xFD0 ; starts 48 bytes from end of page, grows down
     jmp 0x08:dword 0x0080
 align 64
 [bits 32]
@@ -62,6 +61,13 @@ align 64
     mov fs, ax
     mov gs, ax
     mov ss, ax
+    ; Every AP runs this page at the same time, so nothing can be shared until each one has its own stack.
+    mov eax, 1
+    lock xadd QWORD [0xFE0], rax ; claim the next stack slot
+    cmp rax, QWORD [0xFD8] ; number of slots. An AP we didn't ask for, or one that got a second SIPI, may run out
+    jae 0x0200
+    mov rcx, QWORD [0xFE8] ; table of stack tops
+    mov rsp, QWORD [rcx+rax*8]
     mov rax, x86_64_EnsureNX
     push rax
     call near QWORD [rsp]
@@ -72,16 +78,8 @@ align 64
     pop rcx
     test rax, rax
     jz 0x0200
-    lock inc QWORD [aps_running]
-.spin:
-    mov eax, dword [0xFF8] ; start lock
-    test eax, eax
-    jnz .spin ; should be a relative jump
     mov rax, QWORD [0xFF0]
-    mov rdi, QWORD [0xFE8]
-    mov rsp, QWORD [0xFE0]
-    mov rcx, QWORD [0xFD8]
-    mov QWORD [rdi+rcx], rsp
+    mov rdi, rsp ; the entry point gets the top of its stack
     xor rsi, rsi
     xor rdx, rdx
     xor rcx, rcx
@@ -104,5 +102,3 @@ align 4096
 
 extern x86_64_EnsureNX
 extern x86_64_EnsureLargePages
-
-extern aps_running
@@ -0,0 +1,75 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "CPUTopology.hpp"
+#include "cpuid.hpp"
+
+#define CPUID_TOPOLOGY_LEVEL_SMT 1
+#define CPUID_TOPOLOGY_LEVEL_CORE 2
+
+// Number of bits needed to give count items distinct IDs
+static uint8_t GetIDWidth(uint32_t count) {
+    uint8_t width = 0;
+    while ((1UL << width) < count)
+        width++;
+    return width;
+}
+
+void x86_64_GetCPUTopology(x86_64_CPUTopology* topology) {
+    uint32_t max_leaf = x86_64_cpuid({0, 0, 0, 0}).eax;
+    uint8_t SMT_shift = 0;
+    uint8_t package_shift = 0;
+
+    if (max_leaf >= 0xB && x86_64_cpuid({0xB, 0, 0, 0}).ebx != 0) {
+        x86_64_cpuid_regs regs = x86_64_cpuid({0xB, 0, 0, 0});
+        topology->APIC_ID = regs.edx; // full x2APIC ID
+        for (uint32_t level = 0; level < 8; level++) {
+            regs = x86_64_cpuid({0xB, 0, level, 0});
+            uint8_t type = (regs.ecx >> 8) & 0xFF;
+            if (type == 0)
+                break;
+            uint8_t shift = regs.eax & 0x1F;
+            if (type == CPUID_TOPOLOGY_LEVEL_SMT)
+                SMT_shift = shift;
+            if (shift > package_shift)
+                package_shift = shift;
+        }
+    }
+    else {
+        x86_64_cpuid_regs regs = x86_64_cpuid({1, 0, 0, 0});
+        topology->APIC_ID = (regs.ebx >> 24) & 0xFF;
+        uint32_t logical_count = 1;
+        if (regs.edx & (1 << 28)) // HTT, the logical processor count is valid
+            logical_count = (regs.ebx >> 16) & 0xFF;
+        uint32_t core_count = 1;
+        uint32_t vendor_ebx = x86_64_cpuid({0, 0, 0, 0}).ebx;
+        if (vendor_ebx == 0x68747541 /* "Auth" */) {
+            if (x86_64_cpuid({0x80000000, 0, 0, 0}).eax >= 0x80000008)
+                core_count = (x86_64_cpuid({0x80000008, 0, 0, 0}).ecx & 0xFF) + 1;
+        }
+        else if (max_leaf >= 4)
+            core_count = ((x86_64_cpuid({4, 0, 0, 0}).eax >> 26) & 0x3F) + 1;
+        if (core_count > logical_count)
+            core_count = logical_count;
+        SMT_shift = GetIDWidth(logical_count / core_count);
+        package_shift = GetIDWidth(logical_count);
+    }
+
+    topology->core_ID = topology->APIC_ID >> SMT_shift;
+    topology->package_ID = topology->APIC_ID >> package_shift;
+}
@@ -0,0 +1,34 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _X86_64_CPU_TOPOLOGY_HPP
+#define _X86_64_CPU_TOPOLOGY_HPP
+
+#include <stdint.h>
+
+// The core and package IDs are the APIC ID with the lower levels shifted out, so they are unique system-wide.
+struct x86_64_CPUTopology {
+    uint32_t APIC_ID;
+    uint32_t core_ID;
+    uint32_t package_ID;
+};
+
+// Describes the processor this runs on, using cpuid leaf 0xB if available, otherwise leaves 1 and 4 (or 0x80000008 on AMD).
+void x86_64_GetCPUTopology(x86_64_CPUTopology* topology);
+
+#endif /* _X86_64_CPU_TOPOLOGY_HPP */
@@ -22,10 +22,12 @@ x86_64_LoadGDT:
     mov ax, 0x10 ; set the new data segment
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
     mov ss, ax
 
+    xor ax, ax ; fs stays null for good, user TLS lives in the fs base MSR and reloading the selector would clear it
+    mov fs, ax
+
     pop rcx ; save return address
 
     mov rax, 0x08 ; prepare new code segment
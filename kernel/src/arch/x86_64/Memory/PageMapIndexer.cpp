@@ -93,9 +93,11 @@ void __attribute__((no_sanitize("undefined"))) x86_64_map_page_noflush(Level4Gro
     const uint16_t PDP_i   = (uint16_t)((virtual_addr & 0x007FC0000000) >> 30);
     const uint16_t PML4_i  = (uint16_t)((virtual_addr & 0xFF8000000000) >> 39);
 
+    const uint32_t table_flags = flags & ~X86_64_PAGE_CACHE_FLAGS;
+
     PageMapLevel4Entry PML4 = PML4Array->entries[PML4_i];
     if (PML4.Present == 0) {
-        uint64_t temp = ((uint64_t)((flags & 0x0FFF) | ((uint64_t)(flags & 0x07FF0000) << 36)));
+        uint64_t temp = ((uint64_t)((table_flags & 0x0FFF) | ((uint64_t)(table_flags & 0x07FF0000) << 36)));
         PML4 = *(PageMapLevel4Entry*)(&temp);
         PML4.Present = 1;
         PML4.Address = (uint64_t)g_PPFA->AllocatePage() >> 12;
@@ -104,14 +106,14 @@ void __attribute__((no_sanitize("undefined"))) x86_64_map_page_noflush(Level4Gro
     }
     else {
         uint64_t temp = *(uint64_t*)(&PML4);
-        temp |= flags & 0xFFF;
-        temp |= (uint64_t)(flags & 0x7FF0000) << 36;
+        temp |= table_flags & 0xFFF;
+        temp |= (uint64_t)(table_flags & 0x7FF0000) << 36;
         PML4Array->entries[PML4_i] = *(PageMapLevel4Entry*)&temp;
     }
 
     PageMapLevel3Entry PML3 = ((PageMapLevel3Entry*)x86_64_to_HHDM((void*)((uint64_t)(PML4.Address) << 12)))[PDP_i];
     if (PML3.Present == 0) {
-        uint64_t temp = ((uint64_t)((flags & 0x0FFF) | ((uint64_t)(flags & 0x07FF0000) << 36)));
+        uint64_t temp = ((uint64_t)((table_flags & 0x0FFF) | ((uint64_t)(table_flags & 0x07FF0000) << 36)));
         PML3 = *(PageMapLevel3Entry*)(&temp);
         PML3.Present = 1;
         PML3.Address = (uint64_t)g_PPFA->AllocatePage() >> 12;
@@ -120,14 +122,14 @@ void __attribute__((no_sanitize("undefined"))) x86_64_map_page_noflush(Level4Gro
     }
     else {
         uint64_t temp = *(uint64_t*)(&PML3);
-        temp |= flags & 0xFFF;
-        temp |= (uint64_t)(flags & 0x7FF0000) << 36;
+        temp |= table_flags & 0xFFF;
+        temp |= (uint64_t)(table_flags & 0x7FF0000) << 36;
         ((PageMapLevel3Entry*)x86_64_to_HHDM((void*)((uint64_t)(PML4.Address) << 12)))[PDP_i] = *(PageMapLevel3Entry*)&temp;
     }
 
     PageMapLevel2Entry PML2 = ((PageMapLevel2Entry*)x86_64_to_HHDM((void*)((uint64_t)(PML3.Address) << 12)))[PD_i];
     if (PML2.Present == 0) {
-        uint64_t temp = ((uint64_t)((flags & 0x0FFF) | ((uint64_t)(flags & 0x07FF0000) << 36)));
+        uint64_t temp = ((uint64_t)((table_flags & 0x0FFF) | ((uint64_t)(table_flags & 0x07FF0000) << 36)));
         PML2 = *(PageMapLevel2Entry*)(&temp);
         PML2.Present = 1;
         PML2.Address = (uint64_t)g_PPFA->AllocatePage() >> 12;
@@ -136,8 +138,8 @@ void __attribute__((no_sanitize("undefined"))) x86_64_map_page_noflush(Level4Gro
     }
     else {
         uint64_t temp = *(uint64_t*)(&PML2);
-        temp |= flags & 0xFFF;
-        temp |= (uint64_t)(flags & 0x7FF0000) << 36;
+        temp |= table_flags & 0xFFF;
+        temp |= (uint64_t)(table_flags & 0x7FF0000) << 36;
        ((PageMapLevel2Entry*)x86_64_to_HHDM((void*)((uint64_t)(PML3.Address) << 12)))[PD_i] = *(PageMapLevel2Entry*)&temp;
     }
     if (PML2.PageSize)
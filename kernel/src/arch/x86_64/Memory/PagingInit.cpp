@@ -74,9 +74,18 @@ void x86_64_InitPaging(MemoryMapEntry** MemoryMap, uint64_t MMEntryCount, uint64
         x86_64_map_page_noflush(&K_PML4_Array, (void*)i, (void*)(i + HHDM_start), 0x8000003); // Read/Write, Present, Execute Disable
     
     
+    uint64_t fb_phys = fb_virt - HHDM_start;
+
     // Map from 2MiB to 4GiB with 2MiB pages
-    for (uint64_t i = 0x200000; i < 0x100000000; i += 0x200000)
-        x86_64_map_large_page_noflush(&K_PML4_Array, (void*)i, (void*)(i + HHDM_start), 0x8000003); // Read/Write, Present, Execute Disable
+    for (uint64_t i = 0x200000; i < 0x100000000; i += 0x200000) {
+        if (i < (fb_phys + fb_size) && fb_phys < (i + 0x200000)) {
+            // Shares a 2MiB page with the framebuffer, so split it up to let the framebuffer have its own memory type
+            for (uint64_t j = i; j < (i + 0x200000); j += 0x1000)
+                x86_64_map_page_noflush(&K_PML4_Array, (void*)j, (void*)(j + HHDM_start), 0x8000003); // Read/Write, Present, Execute Disable
+        }
+        else
+            x86_64_map_large_page_noflush(&K_PML4_Array, (void*)i, (void*)(i + HHDM_start), 0x8000003); // Read/Write, Present, Execute Disable
+    }
 
     for (uint64_t i = 0; i < MMEntryCount; i++) {
         MemoryMapEntry* entry = MemoryMap[i];
@@ -93,10 +102,8 @@ void x86_64_InitPaging(MemoryMapEntry** MemoryMap, uint64_t MMEntryCount, uint64
     fb_size += 4095;
     fb_size >>= 12; // avoid slow division
 
-    uint64_t fb_phys = fb_virt - HHDM_start;
-
     for (uint64_t i = 0; i < fb_size; i++)
-        x86_64_map_page_noflush(&K_PML4_Array, (void*)(fb_phys + i * 4096), (void*)(fb_virt + i * 4096), 0x8000003); // Present, Read/Write, Execute Disable
+        x86_64_map_page_noflush(&K_PML4_Array, (void*)(fb_phys + i * 4096), (void*)(fb_virt + i * 4096), 0x8000003 | X86_64_PAGE_WRITE_COMBINING); // Present, Read/Write, Execute Disable, Write-combining
 
     fb_size <<= 12; // convert back for later use
     
@@ -114,3 +114,24 @@ x86_64_EnsureLargePages:
     mov rsp, rbp
     pop rbp
     ret
+
+global x86_64_InitPAT
+x86_64_InitPAT:
+    push rbx
+    mov eax, 1
+    xor ecx, ecx
+    cpuid
+    pop rbx
+    bt edx, 16 ; PAT
+    jnc .fail
+
+    mov rcx, 0x277 ; IA32_PAT MSR
+    mov eax, 0x00070106 ; PA0 = WB, PA1 = WC, PA2 = UC-, PA3 = UC
+    mov edx, 0x00070406 ; PA4 = WB, PA5 = WT, PA6 = UC-, PA7 = UC
+    wrmsr
+
+    mov rax, 1
+    ret
+.fail:
+    xor rax, rax
+    ret
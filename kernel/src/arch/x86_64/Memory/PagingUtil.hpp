@@ -23,6 +23,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 // the threshold for when to flush the entire TLB instead of invalidating individual pages
 #define FULL_FLUSH_THRESHOLD 0x100000
 
+// Page flag selecting PAT entry 1, which x86_64_InitPAT sets to write-combining. Without PAT it is write-through.
+#define X86_64_PAGE_WRITE_COMBINING 0x8
+
+// Caching flags only mean something in the last level entry, so they are never copied into the page table entries above it
+#define X86_64_PAGE_CACHE_FLAGS 0x18
+
 // Defined in NASM Source file
 
 extern "C" void x86_64_FlushTLB();
@@ -35,6 +41,9 @@ extern "C" void x86_64_InvalidatePage(uint64_t address);
 extern "C" bool x86_64_EnsureNX();
 extern "C" bool x86_64_EnsureLargePages();
 
+// Must be run on every CPU. Returns false if PAT is unsupported.
+extern "C" bool x86_64_InitPAT();
+
 // Defined in C++ Source file
 
 void x86_64_InitUserTable(void* PML4);
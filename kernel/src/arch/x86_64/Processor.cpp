@@ -25,6 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "interrupts/NMI.hpp"
 
 #include "Memory/PagingInit.hpp"
+#include "Memory/PagingUtil.hpp"
 
 #include <assert.h>
 
@@ -41,6 +42,8 @@ Processor::~Processor() {
 }
 
 void Processor::Init(MemoryMapEntry** MemoryMap, uint64_t MMEntryCount, uint64_t kernel_virtual, uint64_t kernel_physical, uint64_t kernel_size, uint64_t HHDM_start, const FrameBuffer& fb) {
+    // Every CPU needs the same PAT before the framebuffer's write-combining mapping is used
+    x86_64_InitPAT();
     {
         x86_64_GDTInit(&(m_GDT[0]));
         x86_64_GDT_SetTSS(&(m_GDT[0]), &m_TSS);
@@ -57,9 +60,10 @@ void Processor::Init(MemoryMapEntry** MemoryMap, uint64_t MMEntryCount, uint64_t
         m_kernel_stack_size = kernel_stack_size;
         x86_64_InitPaging(MemoryMap, MMEntryCount, kernel_virtual, kernel_physical, kernel_size, (uint64_t)(fb.FrameBufferAddress), ((fb.bpp >> 3) * fb.FrameBufferHeight * fb.FrameBufferWidth), HHDM_start);
         x86_64_NMIInit();
+        x86_64_IPI_Init();
     }
     else
-        m_kernel_stack_size = KERNEL_STACK_SIZE; // m_kernel_stack is set in the APs early startup
+        m_kernel_stack_size = KERNEL_STACK_SIZE; // m_kernel_stack is set by the AP entry point
     x86_64_IDT_Load(&idt.idtr);
 
     m_TSS.RSP[0] = (uint64_t)m_kernel_stack + m_kernel_stack_size;
@@ -77,6 +81,10 @@ void Processor::SetLocalAPIC(x86_64_LocalAPIC* LocalAPIC) {
     m_LocalAPIC = LocalAPIC;
 }
 
+void Processor::SetKernelStack(void* stack) {
+    m_kernel_stack = stack;
+}
+
 x86_64_LocalAPIC* Processor::GetLocalAPIC() const {
     return m_LocalAPIC;
 }
@@ -90,8 +98,15 @@ Scheduling::Scheduler::ProcessorInfo* GetCurrentProcessorInfo() {
     return (Scheduling::Scheduler::ProcessorInfo*)x86_64_get_kernel_gs_base();
 }
 
-uint8_t GetCurrentProcessorID() {
-    x86_64_cpuid_regs regs = x86_64_cpuid({0x1, 0, 0, 0});
+uint32_t GetCurrentProcessorID() {
+    // leaf 0xB reports the full 32-bit x2APIC ID, which is identical to the xAPIC ID below 255
+    x86_64_cpuid_regs regs = x86_64_cpuid({0x0, 0, 0, 0});
+    if (regs.eax >= 0xB) {
+        regs = x86_64_cpuid({0xB, 0, 0, 0});
+        if (regs.ebx != 0)
+            return regs.edx;
+    }
+    regs = x86_64_cpuid({0x1, 0, 0, 0});
     return (regs.ebx >> 24) & 0xFF;
 }
 
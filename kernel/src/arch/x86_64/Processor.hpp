@@ -47,9 +47,7 @@ public:
 
     void InitialiseLocalAPIC();
 
-    static uint64_t get_kernel_stack_offset() {
-        return offsetof(Processor, m_kernel_stack);
-    }
+    void SetKernelStack(void* stack); // only for APs, before Init. stack is the lowest address
 
     void __attribute__((noreturn)) StopThis(); // Stops the current processor
 
@@ -73,6 +71,6 @@ private:
 Processor* GetCurrentProcessor();
 Scheduling::Scheduler::ProcessorInfo* GetCurrentProcessorInfo();
 
-uint8_t GetCurrentProcessorID();
+uint32_t GetCurrentProcessorID();
 
 #endif /* _X86_64_PROCESSOR_HPP */
\ No newline at end of file
@@ -155,7 +155,6 @@ x86_64_HandleSystemCall:
     mov ax, 0x10 ; load segment
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
 
     sti ; safe to enable interrupts
@@ -174,6 +173,12 @@ x86_64_HandleSystemCall:
 
     mov QWORD [rsp], rax ; save rax
 
+    ; If the thread slept, other system calls on this processor have reused the saved user stack slot, and we may be on another processor anyway
+    mov rax, QWORD [rsp+48] ; user stack from the register frame
+    swapgs
+    mov QWORD [gs:16], rax
+    swapgs
+
     add rsp, 8 ; skip restoring rax
     pop rbx
     add rsp, 8 ; don't restore rcx twice
@@ -201,7 +206,6 @@ x86_64_HandleSystemCall:
     mov ax, 0x1b
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
 
     mov rax, QWORD [rsp-160] ; get return value
@@ -76,17 +76,16 @@ x86_64_get_stack_ptr:
     mov rax, rsp
     ret
 
-extern kernel_stack
-extern kernel_stack_size
+extern x86_64_GetExitStack
 
 global x86_64_kernel_thread_end
 x86_64_kernel_thread_end:
     cli
-    pop rax
-    mov rsp, kernel_stack
-    add rsp, [kernel_stack_size]
+    pop rbx ; Scheduler::End, which frees the stack we are on
+    call x86_64_GetExitStack ; each processor has its own, as several threads can end at once
+    mov rsp, rax
     xor rbp, rbp
-    push rax
+    push rbx
     ret
 
 global x86_64_context_switch
@@ -110,8 +109,8 @@ x86_64_context_switch:
     mov ax, WORD [rdi+138]
     mov ds, ax ; load ds
     mov es, ax ; load es
-    mov fs, ax ; load fs
     mov gs, ax ; load gs
+    ; fs is left null so its base, the thread's TLS pointer, is only ever changed by x86_64_set_fs_base
 
     mov rax, QWORD [rdi+148]
     mov cr3, rax ; load CR3
@@ -148,6 +147,15 @@ x86_64_set_kernel_gs_base:
     wrmsr
     ret
 
+global x86_64_set_fs_base
+x86_64_set_fs_base:
+    mov eax, edi
+    shr rdi, 32
+    mov edx, edi
+    mov rcx, 0xc0000100
+    wrmsr
+    ret
+
 global x86_64_get_kernel_gs_base:
 x86_64_get_kernel_gs_base:
     xor rdx, rdx
@@ -162,4 +170,5 @@ global x86_64_idle_loop
 x86_64_idle_loop:
     sti
 .l:
+    hlt ; sleep until the next interrupt, which is at worst the next timer tick or a wakeup IPI
     jmp .l
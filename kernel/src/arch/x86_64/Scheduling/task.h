@@ -66,6 +66,9 @@ void x86_64_set_kernel_gs_base(uint64_t base);
 
 uint64_t x86_64_get_kernel_gs_base();
 
+// base must be canonical
+void x86_64_set_fs_base(uint64_t base);
+
 void __attribute__((noreturn)) x86_64_idle_loop();
 
 #ifdef __cplusplus
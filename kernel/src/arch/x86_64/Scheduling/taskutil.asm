@@ -34,10 +34,15 @@ x86_64_GetReturnAddress:
     mov rax, QWORD [rbp+8]
     ret
 
-extern x86_64_HandleSemaphoreAcquire
+;
+; Save the caller's registers as if it was interrupted straight after the call that got here, then jump to the handler %1
+; with a pointer to them in %2, which must be rdx or rcx. %2 is saved as 0, which the handler's caller sees when it is resumed.
+;
+%macro PREP_HANDLER 2
+extern x86_64_Handle%1
 
-global x86_64_Prep_SemaphoreAcquire
-x86_64_Prep_SemaphoreAcquire:
+global x86_64_Prep_%1
+x86_64_Prep_%1:
     pushf
     cli
     push rax
@@ -68,8 +73,15 @@ x86_64_Prep_SemaphoreAcquire:
     push 0 ; deal with rsp later
     push rdi
     push rsi
+%ifidni %2, rdx
     push 0 ; rdx must be 0 for this to work
     push rcx
+%elifidni %2, rcx
+    push rdx
+    push 0 ; rcx must be 0 for this to work
+%else
+    %error "the registers can only be passed in rdx or rcx"
+%endif
     push rbx
     push QWORD [rbp+8]
 
@@ -80,7 +92,12 @@ x86_64_Prep_SemaphoreAcquire:
     mov QWORD [rsp+48], rax
 
     ; RIP
-    mov QWORD [rsp+128], x86_64_HandleSemaphoreAcquire
+    mov QWORD [rsp+128], x86_64_Handle%1
 
-    mov rdx, rsp
-    jmp x86_64_HandleSemaphoreAcquire
+    mov %2, rsp
+    jmp x86_64_Handle%1
+%endmacro
+
+PREP_HANDLER SemaphoreAcquire, rdx
+PREP_HANDLER ThreadSleep, rdx
+PREP_HANDLER WaitQueueWait, rcx
@@ -17,13 +17,18 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "taskutil.hpp"
 
+#include "../Processor.hpp"
 #include "../interrupts/isr.hpp"
 #include "Scheduling/Semaphore.hpp"
+#include "Scheduling/Scheduler.hpp"
+#include "Scheduling/WaitQueue.hpp"
 
 #include <util.h>
 #include <assert.h>
 #include <stdlib.h>
 
+#include <Memory/PageTable.hpp>
+
 void x86_64_PrepareNewRegisters(x86_64_Interrupt_Registers* out, const x86_64_Registers* in) {
     out->RAX = in->RAX;
     out->RBX = in->RBX;
@@ -73,6 +78,10 @@ void x86_64_ConvertToStandardRegisters(x86_64_Registers* out, const x86_64_Inter
     out->DS = in->ds;
 }
 
+extern "C" uint64_t x86_64_GetExitStack() {
+    return GetCurrentProcessorInfo()->exit_stack;
+}
+
 void x86_64_GetNewStack(PageManager* pm, x86_64_Registers* regs, size_t size) {
     size = ALIGN_UP(size, 4096);
     if (size < KiB(16))
@@ -107,34 +116,32 @@ void x86_64_SaveIRegistersToThread(const Scheduling::Thread* thread, const x86_6
     out->DS = in->ds;
 }
 
-void* x86_64_GetSignalReturnInstructions(size_t* size, int signum) {
-    /* 
-    These are the instructions that get generated:
-    ```
-    mov rax, SC_SIGRETURN(29) (MOV r/m64, imm32) (REX.W + C7 /0 id)
-    mov edi, signum (MOV r32, imm32) (B8 + rd id)
-    syscall
-    ```
-    We need to allocate a buffer big enough to hold these instructions.
-    */
-    uint8_t* buf = (uint8_t*)kmalloc(14);
-    assert(buf != nullptr);
-    buf[0] = 0x48;
-    buf[1] = 0xC7;
-    buf[2] = 0xC0;
-    buf[3] = 0x1D;
-    buf[4] = 0x00;
-    buf[5] = 0x00;
-    buf[6] = 0x00;
-    buf[7] = 0xBF;
-    buf[8] = signum & 0xFF;
-    buf[9] = (signum >> 8) & 0xFF;
-    buf[10] = (signum >> 16) & 0xFF;
-    buf[11] = (signum >> 24) & 0xFF;
-    buf[12] = 0x0F;
-    buf[13] = 0x05;
-    *size = 14;
-    return buf;
+/*
+Shared by every process, so it cannot contain anything process or signal specific. The handler has already returned, so RSP is 8 bytes
+past the start of the frame.
+```
+lea rdi, [rsp - 8]
+mov eax, SC_SIGRETURN(29)
+syscall
+ud2
+```
+*/
+union x86_64_SignalTrampolinePage {
+    uint8_t code[14];
+    uint8_t raw[PAGE_SIZE];
+};
+
+static x86_64_SignalTrampolinePage __attribute__((aligned(0x1000))) g_x86_64_SignalTrampolinePage = {{
+    0x48, 0x8D, 0x7C, 0x24, 0xF8,
+    0xB8, 0x1D, 0x00, 0x00, 0x00,
+    0x0F, 0x05,
+    0x0F, 0x0B
+}};
+
+bool x86_64_MapSignalTrampoline(PageManager* pm) {
+    if (pm == nullptr)
+        return false;
+    return pm->MapPage(g_KPT.GetPhysicalAddress(&g_x86_64_SignalTrampolinePage), PagePermissions::READ_EXECUTE, (void*)X86_64_SIGNAL_TRAMPOLINE_ADDRESS) != nullptr;
 }
 
 extern "C" void x86_64_HandleSemaphoreAcquire(Scheduling::Semaphore* semaphore, Scheduling::Thread* thread, x86_64_Registers* regs) {
@@ -142,4 +149,20 @@ extern "C" void x86_64_HandleSemaphoreAcquire(Scheduling::Semaphore* semaphore,
         memcpy(thread->GetCPURegisters(), regs, sizeof(x86_64_Registers));
         semaphore->acquire(thread);
     }
-}
\ No newline at end of file
+}
+
+extern "C" void x86_64_HandleThreadSleep(Scheduling::Thread* thread, uint64_t ms, x86_64_Registers* regs) {
+    if (regs != nullptr) {
+        memcpy(thread->GetCPURegisters(), regs, sizeof(x86_64_Registers));
+        Scheduling::Scheduler::SleepThread(thread, ms);
+    }
+}
+
+extern "C" void x86_64_HandleWaitQueueWait(Scheduling::WaitQueue* queue, Scheduling::Thread* thread, uint64_t sequence, x86_64_Registers* regs) {
+    if (regs != nullptr) {
+        memcpy(thread->GetCPURegisters(), regs, sizeof(x86_64_Registers));
+        // A wakeup raced with us, so resume straight away. This re-enters here with regs == nullptr and returns to the caller.
+        if (!queue->Block(thread, sequence))
+            x86_64_context_switch(thread->GetCPURegisters());
+    }
+}
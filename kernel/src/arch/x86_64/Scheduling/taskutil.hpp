@@ -28,6 +28,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <Scheduling/Thread.hpp>
 
+namespace Scheduling {
+    class WaitQueue;
+}
+
 void x86_64_PrepareNewRegisters(x86_64_Interrupt_Registers* out, const x86_64_Registers* in);
 void x86_64_ConvertToStandardRegisters(x86_64_Registers* out, const x86_64_Interrupt_Registers* in);
 
@@ -35,10 +39,26 @@ void x86_64_GetNewStack(PageManager* pm, x86_64_Registers* regs, size_t size);
 
 void x86_64_SaveIRegistersToThread(const Scheduling::Thread* thread, const x86_64_Interrupt_Registers* regs);
 
+// Top of the current processor's exit stack, which x86_64_kernel_thread_end switches to.
+extern "C" uint64_t x86_64_GetExitStack();
+
 extern "C" void x86_64_PrepareThreadExit(Scheduling::Thread* thread, int status, bool was_running, void (*func)(Scheduling::Thread*, int, bool));
 
-// We generate the signal return instructions and copy them into a HEAP allocated buffer. The buffer MUST be freed after use. The size is outputted into the size parameter.
-void* x86_64_GetSignalReturnInstructions(size_t* size, int signum);
+// Read-only page holding the sigreturn trampoline. Mapped into every user process by the ELF loader.
+#define X86_64_SIGNAL_TRAMPOLINE_ADDRESS 0x7FFFFFFFD000
+
+// Bytes below a user thread's RSP that leaf functions may use without adjusting RSP, so a signal frame must skip them.
+#define X86_64_RED_ZONE_SIZE 128
+
+// Built on the user stack when a signal is delivered. The handler is entered with RSP pointing at return_address, so returning from it
+// lands in the trampoline, which passes the frame back to sys_sigreturn.
+struct x86_64_SignalFrame {
+    uint64_t return_address;
+    uint64_t signum;
+    x86_64_Registers regs;
+} __attribute__((packed));
+
+bool x86_64_MapSignalTrampoline(PageManager* pm);
 
 extern "C" uint64_t x86_64_GetReturnAddress();
 
@@ -48,5 +68,19 @@ extern "C" void x86_64_HandleSemaphoreAcquire(Scheduling::Semaphore* semaphore,
 
 #define semaphore_acquire(semaphore, thread) x86_64_Prep_SemaphoreAcquire(semaphore, thread)
 
+// Save the current kernel context into thread and park it on the sleep queue. Returns once the thread has been woken.
+extern "C" void x86_64_Prep_ThreadSleep(Scheduling::Thread* thread, uint64_t ms);
+
+extern "C" void x86_64_HandleThreadSleep(Scheduling::Thread* thread, uint64_t ms, x86_64_Registers* regs);
+
+#define thread_sleep(thread, ms) x86_64_Prep_ThreadSleep(thread, ms)
+
+// Save the current kernel context into thread and park it on queue, unless the queue has moved past sequence. Returns once the thread has been woken.
+extern "C" void x86_64_Prep_WaitQueueWait(Scheduling::WaitQueue* queue, Scheduling::Thread* thread, uint64_t sequence);
+
+extern "C" void x86_64_HandleWaitQueueWait(Scheduling::WaitQueue* queue, Scheduling::Thread* thread, uint64_t sequence, x86_64_Registers* regs);
+
+#define wait_queue_wait(queue, thread, sequence) x86_64_Prep_WaitQueueWait(queue, thread, sequence)
+
 
 #endif /* _X86_64_TASK_UTIL_HPP */
\ No newline at end of file
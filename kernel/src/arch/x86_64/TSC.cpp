@@ -0,0 +1,105 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "TSC.hpp"
+#include "cpuid.hpp"
+
+#include <stdio.h>
+
+#include <HAL/drivers/HPET.hpp>
+
+// Calibrate over 50ms of HPET time
+#define TSC_CALIBRATION_FEMTOSECONDS 50'000'000'000'000
+#define TSC_SHIFT 32
+
+__extension__ typedef unsigned __int128 uint128_t; // not part of ISO C++, so -Wpedantic would warn about every use
+
+bool g_TSCAvailable = false;
+uint64_t g_TSCFrequency = 0;
+uint64_t g_TSCBase = 0;
+uint64_t g_TSCBaseNanoseconds = 0;
+uint64_t g_TSCMult = 0;
+
+bool x86_64_TSC_IsInvariant() {
+    x86_64_cpuid_regs regs = x86_64_cpuid({0x1, 0, 0, 0});
+    if (!(regs.edx & (1 << 4))) // TSC
+        return false;
+    regs = x86_64_cpuid({0x80000000, 0, 0, 0});
+    if (regs.eax < 0x80000007)
+        return false;
+    regs = x86_64_cpuid({0x80000007, 0, 0, 0});
+    return regs.edx & (1 << 8); // Invariant TSC
+}
+
+bool x86_64_TSC_Init() {
+    g_TSCAvailable = false;
+    if (!x86_64_TSC_IsInvariant() || g_HPET == nullptr)
+        return false;
+
+    // Wait for the HPET counter to change first so we start on an edge
+    uint64_t start_hpet = g_HPET->GetMainCounter();
+    while (g_HPET->GetMainCounter() == start_hpet)
+        __asm__ volatile("pause" ::: "memory");
+    start_hpet = g_HPET->GetMainCounter();
+    uint64_t start_tsc = x86_64_ReadTSC();
+
+    uint64_t calibration_ticks = TSC_CALIBRATION_FEMTOSECONDS / g_HPET->GetClockPeriod();
+    uint64_t end_hpet;
+    do {
+        __asm__ volatile("pause" ::: "memory");
+        end_hpet = g_HPET->GetMainCounter();
+    } while ((end_hpet - start_hpet) < calibration_ticks);
+    uint64_t end_tsc = x86_64_ReadTSC();
+
+    uint128_t elapsed_fs = (uint128_t)(end_hpet - start_hpet) * g_HPET->GetClockPeriod();
+    g_TSCFrequency = (uint64_t)(((uint128_t)(end_tsc - start_tsc) * 1'000'000'000'000'000) / elapsed_fs);
+    if (g_TSCFrequency == 0)
+        return false;
+    g_TSCMult = (uint64_t)(((uint128_t)1'000'000'000 << TSC_SHIFT) / g_TSCFrequency);
+
+    // Pin the TSC to the HPET time base so both clocks agree
+    g_TSCBase = x86_64_ReadTSC();
+    g_TSCBaseNanoseconds = g_HPET->GetNanoseconds();
+    g_TSCAvailable = true;
+
+    dbgprintf("TSC: invariant, %lu.%.3lu MHz\n", g_TSCFrequency / 1'000'000, (g_TSCFrequency / 1'000) % 1'000);
+    return true;
+}
+
+bool x86_64_TSC_IsAvailable() {
+    return g_TSCAvailable;
+}
+
+uint64_t x86_64_TSC_GetFrequency() {
+    return g_TSCFrequency;
+}
+
+void x86_64_TSC_GetConversion(uint64_t* base_tsc, uint64_t* base_ns, uint64_t* mult, uint8_t* shift) {
+    if (base_tsc != nullptr)
+        *base_tsc = g_TSCBase;
+    if (base_ns != nullptr)
+        *base_ns = g_TSCBaseNanoseconds;
+    if (mult != nullptr)
+        *mult = g_TSCMult;
+    if (shift != nullptr)
+        *shift = TSC_SHIFT;
+}
+
+uint64_t x86_64_TSC_GetNanoseconds() {
+    uint64_t delta = x86_64_ReadTSC() - g_TSCBase;
+    return g_TSCBaseNanoseconds + (uint64_t)(((uint128_t)delta * g_TSCMult) >> TSC_SHIFT);
+}
@@ -0,0 +1,46 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _X86_64_TSC_HPP
+#define _X86_64_TSC_HPP
+
+#include <stdint.h>
+
+static inline uint64_t x86_64_ReadTSC() {
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+// Returns true if the TSC exists and runs at a constant rate in all power states
+bool x86_64_TSC_IsInvariant();
+
+// Calibrate the TSC against the HPET. Must be called after the HPET is initialised. Returns false if the TSC cannot be used as a clocksource.
+bool x86_64_TSC_Init();
+
+bool x86_64_TSC_IsAvailable();
+
+// Frequency in Hz
+uint64_t x86_64_TSC_GetFrequency();
+
+// ns = base_ns + (((tsc - base_tsc) * mult) >> shift)
+void x86_64_TSC_GetConversion(uint64_t* base_tsc, uint64_t* base_ns, uint64_t* mult, uint8_t* shift);
+
+// Nanoseconds in the same time base as HPET::GetNanoseconds
+uint64_t x86_64_TSC_GetNanoseconds();
+
+#endif /* _X86_64_TSC_HPP */
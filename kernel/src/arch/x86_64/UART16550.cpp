@@ -0,0 +1,182 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "UART16550.hpp"
+
+#include "io.h"
+
+#include "interrupts/IRQ.hpp"
+
+#include "interrupts/APIC/IOAPIC.hpp"
+
+#define UART_DATA 0 // THR/RBR, divisor low byte when DLAB is set
+#define UART_IER 1 // divisor high byte when DLAB is set
+#define UART_IIR_FCR 2
+#define UART_LCR 3
+#define UART_MCR 4
+#define UART_LSR 5
+#define UART_SCRATCH 7
+
+#define UART_IER_THRE 0x02
+#define UART_IIR_NO_INTERRUPT 0x01
+#define UART_FCR_ENABLE_CLEAR 0x07 // enable FIFOs and clear both of them
+#define UART_LCR_DLAB 0x80
+#define UART_LCR_8N1 0x03
+#define UART_MCR_DTR_RTS_OUT2 0x0B // OUT2 gates the IRQ line on PC compatibles
+#define UART_LSR_THRE 0x20
+
+#define UART_BASE_CLOCK 115200
+
+x86_64_UART16550* g_DebugUART = nullptr;
+
+x86_64_UART16550* g_UART16550_IRQDevices[16] = {nullptr};
+
+void x86_64_UART16550_IRQHandler(x86_64_Interrupt_Registers* regs) {
+    uint8_t irq = x86_64_IRQ_GetIRQForVector(regs->interrupt); // the I/O APICs' vectors don't have to start at IRQ 0
+    if (irq < 16 && g_UART16550_IRQDevices[irq] != nullptr)
+        g_UART16550_IRQDevices[irq]->HandleInterrupt();
+}
+
+x86_64_UART16550::x86_64_UART16550() : m_port(0), m_irq(0), m_initialised(false), m_polled(false), m_writeLock(0), m_TXLock(0), m_TXBuffer() {
+
+}
+
+bool x86_64_UART16550::Init(uint16_t port, uint8_t irq, uint32_t baud) {
+    if (irq >= 16 || baud == 0 || baud > UART_BASE_CLOCK)
+        return false;
+    if (g_UART16550_IRQDevices[irq] != nullptr)
+        return false; // a shared IRQ would need the handler to poll every UART on it
+    m_port = port;
+    m_irq = irq;
+
+    // a missing UART floats the bus, so the scratch register will not read back
+    x86_64_outb(m_port + UART_SCRATCH, 0xAE);
+    if (x86_64_inb(m_port + UART_SCRATCH) != 0xAE)
+        return false;
+
+    uint16_t divisor = UART_BASE_CLOCK / baud;
+    x86_64_outb(m_port + UART_IER, 0);
+    x86_64_outb(m_port + UART_LCR, UART_LCR_DLAB);
+    x86_64_outb(m_port + UART_DATA, divisor & 0xFF);
+    x86_64_outb(m_port + UART_IER, divisor >> 8);
+    x86_64_outb(m_port + UART_LCR, UART_LCR_8N1);
+    x86_64_outb(m_port + UART_IIR_FCR, UART_FCR_ENABLE_CLEAR);
+    x86_64_outb(m_port + UART_MCR, UART_MCR_DTR_RTS_OUT2);
+
+    // The legacy serial IRQs are reserved in x86_64_IRQ_FullInit, anything else has to still be free
+    if ((m_irq != 3 && m_irq != 4) && x86_64_IRQ_IsIRQReserved(m_irq))
+        return false;
+    x86_64_IRQ_ReserveIRQ(m_irq);
+    g_UART16550_IRQDevices[m_irq] = this;
+    x86_64_IRQ_RegisterHandler(m_irq, x86_64_UART16550_IRQHandler);
+    x86_64_IOAPIC* ioapic = x86_64_IOAPIC_GetIOAPICForIRQ(m_irq);
+    x86_64_IOAPIC_RedirectionEntry entry = ioapic->GetRedirectionEntry(m_irq - ioapic->GetIRQBase());
+    entry.Mask = 0;
+    ioapic->SetRedirectionEntry(m_irq - ioapic->GetIRQBase(), entry);
+
+    x86_64_outb(m_port + UART_IER, UART_IER_THRE);
+
+    m_initialised = true;
+    return true;
+}
+
+size_t x86_64_UART16550::Write(const uint8_t* data, size_t count) {
+    if (!m_initialised)
+        return 0;
+
+    // The IRQ handler can log too, so it must not be able to interrupt us while we hold either lock.
+    bool interrupts_enabled = x86_64_AreInterruptsEnabled();
+    x86_64_DisableInterrupts();
+    spinlock_acquire(&m_writeLock);
+
+    if (m_polled) {
+        for (size_t i = 0; i < count; i++)
+            PutCharPolled(data[i]);
+    }
+    else {
+        bool was_empty = m_TXBuffer.isEmpty();
+        for (size_t i = 0; i < count; i++) {
+            while (!m_TXBuffer.Push(data[i])) {
+                // Ring is full. Wait for the FIFO to empty and refill it ourselves, as the IRQ may not be able to run.
+                while (!IsTransmitterEmpty()) {}
+                spinlock_acquire(&m_TXLock);
+                FillFIFO();
+                spinlock_release(&m_TXLock);
+            }
+        }
+
+        /*
+        Whoever last left data in the ring also left the FIFO busy, so a THRE interrupt is already on its way.
+        Only an empty ring can mean an idle transmitter that nothing is going to wake up, so the common case needs no port I/O at all.
+        */
+        if (was_empty) {
+            spinlock_acquire(&m_TXLock);
+            FillFIFO();
+            spinlock_release(&m_TXLock);
+        }
+    }
+
+    spinlock_release(&m_writeLock);
+    if (interrupts_enabled)
+        x86_64_EnableInterrupts();
+    return count;
+}
+
+void x86_64_UART16550::EnterPolledMode() {
+    if (!m_initialised)
+        return;
+    // Whoever held these may never run again.
+    m_writeLock = 0;
+    m_TXLock = 0;
+    m_polled = true;
+    x86_64_outb(m_port + UART_IER, 0);
+    uint8_t c;
+    while (m_TXBuffer.Pop(c))
+        PutCharPolled(c);
+}
+
+void x86_64_UART16550::HandleInterrupt() {
+    // Reading IIR also acknowledges a pending THRE interrupt.
+    if (x86_64_inb(m_port + UART_IIR_FCR) & UART_IIR_NO_INTERRUPT)
+        return;
+    spinlock_acquire(&m_TXLock);
+    FillFIFO();
+    spinlock_release(&m_TXLock);
+}
+
+bool x86_64_UART16550::IsInitialised() const {
+    return m_initialised;
+}
+
+bool x86_64_UART16550::IsTransmitterEmpty() const {
+    return x86_64_inb(m_port + UART_LSR) & UART_LSR_THRE;
+}
+
+void x86_64_UART16550::FillFIFO() {
+    // With FIFOs enabled, THRE means the whole TX FIFO is empty.
+    if (!IsTransmitterEmpty())
+        return;
+    uint8_t c;
+    for (uint8_t i = 0; i < X86_64_UART16550_FIFO_SIZE && m_TXBuffer.Pop(c); i++)
+        x86_64_outb(m_port + UART_DATA, c);
+}
+
+void x86_64_UART16550::PutCharPolled(uint8_t c) {
+    while (!IsTransmitterEmpty()) {}
+    x86_64_outb(m_port + UART_DATA, c);
+}
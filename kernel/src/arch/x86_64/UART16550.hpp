@@ -0,0 +1,74 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _X86_64_UART16550_HPP
+#define _X86_64_UART16550_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <spinlock.h>
+
+#include <Data-structures/RingBuffer.hpp>
+
+#define X86_64_COM1_PORT 0x3F8
+#define X86_64_COM1_IRQ 4
+
+#define X86_64_UART16550_DEFAULT_BAUD 115200
+#define X86_64_UART16550_FIFO_SIZE 16
+#define X86_64_UART16550_TX_BUFFER_SIZE 16384
+
+/*
+Interrupt driven 16550 UART. Writes only copy into the TX ring and return, the THRE interrupt refills the FIFO in the background.
+Writers only wait on the hardware when the ring is full, or once polled mode has been entered.
+*/
+class x86_64_UART16550 {
+public:
+    x86_64_UART16550();
+
+    // Returns false if no UART responds at port.
+    bool Init(uint16_t port, uint8_t irq, uint32_t baud = X86_64_UART16550_DEFAULT_BAUD);
+
+    size_t Write(const uint8_t* data, size_t count);
+
+    // Drain the ring and transmit synchronously from now on. Used when interrupts can no longer be relied on, such as on panic.
+    void EnterPolledMode();
+
+    void HandleInterrupt();
+
+    bool IsInitialised() const;
+
+private:
+    bool IsTransmitterEmpty() const;
+    void FillFIFO(); // m_TXLock must be held
+    void PutCharPolled(uint8_t c);
+
+private:
+    uint16_t m_port;
+    uint8_t m_irq;
+    bool m_initialised;
+    bool m_polled;
+
+    spinlock_t m_writeLock; // serialises producers
+    spinlock_t m_TXLock; // serialises whoever is moving data from the ring into the FIFO
+    RingBuffer<uint8_t, X86_64_UART16550_TX_BUFFER_SIZE> m_TXBuffer;
+};
+
+// Kernel log sink. nullptr until a UART has been initialised, in which case debug output goes to port 0xE9.
+extern x86_64_UART16550* g_DebugUART;
+
+#endif /* _X86_64_UART16550_HPP */
@@ -0,0 +1,88 @@
+; Copyright (©) 2024  Frosty515
+; 
+; This program is free software: you can redistribute it and/or modify
+; it under the terms of the GNU General Public License as published by
+; the Free Software Foundation, either version 3 of the License, or
+; (at your option) any later version.
+; 
+; This program is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+; GNU General Public License for more details.
+; 
+; You should have received a copy of the GNU General Public License
+; along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+[bits 64]
+
+; Every instruction that touches user memory has an entry in .ex_table pairing it with a fixup address.
+; If it faults, the page fault handler resumes at the fixup instead of panicking. See UserCopy.cpp.
+
+extern g_x86_64_SMAPEnabled
+
+; STAC/CLAC are only needed, and only valid, once SMAP is enabled
+%macro SMAP_ALLOW_ACCESS 0
+    cmp byte [rel g_x86_64_SMAPEnabled], 0
+    je %%skip
+    stac
+%%skip:
+%endmacro
+
+%macro SMAP_DISALLOW_ACCESS 0
+    cmp byte [rel g_x86_64_SMAPEnabled], 0
+    je %%skip
+    clac
+%%skip:
+%endmacro
+
+%macro EX_TABLE_ENTRY 2
+    section .ex_table
+    dq %1, %2
+    section .text
+%endmacro
+
+section .ex_table progbits alloc noexec nowrite align=8
+
+section .text
+
+; uint64_t x86_64_CopyUser(void* dst, const void* src, uint64_t size)
+; Returns the number of bytes that were not copied, so 0 on success.
+global x86_64_CopyUser
+x86_64_CopyUser:
+    mov rcx, rdx
+    SMAP_ALLOW_ACCESS
+.copy:
+    rep movsb
+.fault:
+    SMAP_DISALLOW_ACCESS
+    mov rax, rcx ; rep leaves the remaining count in rcx, whether it finished or faulted
+    ret
+EX_TABLE_ENTRY .copy, .fault
+
+; int64_t x86_64_StrncpyUser(char* dst, const char* src, uint64_t size)
+; Returns the length of the string if a NUL was copied within size bytes, size if there was none, or -1 on a fault.
+global x86_64_StrncpyUser
+x86_64_StrncpyUser:
+    xor rax, rax
+    test rdx, rdx
+    jz .done
+    SMAP_ALLOW_ACCESS
+.loop:
+.load:
+    mov cl, byte [rsi + rax]
+    mov byte [rdi + rax], cl
+    test cl, cl
+    jz .end
+    inc rax
+    cmp rax, rdx
+    jb .loop
+.end:
+    SMAP_DISALLOW_ACCESS
+.done:
+    ret
+.fault:
+    SMAP_DISALLOW_ACCESS
+    mov rax, -1
+    ret
+EX_TABLE_ENTRY .load, .fault
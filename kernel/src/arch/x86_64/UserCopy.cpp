@@ -0,0 +1,50 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "UserCopy.hpp"
+#include "cpuid.hpp"
+
+extern "C" x86_64_ExceptionTableEntry __ex_table_start[];
+extern "C" x86_64_ExceptionTableEntry __ex_table_end[];
+
+bool g_x86_64_SMAPEnabled = false;
+
+bool x86_64_FixupException(x86_64_Interrupt_Registers* regs) {
+    if ((regs->cs & 3) != 0)
+        return false; // only kernel accesses have fixups
+    // There is one entry per instruction that touches user memory, so a linear scan is plenty
+    for (x86_64_ExceptionTableEntry* entry = __ex_table_start; entry < __ex_table_end; entry++) {
+        if (entry->fault_address == regs->rip) {
+            regs->rip = entry->fixup_address;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool x86_64_EnableSMAP() {
+    if (x86_64_cpuid({0, 0, 0, 0}).eax < 7)
+        return false;
+    x86_64_cpuid_regs regs = x86_64_cpuid({7, 0, 0, 0});
+    if (!(regs.ebx & (1 << 20)))
+        return false;
+    uint64_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 | (1UL << 21)) : "memory");
+    g_x86_64_SMAPEnabled = true;
+    return true;
+}
@@ -0,0 +1,46 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _X86_64_USER_COPY_HPP
+#define _X86_64_USER_COPY_HPP
+
+#include <stdint.h>
+
+#include "interrupts/isr.hpp"
+
+struct x86_64_ExceptionTableEntry {
+    uint64_t fault_address;
+    uint64_t fixup_address;
+} __attribute__((packed));
+
+// Defined in UserCopy.asm. Neither checks that the user side is in user space, so callers must.
+
+// Returns the number of bytes not copied, so 0 on success.
+extern "C" uint64_t x86_64_CopyUser(void* dst, const void* src, uint64_t size);
+
+// Returns the length of the string if a NUL was copied within size bytes, size if there was none, or -1 on a fault.
+extern "C" int64_t x86_64_StrncpyUser(char* dst, const char* src, uint64_t size);
+
+extern "C" bool g_x86_64_SMAPEnabled;
+
+// If the faulting instruction has an exception table entry, redirect regs to its fixup and return true.
+bool x86_64_FixupException(x86_64_Interrupt_Registers* regs);
+
+// Stop the kernel from touching user pages outside the routines above. Only safe once every user access goes through them.
+bool x86_64_EnableSMAP();
+
+#endif /* _X86_64_USER_COPY_HPP */
@@ -31,8 +31,10 @@ x86_64_cpuid:
     mov ecx, esi ; get lower 32-bits of rsi
     shr rsi, 32
     mov edx, esi ; get upper 32-bits of rsi
+    pushfq ; cpuid must not be interrupted, but don't leave interrupts disabled for the caller
     cli
     cpuid
+    popfq
     shl rbx, 32
     or rax, rbx ; mov ebx into upper 32-bits of rax
     shl rdx, 32 ; mov edx into upper 32-bits of rdx
@@ -80,8 +80,7 @@ uint8_t x86_64_IOAPIC::GetINTStart() const {
 }
 
 x86_64_IOAPIC* x86_64_IOAPIC_GetIOAPICForIRQ(uint8_t IRQ) {
-    for (uint64_t i = 0; i < g_IOAPICs.getCount(); i++) {
-        x86_64_IOAPIC* ioapic = g_IOAPICs.get(i);
+    for (x86_64_IOAPIC* ioapic : g_IOAPICs) {
         if (IRQ >= ioapic->GetIRQBase() && IRQ <= ioapic->GetIRQEnd())
             return ioapic;
     }
@@ -26,6 +26,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <spinlock.h>
 
+#include <Log/Trace.hpp>
+
 #include <Scheduling/Scheduler.hpp>
 
 x86_64_IPI_List::x86_64_IPI_List() : m_start(nullptr), m_end(nullptr), m_count(0), m_lock(0) {
@@ -104,10 +106,7 @@ void x86_64_IPI_List::Unlock() const {
     spinlock_release(&m_lock);
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Waddress-of-packed-member"
-
-void x86_64_SendIPI(x86_64_LocalAPICRegisters* regs, uint8_t vector, x86_64_IPI_DeliveryMode deliveryMode, bool level, bool trigger_mode, x86_64_IPI_DestinationShorthand destShorthand, uint8_t destination) {
+void x86_64_SendIPI(x86_64_LocalAPIC* LAPIC, uint8_t vector, x86_64_IPI_DeliveryMode deliveryMode, bool level, bool trigger_mode, x86_64_IPI_DestinationShorthand destShorthand, uint32_t destination) {
     uint8_t i_deliveryMode = 0;
     
     switch (deliveryMode) {
@@ -150,34 +149,24 @@ void x86_64_SendIPI(x86_64_LocalAPICRegisters* regs, uint8_t vector, x86_64_IPI_
         default:
             return;
     }
-    
-    uint32_t ICR0 = *(volatile uint32_t*)(&regs->ICR0);
-    uint32_t ICR1 = *(volatile uint32_t*)(&regs->ICR1);
 
-    ICR0 &= 0xFFF32000;
-    ICR0 |= vector;
+    uint32_t ICR0 = vector;
     ICR0 |= (uint32_t)(i_deliveryMode & 0b111) << 8;
     ICR0 |= (level ? 1 : 0) << 14;
     ICR0 |= (trigger_mode ? 1 : 0) << 15;
     ICR0 |= (uint32_t)(shorthand & 0b11) << 18;
 
-    ICR1 &= 0x00FFFFFF;
-    ICR1 |= destination << 24;
-
-    *(volatile uint32_t*)(&regs->ICR1) = ICR1; // must write to ICR1 first
-    *(volatile uint32_t*)(&regs->ICR0) = ICR0;
-
-    while(*(volatile uint32_t*)(&regs->ICR0) & (1 << 12)) { __asm__ volatile ("" ::: "memory"); } // wait for IPI to be sent
+    LAPIC->WriteICR(ICR0, destination);
+    TRACE(TRACE_IPI_SEND, vector, destination);
 }
 
-#pragma GCC diagnostic pop
-
 void x86_64_NMI_IPIHandler(x86_64_Interrupt_Registers* regs) {
     Processor* processor = GetCurrentProcessor();
     x86_64_IPI_List& IPIList = processor->GetIPIList();
     IPIList.Lock();
     while (IPIList.GetCount() > 0) {
         x86_64_IPI* IPI = IPIList.PopFront();
+        TRACE(TRACE_IPI_RECEIVE, regs->interrupt, (uint64_t)IPI->type);
         switch (IPI->type) {
         case x86_64_IPI_Type::Stop:
             processor->StopThis();
@@ -200,7 +189,7 @@ void x86_64_NMI_IPIHandler(x86_64_Interrupt_Registers* regs) {
     IPIList.Unlock();
 }
 
-void x86_64_IssueIPI(x86_64_IPI_DestinationShorthand destShorthand, uint8_t destination, x86_64_IPI_Type type, uint64_t data, bool wait) {
+void x86_64_IssueIPI(x86_64_IPI_DestinationShorthand destShorthand, uint32_t destination, x86_64_IPI_Type type, uint64_t data, bool wait) {
     x86_64_IPI IPI = {
         .type = type,
         .data = data,
@@ -287,7 +276,7 @@ void x86_64_IssueIPI(x86_64_IPI_DestinationShorthand destShorthand, uint8_t dest
     }
     }
 
-    x86_64_SendIPI(GetCurrentProcessor()->GetLocalAPIC()->GetRegisters(), 0, x86_64_IPI_DeliveryMode::NMI, false, false, destShorthand, destination);
+    x86_64_SendIPI(GetCurrentProcessor()->GetLocalAPIC(), 0, x86_64_IPI_DeliveryMode::NMI, false, false, destShorthand, destination);
 
     // If the wait flag is set, the IPI struct won't be deleted on completion.
 
@@ -298,4 +287,22 @@ void x86_64_IssueIPI(x86_64_IPI_DestinationShorthand destShorthand, uint8_t dest
         }
     }
     delete[] IPIs;
-}
\ No newline at end of file
+}
+
+void x86_64_IPI_Init() {
+    x86_64_ISR_RegisterHandler(IPI_WAKEUP_INT, x86_64_WakeupIPIHandler);
+}
+
+void x86_64_WakeupIPIHandler(x86_64_Interrupt_Registers* regs) {
+    TRACE(TRACE_IPI_RECEIVE, regs->interrupt, 0);
+    Scheduling::Thread* thread = Scheduling::Scheduler::GetCurrent();
+    if (thread != nullptr && (thread->IsIdle() || thread->IsExiting())) {
+        x86_64_SaveIRegistersToThread(thread, regs);
+        Scheduling::Scheduler::IdleWakeup(regs);
+    }
+    x86_64_GetCurrentLocalAPIC()->SendEOI();
+}
+
+void x86_64_SendWakeupIPI(uint32_t destination) {
+    x86_64_SendIPI(GetCurrentProcessor()->GetLocalAPIC(), IPI_WAKEUP_INT, x86_64_IPI_DeliveryMode::Fixed, true, false, x86_64_IPI_DestinationShorthand::NoShorthand, destination);
+}
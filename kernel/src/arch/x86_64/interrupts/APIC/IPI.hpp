@@ -22,6 +22,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "LocalAPIC.hpp"
 
+#define IPI_WAKEUP_INT 0xF1
+
 enum class x86_64_IPI_DeliveryMode {
     Fixed = 0,
     LowPriority = 1,
@@ -85,11 +87,18 @@ private:
     mutable spinlock_t m_lock;
 };
 
-void x86_64_SendIPI(x86_64_LocalAPICRegisters* regs, uint8_t vector, x86_64_IPI_DeliveryMode deliveryMode, bool level, bool trigger_mode, x86_64_IPI_DestinationShorthand destShorthand, uint8_t destination);
+void x86_64_SendIPI(x86_64_LocalAPIC* LAPIC, uint8_t vector, x86_64_IPI_DeliveryMode deliveryMode, bool level, bool trigger_mode, x86_64_IPI_DestinationShorthand destShorthand, uint32_t destination);
 
 
 void x86_64_NMI_IPIHandler(x86_64_Interrupt_Registers*);
 
-void x86_64_IssueIPI(x86_64_IPI_DestinationShorthand destShorthand, uint8_t destination, x86_64_IPI_Type type, uint64_t data = 0, bool wait = false);
+void x86_64_IssueIPI(x86_64_IPI_DestinationShorthand destShorthand, uint32_t destination, x86_64_IPI_Type type, uint64_t data = 0, bool wait = false);
+
+void x86_64_IPI_Init();
+
+void x86_64_WakeupIPIHandler(x86_64_Interrupt_Registers* regs);
+
+// Wake a halted processor so it can pick up newly runnable work. Unlike x86_64_IssueIPI this uses a maskable vector, so it never lands while the target holds scheduler locks.
+void x86_64_SendWakeupIPI(uint32_t destination);
 
 #endif /* _X86_64_APIC_IPI_HPP */
\ No newline at end of file
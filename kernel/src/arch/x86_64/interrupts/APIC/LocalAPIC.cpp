@@ -19,6 +19,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "IPI.hpp"
 
 #include "../../io.h"
+#include "../../MSR.hpp"
+#include "../../cpuid.hpp"
 #include "../../Processor.hpp"
 
 #include "../../Memory/PageMapIndexer.hpp"
@@ -27,6 +29,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "arch/x86_64/Memory/PagingUtil.hpp"
 
 #include <math.h>
+#include <stdio.h>
 #include <string.h>
 #include <util.h>
 
@@ -34,141 +37,233 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <HAL/hal.hpp>
 #include <HAL/time.h>
-#include <HAL/drivers/HPET.hpp>
 
 #include <Scheduling/Scheduler.hpp>
 
 
 extern void* ap_trampoline;
 
-extern "C" {
-uint64_t aps_running;
+struct x86_64_APStartInfo {
+    uint32_t ID;
+    Processor* processor;
+    volatile bool started;
+};
+
+static x86_64_APStartInfo* g_APStartInfo = nullptr;
+static uint64_t g_APStartCount = 0;
+
+bool g_x2APIC = false;
+bool g_x2APICDetected = false;
+
+bool x86_64_LAPIC_IsX2APIC() {
+    return g_x2APIC;
+}
+
+void x86_64_LAPIC_DetectX2APIC() {
+    if (g_x2APICDetected)
+        return;
+    x86_64_cpuid_regs regs = x86_64_cpuid({0x1, 0, 0, 0});
+    g_x2APIC = (regs.ecx & (1 << 21)) != 0;
+    g_x2APICDetected = true;
 }
 
 void x86_64_LAPIC_TimerCallback(x86_64_Interrupt_Registers* regs) {
     x86_64_GetCurrentLocalAPIC()->LAPICTimerCallback(regs);
 }
 
-x86_64_LocalAPIC::x86_64_LocalAPIC(void* baseAddress, bool BSP, uint8_t ID) : m_registers((x86_64_LocalAPICRegisters*)baseAddress), m_BSP(BSP), m_ID(ID), m_timerLock(0) {
+x86_64_LocalAPIC::x86_64_LocalAPIC(void* baseAddress, bool BSP, uint32_t ID) : m_registers((x86_64_LocalAPICRegisters*)baseAddress), m_BSP(BSP), m_ID(ID), m_timerLock(0) {
 
 }
 
-void InitProcessor(void* obj) {
-    Processor* proc = (Processor*)obj;
-    proc->Init(nullptr, 0, 0, 0, 0, 0, FrameBuffer());
+// Every AP arrives here from the trampoline on its own stack. The stack it claimed isn't tied to its APIC ID, so it looks itself up.
+extern "C" void x86_64_AP_Entry(void* stack_top) {
+    uint32_t ID = GetCurrentProcessorID();
+    for (uint64_t i = 0; i < g_APStartCount; i++) {
+        x86_64_APStartInfo* info = &(g_APStartInfo[i]);
+        if (info->ID != ID)
+            continue;
+        info->processor->SetKernelStack((void*)((uint64_t)stack_top - KERNEL_STACK_SIZE));
+        __atomic_store_n(&(info->started), true, __ATOMIC_RELEASE);
+        info->processor->Init(nullptr, 0, 0, 0, 0, 0, FrameBuffer());
+    }
+    // not a processor we asked for
+    __asm__ volatile("cli");
+    while (true)
+        __asm__ volatile("hlt");
 }
 
 void x86_64_LocalAPIC::SendEOI() {
-    volatile_write32(m_registers->EOI, 0);
+    WriteRegister(LAPIC_REGISTER_OFFSET(EOI), 0);
+}
+
+uint32_t x86_64_LocalAPIC::ReadRegister(uint32_t offset) const {
+    if (g_x2APIC)
+        return (uint32_t)x86_64_ReadMSR(X2APIC_MSR_BASE + (offset >> 4));
+    return *(volatile uint32_t*)((uint64_t)m_registers + offset);
+}
+
+void x86_64_LocalAPIC::WriteRegister(uint32_t offset, uint32_t value) {
+    if (g_x2APIC)
+        x86_64_WriteMSR(X2APIC_MSR_BASE + (offset >> 4), value);
+    else
+        *(volatile uint32_t*)((uint64_t)m_registers + offset) = value;
+}
+
+void x86_64_LocalAPIC::WriteICR(uint32_t low, uint32_t destination) {
+    if (g_x2APIC) {
+        // A single MSR write with the full 32-bit destination. There is no delivery status to poll.
+        x86_64_WriteMSR(X2APIC_MSR_BASE + (LAPIC_REGISTER_OFFSET(ICR0) >> 4), ((uint64_t)destination << 32) | low);
+        return;
+    }
+    uint32_t ICR0 = ReadRegister(LAPIC_REGISTER_OFFSET(ICR0)) & 0xFFF32000;
+    uint32_t ICR1 = ReadRegister(LAPIC_REGISTER_OFFSET(ICR1)) & 0x00FFFFFF;
+    WriteRegister(LAPIC_REGISTER_OFFSET(ICR1), ICR1 | ((destination & 0xFF) << 24)); // must write to ICR1 first
+    WriteRegister(LAPIC_REGISTER_OFFSET(ICR0), ICR0 | low);
+    while (ReadRegister(LAPIC_REGISTER_OFFSET(ICR0)) & (1 << 12)) { __asm__ volatile ("" ::: "memory"); } // wait for IPI to be sent
 }
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Warray-bounds"
 
-void x86_64_LocalAPIC::StartCPU() {
-    if (!m_BSP) {
-        x86_64_DisableInterrupts();
-        //x86_64_PIC_Disable();
-        x86_64_map_page_noflush(&K_PML4_Array, (void*)0x0000, (void*)0x0000, 0x3); // Present, Read/Write, Execute
-        x86_64_InvalidatePage(0);
-        // copy the ap trampoline to 0x0000
-        memcpy((void*)0x0000, &ap_trampoline, 0x1000);
-        uint32_t* CR3_value = (uint32_t*)0xFFC;
-        uint32_t* start_lock = (uint32_t*)0xFF8;
-        uint64_t* jump_addr = (uint64_t*)0xFF0;
-        uint64_t* jmp_arg = (uint64_t*)0xFE8;
-        uint64_t* stack = (uint64_t*)0xFE0;
-        uint64_t* kernel_stack_offset = (uint64_t*)0xFD8;
-        if ((uint64_t)g_KPML4_physical >= GiB(4)) {
-            PANIC("Kernel PML4 array is not in the first 4GiB of memory");
+// Start every AP at once. They all run the same trampoline, each claiming a stack from the table before touching anything else.
+void x86_64_LocalAPIC::StartCPUs(x86_64_LocalAPIC** APs, uint64_t count) {
+    if (count == 0)
+        return;
+    x86_64_DisableInterrupts();
+    x86_64_map_page_noflush(&K_PML4_Array, (void*)0x0000, (void*)0x0000, 0x3); // Present, Read/Write, Execute
+    x86_64_InvalidatePage(0);
+    // copy the ap trampoline to 0x0000
+    memcpy((void*)0x0000, &ap_trampoline, 0x1000);
+    uint32_t* CR3_value = (uint32_t*)0xFFC;
+    uint64_t* jump_addr = (uint64_t*)0xFF0;
+    uint64_t* stack_table = (uint64_t*)0xFE8;
+    uint64_t* stack_slot = (uint64_t*)0xFE0;
+    uint64_t* stack_count = (uint64_t*)0xFD8;
+    if ((uint64_t)g_KPML4_physical >= GiB(4)) {
+        PANIC("Kernel PML4 array is not in the first 4GiB of memory");
+    }
+    *CR3_value = (uint32_t)(uint64_t)x86_64_get_physaddr(&K_PML4_Array, &K_PML4_Array);
+    *jump_addr = (uint64_t)x86_64_AP_Entry;
+    *stack_slot = 0;
+
+    uint64_t* stacks = new uint64_t[count];
+    g_APStartInfo = new x86_64_APStartInfo[count];
+    if (stacks == nullptr || g_APStartInfo == nullptr)
+        PANIC("Failed to allocate AP startup information");
+    for (uint64_t i = 0; i < count; i++) {
+        x86_64_LocalAPIC* lapic = APs[i];
+        Processor* proc = new Processor(false);
+        proc->SetLocalAPIC(lapic);
+        g_APStartInfo[i].ID = lapic->m_ID;
+        g_APStartInfo[i].processor = proc;
+        g_APStartInfo[i].started = false;
+        stacks[i] = (uint64_t)g_KPM->AllocatePages(KERNEL_STACK_SIZE / PAGE_SIZE) + KERNEL_STACK_SIZE;
+        spinlock_acquire(&(lapic->m_timerLock)); // we can't have the APIC timer being configured until after the HPET is initialized.
+    }
+    *stack_table = (uint64_t)stacks;
+    *stack_count = count;
+    __atomic_store_n(&g_APStartCount, count, __ATOMIC_RELEASE);
+    x86_64_remap_page(&K_PML4_Array, m_registers, 0x8000013); // Present, Read/Write, No execute, Cache disable
+
+    for (uint64_t i = 0; i < count; i++) {
+        WriteRegister(LAPIC_REGISTER_OFFSET(ErrorStatus), 0); // clear errors
+        x86_64_SendIPI(this, 0, x86_64_IPI_DeliveryMode::INIT, false, false, x86_64_IPI_DestinationShorthand::NoShorthand, APs[i]->m_ID); // send INIT IPI
+        if (!g_x2APIC) // INIT level de-assert is not supported in x2APIC mode
+            x86_64_SendIPI(this, 0, x86_64_IPI_DeliveryMode::INIT, true, false, x86_64_IPI_DestinationShorthand::NoShorthand, APs[i]->m_ID); // deassert
+    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        for (uint64_t i = 0; i < count; i++) {
+            if (__atomic_load_n(&(g_APStartInfo[i].started), __ATOMIC_ACQUIRE))
+                continue;
+            WriteRegister(LAPIC_REGISTER_OFFSET(ErrorStatus), 0); // clear errors
+            x86_64_SendIPI(this, 0x00, x86_64_IPI_DeliveryMode::StartUp, false, false, x86_64_IPI_DestinationShorthand::NoShorthand, APs[i]->m_ID); // send SIPI
         }
-        *CR3_value = (uint32_t)(uint64_t)x86_64_get_physaddr(&K_PML4_Array, &K_PML4_Array);
-        *start_lock = 1; // we prevent it from starting executing actual kernel code until we are ready
-        spinlock_acquire(&m_timerLock); // we can't have the APIC timer being configured until after the HPET is initialized.
-        x86_64_remap_page(&K_PML4_Array, m_registers, 0x8000013); // Present, Read/Write, No execute, Cache disable
-        //x86_64_unmap_page(&K_PML4_Array, (void*)0x0000);
-        uint64_t old_aps_running = aps_running;
-        m_registers->ErrorStatus = 0; // clear errors
-        x86_64_SendIPI(m_registers, 0, x86_64_IPI_DeliveryMode::INIT, false, false, x86_64_IPI_DestinationShorthand::NoShorthand, m_ID); // send INIT IPI
-        x86_64_SendIPI(m_registers, 0, x86_64_IPI_DeliveryMode::INIT, true, false, x86_64_IPI_DestinationShorthand::NoShorthand, m_ID); // deassert
-        for (int i = 0; i < 2; i++) {
-            m_registers->ErrorStatus = 0; // clear errors
-            x86_64_SendIPI(m_registers, 0x00, x86_64_IPI_DeliveryMode::StartUp, false, false, x86_64_IPI_DestinationShorthand::NoShorthand, m_ID); // send SIPI
-            uint64_t current_time = GetTimer();
-            while (aps_running == old_aps_running && (GetTimer() - current_time) < (i == 0 ? 1 : 1000)) { // timeout of 1ms for first attempt, 1000ms for second
-                __asm__ volatile("" ::: "memory");
+        uint64_t current_time = GetTimer();
+        bool all_started = false;
+        while (!all_started && (GetTimer() - current_time) < (attempt == 0 ? 1 : 1000)) { // timeout of 1ms for first attempt, 1000ms for second
+            all_started = true;
+            for (uint64_t i = 0; i < count; i++) {
+                if (!__atomic_load_n(&(g_APStartInfo[i].started), __ATOMIC_ACQUIRE)) {
+                    all_started = false;
+                    break;
+                }
             }
-            if (aps_running != old_aps_running)
-                break;
-            else if (i == 1) {
-                PANIC("AP did not start");
+        }
+        if (all_started)
+            break;
+        else if (attempt == 1) {
+            for (uint64_t i = 0; i < count; i++) {
+                if (!__atomic_load_n(&(g_APStartInfo[i].started), __ATOMIC_ACQUIRE))
+                    dbgprintf("AP with APIC ID %u did not start\n", g_APStartInfo[i].ID);
             }
+            PANIC("AP did not start");
         }
-        Processor* proc = new Processor(false);
-        proc->SetLocalAPIC(this);
-        *jump_addr = (uint64_t)InitProcessor;
-        *jmp_arg = (uint64_t)proc;
-        *stack = (uint64_t)g_KPM->AllocatePages(KERNEL_STACK_SIZE / PAGE_SIZE);
-        *kernel_stack_offset = Processor::get_kernel_stack_offset();
-        *start_lock = 0;
-        x86_64_EnableInterrupts();
     }
+
+    // every AP has left the trampoline, and so is done with the stack table, by the time it marks itself started
+    x86_64_unmap_page(&K_PML4_Array, (void*)0x0000);
+    delete[] stacks;
+    x86_64_EnableInterrupts();
 }
 
 #pragma GCC diagnostic pop
 
 void x86_64_LocalAPIC::Init() {
-    if (!m_BSP) // unmap first page
-        x86_64_unmap_page(&K_PML4_Array, (void*)0);
+    x86_64_LAPIC_DetectX2APIC();
+    if (g_x2APIC) {
+        // Every processor comes out of INIT in xAPIC mode, so each one switches itself over.
+        uint64_t base = x86_64_ReadMSR(IA32_APIC_BASE_MSR);
+        if (!(base & IA32_APIC_BASE_X2APIC_ENABLE))
+            x86_64_WriteMSR(IA32_APIC_BASE_MSR, base | IA32_APIC_BASE_GLOBAL_ENABLE | IA32_APIC_BASE_X2APIC_ENABLE);
+    }
+
     // we mask all LVTs
-    uint8_t max_lvt = (volatile_read32(m_registers->Version) >> 16) & 0xFF;
-    for (uint64_t i = (uint64_t)m_registers + 0x320; i < ((uint64_t)m_registers + 0x320 + max_lvt * 0x10); i += 0x10) {
-        uint32_t lvt = *(volatile uint32_t*)i;
+    uint8_t max_lvt = (ReadRegister(LAPIC_REGISTER_OFFSET(Version)) >> 16) & 0xFF;
+    for (uint32_t offset = LAPIC_REGISTER_OFFSET(LVT_TIMER); offset < (LAPIC_REGISTER_OFFSET(LVT_TIMER) + max_lvt * 0x10); offset += 0x10) {
+        uint32_t lvt = ReadRegister(offset);
         lvt |= 1 << 16; // mask
-        *(volatile uint32_t*)i = lvt;
+        WriteRegister(offset, lvt);
     }
 
     // we set the spurious interrupt vector to 0xFF and enable the APIC.
-    uint32_t spurious = volatile_read32(m_registers->SpuriousInterruptVector);
+    uint32_t spurious = ReadRegister(LAPIC_REGISTER_OFFSET(SpuriousInterruptVector));
     spurious &= 0xFFFEFF00; // clear APIC software enable, spurious vector
     spurious |= 0x100; // enable APIC
     spurious |= 0xFF; // spurious vector
-    volatile_write32(m_registers->SpuriousInterruptVector, spurious);
+    WriteRegister(LAPIC_REGISTER_OFFSET(SpuriousInterruptVector), spurious);
 
-    uint32_t TPR = volatile_read32(m_registers->TaskPriority);
+    uint32_t TPR = ReadRegister(LAPIC_REGISTER_OFFSET(TaskPriority));
     // set the TPR so that all interrupts are accepted
     TPR &= 0xFFFFFF00;
-    volatile_write32(m_registers->TaskPriority, TPR);
+    WriteRegister(LAPIC_REGISTER_OFFSET(TaskPriority), TPR);
 }
 
 void x86_64_LocalAPIC::InitTimer() {
     spinlock_acquire(&(this->m_timerLock)); // we must wait until the HPET is ready
 
     // we set the APIC timer to periodic mode
-    uint32_t lvt_timer = volatile_read32(m_registers->LVT_TIMER);
+    uint32_t lvt_timer = ReadRegister(LAPIC_REGISTER_OFFSET(LVT_TIMER));
     lvt_timer &= 0xFFF9FF00; // clear vector and mode (will run in one-shot mode)
-    volatile_write32(m_registers->LVT_TIMER, lvt_timer);
+    WriteRegister(LAPIC_REGISTER_OFFSET(LVT_TIMER), lvt_timer);
 
     // divide by 16
-    volatile_write32(m_registers->DivideConfiguration, 0x3);
-
-    // we poll for 10ms to pass on the HPET, and see how many LAPIC ticks have occurred.
+    WriteRegister(LAPIC_REGISTER_OFFSET(DivideConfiguration), 0x3);
 
-    uint64_t msInHPETTicks = 10'000'000'000'000 / g_HPET->GetClockPeriod();
+    // we poll for 10ms to pass on the monotonic clock, and see how many LAPIC ticks have occurred.
 
-    uint64_t start = g_HPET->GetMainCounter();
-    volatile_write32(m_registers->InitialCount, 0xFFFFFFFF);
+    uint64_t start = GetMonotonicTime();
+    WriteRegister(LAPIC_REGISTER_OFFSET(InitialCount), 0xFFFFFFFF);
     __atomic_signal_fence(__ATOMIC_SEQ_CST);
     while (true) {
-        uint64_t current = g_HPET->GetMainCounter();
-        if ((current - start) >= msInHPETTicks)
+        uint64_t current = GetMonotonicTime();
+        if ((current - start) >= 10'000'000)
             break;
         __atomic_signal_fence(__ATOMIC_SEQ_CST);
     }
-    uint64_t ticksIn1ms = (0xFFFFFFFF - volatile_read32(m_registers->CurrentCount)) * 16;
+    uint64_t ticksIn1ms = (0xFFFFFFFF - ReadRegister(LAPIC_REGISTER_OFFSET(CurrentCount))) * 16;
 
     // stop the timer for now
-    volatile_write32(m_registers->InitialCount, 0);
+    WriteRegister(LAPIC_REGISTER_OFFSET(InitialCount), 0);
     
     uint64_t freq = ticksIn1ms * 100;
     // align freq to nearest 100kHz
@@ -192,30 +287,30 @@ void x86_64_LocalAPIC::InitTimer() {
         111: Divide by 1
     */
     if (real_divisor_shift == 0)
-        volatile_write32(m_registers->DivideConfiguration, 0b111);
+        WriteRegister(LAPIC_REGISTER_OFFSET(DivideConfiguration), 0b111);
     else
-        volatile_write32(m_registers->DivideConfiguration, real_divisor_shift - 1);
+        WriteRegister(LAPIC_REGISTER_OFFSET(DivideConfiguration), real_divisor_shift - 1);
 
     if (m_BSP)
         x86_64_ISR_RegisterHandler(LAPIC_TIMER_INT, x86_64_LAPIC_TimerCallback);
 
     // we set the timer to periodic mode
 
-    lvt_timer = volatile_read32(m_registers->LVT_TIMER);
+    lvt_timer = ReadRegister(LAPIC_REGISTER_OFFSET(LVT_TIMER));
     lvt_timer &= 0xFFF8FF00; // clear vector, mode, and mask
     lvt_timer |= 0x20000 | LAPIC_TIMER_INT; // set periodic mode and vector
-    volatile_write32(m_registers->LVT_TIMER, lvt_timer);
+    WriteRegister(LAPIC_REGISTER_OFFSET(LVT_TIMER), lvt_timer);
 
     // set the initial count
 
-    volatile_write32(m_registers->InitialCount, m_timer_rticks_per_tick);
+    WriteRegister(LAPIC_REGISTER_OFFSET(InitialCount), m_timer_rticks_per_tick);
 }
 
 void x86_64_LocalAPIC::AllowInitTimer() {
     spinlock_release(&(this->m_timerLock));
 }
 
-uint8_t x86_64_LocalAPIC::GetID() const {
+uint32_t x86_64_LocalAPIC::GetID() const {
     return m_ID;
 }
 
@@ -27,6 +27,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #define LAPIC_TIMER_INT 0xF0
 
+#define IA32_APIC_BASE_MSR 0x1B
+#define IA32_APIC_BASE_X2APIC_ENABLE (1 << 10)
+#define IA32_APIC_BASE_GLOBAL_ENABLE (1 << 11)
+
+// In x2APIC mode each 16-byte aligned xAPIC register at offset n is the MSR X2APIC_MSR_BASE + (n >> 4).
+#define X2APIC_MSR_BASE 0x800
+
 struct x86_64_LocalAPICRegisters {
 #define LAPIC_REGISTER(name) uint32_t name; uint32_t _align_##name[3]
     uint32_t Reserved0[8];
@@ -84,33 +91,38 @@ struct x86_64_LocalAPICRegisters {
 #undef LAPIC_REGISTER
 } __attribute__((packed));
 
+#define LAPIC_REGISTER_OFFSET(name) __builtin_offsetof(x86_64_LocalAPICRegisters, name)
+
 void x86_64_LAPIC_TimerCallback(x86_64_Interrupt_Registers* regs);
 
 class x86_64_LocalAPIC {
 public:
-    x86_64_LocalAPIC(void* baseAddress, bool BSP, uint8_t ID);
+    x86_64_LocalAPIC(void* baseAddress, bool BSP, uint32_t ID);
 
     void SendEOI();
 
-    void StartCPU();
+    void StartCPUs(x86_64_LocalAPIC** APs, uint64_t count); // must be called on the BSP's local APIC
 
     void Init();
 
     void InitTimer();
     void AllowInitTimer();
 
-    uint8_t GetID() const;
+    uint32_t GetID() const;
 
     void LAPICTimerCallback(x86_64_Interrupt_Registers* regs);
 
-    x86_64_LocalAPICRegisters* GetRegisters() {
-        return m_registers;
-    }
+    // offset is the xAPIC MMIO offset of the register. The access always goes to the executing processor's local APIC.
+    uint32_t ReadRegister(uint32_t offset) const;
+    void WriteRegister(uint32_t offset, uint32_t value);
+
+    // Write the interrupt command register. In xAPIC mode only the low 8 bits of destination are usable and the write waits for delivery.
+    void WriteICR(uint32_t low, uint32_t destination);
 
 private:
     x86_64_LocalAPICRegisters* m_registers;
     bool m_BSP;
-    uint8_t m_ID;
+    uint32_t m_ID;
     spinlock_t m_timerLock;
     
     uint64_t m_timer_base_freq;
@@ -121,4 +133,8 @@ private:
 
 x86_64_LocalAPIC* x86_64_GetCurrentLocalAPIC();
 
+// Decided once on the BSP. Every processor switches its local APIC to the same mode in Init().
+bool x86_64_LAPIC_IsX2APIC();
+void x86_64_LAPIC_DetectX2APIC();
+
 #endif /* _X86_64_LOCAL_APIC_HPP */
\ No newline at end of file
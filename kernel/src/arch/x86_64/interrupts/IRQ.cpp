@@ -33,6 +33,8 @@ uint8_t g_IOAPIC_INT_END = 0;
 x86_64_IRQHandler_t* g_IRQHandlers;
 uint8_t g_IRQHandlersCount = 0;
 
+uint8_t g_IRQVectorMap[256]; // vector to IRQ, as assigned in x86_64_IRQ_FullInit
+
 Bitmap g_IRQBitmap;
 spinlock_new(g_IRQBitmapLock);
 
@@ -42,9 +44,9 @@ void x86_64_PIC_IRQ_Handler(x86_64_Interrupt_Registers* regs) {
 }
 
 void x86_64_IRQ_Handler(x86_64_Interrupt_Registers* regs) {
-    uint8_t IRQ = regs->interrupt - PIC_REMAP_OFFSET - 0x10;
+    uint8_t IRQ = x86_64_IRQ_GetIRQForVector(regs->interrupt);
 
-    if (g_IRQHandlers[IRQ] != nullptr)
+    if (IRQ != INVALID_IRQ && g_IRQHandlers[IRQ] != nullptr)
         g_IRQHandlers[IRQ](regs);
     else
         dbgprintf("Unhandled IRQ: %#.2hhx\n", IRQ);
@@ -63,8 +65,7 @@ void x86_64_IRQ_EarlyInit() {
 
 void x86_64_IRQ_FullInit() {
     uint64_t INTMax = 0;
-    for (uint64_t i = 0; i < g_IOAPICs.getCount(); i++) {
-        x86_64_IOAPIC* ioapic = g_IOAPICs.get(i);
+    for (x86_64_IOAPIC* ioapic : g_IOAPICs) {
         for (uint64_t j = ioapic->GetIRQBase(); j < ioapic->GetIRQEnd(); j++)
             INTMax = j;
     }
@@ -75,18 +76,20 @@ void x86_64_IRQ_FullInit() {
     0xF0-0xFF - reserved for LAPIC stuff or IPIs
     */
     assert(INTMax < (0x100 - 0x40)); // too many interrupts. 
-    g_IOAPIC_INT_END = INTMax + PIC_REMAP_OFFSET + 0x10;
+    g_IOAPIC_INT_END = INTMax + X86_64_IRQ_INT_BASE;
     g_IRQHandlersCount = INTMax;
     g_IRQHandlers = new x86_64_IRQHandler_t[g_IRQHandlersCount];
     for (uint64_t i = 0; i < g_IRQHandlersCount; i++)
         g_IRQHandlers[i] = nullptr;
 
-    uint64_t k = PIC_REMAP_OFFSET + 0x10;
-    for (uint64_t i = 0; i < g_IOAPICs.getCount(); i++) {
-        x86_64_IOAPIC* ioapic = g_IOAPICs.get(i);
+    memset(g_IRQVectorMap, INVALID_IRQ, sizeof(g_IRQVectorMap));
+    uint64_t k = X86_64_IRQ_INT_BASE;
+    for (x86_64_IOAPIC* ioapic : g_IOAPICs) {
         ioapic->SetINTStart(k);
-        for (uint64_t j = ioapic->GetIRQBase(); j < ioapic->GetIRQEnd(); j++, k++)
+        for (uint64_t j = ioapic->GetIRQBase(); j < ioapic->GetIRQEnd(); j++, k++) {
+            g_IRQVectorMap[k] = j;
             x86_64_ISR_RegisterHandler(k, x86_64_IRQ_Handler);
+        }
     }
     uint8_t* buffer = new uint8_t[g_IRQHandlersCount / 8];
     memset(buffer, 0, g_IRQHandlersCount / 8);
@@ -95,6 +98,13 @@ void x86_64_IRQ_FullInit() {
     // 8042 PS/2 controller device IRQ mappings
     x86_64_IRQ_ReserveIRQ(1); // keyboard
     x86_64_IRQ_ReserveIRQ(12); // mouse
+    // legacy serial port IRQs, so nothing allocated dynamically (such as the HPET's) can take them before the UART driver starts
+    x86_64_IRQ_ReserveIRQ(3); // COM2 and COM4
+    x86_64_IRQ_ReserveIRQ(4); // COM1 and COM3
+}
+
+uint8_t x86_64_IRQ_GetIRQForVector(uint8_t vector) {
+    return g_IRQVectorMap[vector];
 }
 
 void x86_64_IRQ_ReserveIRQ(uint8_t irq) {
@@ -119,11 +129,10 @@ bool x86_64_IRQ_IsIRQReserved(uint8_t irq) {
 uint8_t x86_64_IRQ_AllocateIRQ() {
     spinlock_acquire(&g_IRQBitmapLock);
     uint8_t IRQ = INVALID_IRQ;
-    for (IRQ = 0; IRQ < g_IRQHandlersCount; IRQ++) {
-        if (!g_IRQBitmap[IRQ]) {
-            g_IRQBitmap.Set(IRQ, true);
-            break;
-        }
+    uint64_t index = g_IRQBitmap.FindFirstClear();
+    if (index < g_IRQHandlersCount) {
+        IRQ = index;
+        g_IRQBitmap.Set(IRQ, true);
     }
     spinlock_release(&g_IRQBitmapLock);
     return IRQ;
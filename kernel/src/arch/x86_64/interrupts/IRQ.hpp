@@ -22,6 +22,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #define INVALID_IRQ 0xFF
 
+#define X86_64_IRQ_INT_BASE 0x30 // interrupt vector of I/O APIC IRQ 0
+
 typedef void (*x86_64_IRQHandler_t)(x86_64_Interrupt_Registers* regs);
 
 /*
@@ -36,6 +38,8 @@ void x86_64_IRQ_EarlyInit(); // just configure and disable the PIC
 void x86_64_IRQ_FullInit(); // get the I/O APIC(s) ready
 void x86_64_IRQ_RegisterHandler(const uint8_t irq, x86_64_IRQHandler_t handler);
 
+uint8_t x86_64_IRQ_GetIRQForVector(uint8_t vector); // INVALID_IRQ if no I/O APIC input was given that vector
+
 void x86_64_IRQ_ReserveIRQ(uint8_t irq);
 void x86_64_IRQ_UnreserveIRQ(uint8_t irq);
 bool x86_64_IRQ_IsIRQReserved(uint8_t irq);
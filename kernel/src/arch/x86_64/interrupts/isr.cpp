@@ -18,11 +18,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "isr.hpp"
 
 #include "../Scheduling/taskutil.hpp"
+#include "../UserCopy.hpp"
 
 #include <stdio.h>
 
 #include <HAL/hal.hpp>
 
+#include <Log/Trace.hpp>
+
 #include <Memory/PageFault.hpp>
 
 #include <Scheduling/Thread.hpp>
@@ -77,16 +80,23 @@ extern "C" void x86_64_ISR_Handler(x86_64_Interrupt_Registers* regs) {
         return g_ISRHandlers[regs->interrupt](regs);
 
     if (regs->interrupt == 0x0E) { // Page fault
+        TRACE(TRACE_PAGE_FAULT, regs->CR2, regs->error);
         PageFaultErrorCode error_code;
         error_code.readable = regs->error & 0x1;
         error_code.writable = regs->error & 0x2;
         error_code.user = regs->error & 0x4;
         error_code.reserved_write = regs->error & 0x8;
         error_code.instruction_fetch = regs->error & 0x10;
+        if (PageFaultTryResolve(error_code, (void*)regs->CR2))
+            return;
+        if (!error_code.user && x86_64_FixupException(regs))
+            return; // a user copy hit a bad page, and will now return an error
         x86_64_Registers real_regs;
         x86_64_ConvertToStandardRegisters(&real_regs, regs);
         PageFaultHandler(error_code, (void*)regs->CR2, (void*)regs->rip, &real_regs);
     }
+    else if (regs->interrupt == 0x0D && x86_64_FixupException(regs))
+        return; // a user copy used a non-canonical address
     else if (regs->interrupt == 0x00 || regs->interrupt == 0x06 || regs->interrupt == 0x0D || regs->interrupt == 0x13) { // Divide by zero, Invalid opcode, General protection fault, SIMD Floating-Point Exception
         Scheduling::Thread* thread = Scheduling::Scheduler::GetCurrent();
         Scheduling::Process* process = nullptr;
@@ -118,7 +128,7 @@ extern "C" void x86_64_ISR_Handler(x86_64_Interrupt_Registers* regs) {
                 signum = SIGILL;
                 break;
             }
-            process->ReceiveSignal(signum);
+            process->ReceiveSignal(signum, thread);
         }
     }
 
@@ -349,7 +349,6 @@ isr_common:
     mov ax, 0x10        ; use kernel data segment
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
 
     mov r15, rsp
@@ -367,7 +366,6 @@ isr_common:
     pop rax             ; restore old segment
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
 
     pop rax             ; remove cr3
@@ -39,6 +39,14 @@ x86_64_DisableInterrupts:
     cli
     ret
 
+global x86_64_AreInterruptsEnabled
+x86_64_AreInterruptsEnabled:
+    pushfq
+    pop rax
+    shr rax, 9 ; IF flag
+    and rax, 1
+    ret
+
 global x86_64_iowait
 x86_64_iowait:
     xor rax, rax ; clear rax
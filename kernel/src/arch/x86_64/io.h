@@ -29,6 +29,7 @@ extern uint8_t x86_64_inb(uint16_t port);
 
 extern void x86_64_EnableInterrupts();
 extern void x86_64_DisableInterrupts();
+extern bool x86_64_AreInterruptsEnabled();
 
 extern void x86_64_iowait();
 
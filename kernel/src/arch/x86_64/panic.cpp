@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "io.h"
 #include "panic.hpp"
 #include "Stack.hpp"
+#include "UART16550.hpp"
 
 #include "interrupts/APIC/IPI.hpp"
 
@@ -36,6 +37,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <tty/TTY.hpp>
 
 #include <Scheduling/Scheduler.hpp>
+#include <Log/KernelLog.hpp>
+#include <Log/LockStats.hpp>
 
 BasicVGA* g_VGADevice;
 
@@ -53,7 +56,7 @@ char const* g_panic_reason = nullptr;
 extern "C" void __attribute__((noreturn)) x86_64_Panic(const char* reason, void* data, const bool type) {
     x86_64_DisableInterrupts();
 
-    x86_64_SendIPI(x86_64_GetCurrentLocalAPIC()->GetRegisters(), 0, x86_64_IPI_DeliveryMode::NMI, false, false, x86_64_IPI_DestinationShorthand::AllExcludingSelf, 0);
+    x86_64_SendIPI(x86_64_GetCurrentLocalAPIC(), 0, x86_64_IPI_DeliveryMode::NMI, false, false, x86_64_IPI_DestinationShorthand::AllExcludingSelf, 0);
     
     Scheduling::Scheduler::Stop();
 
@@ -68,6 +71,12 @@ extern "C" void __attribute__((noreturn)) x86_64_Panic(const char* reason, void*
 
     Scheduling::Scheduler::ForceUnlockEverything();
 
+    // Interrupts are off for good, so the UART can no longer drain its ring in the background.
+    if (g_DebugUART != nullptr)
+        g_DebugUART->EnterPolledMode();
+
+    KernelLog_EnterPanicMode();
+
 
     //reason = "temp";
     if (reason == nullptr)
@@ -85,8 +94,8 @@ extern "C" void __attribute__((noreturn)) x86_64_Panic(const char* reason, void*
 
     // Get Processor Info
     Scheduling::Scheduler::ProcessorInfo* info = GetCurrentProcessorInfo();
-    uint8_t id = 255;
-    uint8_t LAPIC_id = 255;
+    uint32_t id = UINT32_MAX;
+    uint32_t LAPIC_id = UINT32_MAX;
     if (info == nullptr)
         dbgputs("WARNING: Processor info unavailable.\n");
     else {
@@ -106,10 +115,10 @@ extern "C" void __attribute__((noreturn)) x86_64_Panic(const char* reason, void*
     if (type)
         dbgputs("Exception: ");
     dbgputs(reason);
-    if (id != 255) {
-        dbgprintf(" on CPU %hhu", id);
-        if (LAPIC_id != 255)
-            dbgprintf(" (LAPIC %hhu)", LAPIC_id);
+    if (id != UINT32_MAX) {
+        dbgprintf(" on CPU %u", id);
+        if (LAPIC_id != UINT32_MAX)
+            dbgprintf(" (LAPIC %u)", LAPIC_id);
     }
     dbgputc('\n');
 
@@ -144,6 +153,11 @@ extern "C" void __attribute__((noreturn)) x86_64_Panic(const char* reason, void*
 
     Scheduling::Scheduler::PrintThreads(stddebug);
 
+#ifdef LOCK_STATS
+    dbgputc('\n');
+    LockStats_Print(stddebug);
+#endif
+
     // Output all to stdout after in case framebuffer writes cause a page fault
 
     if (g_VGADevice == nullptr)
@@ -24,7 +24,7 @@ DirectoryStream::DirectoryStream(Inode* inode, FilePrivilegeLevel privilege, Fil
 }
 
 DirectoryStream::~DirectoryStream() {
-
+    spinlock_destroy(&m_lock);
 }
 
 int DirectoryStream::Open() {
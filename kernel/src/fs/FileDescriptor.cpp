@@ -32,13 +32,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #ifdef __x86_64__
 #include <arch/x86_64/E9.h>
+#include <arch/x86_64/UART16550.hpp>
 #endif
 
-FileDescriptor::FileDescriptor() : m_TTY(nullptr), m_Stream(nullptr), m_is_open(false), m_type(FileDescriptorType::UNKNOWN), m_mode(FileDescriptorMode::READ), m_ID(-1), m_init_successful(false), m_lock(0) {
+FileDescriptor::FileDescriptor() : m_TTY(nullptr), m_Stream(nullptr), m_Serial(nullptr), m_LogReader(nullptr), m_TraceReader(nullptr), m_is_open(false), m_type(FileDescriptorType::UNKNOWN), m_mode(FileDescriptorMode::READ), m_ID(-1), m_init_successful(false), m_lock(0) {
 
 }
 
-FileDescriptor::FileDescriptor(FileDescriptorType type, void* data, FileDescriptorMode mode, fd_t ID) : m_TTY(nullptr), m_Stream(nullptr), m_is_open(false), m_type(type), m_mode(mode), m_ID(ID), m_init_successful(false), m_lock(0) {
+FileDescriptor::FileDescriptor(FileDescriptorType type, void* data, FileDescriptorMode mode, fd_t ID) : m_TTY(nullptr), m_Stream(nullptr), m_Serial(nullptr), m_LogReader(nullptr), m_TraceReader(nullptr), m_is_open(false), m_type(type), m_mode(mode), m_ID(ID), m_init_successful(false), m_lock(0) {
     spinlock_acquire(&m_lock);
     switch (m_type) {
     case FileDescriptorType::FILE_STREAM:
@@ -87,6 +88,42 @@ FileDescriptor::FileDescriptor(FileDescriptorType type, void* data, FileDescript
         }
         m_is_open = true;
         break;
+    case FileDescriptorType::SERIAL:
+        switch (m_mode) {
+        case FileDescriptorMode::READ:
+        case FileDescriptorMode::READ_WRITE:
+            spinlock_release(&m_lock);
+            return; // transmit only
+        case FileDescriptorMode::WRITE:
+        case FileDescriptorMode::APPEND:
+            break;
+        default:
+            spinlock_release(&m_lock);
+            return;
+        }
+        if (data == nullptr) {
+            spinlock_release(&m_lock);
+            return;
+        }
+        m_Serial = data;
+        m_is_open = true;
+        break;
+    case FileDescriptorType::KERNEL_LOG:
+        if (m_mode != FileDescriptorMode::READ || data == nullptr) {
+            spinlock_release(&m_lock);
+            return;
+        }
+        m_LogReader = (KernelLogReader*)data;
+        m_is_open = true;
+        break;
+    case FileDescriptorType::KERNEL_TRACE:
+        if (m_mode != FileDescriptorMode::READ || data == nullptr) {
+            spinlock_release(&m_lock);
+            return;
+        }
+        m_TraceReader = (TraceReader*)data;
+        m_is_open = true;
+        break;
     default:
         spinlock_release(&m_lock);
         return;
@@ -98,12 +135,16 @@ FileDescriptor::FileDescriptor(FileDescriptorType type, void* data, FileDescript
 FileDescriptor::~FileDescriptor() {
     if (m_is_open)
         (void)Close(); // return value is irrelevant
+    spinlock_destroy(&m_lock);
 }
 
 int FileDescriptor::Open() {
     spinlock_acquire(&m_lock);
     switch (m_type) {
     case FileDescriptorType::DEBUG:
+    case FileDescriptorType::SERIAL:
+    case FileDescriptorType::KERNEL_LOG:
+    case FileDescriptorType::KERNEL_TRACE:
     case FileDescriptorType::TTY:
         spinlock_release(&m_lock);
         m_is_open = true;
@@ -145,6 +186,9 @@ int FileDescriptor::Close() {
     spinlock_acquire(&m_lock);
     switch (m_type) {
     case FileDescriptorType::DEBUG:
+    case FileDescriptorType::SERIAL:
+    case FileDescriptorType::KERNEL_LOG:
+    case FileDescriptorType::KERNEL_TRACE:
     case FileDescriptorType::TTY:
         m_is_open = false;
         spinlock_release(&m_lock);
@@ -206,8 +250,23 @@ int64_t FileDescriptor::Read(uint8_t* buffer, int64_t count, int* status) {
         return i; // NOTE: partial reads from TTYs mean the keyboard device had an error or was disconnected.
     }
     case FileDescriptorType::DEBUG:
+    case FileDescriptorType::SERIAL:
         spinlock_release(&m_lock);
         return -ENOSYS;
+    case FileDescriptorType::KERNEL_LOG: {
+        int64_t rc = KernelLog_Read(m_LogReader, buffer, count);
+        spinlock_release(&m_lock);
+        if (status != nullptr)
+            *status = ESUCCESS;
+        return rc;
+    }
+    case FileDescriptorType::KERNEL_TRACE: {
+        int64_t rc = Trace_Read(m_TraceReader, buffer, count);
+        spinlock_release(&m_lock);
+        if (status != nullptr)
+            *status = ESUCCESS;
+        return rc;
+    }
     case FileDescriptorType::FILE_STREAM: {
         FileStream* fileStream = (FileStream*)m_Stream;
         int i_status = 0;
@@ -287,17 +346,39 @@ int64_t FileDescriptor::Write(const uint8_t* buffer, int64_t count, int* status)
         return rc;
     }
     case FileDescriptorType::DIRECTORY_STREAM:
+    case FileDescriptorType::KERNEL_LOG:
+    case FileDescriptorType::KERNEL_TRACE:
         spinlock_release(&m_lock);
         return -EACCES;
     case FileDescriptorType::DEBUG: {
         int64_t i = 0;
 #ifndef NDEBUG
-        while (i < count) {
 #ifdef __x86_64__
-            x86_64_debug_putc(buffer[i]);
+        if (g_DebugUART != nullptr)
+            i = g_DebugUART->Write(buffer, count);
+        else {
+            while (i < count) {
+                x86_64_debug_putc(buffer[i]);
+                i++;
+            }
+        }
+#else
+        i = count;
 #endif
-            i++;
+#endif
+        spinlock_release(&m_lock);
+        if (status != nullptr) {
+            if (i < count)
+                *status = -EAGAIN;
+            else
+                *status = ESUCCESS;
         }
+        return i;
+    }
+    case FileDescriptorType::SERIAL: {
+        int64_t i = 0;
+#ifdef __x86_64__
+        i = ((x86_64_UART16550*)m_Serial)->Write(buffer, count);
 #endif
         spinlock_release(&m_lock);
         if (status != nullptr) {
@@ -329,8 +410,14 @@ int FileDescriptor::Seek(int64_t offset) {
     }
     switch (m_type) {
     case FileDescriptorType::DEBUG:
+    case FileDescriptorType::SERIAL:
+    case FileDescriptorType::KERNEL_TRACE: // there is a position per CPU, so a single offset means nothing
         spinlock_release(&m_lock);
         return -ENOSYS;
+    case FileDescriptorType::KERNEL_LOG:
+        KernelLog_Seek(m_LogReader, offset);
+        spinlock_release(&m_lock);
+        return ESUCCESS;
     case FileDescriptorType::TTY: {
         uldiv_t out = uldiv(offset, m_TTY->GetVGADevice()->GetAmountOfTextRows());
         m_TTY->GetVGADevice()->SetCursorPosition({out.rem * 10, out.quot * 16});
@@ -367,8 +454,17 @@ int FileDescriptor::Rewind() {
     }
     switch (m_type) {
     case FileDescriptorType::DEBUG:
+    case FileDescriptorType::SERIAL:
         spinlock_release(&m_lock);
         return -ENOSYS;
+    case FileDescriptorType::KERNEL_LOG:
+        m_LogReader->position = 0; // the next read skips ahead to the oldest data still kept
+        spinlock_release(&m_lock);
+        return ESUCCESS;
+    case FileDescriptorType::KERNEL_TRACE:
+        Trace_Rewind(m_TraceReader);
+        spinlock_release(&m_lock);
+        return ESUCCESS;
     case FileDescriptorType::TTY:
         m_TTY->putc('\f'); // clear the screen
         spinlock_release(&m_lock);
@@ -402,6 +498,12 @@ void* FileDescriptor::GetData() const {
         return m_Stream;
     case FileDescriptorType::TTY:
         return m_TTY;
+    case FileDescriptorType::SERIAL:
+        return m_Serial;
+    case FileDescriptorType::KERNEL_LOG:
+        return m_LogReader;
+    case FileDescriptorType::KERNEL_TRACE:
+        return m_TraceReader;
     case FileDescriptorType::DEBUG:
     default:
         return nullptr;
@@ -417,7 +519,7 @@ bool FileDescriptor::WasInitSuccessful() const {
 }
 
 void FileDescriptor::ForceUnlock() {
-    spinlock_release(&m_lock);
+    spinlock_init(&m_lock); // the holder may never release it, and releasing a lock that isn't held would corrupt the ticket count
     if (m_type == FileDescriptorType::TTY)
-        m_TTY->Unlock();
+        m_TTY->ForceUnlock();
 }
@@ -20,6 +20,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <tty/TTY.hpp>
 
+#include <Log/KernelLog.hpp>
+#include <Log/Trace.hpp>
+
 #include <stdint.h>
 #include <spinlock.h>
 
@@ -46,7 +49,10 @@ enum class FileDescriptorType {
     FILE_STREAM,
     DIRECTORY_STREAM,
     TTY,
-    DEBUG
+    DEBUG,
+    SERIAL,
+    KERNEL_LOG,
+    KERNEL_TRACE
 };
 
 enum class FileDescriptorMode {
@@ -84,6 +90,9 @@ public:
 private:
     TTY* m_TTY;
     void* m_Stream; // works for both FileStream and DirectoryStream
+    void* m_Serial; // x86_64_UART16550 on x86_64
+    KernelLogReader* m_LogReader;
+    TraceReader* m_TraceReader;
     bool m_is_open;
     FileDescriptorType m_type;
     FileDescriptorMode m_mode;
@@ -38,6 +38,7 @@ FileDescriptorManager::~FileDescriptorManager() {
     for (uint64_t i = 0; i < m_descriptors.getCount(); i++)
         m_descriptors.remove(UINT64_C(0));
     spinlock_release(&m_lock);
+    spinlock_destroy(&m_lock);
 }
 
 bool FileDescriptorManager::ReserveFileDescriptor(FileDescriptorType type, void* data, FileDescriptorMode mode, fd_t ID) {
@@ -114,25 +115,17 @@ FileDescriptor* FileDescriptorManager::GetFileDescriptor(fd_t ID) const {
 }
 
 fd_t FileDescriptorManager::AllocateFileDescriptor(FileDescriptorType type, void* data, FileDescriptorMode mode) {
-    fd_t ID;
-    bool found = false;
     spinlock_acquire(&m_lock);
     size_t size = m_bitmap.GetSize();
-    for (uint64_t i = 0; i < (m_bitmap.GetSize() << 3); i++) {
-        if (!m_bitmap[i]) {
-            ID = i;
-            found = true;
-            break;
-        }
-    }
-    if (!found) {
+    uint64_t index = m_bitmap.FindFirstClear();
+    if (index == UINT64_MAX) {
         if (!ExpandBitmap(ALIGN_UP((size + 1), 8))) {
             spinlock_release(&m_lock);
             return -1;
         }
-        ID = size;
-        found = true;
+        index = size << 3; // the first bit of the new space
     }
+    fd_t ID = index;
     FileDescriptor* descriptor = new FileDescriptor(type, data, mode, ID);
     if (!descriptor->WasInitSuccessful()) {
         spinlock_release(&m_lock);
@@ -28,6 +28,7 @@ FileStream::FileStream(Inode* inode, VFS_MountPoint* mountPoint, uint8_t modes,
 
 FileStream::~FileStream() {
     Close();
+    spinlock_destroy(&m_lock);
 }
 
 int FileStream::Open() {
@@ -50,7 +51,7 @@ int FileStream::Open() {
                     return -EISDIR;
                 }
                 inode->Lock();
-                inode->SetCurrentHead({0, false, nullptr, 0, 0});
+                inode->SetCurrentHead({0, false, nullptr, 0, 0, false});
                 int rc = inode->Open();
                 if (rc < 0) {
                     inode->Unlock();
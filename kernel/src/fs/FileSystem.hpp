@@ -26,7 +26,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 enum class FileSystemType {
     VFS = 0,
-    TMPFS = 1
+    TMPFS = 1,
+    TARFS = 2
 };
 
 constexpr char PATH_SEPARATOR = '/';
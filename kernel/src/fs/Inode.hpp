@@ -49,6 +49,12 @@ public:
 
     virtual int Expand(size_t new_size) = 0;
 
+    // Kernel address of the in-memory page holding the file data at offset, which must be page aligned. Returns nullptr if the file isn't backed by memory pages.
+    virtual void* GetBackingPage(uint64_t offset) const { (void)offset; return nullptr; }
+
+    // True if the pages GetBackingPage returns are never modified or freed, so they can be mapped into processes as they are.
+    virtual bool IsBackingPermanent() const { return false; }
+
     virtual const char* GetName() const { return p_name; }
     virtual void SetName(const char* name) { p_name = name; }
 
@@ -0,0 +1,388 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "TarFSInode.hpp"
+#include "TarFileSystem.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+namespace TarFS {
+    TarFSInode::TarFSInode() {
+
+    }
+
+    TarFSInode::~TarFSInode() {
+        spinlock_destroy(&m_lock);
+    }
+
+    int TarFSInode::Create(const char* name, TarFSInode* parent, InodeType type, TarFileSystem* fileSystem, FilePrivilegeLevel privilege, const uint8_t* data, size_t size, const char* link_target) {
+        if (name == nullptr || fileSystem == nullptr || type == InodeType::Unkown || (type == InodeType::SymLink && link_target == nullptr))
+            return -EINVAL;
+        m_parent = parent;
+        m_fileSystem = fileSystem;
+        m_privilegeLevel = privilege;
+        m_data = data;
+        m_size = size;
+        m_linkTarget = link_target;
+        m_linkInode = nullptr;
+        p_name = name;
+        p_type = type;
+        p_blockSize = 512;
+        p_CurrentOffset = 0;
+        p_isOpen = false;
+        spinlock_init(&m_lock);
+        ResetID();
+        if (m_parent != nullptr) {
+            int rc = m_parent->AddChild(this);
+            if (rc != ESUCCESS)
+                return rc;
+        }
+        else
+            m_fileSystem->CreateNewRootInode(this);
+        return ESUCCESS;
+    }
+
+    int TarFSInode::Delete() {
+        for (TarFSInode* child : m_children) {
+            child->Delete();
+            delete child;
+        }
+        delete[] p_name;
+        delete[] m_linkTarget;
+        p_ID = 0; // invalidate this inode
+        return ESUCCESS;
+    }
+
+    int TarFSInode::Open() {
+        TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return -ENOLINK;
+            return target->Open();
+        }
+        if (p_isOpen)
+            return ESUCCESS; // already open
+        if (p_type != InodeType::File)
+            return -EISDIR;
+        p_isOpen = true;
+        p_CurrentOffset = 0;
+        return ESUCCESS;
+    }
+
+    int TarFSInode::Close() {
+        TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return -ENOLINK;
+            return target->Close();
+        }
+        if (!p_isOpen)
+            return ESUCCESS; // already closed
+        if (p_type != InodeType::File)
+            return -EISDIR;
+        p_isOpen = false;
+        return ESUCCESS;
+    }
+
+    int64_t TarFSInode::ReadStream(FilePrivilegeLevel privilege, uint8_t* bytes, int64_t count, int* status) {
+        TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return -ENOLINK;
+            return target->ReadStream(privilege, bytes, count, status);
+        }
+        if (!p_isOpen)
+            return -EBADF;
+        int64_t bytes_read = Read(privilege, p_CurrentOffset, bytes, count, status);
+        if (bytes_read > 0)
+            p_CurrentOffset += bytes_read;
+        return bytes_read;
+    }
+
+    int64_t TarFSInode::WriteStream(FilePrivilegeLevel, const uint8_t*, int64_t, int*) {
+        return -EROFS;
+    }
+
+    int TarFSInode::Seek(int64_t offset) {
+        TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return -ENOLINK;
+            return target->Seek(offset);
+        }
+        if (!p_isOpen)
+            return -EBADF;
+        if (p_type != InodeType::File)
+            return -EISDIR;
+        if (offset < 0 || offset >= m_size)
+            return -EINVAL;
+        p_CurrentOffset = offset;
+        return ESUCCESS;
+    }
+
+    int TarFSInode::Rewind() {
+        TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return -ENOLINK;
+            return target->Rewind();
+        }
+        if (!p_isOpen)
+            return -EBADF;
+        if (p_type != InodeType::File)
+            return -EISDIR;
+        p_CurrentOffset = 0;
+        return ESUCCESS;
+    }
+
+    // Doesn't touch the stream offset, so no need to open the inode first.
+    int64_t TarFSInode::Read(FilePrivilegeLevel privilege, int64_t offset, uint8_t* bytes, int64_t count, int* status) {
+        TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return -ENOLINK;
+            return target->Read(privilege, offset, bytes, count, status);
+        }
+        if (p_type != InodeType::File)
+            return -EISDIR;
+        if (bytes == nullptr || count <= 0 || offset < 0)
+            return -EINVAL;
+        if (privilege.UID == m_privilegeLevel.UID || privilege.UID == 0) {
+            if (!((m_privilegeLevel.ACL & ACL_USER_READ) > 0))
+                return -EACCES;
+        }
+        else if (privilege.GID == m_privilegeLevel.GID || privilege.GID == 0) {
+            if (!((m_privilegeLevel.ACL & ACL_GROUP_READ) > 0))
+                return -EACCES;
+        }
+        else {
+            if (!((m_privilegeLevel.ACL & ACL_OTHER_READ) > 0))
+                return -EACCES;
+        }
+        if (offset >= m_size) {
+            if (status != nullptr)
+                *status = -EINVAL;
+            return 0;
+        }
+        if (count > (m_size - offset))
+            count = m_size - offset;
+        memcpy(bytes, &(m_data[offset]), count);
+        if (status != nullptr)
+            *status = ESUCCESS;
+        return count;
+    }
+
+    int64_t TarFSInode::Write(FilePrivilegeLevel, int64_t, const uint8_t*, int64_t, int*) {
+        return -EROFS;
+    }
+
+    int TarFSInode::Expand(size_t) {
+        return -EROFS;
+    }
+
+    // The archive is contiguous in memory, so the data at any offset is already a complete page as far as the caller is concerned.
+    void* TarFSInode::GetBackingPage(uint64_t offset) const {
+        const TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return nullptr;
+            return target->GetBackingPage(offset);
+        }
+        if (p_type != InodeType::File || offset >= (uint64_t)m_size)
+            return nullptr;
+        return (void*)&(m_data[offset]);
+    }
+
+    InodeType TarFSInode::GetType() const {
+        switch (p_type) {
+        case InodeType::File:
+        case InodeType::Folder:
+            return p_type;
+        case InodeType::SymLink:
+            if (m_linkInode == nullptr)
+                return InodeType::Unkown;
+            return m_linkInode->GetType();
+        default:
+            return InodeType::Unkown;
+        }
+    }
+
+    void TarFSInode::SetType(InodeType) {
+        // the archive can't be changed
+    }
+
+    int TarFSInode::AddChild(TarFSInode* child) {
+        if (child == nullptr)
+            return -EFAULT;
+        if (p_type != InodeType::Folder)
+            return -ENOTDIR;
+        m_children.insert(child);
+        return ESUCCESS;
+    }
+
+    TarFSInode* TarFSInode::GetTarFSChild(const char* name, int* status) const {
+        const TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr) {
+                if (status != nullptr)
+                    *status = -ENOLINK;
+                return nullptr;
+            }
+            return target->GetTarFSChild(name, status);
+        }
+        if (p_type != InodeType::Folder) {
+            if (status != nullptr)
+                *status = -ENOTDIR;
+            return nullptr;
+        }
+        if (name == nullptr) {
+            if (status != nullptr)
+                *status = -EFAULT;
+            return nullptr;
+        }
+        for (TarFSInode* inode : m_children) {
+            if (strcmp(name, inode->p_name) == 0)
+                return inode;
+        }
+        if (status != nullptr)
+            *status = -ENOENT;
+        return nullptr;
+    }
+
+    Inode* TarFSInode::GetChild(const char* name, int* status) const {
+        return GetTarFSChild(name, status);
+    }
+
+    Inode* TarFSInode::GetChild(uint64_t index, int* status) const {
+        const TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr) {
+                if (status != nullptr)
+                    *status = -ENOLINK;
+                return nullptr;
+            }
+            return target->GetChild(index, status);
+        }
+        if (p_type != InodeType::Folder) {
+            if (status != nullptr)
+                *status = -ENOTDIR;
+            return nullptr;
+        }
+        TarFSInode* inode = m_children.get(index);
+        if (inode == nullptr) {
+            if (status != nullptr)
+                *status = -EINVAL;
+            return nullptr;
+        }
+        return inode;
+    }
+
+    uint64_t TarFSInode::GetChildCount() const {
+        const TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return 0;
+            return target->GetChildCount();
+        }
+        return m_children.getCount();
+    }
+
+    TarFSInode* TarFSInode::GetParent(int* status) const {
+        const TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr) {
+                if (status != nullptr)
+                    *status = -ENOLINK;
+                return nullptr;
+            }
+            return target->GetParent(status);
+        }
+        return m_parent;
+    }
+
+    void TarFSInode::ResetID(uint32_t seed) {
+        if (seed != 0)
+            srand(seed);
+        p_ID = ((uint64_t)rand() << 32) | rand();
+    }
+
+    FilePrivilegeLevel TarFSInode::GetPrivilegeLevel() const {
+        return m_privilegeLevel;
+    }
+
+    void TarFSInode::SetPrivilegeLevel(FilePrivilegeLevel privilege) {
+        m_privilegeLevel = privilege;
+    }
+
+    size_t TarFSInode::GetSize(int* status) const {
+        const TarFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr) {
+                if (status != nullptr)
+                    *status = -ENOLINK;
+                return 0;
+            }
+            return target->GetSize(status);
+        }
+        if (p_type != InodeType::File) {
+            if (status != nullptr)
+                *status = -EISDIR;
+            return 0;
+        }
+        return m_size;
+    }
+
+    const uint8_t* TarFSInode::GetData() const {
+        return m_data;
+    }
+
+    const char* TarFSInode::GetLinkTarget() const {
+        return m_linkTarget;
+    }
+
+    void TarFSInode::SetLinkInode(TarFSInode* inode) {
+        m_linkInode = inode;
+    }
+
+    void TarFSInode::Lock() const {
+        spinlock_acquire(&m_lock);
+    }
+
+    void TarFSInode::Unlock() const {
+        spinlock_release(&m_lock);
+    }
+
+    TarFSInode* TarFSInode::GetTarget(int* status) {
+        if (p_type == InodeType::SymLink) {
+            if (m_linkInode == nullptr && status != nullptr)
+                *status = -ENOLINK;
+            return m_linkInode;
+        }
+        return this;
+    }
+
+    const TarFSInode* TarFSInode::GetTarget(int* status) const {
+        if (p_type == InodeType::SymLink) {
+            if (m_linkInode == nullptr && status != nullptr)
+                *status = -ENOLINK;
+            return m_linkInode;
+        }
+        return this;
+    }
+}
@@ -0,0 +1,103 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TAR_FS_INODE_HPP
+#define _TAR_FS_INODE_HPP
+
+#include "../Inode.hpp"
+
+#include <spinlock.h>
+
+#include <Data-structures/LinkedList.hpp>
+
+
+namespace TarFS {
+    class TarFileSystem;
+
+    // An entry of a tar archive. File data is never copied, reads come straight out of the archive image.
+    class TarFSInode : public Inode {
+    public:
+        TarFSInode();
+        ~TarFSInode() override;
+
+        int Create(const char* name, TarFSInode* parent, InodeType type, TarFileSystem* fileSystem, FilePrivilegeLevel privilege, const uint8_t* data = nullptr, size_t size = 0, const char* link_target = nullptr);
+        int Delete(); // deletes this inode's children and name. the archive itself is left alone
+
+        int Open() override;
+        int Close() override;
+        int64_t ReadStream(FilePrivilegeLevel privilege, uint8_t* bytes, int64_t count = 1, int* status = nullptr) override; // status will be set if not nullptr, and if the return value is >= 0
+        int64_t WriteStream(FilePrivilegeLevel privilege, const uint8_t* bytes, int64_t count = 1, int* status = nullptr) override; // always fails with -EROFS
+        int Seek(int64_t offset) override;
+        int Rewind() override;
+
+        int64_t Read(FilePrivilegeLevel privilege, int64_t offset, uint8_t* bytes, int64_t count = 1, int* status = nullptr) override; // status will be set if not nullptr, and if the return value is >= 0
+        int64_t Write(FilePrivilegeLevel privilege, int64_t offset, const uint8_t* bytes, int64_t count = 1, int* status = nullptr) override; // always fails with -EROFS
+
+        int Expand(size_t new_size) override; // always fails with -EROFS
+
+        void* GetBackingPage(uint64_t offset) const override;
+        bool IsBackingPermanent() const override { return true; } // the archive is read-only and is never freed
+
+        InodeType GetType() const override;
+        void SetType(InodeType type) override;
+
+        int AddChild(TarFSInode* child);
+        TarFSInode* GetTarFSChild(const char* name, int* status = nullptr) const; // status will be set if not nullptr
+        Inode* GetChild(uint64_t index, int* status = nullptr) const override; // status will be set if not nullptr
+        Inode* GetChild(const char* name, int* status = nullptr) const override; // status will be set if not nullptr
+        uint64_t GetChildCount() const override;
+
+        TarFSInode* GetParent(int* status = nullptr) const override; // status will be set if not nullptr
+
+        void ResetID(uint32_t seed = 0) override;
+
+        FilePrivilegeLevel GetPrivilegeLevel() const override;
+        void SetPrivilegeLevel(FilePrivilegeLevel privilege) override;
+
+        size_t GetSize(int* status = nullptr) const; // status will be set if not nullptr
+        const uint8_t* GetData() const; // the file's data within the archive
+
+        const char* GetLinkTarget() const; // the path stored in the archive for symbolic links, nullptr for anything else
+        void SetLinkInode(TarFSInode* inode); // set once the whole archive has been indexed, as links can point forward
+
+        void Lock() const override;
+        void Unlock() const override;
+
+    protected:
+        TarFSInode* GetTarget(int* status = nullptr); // for symbolic links, returns the inode pointed to. status will be set if not nullptr
+        const TarFSInode* GetTarget(int* status = nullptr) const; // status will be set if not nullptr
+
+    private:
+        TarFSInode* m_parent;
+        TarFileSystem* m_fileSystem;
+        FilePrivilegeLevel m_privilegeLevel;
+
+        LinkedList::SimpleLinkedList<TarFSInode> m_children; // the archive is immutable, so this is only modified while indexing
+
+        /* Only for files */
+        const uint8_t* m_data;
+        int64_t m_size;
+
+        /* Only for symbolic links */
+        const char* m_linkTarget;
+        TarFSInode* m_linkInode;
+
+        mutable spinlock_t m_lock;
+    };
+}
+
+#endif /* _TAR_FS_INODE_HPP */
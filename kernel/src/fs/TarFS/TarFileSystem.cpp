@@ -0,0 +1,309 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "TarFileSystem.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <util.h>
+
+#include <fs/initramfs.hpp>
+
+namespace TarFS {
+
+    // ustar string fields are only null terminated if they are shorter than the field
+    static size_t FieldLength(const char* field, size_t max) {
+        size_t length = 0;
+        while (length < max && field[length] != 0)
+            length++;
+        return length;
+    }
+
+    static char* CopyString(const char* str, size_t length) {
+        char* copy = new char[length + 1];
+        if (copy == nullptr)
+            return nullptr;
+        memcpy(copy, str, length);
+        copy[length] = 0;
+        return copy;
+    }
+
+    TarFileSystem::TarFileSystem(const void* archive, size_t size, FilePrivilegeLevel rootPrivilege) : m_archive((const uint8_t*)archive), m_size(size), m_rootPrivilege(rootPrivilege) {
+        p_blockSize = 512;
+        int rc = Index();
+        if (rc != ESUCCESS)
+            dbgprintf("[TarFS] WARN: failed to index archive at %lp: %d\n", archive, rc);
+    }
+
+    TarFileSystem::~TarFileSystem() {
+
+    }
+
+    int TarFileSystem::CreateFile(FilePrivilegeLevel, const char*, const char*, size_t, bool, FilePrivilegeLevel) {
+        return -EROFS;
+    }
+
+    int TarFileSystem::CreateFolder(FilePrivilegeLevel, const char*, const char*, bool, FilePrivilegeLevel) {
+        return -EROFS;
+    }
+
+    int TarFileSystem::CreateSymLink(FilePrivilegeLevel, const char*, const char*, const char*, bool, FilePrivilegeLevel) {
+        return -EROFS;
+    }
+
+    int TarFileSystem::DeleteInode(FilePrivilegeLevel, const char*, bool, bool) {
+        return -EROFS;
+    }
+
+    int TarFileSystem::DestroyFileSystem() {
+        for (TarFSInode* inode : m_rootInodes) {
+            inode->Delete();
+            delete inode;
+        }
+        for (uint64_t i = m_rootInodes.getCount(); i > 0; i--)
+            m_rootInodes.remove(i - 1);
+        for (uint64_t i = m_links.getCount(); i > 0; i--)
+            m_links.remove(i - 1);
+        return ESUCCESS;
+    }
+
+    Inode* TarFileSystem::GetRootInode(uint64_t index, int* status) const {
+        TarFSInode* inode = m_rootInodes.get(index);
+        if (inode == nullptr && status != nullptr)
+            *status = -EINVAL;
+        return inode;
+    }
+
+    uint64_t TarFileSystem::GetRootInodeCount() const {
+        return m_rootInodes.getCount();
+    }
+
+    // Symbolic links in the middle of the path are followed, but not a link at the end.
+    TarFSInode* TarFileSystem::GetSubInode(TarFSInode* parent, const char* path, int* status) const {
+        if (path == nullptr) {
+            if (status != nullptr)
+                *status = -EFAULT;
+            return nullptr;
+        }
+        TarFSInode* inode = parent;
+        size_t i = 0;
+        while (path[i] != 0) {
+            if (path[i] == PATH_SEPARATOR) {
+                i++;
+                continue;
+            }
+            size_t length = 0;
+            while (path[i + length] != 0 && path[i + length] != PATH_SEPARATOR)
+                length++;
+            char* name = CopyString(&(path[i]), length);
+            if (name == nullptr) {
+                if (status != nullptr)
+                    *status = -ENOMEM;
+                return nullptr;
+            }
+            i += length;
+            if (strcmp(name, "..") == 0) {
+                if (inode != nullptr)
+                    inode = inode->GetParent();
+            }
+            else if (strcmp(name, ".") != 0) {
+                int i_status = -ENOENT;
+                TarFSInode* child = inode == nullptr ? GetRootTarFSInode(name) : inode->GetTarFSChild(name, &i_status);
+                if (child == nullptr) {
+                    delete[] name;
+                    if (status != nullptr)
+                        *status = i_status;
+                    return nullptr;
+                }
+                inode = child;
+            }
+            delete[] name;
+        }
+        if (inode == nullptr && status != nullptr)
+            *status = -ENOENT;
+        return inode;
+    }
+
+    TarFSInode* TarFileSystem::GetInode(const char* path, int* status) const {
+        return GetSubInode(nullptr, path, status);
+    }
+
+    FileSystemType TarFileSystem::GetType() const {
+        return FileSystemType::TARFS;
+    }
+
+    FilePrivilegeLevel TarFileSystem::GetRootPrivilege() const {
+        return m_rootPrivilege;
+    }
+
+    void TarFileSystem::CreateNewRootInode(TarFSInode* inode) {
+        m_rootInodes.insert(inode);
+    }
+
+    // Walk the archive headers once, building the inode tree in place. Folders that only appear as part of another entry's path are created with the root privilege.
+    int TarFileSystem::Index() {
+        uint64_t offset = 0;
+        while ((offset + sizeof(USTARItemHeader)) <= m_size) {
+            USTARItemHeader* header = (USTARItemHeader*)&(m_archive[offset]);
+            if (memcmp(header->ID, "ustar", 5) != 0)
+                break; // end of archive
+            uint64_t size = ASCII_OCT_To_UInt(header->size, 12);
+            if ((offset + 512 + size) > m_size)
+                return -EINVAL;
+            const uint8_t* data = &(m_archive[offset + 512]);
+            offset += 512 + ALIGN_UP(size, 512);
+
+            // POSIX ustar splits long paths across the prefix and path fields. Old GNU archives ("ustar  ") use that space for other things.
+            char path[sizeof(header->FilenamePrefix) + sizeof(header->filepath) + 2];
+            size_t prefix_length = header->ID[5] == 0 ? FieldLength(header->FilenamePrefix, sizeof(header->FilenamePrefix)) : 0;
+            size_t path_length = 0;
+            if (prefix_length > 0) {
+                memcpy(path, header->FilenamePrefix, prefix_length);
+                path[prefix_length] = PATH_SEPARATOR;
+                path_length = prefix_length + 1;
+            }
+            size_t name_length = FieldLength(header->filepath, sizeof(header->filepath));
+            memcpy(&(path[path_length]), header->filepath, name_length);
+            path_length += name_length;
+            path[path_length] = 0;
+
+            InodeType type;
+            switch (header->TypeFlag) {
+            case 0:
+            case '0':
+            case '1':
+                type = InodeType::File;
+                break;
+            case '2':
+                type = InodeType::SymLink;
+                break;
+            case '5':
+                type = InodeType::Folder;
+                break;
+            default:
+                dbgprintf("[TarFS] skipping \"%s\", unsupported type %c\n", path, header->TypeFlag);
+                continue;
+            }
+
+            FilePrivilegeLevel privilege = {(uint32_t)ASCII_OCT_To_UInt(header->uid, 8), (uint32_t)ASCII_OCT_To_UInt(header->gid, 8), (uint16_t)ASCII_OCT_To_UInt(header->mode, 8)};
+
+            const char* link_target = nullptr;
+            if (header->TypeFlag == '1' || header->TypeFlag == '2') {
+                link_target = CopyString(header->filename, FieldLength(header->filename, sizeof(header->filename)));
+                if (link_target == nullptr)
+                    return -ENOMEM;
+            }
+            if (header->TypeFlag == '1') { // hard links share the data of an earlier entry
+                TarFSInode* target = GetInode(link_target);
+                delete[] link_target;
+                link_target = nullptr;
+                if (target == nullptr || target->GetType() != InodeType::File) {
+                    dbgprintf("[TarFS] skipping hard link \"%s\", target is not an earlier file\n", path);
+                    continue;
+                }
+                data = target->GetData();
+                size = target->GetSize();
+            }
+
+            TarFSInode* parent = nullptr;
+            size_t i = 0;
+            while (true) {
+                while (path[i] == PATH_SEPARATOR)
+                    i++;
+                if (path[i] == 0)
+                    break;
+                size_t length = 0;
+                while (path[i + length] != 0 && path[i + length] != PATH_SEPARATOR)
+                    length++;
+                size_t next = i + length;
+                while (path[next] == PATH_SEPARATOR)
+                    next++;
+                bool last = path[next] == 0;
+
+                if (length == 1 && path[i] == '.') { // tar run inside the directory prefixes everything with "./"
+                    i = next;
+                    continue;
+                }
+
+                char* name = CopyString(&(path[i]), length);
+                if (name == nullptr)
+                    return -ENOMEM;
+                TarFSInode* inode = parent == nullptr ? GetRootTarFSInode(name) : parent->GetTarFSChild(name);
+                if (inode != nullptr) {
+                    delete[] name;
+                    if (last && type == InodeType::Folder && inode->GetRealType() == InodeType::Folder)
+                        inode->SetPrivilegeLevel(privilege); // the folder was created implicitly before its own entry
+                    else if (last || inode->GetRealType() != InodeType::Folder) {
+                        dbgprintf("[TarFS] skipping \"%s\", it conflicts with an earlier entry\n", path);
+                        break;
+                    }
+                    parent = inode;
+                    i = next;
+                    continue;
+                }
+                inode = new TarFSInode;
+                if (inode == nullptr) {
+                    delete[] name;
+                    return -ENOMEM;
+                }
+                int rc;
+                if (last)
+                    rc = inode->Create(name, parent, type, this, privilege, data, type == InodeType::File ? size : 0, link_target);
+                else
+                    rc = inode->Create(name, parent, InodeType::Folder, this, m_rootPrivilege);
+                if (rc != ESUCCESS) {
+                    delete[] name;
+                    delete inode;
+                    return rc;
+                }
+                if (last && type == InodeType::SymLink) {
+                    m_links.insert(inode);
+                    link_target = nullptr; // now owned by the inode
+                }
+                parent = inode;
+                i = next;
+            }
+            delete[] link_target; // only left over if the entry was skipped
+        }
+
+        // Links can point at entries later in the archive, and at other links. Resolve until nothing changes, only ever pointing at links that have already been resolved, so loops are left dangling.
+        // Like the rest of the initramfs, relative targets are taken from the root of the archive.
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (TarFSInode* link : m_links) {
+                if (link->GetType() != InodeType::Unkown)
+                    continue;
+                TarFSInode* target = GetInode(link->GetLinkTarget());
+                if (target == nullptr || target == link || (target->GetRealType() == InodeType::SymLink && target->GetType() == InodeType::Unkown))
+                    continue;
+                link->SetLinkInode(target);
+                progress = true;
+            }
+        }
+        return ESUCCESS;
+    }
+
+    TarFSInode* TarFileSystem::GetRootTarFSInode(const char* name) const {
+        for (TarFSInode* inode : m_rootInodes) {
+            if (strcmp(name, inode->GetName()) == 0)
+                return inode;
+        }
+        return nullptr;
+    }
+}
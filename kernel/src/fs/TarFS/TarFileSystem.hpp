@@ -0,0 +1,68 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TAR_FILE_SYSTEM_HPP
+#define _TAR_FILE_SYSTEM_HPP
+
+#include "../FileSystem.hpp"
+
+#include "TarFSInode.hpp"
+
+#include <Data-structures/LinkedList.hpp>
+
+namespace TarFS {
+
+    // Read-only view of a ustar archive that stays resident in memory. The archive is indexed once when constructed.
+    class TarFileSystem : public FileSystem {
+    public:
+        TarFileSystem(const void* archive, size_t size, FilePrivilegeLevel rootPrivilege);
+        ~TarFileSystem();
+
+        // All of these fail with -EROFS
+        int CreateFile(FilePrivilegeLevel current_privilege, const char* parent, const char* name, size_t size = 0, bool inherit_permissions = true, FilePrivilegeLevel privilege = {0, 0, 00644}) override;
+        int CreateFolder(FilePrivilegeLevel current_privilege, const char* parent, const char* name, bool inherit_permissions = true, FilePrivilegeLevel privilege = {0, 0, 00644}) override;
+        int CreateSymLink(FilePrivilegeLevel current_privilege, const char* parent, const char* name, const char* target, bool inherit_permissions = true, FilePrivilegeLevel privilege = {0, 0, 00644}) override;
+        int DeleteInode(FilePrivilegeLevel current_privilege, const char* path, bool recursive = false, bool delete_name = false) override;
+
+        int DestroyFileSystem() override;
+
+        Inode* GetRootInode(uint64_t index, int* status = nullptr) const override; // status will be set if not nullptr
+        uint64_t GetRootInodeCount() const override;
+
+        TarFSInode* GetSubInode(TarFSInode* parent, const char* path, int* status = nullptr) const; // status will be set if not nullptr
+        TarFSInode* GetInode(const char* path, int* status = nullptr) const; // status will be set if not nullptr
+
+        FileSystemType GetType() const override;
+
+        FilePrivilegeLevel GetRootPrivilege() const override;
+
+        void CreateNewRootInode(TarFSInode* inode); // only used while indexing
+
+    private:
+        int Index();
+        TarFSInode* GetRootTarFSInode(const char* name) const;
+
+    private:
+        const uint8_t* m_archive;
+        size_t m_size;
+        FilePrivilegeLevel m_rootPrivilege;
+        LinkedList::SimpleLinkedList<TarFSInode> m_rootInodes;
+        LinkedList::SimpleLinkedList<TarFSInode> m_links; // symbolic links, resolved after indexing
+    };
+}
+
+#endif /* _TAR_FILE_SYSTEM_HPP */
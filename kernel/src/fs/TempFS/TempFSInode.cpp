@@ -24,13 +24,33 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <Memory/PageManager.hpp>
 
+#include <fs/TextCache.hpp>
+
 namespace TempFS {
+    // The lower inode must be memory resident, so its data is read straight out of its backing pages.
+    static int64_t ReadLower(const Inode* lower, int64_t offset, uint8_t* bytes, int64_t count) {
+        int64_t bytes_read = 0;
+        while (bytes_read < count) {
+            uint64_t page_offset = offset % PAGE_SIZE;
+            const uint8_t* page = (const uint8_t*)lower->GetBackingPage(offset - page_offset);
+            if (page == nullptr)
+                break;
+            int64_t chunk = PAGE_SIZE - page_offset;
+            if (chunk > (count - bytes_read))
+                chunk = count - bytes_read;
+            memcpy(&(bytes[bytes_read]), &(page[page_offset]), chunk);
+            offset += chunk;
+            bytes_read += chunk;
+        }
+        return bytes_read;
+    }
+
     TempFSInode::TempFSInode() {
 
     }
     
     TempFSInode::~TempFSInode() {
-
+        spinlock_destroy(&m_lock);
     }
 
     int TempFSInode::Create(const char* name, TempFSInode* parent, InodeType type, TempFileSystem* fileSystem, FilePrivilegeLevel privilege, size_t blockSize, void* extra, uint32_t seed) {
@@ -40,6 +60,7 @@ namespace TempFS {
         m_fileSystem = fileSystem;
         m_privilegeLevel = privilege;
         m_size = 0;
+        m_lower = nullptr;
         p_name = name;
         p_type = type;
         p_blockSize = blockSize;
@@ -82,10 +103,8 @@ namespace TempFS {
             m_fileSystem->DeleteRootInode(this);
         p_isOpen = false; // Inlined from Close()
         if (p_type == InodeType::File) {
-            for (uint64_t i = 0; i < m_data.getCount(); i++) {
-                MemBlock* block = m_data.get(i);
-                if (block == nullptr)
-                    return -ENOSYS;
+            TextCache_Invalidate(p_ID);
+            for (MemBlock* block : m_data) {
                 uint64_t pages = block->size / PAGE_SIZE;
                 if (pages > 1)
                     g_KPM->FreePages(block->address);
@@ -158,6 +177,20 @@ namespace TempFS {
             if (!((m_privilegeLevel.ACL & ACL_OTHER_READ) > 0))
                 return -EACCES;
         }
+        if (m_lower != nullptr) {
+            if (p_CurrentOffset >= m_size) {
+                if (status != nullptr)
+                    *status = -EINVAL;
+                return 0;
+            }
+            if (count > (m_size - p_CurrentOffset))
+                count = m_size - p_CurrentOffset;
+            int64_t bytes_read = ReadLower(m_lower, p_CurrentOffset, bytes, count);
+            p_CurrentOffset += bytes_read;
+            if (status != nullptr)
+                *status = bytes_read == count ? ESUCCESS : -ENOSYS;
+            return bytes_read;
+        }
         int64_t bytes_read = 0;
         for (int64_t currentCount = 0; currentCount < count; m_currentBlockIndex++) {
             if ((p_CurrentOffset + bytes_read) >= m_size) {
@@ -214,6 +247,12 @@ namespace TempFS {
             if (!((m_privilegeLevel.ACL & ACL_OTHER_WRITE) > 0))
                 return -EACCES;
         }
+        if (m_lower != nullptr) {
+            int rc = CopyUp();
+            if (rc < 0)
+                return rc;
+        }
+        TextCache_Invalidate(p_ID);
         uint64_t bytes_written = 0;
         for (int64_t currentCount = 0; currentCount < count; m_currentBlockIndex++) {
             m_currentBlock = m_data.get(m_currentBlockIndex);
@@ -262,6 +301,10 @@ namespace TempFS {
             return -EISDIR;
         if (offset >= m_size)
             return -EINVAL;
+        if (m_lower != nullptr) {
+            p_CurrentOffset = offset;
+            return ESUCCESS;
+        }
         offset = ALIGN_UP(offset, 8);
         p_CurrentOffset = 0;
         for (; (uint64_t)m_currentBlockIndex < m_data.getCount(); m_currentBlockIndex++) {
@@ -360,6 +403,12 @@ namespace TempFS {
                 return -ENOLINK;
             return target->Expand(new_size);
         }
+        if (m_lower != nullptr) {
+            int rc = CopyUp();
+            if (rc < 0)
+                return rc;
+        }
+        TextCache_Invalidate(p_ID);
         MemBlock* mem_block = new MemBlock;
         if (mem_block == nullptr)
             return -ENOMEM;
@@ -372,6 +421,77 @@ namespace TempFS {
         return ESUCCESS;
     }
 
+    void* TempFSInode::GetBackingPage(uint64_t offset) const {
+        const TempFSInode* target = GetTarget();
+        if (target != this) {
+            if (target == nullptr)
+                return nullptr;
+            return target->GetBackingPage(offset);
+        }
+        if (p_type != InodeType::File || (p_blockSize % PAGE_SIZE) != 0 || offset >= (uint64_t)m_size)
+            return nullptr;
+        if (m_lower != nullptr)
+            return m_lower->GetBackingPage(offset);
+        uint64_t block_start = 0;
+        for (MemBlock* block : m_data) {
+            if (offset < (block_start + block->size))
+                return (void*)((uint64_t)(block->address) + ALIGN_DOWN(offset - block_start, PAGE_SIZE));
+            block_start += block->size;
+        }
+        return nullptr;
+    }
+
+    bool TempFSInode::IsBackingPermanent() const {
+        const TempFSInode* target = GetTarget();
+        if (target != this)
+            return target != nullptr && target->IsBackingPermanent();
+        return m_lower != nullptr && m_lower->IsBackingPermanent(); // our own blocks are written in place and freed on delete
+    }
+
+    int TempFSInode::SetLower(Inode* lower, size_t size) {
+        if (lower == nullptr)
+            return -EFAULT;
+        if (p_type != InodeType::File)
+            return -EISDIR;
+        if (m_size != 0 || size == 0 || lower->GetBackingPage(0) == nullptr)
+            return -EINVAL;
+        m_lower = lower;
+        m_size = size;
+        return ESUCCESS;
+    }
+
+    // Move the data out of the lower inode into blocks of our own, so it can be modified.
+    int TempFSInode::CopyUp() {
+        Inode* lower = m_lower;
+        int64_t size = m_size;
+        m_lower = nullptr;
+        m_size = 0;
+        int rc = Expand(size);
+        if (rc < 0) {
+            m_lower = lower;
+            m_size = size;
+            return rc;
+        }
+        MemBlock* block = m_data.get(0);
+        if (block == nullptr || ReadLower(lower, 0, (uint8_t*)(block->address), size) != size)
+            return -ENOSYS;
+        SyncBlockPosition();
+        return ESUCCESS;
+    }
+
+    void TempFSInode::SyncBlockPosition() {
+        uint64_t block_start = 0;
+        m_currentBlockIndex = 0;
+        for (MemBlock* block : m_data) {
+            if ((uint64_t)p_CurrentOffset < (block_start + block->size))
+                break;
+            block_start += block->size;
+            m_currentBlockIndex++;
+        }
+        m_currentBlock = m_data.get(m_currentBlockIndex);
+        m_currentBlockOffset = p_CurrentOffset - block_start;
+    }
+
     InodeType TempFSInode::GetType() const {
         switch (p_type) {
         case InodeType::File:
@@ -439,14 +559,7 @@ namespace TempFS {
             return nullptr;
         }
         m_children.lock();
-        for (uint64_t i = 0; i < m_children.getCount(); i++) {
-            TempFSInode* inode = m_children.get(i);
-            if (inode == nullptr) {
-                m_children.unlock();
-                if (status != nullptr)
-                    *status = -ENOSYS;
-                return nullptr;
-            }
+        for (TempFSInode* inode : m_children) {
             if (inode->p_ID == ID) {
                 m_children.unlock();
                 return inode;
@@ -479,14 +592,7 @@ namespace TempFS {
             return nullptr;
         }
         m_children.lock();
-        for (uint64_t i = 0; i < m_children.getCount(); i++) {
-            TempFSInode* inode = m_children.get(i);
-            if (inode == nullptr) {
-                m_children.unlock();
-                if (status != nullptr)
-                    *status = -ENOSYS;
-                return nullptr;
-            }
+        for (TempFSInode* inode : m_children) {
             if (strcmp(name, inode->p_name) == 0) {
                 m_children.unlock();
                 return inode;
@@ -519,14 +625,7 @@ namespace TempFS {
             return nullptr;
         }
         m_children.lock();
-        for (uint64_t i = 0; i < m_children.getCount(); i++) {
-            TempFSInode* inode = m_children.get(i);
-            if (inode == nullptr) {
-                m_children.unlock();
-                if (status != nullptr)
-                    *status = -ENOSYS;
-                return nullptr;
-            }
+        for (TempFSInode* inode : m_children) {
             if (strcmp(name, inode->p_name) == 0) {
                 m_children.unlock();
                 return (Inode*)inode;
@@ -652,6 +751,8 @@ namespace TempFS {
         m_currentBlock = (MemBlock*)head.currentBlock;
         m_currentBlockIndex = head.currentBlockIndex;
         m_currentBlockOffset = head.currentBlockOffset;
+        if (head.isLower && m_lower == nullptr) // another stream has written to the file since
+            SyncBlockPosition();
     }
 
     TempFSInode::Head TempFSInode::GetCurrentHead() const {
@@ -660,7 +761,8 @@ namespace TempFS {
             .isOpen = p_isOpen,
             .currentBlock = m_currentBlock,
             .currentBlockIndex = m_currentBlockIndex,
-            .currentBlockOffset = m_currentBlockOffset
+            .currentBlockOffset = m_currentBlockOffset,
+            .isLower = m_lower != nullptr
         };
     }
 
@@ -38,6 +38,7 @@ namespace TempFS {
             void* currentBlock;
             int64_t currentBlockIndex;
             size_t currentBlockOffset;
+            bool isLower; // saved before the data was copied up from the lower inode
         };
 
         
@@ -60,6 +61,12 @@ namespace TempFS {
 
         int Expand(size_t new_size) override;
 
+        void* GetBackingPage(uint64_t offset) const override;
+        bool IsBackingPermanent() const override; // only while the data is still served from a permanent lower inode
+
+        // Serve the contents of an empty file from a read-only, memory resident inode of the given size. The data is only copied into this inode on the first write.
+        int SetLower(Inode* lower, size_t size);
+
         InodeType GetType() const override;
         void SetType(InodeType type) override;
 
@@ -92,6 +99,10 @@ namespace TempFS {
         TempFSInode* GetTarget(int* status = nullptr); // resolve the actual target of an operation. for files and folders, it just returns `this`, but for symbolic links, it returns the sub inode. status will be set if not nullptr
         const TempFSInode* GetTarget(int* status = nullptr) const; // status will be set if not nullptr
 
+    private:
+        int CopyUp();
+        void SyncBlockPosition(); // point the current block at p_CurrentOffset
+
     private:
         TempFSInode* m_parent;
         TempFileSystem* m_fileSystem;
@@ -111,6 +122,7 @@ namespace TempFS {
         MemBlock* m_currentBlock;
         int64_t m_currentBlockIndex;
         size_t m_currentBlockOffset; // offset within a block
+        Inode* m_lower; // reads come from here until the first write, see SetLower()
 
         mutable spinlock_t m_lock;
     };
@@ -0,0 +1,139 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "TextCache.hpp"
+
+#include <string.h>
+#include <util.h>
+
+#include <Data-structures/LinkedList.hpp>
+
+#include <Memory/PageManager.hpp>
+
+LinkedList::LockableLinkedList<TextCacheEntry> g_TextCache;
+
+static void TextCache_DestroyEntry(TextCacheEntry* entry) {
+    for (uint64_t i = 0; i < entry->page_count; i++) {
+        if (entry->pages[i] != nullptr && entry->copied[i])
+            g_KPM->FreePage(entry->pages[i]);
+    }
+    delete[] entry->pages;
+    delete[] entry->copied;
+    spinlock_destroy(&entry->lock);
+    delete entry;
+}
+
+TextCacheEntry* TextCache_Acquire(Inode* inode, size_t size) {
+    if (inode == nullptr || size == 0)
+        return nullptr;
+    uint64_t inode_id = inode->GetID();
+    g_TextCache.lock();
+    for (uint64_t i = 0; i < g_TextCache.getCount(); i++) {
+        TextCacheEntry* entry = g_TextCache.get(i);
+        if (entry->inode != nullptr && entry->inode_id == inode_id && entry->size == size) {
+            entry->ref_count++;
+            g_TextCache.unlock();
+            return entry;
+        }
+    }
+    TextCacheEntry* entry = new TextCacheEntry;
+    if (entry == nullptr) {
+        g_TextCache.unlock();
+        return nullptr;
+    }
+    entry->inode_id = inode_id;
+    entry->inode = inode;
+    entry->size = size;
+    entry->page_count = DIV_ROUNDUP(size, PAGE_SIZE);
+    entry->permanent = inode->IsBackingPermanent();
+    entry->pages = new void*[entry->page_count];
+    entry->copied = new bool[entry->page_count];
+    if (entry->pages == nullptr || entry->copied == nullptr) {
+        delete[] entry->pages;
+        delete[] entry->copied;
+        delete entry;
+        g_TextCache.unlock();
+        return nullptr;
+    }
+    for (uint64_t i = 0; i < entry->page_count; i++) {
+        entry->pages[i] = nullptr;
+        entry->copied[i] = false;
+    }
+    entry->ref_count = 1;
+    spinlock_init(&entry->lock);
+    g_TextCache.insert(entry);
+    g_TextCache.unlock();
+    return entry;
+}
+
+void TextCache_Release(TextCacheEntry* entry) {
+    if (entry == nullptr)
+        return;
+    g_TextCache.lock();
+    entry->ref_count--;
+    if (entry->ref_count == 0) { // keeping it for the next exec would pin its copies for as long as the file exists
+        g_TextCache.remove(entry);
+        TextCache_DestroyEntry(entry);
+    }
+    g_TextCache.unlock();
+}
+
+void* TextCache_GetPage(TextCacheEntry* entry, uint64_t offset) {
+    if (entry == nullptr || (offset % PAGE_SIZE) != 0 || offset >= entry->size)
+        return nullptr;
+    uint64_t index = offset / PAGE_SIZE;
+    spinlock_acquire(&entry->lock);
+    if (entry->pages[index] == nullptr) {
+        void* file_page = entry->inode != nullptr ? entry->inode->GetBackingPage(offset) : nullptr;
+        uint64_t valid_size = entry->size - offset;
+        // A whole, aligned page that never changes is shared as it is. The last page is copied, so nothing after the end of the file is exposed.
+        if (entry->permanent && file_page != nullptr && ((uint64_t)file_page % PAGE_SIZE) == 0 && valid_size >= PAGE_SIZE)
+            entry->pages[index] = file_page;
+        else {
+            void* page = file_page != nullptr ? g_KPM->AllocatePage() : nullptr;
+            if (page == nullptr) {
+                spinlock_release(&entry->lock);
+                return nullptr;
+            }
+            if (valid_size >= PAGE_SIZE)
+                fast_memcpy(page, file_page, PAGE_SIZE);
+            else { // don't leak whatever is after the end of the file
+                memcpy(page, file_page, valid_size);
+                memset((void*)((uint64_t)page + valid_size), 0, PAGE_SIZE - valid_size);
+            }
+            entry->pages[index] = page;
+            entry->copied[index] = true;
+        }
+    }
+    void* physical_addr = g_KPM->GetPageTable().GetPhysicalAddress(entry->pages[index]);
+    spinlock_release(&entry->lock);
+    return physical_addr;
+}
+
+void TextCache_Invalidate(uint64_t inode_id) {
+    g_TextCache.lock();
+    for (uint64_t i = g_TextCache.getCount(); i > 0; i--) {
+        TextCacheEntry* entry = g_TextCache.get(i - 1);
+        if (entry->inode == nullptr || entry->inode_id != inode_id)
+            continue;
+        spinlock_acquire(&entry->lock);
+        entry->inode = nullptr; // entries are freed with their last user, so this one still has users
+        spinlock_release(&entry->lock);
+    }
+    g_TextCache.unlock();
+}
@@ -0,0 +1,60 @@
+/*
+Copyright (©) 2024  Frosty515
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _TEXT_CACHE_HPP
+#define _TEXT_CACHE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <spinlock.h>
+
+#include "Inode.hpp"
+
+/*
+Snapshots of executable file pages, shared between every process running the same program.
+Entries are keyed on the inode ID. Writing to the file invalidates its entry: processes already using it keep
+the old pages, new execs get a fresh snapshot, and the old pages are freed when the last user releases them.
+An entry is freed as soon as nothing uses it. Whole pages of files whose backing pages are permanent are not copied at all.
+The pages must never be mapped writable. PageManager::Remap refuses shared mappings, and copy-on-write ones stay read-only until
+the first write has given the process its own copy. Userland/Programs/Utilities/src/textshare.cpp checks this.
+*/
+
+struct TextCacheEntry {
+    uint64_t inode_id;
+    Inode* inode; // nullptr once invalidated
+    size_t size;
+    uint64_t page_count;
+    void** pages; // kernel addresses of the cached copies, indexed by file page. Filled on first use.
+    bool* copied; // false where pages holds the file's own permanent page, which isn't ours to free
+    bool permanent; // the inode's backing pages can be used directly
+    uint64_t ref_count;
+    mutable spinlock_t lock;
+};
+
+// Get the cache entry for an executable, creating it if needed. Must be released with TextCache_Release.
+TextCacheEntry* TextCache_Acquire(Inode* inode, size_t size);
+
+void TextCache_Release(TextCacheEntry* entry);
+
+// Physical address of the cached copy of the page at offset, which must be page aligned. Returns nullptr on failure.
+void* TextCache_GetPage(TextCacheEntry* entry, uint64_t offset);
+
+// Called by filesystems whenever a file's contents change or it goes away.
+void TextCache_Invalidate(uint64_t inode_id);
+
+#endif /* _TEXT_CACHE_HPP */
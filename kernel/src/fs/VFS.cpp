@@ -28,11 +28,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 VFS* g_VFS = nullptr;
 
-VFS::VFS() : m_root(nullptr) {
+VFS::VFS() : m_root(nullptr), m_mountPointsLock({0, 0, 0}) {
 
 }
 
-VFS::VFS(FileSystemType root_type) : m_root(nullptr) {
+VFS::VFS(FileSystemType root_type) : m_root(nullptr), m_mountPointsLock({0, 0, 0}) {
     MountRoot(root_type);
 }
 
@@ -45,6 +45,7 @@ int VFS::MountRoot(FileSystemType type) {
     m_root->type = type;
     m_root->RootInode = nullptr;
     m_root->parent = nullptr;
+    m_root->node.data = m_root;
     switch (type) {
         case FileSystemType::TMPFS:
             m_root->fs = (FileSystem*)(new TempFS::TempFileSystem(PAGE_SIZE, {0, 0, 00755}));
@@ -53,9 +54,9 @@ int VFS::MountRoot(FileSystemType type) {
             delete m_root;
             return -ENOSYS;
     }
-    m_mountPoints.lock();
-    m_mountPoints.insert(m_root);
-    m_mountPoints.unlock();
+    rwlock_write_acquire(&m_mountPointsLock);
+    m_mountPoints.PushBack(&m_root->node);
+    rwlock_write_release(&m_mountPointsLock);
     return ESUCCESS;
 }
 
@@ -88,12 +89,47 @@ int VFS::Mount(FilePrivilegeLevel current_privilege, const char* path, FileSyste
     }
     mountPoint->fs = fs;
     mountPoint->parent = parent_mountPoint;
-    m_mountPoints.lock();
-    m_mountPoints.insert(mountPoint);
-    m_mountPoints.unlock();
+    mountPoint->node.data = mountPoint;
+    rwlock_write_acquire(&m_mountPointsLock);
+    m_mountPoints.PushBack(&mountPoint->node);
+    rwlock_write_release(&m_mountPointsLock);
     return ESUCCESS;
 }
 
+// Take every stream that matches off list, then close and delete them once it is unlocked. Returns false if there is no memory to do so.
+template <typename Stream, typename Filter>
+static bool CloseMatchingStreams(LinkedList::LockableLinkedList<Stream>& list, Filter filter) {
+    list.lock();
+    uint64_t count = 0;
+    for (Stream* stream : list) {
+        if (filter(stream))
+            count++;
+    }
+    if (count == 0) {
+        list.unlock();
+        return true;
+    }
+    Stream** streams = new Stream*[count];
+    if (streams == nullptr) {
+        list.unlock();
+        return false;
+    }
+    uint64_t index = 0;
+    for (LinkedList::Iterator<Stream> it = list.begin(); it != list.end(); ++it) {
+        if (filter(*it)) {
+            streams[index++] = *it;
+            list.remove(it);
+        }
+    }
+    list.unlock();
+    for (uint64_t i = 0; i < count; i++) {
+        (void)(streams[i]->Close()); // ignore return value
+        delete streams[i];
+    }
+    delete[] streams;
+    return true;
+}
+
 int VFS::Unmount(FilePrivilegeLevel current_privilege, const char* path, VFS_WorkingDirectory* working_directory) {
     if (current_privilege.UID != 0) {
         return -EACCES;
@@ -105,13 +141,8 @@ int VFS::Unmount(FilePrivilegeLevel current_privilege, const char* path, VFS_Wor
     }
 
     VFS_MountPoint* mountPoint = nullptr;
-    m_mountPoints.lock();
-    for (uint64_t i = 0; i < m_mountPoints.getCount(); i++) {
-        VFS_MountPoint* i_mountPoint = m_mountPoints.get(i);
-        if (i_mountPoint == nullptr) {
-            m_mountPoints.unlock();
-            return -ENOSYS;
-        }
+    rwlock_read_acquire(&m_mountPointsLock);
+    for (VFS_MountPoint* i_mountPoint : m_mountPoints) {
         if (i_mountPoint->RootInode == inode) {
             mountPoint = i_mountPoint;
             break;
@@ -119,56 +150,25 @@ int VFS::Unmount(FilePrivilegeLevel current_privilege, const char* path, VFS_Wor
     }
 
     // we need to check if this mountpoint has any sub-mountpoints
-    for (uint64_t i = 0; i < m_mountPoints.getCount(); i++) {
-        VFS_MountPoint* i_mountPoint = m_mountPoints.get(i);
-        if (i_mountPoint == nullptr) {
-            m_mountPoints.unlock();
-            return -ENOSYS;
-        }
+    for (VFS_MountPoint* i_mountPoint : m_mountPoints) {
         if (i_mountPoint->parent == mountPoint) {
-            m_mountPoints.unlock();
+            rwlock_read_release(&m_mountPointsLock);
             return -EBUSY;
         }
     }
-    m_mountPoints.unlock();
+    rwlock_read_release(&m_mountPointsLock);
 
     // close any streams
-    m_streams.lock();
-    for (uint64_t i = 0; i < m_streams.getCount(); i++) {
-        FileStream* i_stream = m_streams.get(i);
-        if (i_stream == nullptr) {
-            m_streams.unlock();
-            return -ENOSYS;
-        }
-        if (i_stream->GetMountPoint() == mountPoint) {
-            m_streams.remove(i);
-            m_streams.unlock();
-            (void)(i_stream->Close()); // ignore return value
-            delete i_stream;
-        }
-    }
-    m_streams.unlock();
+    if (!CloseMatchingStreams(m_streams, [mountPoint](FileStream* stream) { return stream->GetMountPoint() == mountPoint; }))
+        return -ENOMEM;
 
     // close any directory streams
-    m_directoryStreams.lock();
-    for (uint64_t i = 0; i < m_directoryStreams.getCount(); i++) {
-        DirectoryStream* i_stream = m_directoryStreams.get(i);
-        if (i_stream == nullptr) {
-            m_directoryStreams.unlock();
-            return -ENOSYS;
-        }
-        if (i_stream->GetFileSystem() == mountPoint->fs) {
-            m_directoryStreams.remove(i);
-            m_directoryStreams.unlock();
-            (void)(i_stream->Close()); // ignore return value
-            delete i_stream;
-        }
-    }
-    m_directoryStreams.unlock();
+    if (!CloseMatchingStreams(m_directoryStreams, [mountPoint](DirectoryStream* stream) { return stream->GetFileSystem() == mountPoint->fs; }))
+        return -ENOMEM;
 
-    m_mountPoints.lock();
-    m_mountPoints.remove(mountPoint);
-    m_mountPoints.unlock();
+    rwlock_write_acquire(&m_mountPointsLock);
+    m_mountPoints.Remove(&mountPoint->node);
+    rwlock_write_release(&m_mountPointsLock);
     mountPoint->fs->DestroyFileSystem();
     delete mountPoint->fs;
     delete mountPoint;
@@ -357,14 +357,9 @@ int VFS::CloseStream(FileStream* stream) {
     if (stream == nullptr)
         return -EINVAL;
     m_streams.lock();
-    for (uint64_t i = 0; i < m_streams.getCount(); i++) {
-        FileStream* i_stream = m_streams.get(i);
-        if (i_stream == nullptr) {
-            m_streams.unlock();
-            return -ENOSYS;
-        }
+    for (FileStream* i_stream : m_streams) {
         if (stream == i_stream) {
-            m_streams.remove(i);
+            m_streams.remove(i_stream);
             m_streams.unlock();
             (void)(stream->Close()); // ignore return value
             delete stream;
@@ -407,14 +402,9 @@ int VFS::CloseDirectoryStream(DirectoryStream* stream) {
     if (stream == nullptr)
         return -EINVAL;
     m_directoryStreams.lock();
-    for (uint64_t i = 0; i < m_directoryStreams.getCount(); i++) {
-        DirectoryStream* i_stream = m_directoryStreams.get(i);
-        if (i_stream == nullptr) {
-            m_directoryStreams.unlock();
-            return -ENOSYS;
-        }
+    for (DirectoryStream* i_stream : m_directoryStreams) {
         if (stream == i_stream) {
-            m_directoryStreams.remove(i);
+            m_directoryStreams.remove(i_stream);
             m_directoryStreams.unlock();
             (void)(stream->Close()); // ignore return value
             delete stream;
@@ -466,23 +456,16 @@ VFS_MountPoint* VFS::GetMountPoint(FileSystem* fs, int* status) const {
             *status = -EINVAL;
         return nullptr;
     }
-    m_mountPoints.lock();
-    for (uint64_t i = 0; i < m_mountPoints.getCount(); i++) {
-        VFS_MountPoint* mountPoint = m_mountPoints.get(i);
-        if (mountPoint == nullptr) {
-            m_mountPoints.unlock();
-            if (status != nullptr)
-                *status = -ENOSYS;
-            return nullptr;
-        }
+    rwlock_read_acquire(&m_mountPointsLock);
+    for (VFS_MountPoint* mountPoint : m_mountPoints) {
         if (mountPoint->fs == fs) {
-            m_mountPoints.unlock();
+            rwlock_read_release(&m_mountPointsLock);
             if (status != nullptr)
                 *status = ESUCCESS;
             return mountPoint;
         }
     }
-    m_mountPoints.unlock();
+    rwlock_read_release(&m_mountPointsLock);
     if (status != nullptr)
         *status = -EINVAL;
     return nullptr;
@@ -600,23 +583,14 @@ VFS_MountPoint* VFS::GetMountPoint(const char* path, VFS_WorkingDirectory* worki
             return nullptr;
         }
         VFS_MountPoint* last_mountPoint = mountPoint;
-        m_mountPoints.lock();
-        for (uint64_t i = 0; i < m_mountPoints.getCount(); i++) {
-            VFS_MountPoint* i_mountPoint = m_mountPoints.get(i);
-            if (i_mountPoint == nullptr) {
-                m_mountPoints.unlock();
-                if (inode != nullptr)
-                    *inode = nullptr;
-                if (status != nullptr)
-                    *status = -ENOSYS;
-                return nullptr;
-            }
+        rwlock_read_acquire(&m_mountPointsLock);
+        for (VFS_MountPoint* i_mountPoint : m_mountPoints) {
             if (i_mountPoint->RootInode == last_inode) {
                 mountPoint = i_mountPoint;
                 break;
             }
         }
-        m_mountPoints.unlock();
+        rwlock_read_release(&m_mountPointsLock);
         if (mountPoint == last_mountPoint) {
             if (inode != nullptr)
                 *inode = nullptr;
@@ -669,23 +643,14 @@ VFS_MountPoint* VFS::GetMountPoint(const char* path, VFS_WorkingDirectory* worki
             return nullptr;
         }
         VFS_MountPoint* last_mountPoint = mountPoint;
-        m_mountPoints.lock();
-        for (uint64_t i = 0; i < m_mountPoints.getCount(); i++) {
-            VFS_MountPoint* i_mountPoint = m_mountPoints.get(i);
-            if (i_mountPoint == nullptr) {
-                m_mountPoints.unlock();
-                if (inode != nullptr)
-                    *inode = nullptr;
-                if (status != nullptr)
-                    *status = -ENOSYS;
-                return nullptr;
-            }
+        rwlock_read_acquire(&m_mountPointsLock);
+        for (VFS_MountPoint* i_mountPoint : m_mountPoints) {
             if (i_mountPoint->RootInode == last_inode) {
                 mountPoint = i_mountPoint;
                 break;
             }
         }
-        m_mountPoints.unlock();
+        rwlock_read_release(&m_mountPointsLock);
         if (mountPoint == last_mountPoint) {
             if (inode != nullptr)
                 *inode = nullptr;
@@ -714,23 +679,14 @@ VFS_MountPoint* VFS::GetChildMountPoint(const char* path, VFS_WorkingDirectory*
     }
 
     VFS_MountPoint* mountPoint = nullptr;
-    m_mountPoints.lock();
-    for (uint64_t i = 0; i < m_mountPoints.getCount(); i++) {
-        VFS_MountPoint* i_mountPoint = m_mountPoints.get(i);
-        if (i_mountPoint == nullptr) {
-            m_mountPoints.unlock();
-            if (inode != nullptr)
-                *inode = nullptr;
-            if (status != nullptr)
-                *status = -ENOSYS;
-            return nullptr;
-        }
+    rwlock_read_acquire(&m_mountPointsLock);
+    for (VFS_MountPoint* i_mountPoint : m_mountPoints) {
         if (i_mountPoint->RootInode == i_inode) {
             mountPoint = i_mountPoint;
             break;
         }
     }
-    m_mountPoints.unlock();
+    rwlock_read_release(&m_mountPointsLock);
     if (status != nullptr)
         *status = ESUCCESS;
     if (mountPoint == nullptr) {
@@ -20,11 +20,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <stdint.h>
 #include <stddef.h>
+#include <rwlock.h>
 
 #include "DirectoryStream.hpp"
 #include "FileSystem.hpp"
 #include "Inode.hpp"
 
+#include <Data-structures/IntrusiveList.hpp>
 #include <Data-structures/LinkedList.hpp>
 
 
@@ -37,6 +39,7 @@ struct VFS_MountPoint {
     FileSystem* fs;
     Inode* RootInode;
     VFS_MountPoint* parent;
+    IntrusiveList::Node node;
 };
 
 struct VFS_WorkingDirectory {
@@ -97,7 +100,8 @@ private:
 private:
     VFS_MountPoint* m_root;
 
-    LinkedList::LockableLinkedList<VFS_MountPoint> m_mountPoints;
+    IntrusiveList::List<VFS_MountPoint> m_mountPoints;
+    mutable rwlock_t m_mountPointsLock; // looked up on every path walk, but only changed by mount and unmount
     LinkedList::LockableLinkedList<FileStream> m_streams;
     LinkedList::LockableLinkedList<DirectoryStream> m_directoryStreams;
 };
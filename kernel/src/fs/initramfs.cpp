@@ -17,7 +17,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "initramfs.hpp"
 #include "VFS.hpp"
-#include "FileStream.hpp"
+
+#include "TarFS/TarFileSystem.hpp"
+#include "TempFS/TempFSInode.hpp"
 
 #include <assert.h>
 #include <errno.h>
@@ -25,76 +27,81 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <string.h>
 #include <util.h>
 
-bool Initialise_InitRAMFS(void* address, size_t size) {
-    if (g_VFS == nullptr)
-        return false;
-
-    using namespace TarFS;
-    USTARItemHeader* header = (USTARItemHeader*)address;
-
-
-    while (memcmp(&(header->ID), "ustar", 5) == 0 && ((uint64_t)header - (uint64_t)address) < size) {
-        assert(header->filepath[99] == 0);
-        uint64_t size = ASCII_OCT_To_UInt(header->size, 12);
-        uint32_t uid = (uint32_t)ASCII_OCT_To_UInt(header->uid, 8);
-        uint32_t gid = (uint32_t)ASCII_OCT_To_UInt(header->gid, 8);
-        uint16_t ACL = (uint16_t)ASCII_OCT_To_UInt(header->mode, 8);
-        dbgprintf("initramfs item: path=\"%s\", size=%lu, type=%c, uid=%u, gid=%u, ACL=%03ho\n", header->filepath, size, header->TypeFlag, uid, gid, ACL);
-
-        uint8_t last_separator = 255;
-        for (uint8_t i = 0; i < 99 && header->filepath[i]; i++) {
-            if (header->filepath[i] == PATH_SEPARATOR && header->filepath[i + 1] != 0)
-                last_separator = i;
-        }
-        char const* parent = "/";
-        char* name = header->filepath;
-        if (last_separator < 99) {
-            parent = new char[last_separator + 1];
-            assert(parent != nullptr);
-            memcpy((void*)((uint64_t)parent + 0), header->filepath, last_separator);
-            name = &(header->filepath[last_separator + 1]);
-        }
-
-        assert(g_VFS != nullptr);
-
-        FilePrivilegeLevel privilege = {uid, gid, ACL};
-        
-        switch (header->TypeFlag - '0') {
-        case 0: // File
-            {
-            assert(g_VFS->CreateFile({0, 0, 07777}, parent, name, size, false, privilege) == ESUCCESS);
-            if (size == 0)
-                break;
-            FileStream* stream = g_VFS->OpenStream({0, 0, 07777}, header->filepath, VFS_READ | VFS_WRITE, nullptr);
-            assert(stream != nullptr);
-            assert(stream->Open() == ESUCCESS);
-            assert(stream->WriteStream((const uint8_t*)((uint64_t)header + 512), size) == (int64_t)size);
-
-            // Validate the data. can be excluded
+constexpr size_t INITRAMFS_PATH_MAX = 512; // the longest path ustar can hold is 256 bytes
 
-            uint8_t* buffer = new uint8_t[size];
-            assert(stream->Rewind() == ESUCCESS);
-            assert(stream->ReadStream(buffer, size) == (int64_t)size);
-            assert(memcmp(buffer, (const void*)((uint64_t)header + 512), size) == 0);
-            delete[] buffer;
+TarFS::TarFileSystem* g_InitRAMFS = nullptr;
 
-            assert(stream->Close() == ESUCCESS);
-            assert(g_VFS->CloseStream(stream) == ESUCCESS);
-            }
+// Recreate the archive's tree in the VFS, extending path as we go down. Files are not copied, they read through to the archive until the first write.
+// Symbolic links are done in a second pass with links set, as they can point at anything in the archive.
+static void InitRAMFS_Populate(TarFS::TarFSInode* folder, char* path, size_t path_length, bool links) {
+    using namespace TarFS;
+    uint64_t count = folder == nullptr ? g_InitRAMFS->GetRootInodeCount() : folder->GetChildCount();
+    for (uint64_t i = 0; i < count; i++) {
+        TarFSInode* item = (TarFSInode*)(folder == nullptr ? g_InitRAMFS->GetRootInode(i) : folder->GetChild(i));
+        assert(item != nullptr);
+        const char* name = item->GetName();
+        size_t name_length = strlen(name);
+        assert((path_length + name_length + 2) <= INITRAMFS_PATH_MAX);
+
+        path[path_length] = 0;
+        const char* parent = path_length == 0 ? "/" : path;
+        FilePrivilegeLevel privilege = item->GetPrivilegeLevel();
+        InodeType type = item->GetRealType();
+        if (!links || type == InodeType::SymLink)
+            dbgprintf("initramfs item: path=\"%s/%s\", size=%lu, type=%d, uid=%u, gid=%u, ACL=%03ho\n", path, name, type == InodeType::File ? item->GetSize() : 0, (int)type, privilege.UID, privilege.GID, privilege.ACL);
+
+        switch (type) {
+        case InodeType::File:
+            if (!links)
+                assert(g_VFS->CreateFile({0, 0, 07777}, parent, name, 0, false, privilege) == ESUCCESS);
             break;
-        case 2: // Symbolic Link
-            assert(g_VFS->CreateSymLink({0, 0, 07777}, parent, name, header->filename, false, privilege) == ESUCCESS);
+        case InodeType::Folder:
+            if (!links)
+                assert(g_VFS->CreateFolder({0, 0, 07777}, parent, name, false, privilege) == ESUCCESS);
             break;
-        case 5: // Folder
-            assert(g_VFS->CreateFolder({0, 0, 07777}, parent, name, false, privilege) == ESUCCESS);
+        case InodeType::SymLink:
+            if (links) {
+                int rc = g_VFS->CreateSymLink({0, 0, 07777}, parent, name, item->GetLinkTarget(), false, privilege);
+                if (rc != ESUCCESS)
+                    dbgprintf("initramfs: failed to link \"%s/%s\" to \"%s\": %d\n", path, name, item->GetLinkTarget(), rc);
+            }
             break;
         default:
             assert(false);
             break;
         }
 
-        header = (USTARItemHeader*)((uint64_t)header + 512 + ALIGN_UP(size, 512));
+        if (type == InodeType::SymLink || (type == InodeType::File && (links || item->GetSize() == 0)))
+            continue;
+
+        path[path_length] = PATH_SEPARATOR;
+        memcpy(&(path[path_length + 1]), name, name_length + 1);
+        if (type == InodeType::Folder) {
+            InitRAMFS_Populate(item, path, path_length + 1 + name_length, links);
+            continue;
+        }
+
+        VFS_MountPoint* mountPoint = nullptr;
+        Inode* inode = g_VFS->GetInode(path, nullptr, nullptr, &mountPoint);
+        assert(inode != nullptr && mountPoint != nullptr && mountPoint->type == FileSystemType::TMPFS);
+        assert(((TempFS::TempFSInode*)inode)->SetLower(item, item->GetSize()) == ESUCCESS);
     }
+}
+
+bool Initialise_InitRAMFS(void* address, size_t size) {
+    if (g_VFS == nullptr)
+        return false;
+
+    g_InitRAMFS = new TarFS::TarFileSystem(address, size, g_VFS->GetRootPrivilege());
+    if (g_InitRAMFS == nullptr)
+        return false;
+
+    char* path = new char[INITRAMFS_PATH_MAX];
+    if (path == nullptr)
+        return false;
+    InitRAMFS_Populate(nullptr, path, 0, false);
+    InitRAMFS_Populate(nullptr, path, 0, true);
+    delete[] path;
     return true;
 }
 
@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <stddef.h>
 
+// Index the archive as a TarFS and mirror it into the root file system. The archive has to stay in memory afterwards, as file data is read from it in place.
 bool Initialise_InitRAMFS(void* address, size_t size);
 
 namespace TarFS {
@@ -53,10 +54,14 @@ namespace TarFS {
         NAMED_PIPE = 6
     };
 
+    class TarFileSystem;
+
     size_t ASCII_OCT_To_UInt(char* str, size_t len);
 
     size_t USTAR_Lookup(uint8_t* archive, const char* filename, uint8_t** out);
     void EnumerateUSTAR(uint8_t* archive);
 }
 
+extern TarFS::TarFileSystem* g_InitRAMFS;
+
 #endif /* _INITRAMFS_HPP */
\ No newline at end of file
@@ -31,6 +31,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <HAL/time.h>
 
+#include <Scheduling/InitTask.hpp>
 #include <Scheduling/Scheduler.hpp>
 
 #include <Graphics/VGA.hpp>
@@ -49,6 +50,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <SystemCalls/SystemCall.hpp>
 #include <SystemCalls/exec.hpp>
 
+#include <Log/KernelLog.hpp>
+
 #include <arch/x86_64/cpuid.hpp>
 
 FrameBuffer m_InitialFrameBuffer;
@@ -161,7 +164,7 @@ extern "C" void StartKernel(KernelParams* params) {
     KProcess->SetDefaultWorkingDirectory(KWorkingDirectory);
     KProcess->Start();
 
-    for (uint8_t i = 0; i < (Scheduling::Scheduler::GetProcessorCount() - 1); i++) {
+    for (uint32_t i = 0; i < (Scheduling::Scheduler::GetProcessorCount() - 1); i++) {
         Scheduling::Thread* thread = new Scheduling::Thread(KProcess, nullptr, nullptr, Scheduling::THREAD_KERNEL_DEFAULT);
         Scheduling::Scheduler::AddIdleThread(thread);
     }
@@ -171,16 +174,11 @@ extern "C" void StartKernel(KernelParams* params) {
     PANIC("Scheduler Start returned!\n");
 }
 
-void Kernel_Stage2(void* params_addr) {
-    dbgputs("Starting FrostyOS!\n");
-    puts("Starting FrostyOS!\n");
-
-    m_Stage = STAGE2;
-
-    Stage2_Params* params = (Stage2_Params*)params_addr;
-
+static void Kernel_Stage2_HAL(void*) {
     HAL_FullInit();
+}
 
+static void Kernel_Stage2_VFS(void*) {
     VFS* KVFS = (VFS*)kcalloc_eternal(1, sizeof(VFS));
     g_VFS = KVFS;
     assert(KVFS->MountRoot(FileSystemType::TMPFS) == ESUCCESS);
@@ -189,12 +187,43 @@ void Kernel_Stage2(void* params_addr) {
 
     KWorkingDirectory = KVFS->GetRootWorkingDirectory();
     KProcess->SetDefaultWorkingDirectory(KWorkingDirectory);
+}
+
+static void Kernel_Stage2_InitRAMFS(void* params_addr) {
+    Stage2_Params* params = (Stage2_Params*)params_addr;
 
     Initialise_InitRAMFS(params->initramfs_addr, params->initramfs_size);
 
     dbgputs("Initial RAMFS initialised.\n");
+}
 
+static void Kernel_Stage2_SystemCalls(void*) {
     SystemCallInit();
+}
+
+void Kernel_Stage2(void* params_addr) {
+    KernelLog_StartDrainThread(KProcess);
+
+    dbgputs("Starting FrostyOS!\n");
+    puts("Starting FrostyOS!\n");
+
+    m_Stage = STAGE2;
+
+    // PCI enumeration and the filesystem setup don't touch each other, so they run side by side on whichever processors are free.
+    Scheduling::InitTask HAL_task = {"HAL", Kernel_Stage2_HAL, nullptr, {}, 0, false};
+    Scheduling::InitTask VFS_task = {"VFS", Kernel_Stage2_VFS, nullptr, {}, 0, false};
+    Scheduling::InitTask InitRAMFS_task = {"InitRAMFS", Kernel_Stage2_InitRAMFS, params_addr, {&VFS_task}, 1, false};
+    Scheduling::InitTask SystemCalls_task = {"SystemCalls", Kernel_Stage2_SystemCalls, nullptr, {}, 0, false};
+    Scheduling::InitTask* tasks[] = {&HAL_task, &VFS_task, &InitRAMFS_task, &SystemCalls_task};
+    Scheduling::RunInitTasks(KProcess, tasks, sizeof(tasks) / sizeof(tasks[0]));
+
+#ifdef KERNEL_AUTORUN
+    char* const autorun_argv[] = {(char*)KERNEL_AUTORUN, nullptr};
+    char* const autorun_envv[] = {nullptr};
+    int autorun_rc = Execute(KProcess, KERNEL_AUTORUN, 1, autorun_argv, 0, autorun_envv);
+    if (autorun_rc < 0)
+        dbgprintf("Failed to start %s: %d\n", KERNEL_AUTORUN, autorun_rc);
+#endif
 
     while (true) {
         
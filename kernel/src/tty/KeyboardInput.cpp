@@ -17,6 +17,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "KeyboardInput.hpp"
 
+#include <Scheduling/Scheduler.hpp>
+#include <Scheduling/WaitQueue.hpp>
+
 bool KeyboardEventHandler(void* data, KeyboardEvent event) {
     KeyboardInput* input = (KeyboardInput*)data;
     if (input == nullptr)
@@ -24,7 +27,7 @@ bool KeyboardEventHandler(void* data, KeyboardEvent event) {
     return input->HandleEvent(event);
 }
 
-KeyboardInput::KeyboardInput() : m_bufferOffset(0), m_bufferReadOffset(0), m_keyboard(nullptr), m_keyboardState({false, false, false, false, false}), m_bufferSize(0), m_buffer(nullptr), m_keyCallback({nullptr, nullptr}) {
+KeyboardInput::KeyboardInput() : m_keyboard(nullptr), m_keyboardState({false, false, false, false, false}), m_buffer(), m_readLock(0), m_waitQueue(nullptr), m_keyCallback({nullptr, nullptr}) {
 
 }
 
@@ -33,7 +36,7 @@ KeyboardInput::~KeyboardInput() {
 }
 
 void KeyboardInput::Initialise(Keyboard* keyboard) {
-    m_buffer = new Buffer(DEFAULT_BUFFER_BLOCK_SIZE, DEFAULT_BUFFER_BLOCK_SIZE);
+    m_waitQueue = new Scheduling::WaitQueue;
     m_keyboard = keyboard;
     if (m_keyboard != nullptr)
         m_keyboard->RegisterEventHandler(KeyboardEventHandler, this);
@@ -42,24 +45,30 @@ void KeyboardInput::Initialise(Keyboard* keyboard) {
 void KeyboardInput::Destroy() {
     if (m_keyboard != nullptr)
         m_keyboard->RegisterEventHandler(nullptr, nullptr);
-    delete m_buffer;
+    delete m_waitQueue;
+    m_waitQueue = nullptr;
 }
 
 int KeyboardInput::GetChar() {
-    if (m_bufferSize == 0)
+    char c;
+    spinlock_acquire(&m_readLock);
+    bool found = m_buffer.Pop(c);
+    spinlock_release(&m_readLock);
+    if (!found || c == (char)-1)
         return -1;
-    char c = (char)-1;
-    m_buffer->Read(m_bufferReadOffset, (uint8_t*)&c, sizeof(char));
-    uint64_t rc = m_buffer->ClearUntil(m_bufferReadOffset + sizeof(char));
-    if (rc > 0) {
-        if (m_bufferOffset >= m_bufferReadOffset)
-            m_bufferOffset = 0;
-        m_bufferReadOffset = 0;
+    return (int)c & 0xFF;
+}
+
+int KeyboardInput::WaitForChar() {
+    Scheduling::Thread* thread = Scheduling::Scheduler::GetCurrent();
+    while (true) {
+        uint64_t sequence = m_waitQueue == nullptr ? 0 : m_waitQueue->GetSequence();
+        int c = GetChar();
+        if (c != -1)
+            return c;
+        if (m_waitQueue != nullptr)
+            m_waitQueue->Wait(thread, sequence);
     }
-    else
-        m_bufferReadOffset++;
-    m_bufferSize--;
-    return c == (char)-1 ? -1 : ((int)c & 0xFF);
 }
 
 bool KeyboardInput::HandleEvent(KeyboardEvent event) {
@@ -261,10 +270,9 @@ void KeyboardInput::OnKey(void (*func)(void*, char), void* data) {
 }
 
 void KeyboardInput::AppendChar(char c) {
-    uint64_t oldOffset = m_bufferOffset;
-    m_bufferOffset++;
-    m_buffer->Write(oldOffset, (const uint8_t*)&c, sizeof(char));
-    m_bufferSize++;
+    // If nobody is reading, the keystroke is dropped once the buffer fills up
+    if (m_buffer.Push(c) && m_waitQueue != nullptr)
+        m_waitQueue->WakeAll();
     if (m_keyCallback.func != nullptr)
         m_keyCallback.func(m_keyCallback.data, c);
 }
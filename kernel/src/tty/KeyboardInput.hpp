@@ -20,7 +20,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <HAL/drivers/Keyboard.hpp>
 
-#include <Data-structures/Buffer.hpp>
+#include <Data-structures/RingBuffer.hpp>
+
+#include <spinlock.h>
+
+namespace Scheduling {
+    class WaitQueue;
+}
+
+#define KEYBOARD_INPUT_BUFFER_SIZE 256
 
 bool KeyboardEventHandler(void* data, KeyboardEvent event);
 
@@ -32,8 +40,11 @@ public:
     void Initialise(Keyboard* keyboard);
     void Destroy();
 
-    // Get first character in buffer. returns int to allow for better ISO C compatibility
+    // Get first character in buffer, or -1 if it is empty. returns int to allow for better ISO C compatibility
     int GetChar();
+
+    // Like GetChar, but parks the current thread until a character arrives instead of returning -1
+    int WaitForChar();
     bool HandleEvent(KeyboardEvent event);
 
     // Gets called when a character is appended to the buffer
@@ -43,8 +54,6 @@ private:
     void AppendChar(char c);
 
 private:
-    uint64_t m_bufferOffset;
-    uint64_t m_bufferReadOffset;
     Keyboard* m_keyboard;
     struct KeyboardState {
         bool control;
@@ -53,8 +62,9 @@ private:
         bool caps_lock;
         bool num_lock;
     } m_keyboardState;
-    size_t m_bufferSize;
-    Buffer* m_buffer;
+    RingBuffer<char, KEYBOARD_INPUT_BUFFER_SIZE> m_buffer; // filled by the keyboard IRQ
+    spinlock_t m_readLock; // the ring buffer only supports one reader at a time
+    Scheduling::WaitQueue* m_waitQueue; // readers waiting for a keystroke
     struct {
         void (*func)(void*, char);
         void* data;
@@ -41,16 +41,13 @@ TTY::TTY(BasicVGA* VGADevice, KeyboardInput* input, const Colour& fg_colour, con
 TTY::~TTY() {
     if (m_keyboardInput != nullptr)
         m_keyboardInput->OnKey(nullptr, nullptr);
+    spinlock_destroy(&m_lock);
 }
 
 int TTY::getc() {
     if (m_keyboardInput == nullptr)
         return EOF;
-    int c;
-    do {
-        c = m_keyboardInput->GetChar();
-    } while (c == EOF);
-    return c;
+    return m_keyboardInput->WaitForChar();
 }
 
 void TTY::putc(char c) {
@@ -149,3 +146,8 @@ void TTY::Unlock() const {
     m_locked = false;
     spinlock_release(&m_lock);
 }
+
+void TTY::ForceUnlock() const {
+    m_locked = false;
+    spinlock_init(&m_lock);
+}
@@ -55,6 +55,7 @@ public:
 
     void Lock() const;
     void Unlock() const;
+    void ForceUnlock() const; // should only ever be used in a PANIC to get emergency access to resources.
 
 private:
     BasicVGA* m_VGADevice;
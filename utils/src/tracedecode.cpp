@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <trace.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+static_assert(sizeof(trace_event) == 32, "trace_event layout does not match the kernel");
+
+struct RunningThread {
+    uint64_t since;
+    int tid;
+};
+
+static bool g_first_event = true;
+
+static void BeginEvent(FILE* out) {
+    fprintf(out, g_first_event ? "\n" : ",\n");
+    g_first_event = false;
+}
+
+static double ToMicroseconds(uint64_t ns) {
+    return (double)ns / 1000.0;
+}
+
+static void WriteInstant(FILE* out, const trace_event& event, const char* name, const char* arg0_name, const char* arg1_name) {
+    BeginEvent(out);
+    fprintf(out, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%u,\"tid\":%d,\"args\":{\"%s\":\"0x%lx\"", name, ToMicroseconds(event.timestamp), event.cpu, event.tid, arg0_name, event.args[0]);
+    if (arg1_name != nullptr)
+        fprintf(out, ",\"%s\":\"0x%lx\"", arg1_name, event.args[1]);
+    fprintf(out, "}}");
+}
+
+static void WriteSlice(FILE* out, const char* name, uint64_t start, uint64_t duration, unsigned int pid, long tid) {
+    BeginEvent(out);
+    fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%ld}", name, ToMicroseconds(start), ToMicroseconds(duration), pid, tid);
+}
+
+// we read the contents of KERNEL_TRACE_PATH from <in-file> and write Chrome trace event JSON to <out-file>
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("Usage: %s <in-file> <out-file>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (in == nullptr) {
+        perror("fopen");
+        return 1;
+    }
+    std::vector<trace_event> events;
+    trace_event event;
+    while (fread(&event, sizeof(trace_event), 1, in) == 1)
+        events.push_back(event);
+    fclose(in);
+
+    // Each CPU's events are in order already, but a read returns the CPUs one after another
+    std::stable_sort(events.begin(), events.end(), [](const trace_event& a, const trace_event& b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    FILE* out = fopen(argv[2], "w");
+    if (out == nullptr) {
+        perror("fopen");
+        return 1;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    // Each CPU is shown as a process. Thread -1 is the CPU's scheduling track, the rest are the threads that ran there.
+    std::map<unsigned int, RunningThread> running;
+    char name[64];
+    for (const trace_event& e : events) {
+        if (running.find(e.cpu) == running.end()) {
+            BeginEvent(out);
+            fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"CPU %u\"}}", e.cpu, e.cpu);
+            BeginEvent(out);
+            fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":-1,\"args\":{\"name\":\"scheduler\"}}", e.cpu);
+            running[e.cpu] = {e.timestamp, e.type == TRACE_CONTEXT_SWITCH ? -1 : e.tid};
+        }
+        switch (e.type) {
+        case TRACE_CONTEXT_SWITCH: {
+            RunningThread& current = running[e.cpu];
+            if (current.tid >= 0) {
+                snprintf(name, sizeof(name), "thread %d", current.tid);
+                WriteSlice(out, name, current.since, e.timestamp - current.since, e.cpu, -1);
+            }
+            current = {e.timestamp, (int)e.args[1]};
+            break;
+        }
+        case TRACE_WAKEUP:
+            WriteInstant(out, e, "wakeup", "tid", nullptr);
+            break;
+        case TRACE_SYSCALL_ENTER:
+            break; // the exit event carries the latency, so the slice survives the entry being overwritten
+        case TRACE_SYSCALL_EXIT:
+            snprintf(name, sizeof(name), "syscall %lu", e.args[0]);
+            WriteSlice(out, name, e.timestamp - std::min(e.args[1], e.timestamp), e.args[1], e.cpu, e.tid);
+            break;
+        case TRACE_PAGE_FAULT:
+            WriteInstant(out, e, "page fault", "address", "error");
+            break;
+        case TRACE_IPI_SEND:
+            WriteInstant(out, e, "IPI send", "vector", "destination");
+            break;
+        case TRACE_IPI_RECEIVE:
+            WriteInstant(out, e, "IPI receive", "vector", "type");
+            break;
+        case TRACE_KMALLOC:
+            WriteInstant(out, e, "kmalloc", "size", "address");
+            break;
+        case TRACE_KFREE:
+            WriteInstant(out, e, "kfree", "address", nullptr);
+            break;
+        default:
+            fprintf(stderr, "Unknown event type %u at %lu\n", e.type, e.timestamp);
+            break;
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    return 0;
+}